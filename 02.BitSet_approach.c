@@ -101,9 +101,14 @@ int allocateBitSet(BitSetAllocator *allocator) {
     if (allocator->nextAvailable == allocator->maxId) return -1; // No available ID
     int id = allocator->nextAvailable;
     setBit(allocator, id);
-    while (allocator->nextAvailable < allocator->maxId && isBitSet(allocator, allocator->nextAvailable)) {
-        allocator->nextAvailable++;
+    // Skip fully used bytes, then find the first clear bit of the next one with ctz
+    int byte = id / 8;
+    int bytes = (allocator->maxId + 7) / 8;
+    while (byte < bytes && allocator->bitSet[byte] == 0xFF) {
+        byte++;
     }
+    int next = byte < bytes ? byte * 8 + __builtin_ctz(~allocator->bitSet[byte] & 0xFF) : allocator->maxId;
+    allocator->nextAvailable = next < allocator->maxId ? next : allocator->maxId;
     return id;
 }
 
@@ -3,6 +3,10 @@
 #include <stdbool.h>
 #include <limits.h>
 #include <string.h>
+#include <stdint.h>
+#include <stdatomic.h>
+#include <pthread.h>
+#include <time.h>
 
 #define MAX_ID 100  // Adjust as needed
 
@@ -101,9 +105,14 @@ int allocateBitSet(BitSetAllocator *allocator) {
     if (allocator->nextAvailable == allocator->maxId) return -1; // No available ID
     int id = allocator->nextAvailable;
     setBit(allocator, id);
-    while (allocator->nextAvailable < allocator->maxId && isBitSet(allocator, allocator->nextAvailable)) {
-        allocator->nextAvailable++;
+    // Skip fully used bytes, then find the first clear bit of the next one with ctz
+    int byte = id / 8;
+    int bytes = (allocator->maxId + 7) / 8;
+    while (byte < bytes && allocator->bitSet[byte] == 0xFF) {
+        byte++;
     }
+    int next = byte < bytes ? byte * 8 + __builtin_ctz(~allocator->bitSet[byte] & 0xFF) : allocator->maxId;
+    allocator->nextAvailable = next < allocator->maxId ? next : allocator->maxId;
     return id;
 }
 
@@ -157,7 +166,14 @@ int allocateTree(TreeAllocator *allocator) {
         }
     }
     allocator->tree[index] = 1;
-    return index - allocator->maxId + 1;
+    int id = index - allocator->maxId + 1;
+    // Mark each ancestor whose children are now both full, so later searches skip it
+    while (index > 0) {
+        int parent = (index - 1) / 2;
+        allocator->tree[parent] = allocator->tree[parent * 2 + 1] && allocator->tree[parent * 2 + 2];
+        index = parent;
+    }
+    return id;
 }
 
 // Function to release an ID
@@ -177,8 +193,340 @@ void destroyTreeAllocator(TreeAllocator *allocator) {
     free(allocator);
 }
 
+// ---------------------------- Hierarchical Bitmap Approach ----------------------------
+// Level 0 has one bit per ID (1 = allocated). Each bit of level k + 1 says the matching
+// word of level k is full, up to a single top word, so a free ID is found with one ctz
+// per level. Leaf words are claimed with CAS and are the only source of truth; summary
+// bits are hints kept up to date after each change, and a stale hint only costs a retry.
+#define ID_CACHE_RELEASES 128  // IDs a thread keeps for reuse before returning half
+
+typedef struct {
+    _Atomic uint64_t *words;   // All levels, leaf level first
+    int levelOffset[8];        // First word of each level
+    int levelWords[8];
+    int levels;
+    int maxId;
+} HierarchicalAllocator;
+
+// Per-thread cache: a whole leaf word reserved at once plus recently released IDs
+typedef struct {
+    HierarchicalAllocator *allocator;
+    int word;                  // Reserved leaf word, -1 if none
+    uint64_t reserved;         // IDs of that word still unused by this thread
+    int released[ID_CACHE_RELEASES];
+    int releasedCount;
+} IdCache;
+
+static inline _Atomic uint64_t *levelWord(HierarchicalAllocator *allocator, int level, int index) {
+    return &allocator->words[allocator->levelOffset[level] + index];
+}
+
+// Function to create a hierarchical allocator
+HierarchicalAllocator* createHierarchicalAllocator(int maxId) {
+    if (maxId < 1) return NULL;
+    HierarchicalAllocator *allocator = (HierarchicalAllocator*)malloc(sizeof(HierarchicalAllocator));
+    if (!allocator) return NULL;
+    allocator->maxId = maxId;
+    allocator->levels = 0;
+    int total = 0;
+    int count = maxId; // Bits at this level
+    do {
+        allocator->levelOffset[allocator->levels] = total;
+        allocator->levelWords[allocator->levels] = (count + 63) / 64;
+        total += allocator->levelWords[allocator->levels];
+        count = allocator->levelWords[allocator->levels];
+        allocator->levels++;
+    } while (count > 1);
+    allocator->words = (_Atomic uint64_t*)malloc(total * sizeof(uint64_t));
+    if (!allocator->words) {
+        free(allocator);
+        return NULL;
+    }
+    // Bits past the end of each level count as allocated / full
+    count = maxId;
+    for (int level = 0; level < allocator->levels; level++) {
+        for (int i = 0; i < allocator->levelWords[level]; i++) {
+            int valid = count - i * 64;
+            uint64_t padding = valid >= 64 ? 0 : ~0ULL << valid;
+            atomic_init(levelWord(allocator, level, i), padding);
+        }
+        count = allocator->levelWords[level];
+    }
+    return allocator;
+}
+
+// Function to free memory
+void destroyHierarchicalAllocator(HierarchicalAllocator *allocator) {
+    free((void*)allocator->words);
+    free(allocator);
+}
+
+// Set the "full" bit of a word that was seen full, then recheck: if an ID was released
+// in between, clear the bit again so the free ID stays visible
+static void markFull(HierarchicalAllocator *allocator, int level, int index) {
+    while (level + 1 < allocator->levels) {
+        _Atomic uint64_t *parent = levelWord(allocator, level + 1, index / 64);
+        uint64_t bit = 1ULL << (index % 64);
+        uint64_t updated = atomic_fetch_or(parent, bit) | bit;
+        if (atomic_load(levelWord(allocator, level, index)) != ~0ULL) {
+            atomic_fetch_and(parent, ~bit);
+            return;
+        }
+        if (updated != ~0ULL) return;
+        index /= 64;
+        level++;
+    }
+}
+
+// A word at level went from full to not full: clear its bit up the levels
+static void markNotFull(HierarchicalAllocator *allocator, int level, int index) {
+    while (level + 1 < allocator->levels) {
+        uint64_t bit = 1ULL << (index % 64);
+        uint64_t old = atomic_fetch_and(levelWord(allocator, level + 1, index / 64), ~bit);
+        if (old != ~0ULL) return;  // Parent was not full, so nothing above changes
+        index /= 64;
+        level++;
+    }
+}
+
+// Find a leaf word that looks non-full, or -1 if the top word says everything is full
+static int findLeafWord(HierarchicalAllocator *allocator) {
+    for (;;) {
+        int index = 0;
+        int level = allocator->levels - 1;
+        for (; level > 0; level--) {
+            uint64_t word = atomic_load(levelWord(allocator, level, index));
+            if (word == ~0ULL) break;
+            index = index * 64 + __builtin_ctzll(~word);
+        }
+        if (level == 0) return index;
+        if (level == allocator->levels - 1) return -1;
+        markFull(allocator, level, index);  // Stale hint below the top: fix it and retry
+    }
+}
+
+// Function to allocate an ID with CAS on the leaf word; safe from any thread
+int allocateHierarchical(HierarchicalAllocator *allocator) {
+    for (;;) {
+        int index = findLeafWord(allocator);
+        if (index < 0) return -1;
+        _Atomic uint64_t *leaf = levelWord(allocator, 0, index);
+        uint64_t word = atomic_load(leaf);
+        while (word != ~0ULL) {
+            uint64_t bit = ~word & (word + 1);  // Lowest clear bit
+            if (atomic_compare_exchange_weak(leaf, &word, word | bit)) {
+                if ((word | bit) == ~0ULL) markFull(allocator, 0, index);
+                return index * 64 + __builtin_ctzll(bit);
+            }
+        }
+        markFull(allocator, 0, index);
+    }
+}
+
+// Return a set of IDs of one leaf word (mask of bits) to the allocator
+static void releaseLeafBits(HierarchicalAllocator *allocator, int index, uint64_t mask) {
+    uint64_t old = atomic_fetch_and(levelWord(allocator, 0, index), ~mask);
+    if (old == ~0ULL) markNotFull(allocator, 0, index);
+}
+
+// Function to release an ID; safe from any thread. Releasing a free ID does nothing.
+void releaseHierarchical(HierarchicalAllocator *allocator, int id) {
+    if (id < 0 || id >= allocator->maxId) return;
+    uint64_t bit = 1ULL << (id % 64);
+    if (atomic_load(levelWord(allocator, 0, id / 64)) & bit) {
+        releaseLeafBits(allocator, id / 64, bit);
+    }
+}
+
+// Function to check if an ID is available. IDs held in a thread's cache count as taken.
+bool checkHierarchical(HierarchicalAllocator *allocator, int id) {
+    if (id < 0 || id >= allocator->maxId) return false;
+    return !(atomic_load(levelWord(allocator, 0, id / 64)) & (1ULL << (id % 64)));
+}
+
+void initIdCache(IdCache *cache, HierarchicalAllocator *allocator) {
+    cache->allocator = allocator;
+    cache->word = -1;
+    cache->reserved = 0;
+    cache->releasedCount = 0;
+}
+
+// Function to allocate an ID through a thread's cache: recently released IDs first,
+// then the reserved word, and only when both are empty one CAS to reserve a new word
+int allocateCached(IdCache *cache) {
+    if (cache->releasedCount > 0) {
+        return cache->released[--cache->releasedCount];
+    }
+    while (!cache->reserved) {
+        int index = findLeafWord(cache->allocator);
+        if (index < 0) return -1;
+        _Atomic uint64_t *leaf = levelWord(cache->allocator, 0, index);
+        uint64_t word = atomic_load(leaf);
+        while (word != ~0ULL && !atomic_compare_exchange_weak(leaf, &word, ~0ULL)) {
+        }
+        markFull(cache->allocator, 0, index);
+        cache->word = index;
+        cache->reserved = ~word;  // Every ID that was free in the word is now ours
+    }
+    int id = cache->word * 64 + __builtin_ctzll(cache->reserved);
+    cache->reserved &= cache->reserved - 1;
+    return id;
+}
+
+// Function to release an ID through a thread's cache. The ID must have come from
+// this allocator; when the cache fills, the older half goes back to the allocator.
+void releaseCached(IdCache *cache, int id) {
+    if (id < 0 || id >= cache->allocator->maxId) return;
+    if (cache->releasedCount == ID_CACHE_RELEASES) {
+        int keep = ID_CACHE_RELEASES / 2;
+        for (int i = 0; i < keep; i++) {
+            releaseHierarchical(cache->allocator, cache->released[i]);
+        }
+        memmove(cache->released, cache->released + keep, (ID_CACHE_RELEASES - keep) * sizeof(int));
+        cache->releasedCount -= keep;
+    }
+    cache->released[cache->releasedCount++] = id;
+}
+
+// Function to return everything a thread's cache holds, e.g. before the thread exits
+void flushIdCache(IdCache *cache) {
+    if (cache->reserved) {
+        releaseLeafBits(cache->allocator, cache->word, cache->reserved);
+    }
+    for (int i = 0; i < cache->releasedCount; i++) {
+        releaseHierarchical(cache->allocator, cache->released[i]);
+    }
+    cache->word = -1;
+    cache->reserved = 0;
+    cache->releasedCount = 0;
+}
+
+// ---------------------------- Benchmark ----------------------------
+// Each thread repeatedly allocates a few IDs and releases them, on an allocator prefilled
+// to a given level. The free-list, bitset and tree allocators are not thread-safe, so
+// they run under one mutex.
+#define BENCH_MAX_ID (1 << 20)
+#define BENCH_OPS_PER_THREAD 200000
+#define BENCH_WINDOW 8
+
+typedef enum { BENCH_FREELIST, BENCH_BITSET, BENCH_TREE, BENCH_HIERARCHICAL, BENCH_CACHED, BENCH_STRATEGIES } BenchStrategy;
+
+static const char *benchNames[BENCH_STRATEGIES] = {
+    "FreeList (mutex)", "BitSet (mutex)", "Tree (mutex)", "Hierarchical (CAS)", "Hierarchical (cached)"
+};
+
+typedef struct {
+    BenchStrategy strategy;
+    void *allocator;
+    pthread_mutex_t *lock;
+    long failures;
+} BenchArgs;
+
+static int benchAllocate(BenchArgs *args, IdCache *cache) {
+    int id;
+    switch (args->strategy) {
+        case BENCH_HIERARCHICAL: return allocateHierarchical((HierarchicalAllocator*)args->allocator);
+        case BENCH_CACHED: return allocateCached(cache);
+        default: break;
+    }
+    pthread_mutex_lock(args->lock);
+    if (args->strategy == BENCH_FREELIST) id = allocate((Allocator*)args->allocator);
+    else if (args->strategy == BENCH_BITSET) id = allocateBitSet((BitSetAllocator*)args->allocator);
+    else id = allocateTree((TreeAllocator*)args->allocator);
+    pthread_mutex_unlock(args->lock);
+    return id;
+}
+
+static void benchRelease(BenchArgs *args, IdCache *cache, int id) {
+    switch (args->strategy) {
+        case BENCH_HIERARCHICAL: releaseHierarchical((HierarchicalAllocator*)args->allocator, id); return;
+        case BENCH_CACHED: releaseCached(cache, id); return;
+        default: break;
+    }
+    pthread_mutex_lock(args->lock);
+    if (args->strategy == BENCH_FREELIST) release((Allocator*)args->allocator, id);
+    else if (args->strategy == BENCH_BITSET) releaseBitSet((BitSetAllocator*)args->allocator, id);
+    else releaseTree((TreeAllocator*)args->allocator, id);
+    pthread_mutex_unlock(args->lock);
+}
+
+static void *benchThread(void *arg) {
+    BenchArgs *args = (BenchArgs*)arg;
+    IdCache cache;
+    if (args->strategy == BENCH_CACHED) initIdCache(&cache, (HierarchicalAllocator*)args->allocator);
+    int window[BENCH_WINDOW];
+    for (int op = 0; op < BENCH_OPS_PER_THREAD; op += BENCH_WINDOW) {
+        for (int i = 0; i < BENCH_WINDOW; i++) {
+            window[i] = benchAllocate(args, &cache);
+            if (window[i] < 0) args->failures++;
+        }
+        for (int i = 0; i < BENCH_WINDOW; i++) {
+            if (window[i] >= 0) benchRelease(args, &cache, window[i]);
+        }
+    }
+    if (args->strategy == BENCH_CACHED) flushIdCache(&cache);
+    return NULL;
+}
+
+static double benchRun(BenchStrategy strategy, int threads, int fillPercent) {
+    void *allocator;
+    switch (strategy) {
+        case BENCH_FREELIST: allocator = createAllocator(BENCH_MAX_ID); break;
+        case BENCH_BITSET: allocator = createBitSetAllocator(BENCH_MAX_ID); break;
+        case BENCH_TREE: allocator = createTreeAllocator(BENCH_MAX_ID); break;
+        default: allocator = createHierarchicalAllocator(BENCH_MAX_ID); break;
+    }
+    pthread_mutex_t lock = PTHREAD_MUTEX_INITIALIZER;
+    BenchArgs prefill = { strategy == BENCH_CACHED ? BENCH_HIERARCHICAL : strategy, allocator, &lock, 0 };
+    for (int i = 0; i < (long)BENCH_MAX_ID * fillPercent / 100; i++) {
+        benchAllocate(&prefill, NULL);
+    }
+
+    pthread_t tids[16];
+    BenchArgs args[16];
+    struct timespec start, end;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for (int t = 0; t < threads; t++) {
+        args[t] = (BenchArgs){ strategy, allocator, &lock, 0 };
+        pthread_create(&tids[t], NULL, benchThread, &args[t]);
+    }
+    for (int t = 0; t < threads; t++) {
+        pthread_join(tids[t], NULL);
+    }
+    clock_gettime(CLOCK_MONOTONIC, &end);
+
+    switch (strategy) {
+        case BENCH_FREELIST: destroyAllocator((Allocator*)allocator); break;
+        case BENCH_BITSET: destroyBitSetAllocator((BitSetAllocator*)allocator); break;
+        case BENCH_TREE: destroyTreeAllocator((TreeAllocator*)allocator); break;
+        default: destroyHierarchicalAllocator((HierarchicalAllocator*)allocator); break;
+    }
+    double seconds = (end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) / 1e9;
+    return 2.0 * threads * BENCH_OPS_PER_THREAD / seconds / 1e6; // Million allocate + release calls per second
+}
+
+// Function to compare all strategies across thread counts and fill levels
+void runAllocatorBenchmark(void) {
+    int threadCounts[] = {1, 2, 4, 8};
+    int fills[] = {0, 50, 90};
+    printf("\nAllocator benchmark (million operations per second, %d IDs):\n", BENCH_MAX_ID);
+    printf("%-24s %6s", "Strategy", "Fill");
+    for (int t = 0; t < 4; t++) printf(" %8d thr", threadCounts[t]);
+    printf("\n");
+    for (int s = 0; s < BENCH_STRATEGIES; s++) {
+        for (int f = 0; f < 3; f++) {
+            printf("%-24s %5d%%", benchNames[s], fills[f]);
+            for (int t = 0; t < 4; t++) {
+                printf(" %12.1f", benchRun((BenchStrategy)s, threadCounts[t], fills[f]));
+                fflush(stdout);
+            }
+            printf("\n");
+        }
+    }
+}
+
 // ---------------------------- Main Function ----------------------------
-int main() {
+int main(int argc, char *argv[]) {
     // Testing Tree Allocator
     TreeAllocator *treeAllocator = createTreeAllocator(10);
     int t1 = allocateTree(treeAllocator);
@@ -186,6 +534,22 @@ int main() {
     printf("Tree Allocated IDs: %d, %d\n", t1, t2);
     releaseTree(treeAllocator, t1);
     destroyTreeAllocator(treeAllocator);
+
+    // Testing Hierarchical Allocator
+    HierarchicalAllocator *hierarchical = createHierarchicalAllocator(10);
+    IdCache cache;
+    initIdCache(&cache, hierarchical);
+    int h1 = allocateHierarchical(hierarchical);
+    int h2 = allocateCached(&cache);
+    printf("Hierarchical Allocated IDs: %d, %d\n", h1, h2);
+    releaseCached(&cache, h2);
+    flushIdCache(&cache);
+    printf("After release, check ID %d: %s\n", h2, checkHierarchical(hierarchical, h2) ? "Available" : "Not Available");
+    destroyHierarchicalAllocator(hierarchical);
+
+    if (argc > 1 && strcmp(argv[1], "bench") == 0) {
+        runAllocatorBenchmark();
+    }
     return 0;
 }
 
@@ -3,6 +3,7 @@
 #include <stdbool.h>
 #include <limits.h>
 #include <string.h>
+#include <stdint.h>
 
 #define MAX_ID 100  // Adjust as needed
 
@@ -81,19 +82,36 @@ DownloaderBitSet* createDownloader(int size) {
 
 // Function to set a bit (mark chunk as downloaded)
 void setDownloadBit(DownloaderBitSet *downloader, int start, int end) {
-    for (int i = start; i < end; i++) {
-        downloader->bitSet[i / 8] |= (1 << (i % 8));
+    if (start < 0) start = 0;
+    if (end > downloader->size) end = downloader->size;
+    // Partial bytes at either edge bit by bit, whole bytes in between with memset
+    while (start < end && start % 8) {
+        downloader->bitSet[start / 8] |= (1 << (start % 8));
+        start++;
+    }
+    if (end - start >= 8) {
+        memset(downloader->bitSet + start / 8, 0xFF, (end - start) / 8);
+        start += (end - start) / 8 * 8;
+    }
+    for (; start < end; start++) {
+        downloader->bitSet[start / 8] |= (1 << (start % 8));
     }
 }
 
-// Function to check if file is fully downloaded
+// Function to check if file is fully downloaded, 64 bits at a time
 bool isDownloadComplete(DownloaderBitSet *downloader) {
-    for (int i = 0; i < downloader->size; i++) {
-        if (!(downloader->bitSet[i / 8] & (1 << (i % 8)))) {
-            return false;
-        }
+    int fullBytes = downloader->size / 8;
+    int i = 0;
+    for (; i + 8 <= fullBytes; i += 8) {
+        uint64_t word;
+        memcpy(&word, downloader->bitSet + i, sizeof(word));
+        if (word != ~0ULL) return false;
     }
-    return true;
+    for (; i < fullBytes; i++) {
+        if (downloader->bitSet[i] != 0xFF) return false;
+    }
+    int tail = downloader->size % 8;
+    return !tail || (downloader->bitSet[fullBytes] & ((1 << tail) - 1)) == (1 << tail) - 1;
 }
 
 // Function to free memory
@@ -123,12 +141,10 @@ DownloaderInterval* createDownloaderInterval(int size) {
 
 // Function to add a downloaded chunk
 void addDownloadChunk(DownloaderInterval *downloader, int start, int end) {
-    Interval *newChunk = (Interval*)malloc(sizeof(Interval));
-    newChunk->start = start;
-    newChunk->end = end;
-    newChunk->next = NULL;
-    
     if (!downloader->head || downloader->head->start > end) {
+        Interval *newChunk = (Interval*)malloc(sizeof(Interval));
+        newChunk->start = start;
+        newChunk->end = end;
         newChunk->next = downloader->head;
         downloader->head = newChunk;
         return;
@@ -139,14 +155,24 @@ void addDownloadChunk(DownloaderInterval *downloader, int start, int end) {
         if (current->end >= start) {
             if (current->start > start) current->start = start;
             if (current->end < end) current->end = end;
+            // The grown chunk may now reach the ones after it
+            while (current->next && current->next->start <= current->end) {
+                Interval *temp = current->next;
+                if (temp->end > current->end) current->end = temp->end;
+                current->next = temp->next;
+                free(temp);
+            }
             return;
         }
         prev = current;
         current = current->next;
     }
     
+    Interval *newChunk = (Interval*)malloc(sizeof(Interval));
+    newChunk->start = start;
+    newChunk->end = end;
     newChunk->next = current;
-    if (prev) prev->next = newChunk;
+    prev->next = newChunk;
 }
 
 // Function to check if the file is fully downloaded
@@ -165,6 +191,355 @@ void destroyDownloaderInterval(DownloaderInterval *downloader) {
     free(downloader);
 }
 
+// ---------------------------- Skip List Interval Approach ----------------------------
+// Downloaded ranges [start, end) kept disjoint and sorted in a skip list, so adding a
+// chunk, checking completion and finding the next gap are O(log n) instead of a list walk.
+#define SKIP_MAX_LEVEL 24
+
+typedef struct RangeNode {
+    int64_t start, end;
+    int level;
+    struct RangeNode *next[];  // One forward pointer per level
+} RangeNode;
+
+typedef struct {
+    RangeNode *head;           // Sentinel with SKIP_MAX_LEVEL pointers
+    int level;                 // Levels in use
+    int64_t size;
+    uint64_t seed;
+    int count;                 // Disjoint ranges stored
+} DownloaderSkipList;
+
+static RangeNode* createRangeNode(int level, int64_t start, int64_t end) {
+    RangeNode *node = (RangeNode*)malloc(sizeof(RangeNode) + level * sizeof(RangeNode*));
+    node->start = start;
+    node->end = end;
+    node->level = level;
+    return node;
+}
+
+// Function to create a Downloader using a skip list of ranges
+DownloaderSkipList* createDownloaderSkipList(int64_t size) {
+    DownloaderSkipList *downloader = (DownloaderSkipList*)malloc(sizeof(DownloaderSkipList));
+    downloader->head = createRangeNode(SKIP_MAX_LEVEL, -1, -1);
+    for (int i = 0; i < SKIP_MAX_LEVEL; i++) downloader->head->next[i] = NULL;
+    downloader->level = 1;
+    downloader->size = size;
+    downloader->seed = 0x9E3779B97F4A7C15ULL;
+    downloader->count = 0;
+    return downloader;
+}
+
+static int randomRangeLevel(DownloaderSkipList *downloader) {
+    // xorshift64; each level is kept with probability 1/4
+    downloader->seed ^= downloader->seed << 13;
+    downloader->seed ^= downloader->seed >> 7;
+    downloader->seed ^= downloader->seed << 17;
+    uint64_t bits = downloader->seed;
+    int level = 1;
+    while (level < SKIP_MAX_LEVEL && (bits & 3) == 0) {
+        level++;
+        bits >>= 2;
+    }
+    return level;
+}
+
+// Fill update[] with the last node at each level whose start is below key (the head
+// for levels not yet in use)
+static void findRangePredecessors(DownloaderSkipList *downloader, int64_t key, RangeNode **update) {
+    RangeNode *node = downloader->head;
+    for (int i = downloader->level - 1; i >= 0; i--) {
+        while (node->next[i] && node->next[i]->start < key) node = node->next[i];
+        update[i] = node;
+    }
+    for (int i = downloader->level; i < SKIP_MAX_LEVEL; i++) update[i] = downloader->head;
+}
+
+// Function to add a downloaded chunk [start, end), merging every range it touches
+void addDownloadChunkSkipList(DownloaderSkipList *downloader, int64_t start, int64_t end) {
+    if (start >= end) return;
+    RangeNode *update[SKIP_MAX_LEVEL];
+    findRangePredecessors(downloader, start, update);
+    if (update[0] != downloader->head && update[0]->end >= start) {
+        // The range before overlaps or touches: absorb it too
+        start = update[0]->start;
+        findRangePredecessors(downloader, start, update);
+    }
+    RangeNode *node = update[0]->next[0];
+    while (node && node->start <= end) {
+        if (node->end > end) end = node->end;
+        for (int i = 0; i < node->level; i++) update[i]->next[i] = node->next[i];
+        RangeNode *temp = node;
+        node = node->next[0];
+        free(temp);
+        downloader->count--;
+    }
+    int level = randomRangeLevel(downloader);
+    if (level > downloader->level) downloader->level = level;
+    node = createRangeNode(level, start, end);
+    for (int i = 0; i < level; i++) {
+        node->next[i] = update[i]->next[i];
+        update[i]->next[i] = node;
+    }
+    downloader->count++;
+}
+
+// Function to check if the file is fully downloaded
+bool isDownloadCompleteSkipList(DownloaderSkipList *downloader) {
+    RangeNode *first = downloader->head->next[0];
+    return first && first->start <= 0 && first->end >= downloader->size;
+}
+
+// Function to find the first missing range [*gapStart, *gapEnd) at or after from;
+// returns false if everything from there to the end of the file is downloaded
+bool nextMissingRangeSkipList(DownloaderSkipList *downloader, int64_t from, int64_t *gapStart, int64_t *gapEnd) {
+    if (from < 0) from = 0;
+    RangeNode *update[SKIP_MAX_LEVEL];
+    findRangePredecessors(downloader, from + 1, update); // Last range starting at or before from
+    RangeNode *node = update[0];
+    if (node != downloader->head && node->end > from) from = node->end;
+    if (from >= downloader->size) return false;
+    RangeNode *next = node->next[0];
+    while (next && next->start <= from) next = next->next[0];
+    *gapStart = from;
+    *gapEnd = next && next->start < downloader->size ? next->start : downloader->size;
+    return true;
+}
+
+// Function to free memory
+void destroyDownloaderSkipList(DownloaderSkipList *downloader) {
+    RangeNode *node = downloader->head;
+    while (node) {
+        RangeNode *temp = node;
+        node = node->next[0];
+        free(temp);
+    }
+    free(downloader);
+}
+
+// ---------------------------- Roaring Bitmap Approach ----------------------------
+// One bit per byte offset, split into 65536-bit containers picked by the high bits.
+// Each container is empty, full, a sorted list of runs (while fragmented into few
+// pieces) or a plain bitmap, so scattered chunks and finished regions both stay compact.
+// Downloads arrive as byte ranges, so runs take the place of Roaring's array containers.
+#define ROARING_CHUNK_BITS 16
+#define ROARING_CHUNK (1 << ROARING_CHUNK_BITS)
+#define ROARING_WORDS (ROARING_CHUNK / 64)
+#define ROARING_RUN_MAX 2048   // Past this, runs take more space than a bitmap
+
+typedef enum { CONTAINER_EMPTY, CONTAINER_RUN, CONTAINER_BITMAP, CONTAINER_FULL } ContainerType;
+
+typedef struct {
+    uint16_t start, last;      // Inclusive, so a run can cover the whole container
+} RoaringRun;
+
+typedef struct {
+    ContainerType type;
+    int cardinality;
+    int runCount, capacity;    // Run containers only
+    RoaringRun *runs;
+    uint64_t *bitmap;
+} RoaringContainer;
+
+typedef struct {
+    RoaringContainer *containers;
+    int64_t containerCount;
+    int64_t size;
+    int64_t fullContainers;    // Containers holding every offset they should
+} DownloaderRoaring;
+
+// Function to create a Downloader using a Roaring-style bitmap
+DownloaderRoaring* createDownloaderRoaring(int64_t size) {
+    DownloaderRoaring *downloader = (DownloaderRoaring*)malloc(sizeof(DownloaderRoaring));
+    downloader->size = size;
+    downloader->containerCount = (size + ROARING_CHUNK - 1) / ROARING_CHUNK;
+    downloader->containers = (RoaringContainer*)calloc(downloader->containerCount ? downloader->containerCount : 1, sizeof(RoaringContainer));
+    downloader->fullContainers = 0;
+    return downloader;
+}
+
+// Offsets the container at key must hold to be complete (the last one may be short)
+static int containerLimit(DownloaderRoaring *downloader, int64_t key) {
+    int64_t rest = downloader->size - key * ROARING_CHUNK;
+    return rest < ROARING_CHUNK ? (int)rest : ROARING_CHUNK;
+}
+
+// Set [lo, hi) in a bitmap container and return how many bits were newly set
+static int setBitmapRange(uint64_t *bitmap, int lo, int hi) {
+    int first = lo / 64, last = (hi - 1) / 64;
+    uint64_t firstMask = ~0ULL << (lo % 64);
+    uint64_t lastMask = ~0ULL >> (63 - (hi - 1) % 64);
+    int added = 0;
+    if (first == last) firstMask &= lastMask;
+    added += __builtin_popcountll(firstMask & ~bitmap[first]);
+    bitmap[first] |= firstMask;
+    if (first == last) return added;
+    for (int i = first + 1; i < last; i++) {
+        added += 64 - __builtin_popcountll(bitmap[i]);
+        bitmap[i] = ~0ULL;
+    }
+    added += __builtin_popcountll(lastMask & ~bitmap[last]);
+    bitmap[last] |= lastMask;
+    return added;
+}
+
+static void convertToBitmap(RoaringContainer *container) {
+    uint64_t *bitmap = (uint64_t*)calloc(ROARING_WORDS, sizeof(uint64_t));
+    for (int i = 0; i < container->runCount; i++) {
+        setBitmapRange(bitmap, container->runs[i].start, container->runs[i].last + 1);
+    }
+    free(container->runs);
+    container->runs = NULL;
+    container->runCount = container->capacity = 0;
+    container->bitmap = bitmap;
+    container->type = CONTAINER_BITMAP;
+}
+
+// First run in a run container that ends at or after value
+static int runLowerBound(const RoaringContainer *container, int value) {
+    int lo = 0, hi = container->runCount;
+    while (lo < hi) {
+        int mid = (lo + hi) / 2;
+        if (container->runs[mid].last < value) lo = mid + 1;
+        else hi = mid;
+    }
+    return lo;
+}
+
+// Add [lo, hi) of one container; limit is how many offsets the container covers
+static void containerAddRange(RoaringContainer *container, int lo, int hi, int limit) {
+    if (container->type == CONTAINER_FULL) return;
+    if (container->type != CONTAINER_BITMAP) {
+        // Runs [left, right) overlap or touch [lo, hi) and collapse into one
+        int left = runLowerBound(container, lo - 1);
+        int right = left;
+        int last = hi - 1;
+        while (right < container->runCount && container->runs[right].start <= hi) {
+            container->cardinality -= container->runs[right].last - container->runs[right].start + 1;
+            if (container->runs[right].start < lo) lo = container->runs[right].start;
+            if (container->runs[right].last > last) last = container->runs[right].last;
+            right++;
+        }
+        int merged = container->runCount - (right - left) + 1;
+        if (merged <= ROARING_RUN_MAX) {
+            if (merged > container->capacity) {
+                int capacity = container->capacity ? container->capacity * 2 : 4;
+                container->runs = (RoaringRun*)realloc(container->runs, capacity * sizeof(RoaringRun));
+                container->capacity = capacity;
+            }
+            memmove(container->runs + left + 1, container->runs + right,
+                    (container->runCount - right) * sizeof(RoaringRun));
+            container->runs[left] = (RoaringRun){ (uint16_t)lo, (uint16_t)last };
+            container->runCount = merged;
+            container->cardinality += last - lo + 1;
+            container->type = CONTAINER_RUN;
+        } else {
+            // Put the merged runs back before switching representation
+            for (int i = left; i < right; i++) {
+                container->cardinality += container->runs[i].last - container->runs[i].start + 1;
+            }
+            convertToBitmap(container);
+        }
+    }
+    if (container->type == CONTAINER_BITMAP) {
+        container->cardinality += setBitmapRange(container->bitmap, lo, hi);
+    }
+    if (container->cardinality == limit) {
+        free(container->runs);
+        free(container->bitmap);
+        container->runs = NULL;
+        container->bitmap = NULL;
+        container->runCount = container->capacity = 0;
+        container->type = CONTAINER_FULL;
+    }
+}
+
+// Function to add a downloaded chunk [start, end)
+void addDownloadChunkRoaring(DownloaderRoaring *downloader, int64_t start, int64_t end) {
+    if (start < 0) start = 0;
+    if (end > downloader->size) end = downloader->size;
+    while (start < end) {
+        int64_t key = start / ROARING_CHUNK;
+        int64_t chunkEnd = (key + 1) * ROARING_CHUNK < end ? (key + 1) * ROARING_CHUNK : end;
+        RoaringContainer *container = &downloader->containers[key];
+        bool wasFull = container->type == CONTAINER_FULL;
+        containerAddRange(container, (int)(start - key * ROARING_CHUNK), (int)(chunkEnd - key * ROARING_CHUNK),
+                          containerLimit(downloader, key));
+        if (!wasFull && container->type == CONTAINER_FULL) downloader->fullContainers++;
+        start = chunkEnd;
+    }
+}
+
+// Function to check if the file is fully downloaded
+bool isDownloadCompleteRoaring(DownloaderRoaring *downloader) {
+    return downloader->fullContainers == downloader->containerCount;
+}
+
+// Next offset >= from (within one container) that is set (want = true) or clear, or limit
+static int containerNext(const RoaringContainer *container, int from, int limit, bool want) {
+    if (from >= limit) return limit;
+    switch (container->type) {
+        case CONTAINER_EMPTY: return want ? limit : from;
+        case CONTAINER_FULL: return want ? from : limit;
+        case CONTAINER_RUN: {
+            int i = runLowerBound(container, from);
+            if (want) {
+                if (i == container->runCount) return limit;
+                return container->runs[i].start > from ? container->runs[i].start : from;
+            }
+            // Runs never touch, so the offset after a run is always clear
+            if (i < container->runCount && container->runs[i].start <= from) from = container->runs[i].last + 1;
+            return from < limit ? from : limit;
+        }
+        default: {
+            int word = from / 64;
+            uint64_t bits = (want ? container->bitmap[word] : ~container->bitmap[word]) & (~0ULL << (from % 64));
+            while (!bits) {
+                if (++word == ROARING_WORDS) return limit;
+                bits = want ? container->bitmap[word] : ~container->bitmap[word];
+            }
+            int next = word * 64 + __builtin_ctzll(bits);
+            return next < limit ? next : limit;
+        }
+    }
+}
+
+// Next offset >= from with the given state, or the file size if there is none
+static int64_t roaringNext(DownloaderRoaring *downloader, int64_t from, bool want) {
+    for (int64_t key = from / ROARING_CHUNK; key < downloader->containerCount; key++) {
+        const RoaringContainer *container = &downloader->containers[key];
+        int limit = containerLimit(downloader, key);
+        int low = key == from / ROARING_CHUNK ? (int)(from - key * ROARING_CHUNK) : 0;
+        // Whole containers of the wrong kind are skipped without looking inside
+        if (container->type == (want ? CONTAINER_EMPTY : CONTAINER_FULL)) continue;
+        int next = containerNext(container, low, limit, want);
+        if (next < limit) return key * ROARING_CHUNK + next;
+    }
+    return downloader->size;
+}
+
+// Function to find the first missing range [*gapStart, *gapEnd) at or after from;
+// returns false if everything from there to the end of the file is downloaded
+bool nextMissingRangeRoaring(DownloaderRoaring *downloader, int64_t from, int64_t *gapStart, int64_t *gapEnd) {
+    if (from < 0) from = 0;
+    if (from >= downloader->size) return false;
+    int64_t start = roaringNext(downloader, from, false);
+    if (start >= downloader->size) return false;
+    *gapStart = start;
+    *gapEnd = roaringNext(downloader, start, true);
+    return true;
+}
+
+// Function to free memory
+void destroyDownloaderRoaring(DownloaderRoaring *downloader) {
+    for (int64_t i = 0; i < downloader->containerCount; i++) {
+        free(downloader->containers[i].runs);
+        free(downloader->containers[i].bitmap);
+    }
+    free(downloader->containers);
+    free(downloader);
+}
+
 // ---------------------------- Main Function ----------------------------
 int main() {
     // Testing Download using BitSet
@@ -181,6 +556,30 @@ int main() {
     printf("File downloaded (Interval Merging): %s\n", isDownloadCompleteInterval(intervalDownloader) ? "Yes" : "No");
     destroyDownloaderInterval(intervalDownloader);
     
+    // Testing Download using a Skip List, chunks arriving out of order
+    int64_t gapStart, gapEnd;
+    DownloaderSkipList *skipDownloader = createDownloaderSkipList(100);
+    addDownloadChunkSkipList(skipDownloader, 40, 60);
+    addDownloadChunkSkipList(skipDownloader, 0, 10);
+    addDownloadChunkSkipList(skipDownloader, 10, 25);
+    if (nextMissingRangeSkipList(skipDownloader, 0, &gapStart, &gapEnd)) {
+        printf("Next missing range (Skip List): [%lld, %lld)\n", (long long)gapStart, (long long)gapEnd);
+    }
+    addDownloadChunkSkipList(skipDownloader, 20, 100);
+    printf("File downloaded (Skip List): %s\n", isDownloadCompleteSkipList(skipDownloader) ? "Yes" : "No");
+    destroyDownloaderSkipList(skipDownloader);
+    
+    // Testing Download using a Roaring Bitmap
+    DownloaderRoaring *roaringDownloader = createDownloaderRoaring(200000);
+    addDownloadChunkRoaring(roaringDownloader, 0, 70000);
+    addDownloadChunkRoaring(roaringDownloader, 70100, 200000);
+    if (nextMissingRangeRoaring(roaringDownloader, 0, &gapStart, &gapEnd)) {
+        printf("Next missing range (Roaring): [%lld, %lld)\n", (long long)gapStart, (long long)gapEnd);
+    }
+    addDownloadChunkRoaring(roaringDownloader, 70000, 70100);
+    printf("File downloaded (Roaring): %s\n", isDownloadCompleteRoaring(roaringDownloader) ? "Yes" : "No");
+    destroyDownloaderRoaring(roaringDownloader);
+    
     return 0;
 }
 
@@ -3,6 +3,7 @@
 #include <stdbool.h>
 #include <limits.h>
 #include <string.h>
+#include <stdint.h>
 
 #define MAX_ID 100  // Adjust as needed
 
@@ -84,19 +85,12 @@ SummaryRanges* createSummaryRanges() {
 
 // Function to add a number to the data stream
 void addNum(SummaryRanges *sr, int val) {
-    Interval *newInterval = (Interval*)malloc(sizeof(Interval));
-    newInterval->start = val;
-    newInterval->end = val;
-    newInterval->next = NULL;
-    
-    if (!sr->head) {
-        sr->head = newInterval;
-        return;
-    }
-    
     Interval *prev = NULL, *current = sr->head;
     while (current) {
         if (val < current->start - 1) {
+            Interval *newInterval = (Interval*)malloc(sizeof(Interval));
+            newInterval->start = val;
+            newInterval->end = val;
             newInterval->next = current;
             if (prev) prev->next = newInterval;
             else sr->head = newInterval;
@@ -120,7 +114,12 @@ void addNum(SummaryRanges *sr, int val) {
         current = current->next;
     }
     
-    prev->next = newInterval;
+    Interval *newInterval = (Interval*)malloc(sizeof(Interval));
+    newInterval->start = val;
+    newInterval->end = val;
+    newInterval->next = NULL;
+    if (prev) prev->next = newInterval;
+    else sr->head = newInterval;
 }
 
 // Function to print the intervals
@@ -145,6 +144,116 @@ void destroySummaryRanges(SummaryRanges *sr) {
     free(sr);
 }
 
+// ---------------------------- Skip List Approach for Data Stream as Disjoint Intervals ----------------------------
+// The ordered set a TreeSet would give: intervals kept sorted by start in a skip list,
+// so each addNum finds its neighbours in O(log n) instead of walking the list.
+#define SKIP_MAX_LEVEL 24
+
+typedef struct IntervalNode {
+    int start, end;
+    int level;
+    struct IntervalNode *next[];  // One forward pointer per level
+} IntervalNode;
+
+typedef struct {
+    IntervalNode *head;           // Sentinel with SKIP_MAX_LEVEL pointers
+    int level;                    // Levels in use
+    int count;                    // Disjoint intervals stored
+    uint64_t seed;
+} SummaryRangesSkipList;
+
+static IntervalNode* createIntervalNode(int level, int start, int end) {
+    IntervalNode *node = (IntervalNode*)malloc(sizeof(IntervalNode) + level * sizeof(IntervalNode*));
+    node->start = start;
+    node->end = end;
+    node->level = level;
+    return node;
+}
+
+// Function to create a SummaryRanges object backed by a skip list
+SummaryRangesSkipList* createSummaryRangesSkipList() {
+    SummaryRangesSkipList *sr = (SummaryRangesSkipList*)malloc(sizeof(SummaryRangesSkipList));
+    sr->head = createIntervalNode(SKIP_MAX_LEVEL, INT_MIN, INT_MIN);
+    for (int i = 0; i < SKIP_MAX_LEVEL; i++) sr->head->next[i] = NULL;
+    sr->level = 1;
+    sr->count = 0;
+    sr->seed = 0x9E3779B97F4A7C15ULL;
+    return sr;
+}
+
+static int randomIntervalLevel(SummaryRangesSkipList *sr) {
+    // xorshift64; each level is kept with probability 1/4
+    sr->seed ^= sr->seed << 13;
+    sr->seed ^= sr->seed >> 7;
+    sr->seed ^= sr->seed << 17;
+    uint64_t bits = sr->seed;
+    int level = 1;
+    while (level < SKIP_MAX_LEVEL && (bits & 3) == 0) {
+        level++;
+        bits >>= 2;
+    }
+    return level;
+}
+
+// Function to add a number to the data stream
+void addNumSkipList(SummaryRangesSkipList *sr, int val) {
+    // update[i] is the last interval at level i starting at or before val
+    IntervalNode *update[SKIP_MAX_LEVEL];
+    IntervalNode *node = sr->head;
+    for (int i = sr->level - 1; i >= 0; i--) {
+        while (node->next[i] && node->next[i]->start <= val) node = node->next[i];
+        update[i] = node;
+    }
+    for (int i = sr->level; i < SKIP_MAX_LEVEL; i++) update[i] = sr->head;
+
+    IntervalNode *prev = update[0] != sr->head ? update[0] : NULL;
+    IntervalNode *next = update[0]->next[0];
+    if (prev && prev->end >= val) return; // Already covered
+    bool joinPrev = prev && (int64_t)prev->end + 1 == val;
+    bool joinNext = next && (int64_t)next->start - 1 == val;
+
+    if (joinPrev && joinNext) {
+        // val fills the only gap between two intervals: keep prev, drop next
+        prev->end = next->end;
+        for (int i = 0; i < next->level; i++) update[i]->next[i] = next->next[i];
+        free(next);
+        sr->count--;
+    } else if (joinPrev) {
+        prev->end = val;
+    } else if (joinNext) {
+        next->start = val;
+    } else {
+        int level = randomIntervalLevel(sr);
+        if (level > sr->level) sr->level = level;
+        node = createIntervalNode(level, val, val);
+        for (int i = 0; i < level; i++) {
+            node->next[i] = update[i]->next[i];
+            update[i]->next[i] = node;
+        }
+        sr->count++;
+    }
+}
+
+// Function to print the intervals
+void printIntervalsSkipList(SummaryRangesSkipList *sr) {
+    printf("Intervals: ");
+    for (IntervalNode *node = sr->head->next[0]; node; node = node->next[0]) {
+        printf("[%d, %d] ", node->start, node->end);
+    }
+    printf("\n");
+}
+
+// Function to free memory
+void destroySummaryRangesSkipList(SummaryRangesSkipList *sr) {
+    IntervalNode *node = sr->head;
+    while (node) {
+        IntervalNode *temp = node;
+        node = node->next[0];
+        free(temp);
+    }
+    free(sr);
+}
+
 // ---------------------------- Main Function ----------------------------
 int main() {
     // Testing TreeSet Approach for Data Stream as Disjoint Intervals
@@ -156,6 +265,15 @@ int main() {
     addNum(sr, 6);
     printIntervals(sr);
     destroySummaryRanges(sr);
+    
+    // Testing Skip List Approach with the same stream
+    SummaryRangesSkipList *skip = createSummaryRangesSkipList();
+    int stream[] = {1, 3, 7, 2, 6};
+    for (int i = 0; i < 5; i++) {
+        addNumSkipList(skip, stream[i]);
+    }
+    printIntervalsSkipList(skip);
+    destroySummaryRangesSkipList(skip);
     return 0;
 }
 
@@ -2,144 +2,392 @@
 #include <stdlib.h>
 #include <string.h>
 #include <dirent.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <stdatomic.h>
+#include <sys/mman.h>
 #include <sys/stat.h>
 #include <openssl/sha.h>
 
-#define BUFFER_SIZE 1024
+#define BUFFER_SIZE (1024 * 1024)   // Read size when a file cannot be mapped
+#define PARTIAL_HASH_BYTES 4096     // Bytes hashed from each end of a file in the quick pass
+#define MAX_WORKER_THREADS 16       // Upper bound on directory walkers and hashers
+#define PATH_LENGTH 4096
 
-// Function to compute SHA-256 hash of a file
-char* hash_file(const char* file_path) {
-    FILE* file = fopen(file_path, "rb");
-    if (!file) {
-        perror("Error opening file");
-        return NULL;
+// A regular file found by the directory walk
+typedef struct {
+    char* path;
+    off_t size;
+    unsigned char partial[SHA256_DIGEST_LENGTH]; // First and last PARTIAL_HASH_BYTES
+    unsigned char full[SHA256_DIGEST_LENGTH];    // Whole file
+    int ok;                                      // Cleared when the file could not be read
+} FileEntry;
+
+// Growable array of files
+typedef struct {
+    FileEntry* items;
+    size_t count;
+    size_t capacity;
+} FileList;
+
+// One directory waiting to be listed
+typedef struct DirTask {
+    char* path;
+    struct DirTask* next;
+} DirTask;
+
+// Shared state of the parallel directory walk
+typedef struct {
+    pthread_mutex_t lock;
+    pthread_cond_t ready;
+    DirTask* head;
+    int busy;                                    // Walkers currently listing a directory
+    int done;
+} WalkQueue;
+
+typedef struct {
+    WalkQueue* queue;
+    FileList files;                              // Found by this walker, merged at the end
+} Walker;
+
+// A hashing pass over a list of files, split dynamically between threads
+typedef struct {
+    FileEntry** files;
+    size_t count;
+    atomic_size_t next;
+    int full;                                    // Full hash instead of the partial one
+} HashJob;
+
+static int worker_count(void) {
+    long n = sysconf(_SC_NPROCESSORS_ONLN);
+    if (n < 1) n = 1;
+    return n > MAX_WORKER_THREADS ? MAX_WORKER_THREADS : (int)n;
+}
+
+static int file_list_add(FileList* list, const char* path, off_t size) {
+    if (list->count == list->capacity) {
+        size_t capacity = list->capacity ? list->capacity * 2 : 256;
+        FileEntry* items = realloc(list->items, capacity * sizeof(FileEntry));
+        if (!items) return 0;
+        list->items = items;
+        list->capacity = capacity;
     }
+    FileEntry* entry = &list->items[list->count];
+    entry->path = strdup(path);
+    if (!entry->path) return 0;
+    entry->size = size;
+    entry->ok = 1;
+    list->count++;
+    return 1;
+}
 
-    SHA256_CTX sha256;
-    SHA256_Init(&sha256);
-    
-    unsigned char buffer[BUFFER_SIZE];
-    size_t bytesRead;
-    while ((bytesRead = fread(buffer, 1, BUFFER_SIZE, file)) > 0) {
-        SHA256_Update(&sha256, buffer, bytesRead);
-    }
-    
-    fclose(file);
-    
-    unsigned char hash[SHA256_DIGEST_LENGTH];
-    SHA256_Final(hash, &sha256);
-    
-    char* hashString = malloc(SHA256_DIGEST_LENGTH * 2 + 1);
-    for (int i = 0; i < SHA256_DIGEST_LENGTH; i++) {
-        sprintf(hashString + (i * 2), "%02x", hash[i]);
-    }
-    hashString[SHA256_DIGEST_LENGTH * 2] = '\0';
-    
-    return hashString;
-}
-
-// Function to get all files recursively
-void get_all_files(const char* path, FILE* outputFile) {
-    struct dirent *entry;
-    struct stat fileStat;
-    DIR *dir = opendir(path);
+// Stage 1: Parallel Directory Walk
+
+// Queue a directory for listing. Caller holds the queue lock.
+static void walk_push(WalkQueue* queue, const char* path) {
+    DirTask* task = malloc(sizeof(DirTask));
+    if (!task || !(task->path = strdup(path))) {
+        free(task);
+        fprintf(stderr, "Out of memory, skipping %s\n", path);
+        return;
+    }
+    task->next = queue->head;
+    queue->head = task;
+    pthread_cond_signal(&queue->ready);
+}
+
+// List one directory: record regular files with their size, queue subdirectories
+static void walk_directory(Walker* walker, const char* path) {
+    DIR* dir = opendir(path);
     if (!dir) {
         perror("Error opening directory");
         return;
     }
-    
+    char fullPath[PATH_LENGTH];
+    struct dirent* entry;
     while ((entry = readdir(dir)) != NULL) {
         if (strcmp(entry->d_name, ".") == 0 || strcmp(entry->d_name, "..") == 0)
             continue;
-        
-        char fullPath[1024];
-        snprintf(fullPath, sizeof(fullPath), "%s/%s", path, entry->d_name);
-        
-        if (lstat(fullPath, &fileStat) == -1) {
+        if (snprintf(fullPath, sizeof(fullPath), "%s/%s", path, entry->d_name) >= (int)sizeof(fullPath)) {
+            fprintf(stderr, "Path too long, skipping %s/%s\n", path, entry->d_name);
+            continue;
+        }
+
+        struct stat fileStat;
+        if (fstatat(dirfd(dir), entry->d_name, &fileStat, AT_SYMLINK_NOFOLLOW) == -1) {
             perror("Error getting file status");
             continue;
         }
-        
         if (S_ISREG(fileStat.st_mode)) { // If it's a regular file
-            char* hash = hash_file(fullPath);
-            if (hash) {
-                fprintf(outputFile, "%s %s\n", hash, fullPath);
-                free(hash);
+            if (!file_list_add(&walker->files, fullPath, fileStat.st_size)) {
+                fprintf(stderr, "Out of memory, skipping %s\n", fullPath);
             }
         } else if (S_ISDIR(fileStat.st_mode)) { // If it's a directory
-            get_all_files(fullPath, outputFile);
+            pthread_mutex_lock(&walker->queue->lock);
+            walk_push(walker->queue, fullPath);
+            pthread_mutex_unlock(&walker->queue->lock);
         }
     }
-    
     closedir(dir);
 }
 
-// Function to find duplicates from a stored hash map
+// Walker thread: list directories until none are queued and none are being listed
+static void* walk_worker(void* arg) {
+    Walker* walker = arg;
+    WalkQueue* queue = walker->queue;
+    pthread_mutex_lock(&queue->lock);
+    for (;;) {
+        while (!queue->head && !queue->done) {
+            pthread_cond_wait(&queue->ready, &queue->lock);
+        }
+        if (queue->done) break;
+        DirTask* task = queue->head;
+        queue->head = task->next;
+        queue->busy++;
+        pthread_mutex_unlock(&queue->lock);
+
+        walk_directory(walker, task->path);
+        free(task->path);
+        free(task);
+
+        pthread_mutex_lock(&queue->lock);
+        if (--queue->busy == 0 && !queue->head) {
+            // Nothing queued and nobody listing: no more directories can appear
+            queue->done = 1;
+            pthread_cond_broadcast(&queue->ready);
+        }
+    }
+    pthread_mutex_unlock(&queue->lock);
+    return NULL;
+}
+
+// Function to get all files recursively, listing directories in parallel
+static FileList get_all_files(const char* path, int threads) {
+    WalkQueue queue = { .head = NULL, .busy = 0, .done = 0 };
+    pthread_mutex_init(&queue.lock, NULL);
+    pthread_cond_init(&queue.ready, NULL);
+    walk_push(&queue, path);
+
+    Walker walkers[MAX_WORKER_THREADS];
+    pthread_t tids[MAX_WORKER_THREADS];
+    for (int i = 0; i < threads; i++) {
+        walkers[i].queue = &queue;
+        walkers[i].files = (FileList){ NULL, 0, 0 };
+        pthread_create(&tids[i], NULL, walk_worker, &walkers[i]);
+    }
+
+    FileList all = { NULL, 0, 0 };
+    for (int i = 0; i < threads; i++) {
+        pthread_join(tids[i], NULL);
+        FileList* mine = &walkers[i].files;
+        FileEntry* items = realloc(all.items, (all.count + mine->count + 1) * sizeof(FileEntry));
+        if (!items) {
+            fprintf(stderr, "Out of memory merging file lists\n");
+            exit(1);
+        }
+        all.items = items;
+        memcpy(all.items + all.count, mine->items, mine->count * sizeof(FileEntry));
+        all.count += mine->count;
+        free(mine->items);
+    }
+    pthread_mutex_destroy(&queue.lock);
+    pthread_cond_destroy(&queue.ready);
+    return all;
+}
+
+// Stages 2 and 3: Hashing
+
+// SHA-256 of the first and last PARTIAL_HASH_BYTES of a file; the whole file if it is
+// no longer than that
+static int hash_file_ends(int fd, off_t size, unsigned char digest[SHA256_DIGEST_LENGTH]) {
+    unsigned char buffer[2 * PARTIAL_HASH_BYTES];
+    size_t head = size < PARTIAL_HASH_BYTES ? (size_t)size : PARTIAL_HASH_BYTES;
+    size_t tail = size - head < PARTIAL_HASH_BYTES ? (size_t)(size - head) : PARTIAL_HASH_BYTES;
+    if (pread(fd, buffer, head, 0) != (ssize_t)head ||
+        pread(fd, buffer + head, tail, size - (off_t)tail) != (ssize_t)tail) {
+        return 0;
+    }
+    SHA256(buffer, head + tail, digest);
+    return 1;
+}
+
+// SHA-256 of a whole file: mapped and hashed in place, or read in BUFFER_SIZE chunks
+// where the file cannot be mapped
+static int hash_file_contents(int fd, off_t size, unsigned char digest[SHA256_DIGEST_LENGTH]) {
+    SHA256_CTX sha256;
+    SHA256_Init(&sha256);
+    void* map = size > 0 ? mmap(NULL, (size_t)size, PROT_READ, MAP_PRIVATE, fd, 0) : MAP_FAILED;
+    if (map != MAP_FAILED) {
+        madvise(map, (size_t)size, MADV_SEQUENTIAL);
+        SHA256_Update(&sha256, map, (size_t)size);
+        munmap(map, (size_t)size);
+    } else if (size > 0) {
+        unsigned char* buffer = malloc(BUFFER_SIZE);
+        if (!buffer) return 0;
+        ssize_t bytesRead;
+        while ((bytesRead = read(fd, buffer, BUFFER_SIZE)) > 0) {
+            SHA256_Update(&sha256, buffer, (size_t)bytesRead);
+        }
+        free(buffer);
+        if (bytesRead < 0) return 0;
+    }
+    SHA256_Final(digest, &sha256);
+    return 1;
+}
+
+// Hasher thread: take files from the job one at a time, so large files do not
+// leave the other threads idle
+static void* hash_worker(void* arg) {
+    HashJob* job = arg;
+    size_t i;
+    while ((i = atomic_fetch_add(&job->next, 1)) < job->count) {
+        FileEntry* file = job->files[i];
+        int fd = open(file->path, O_RDONLY | O_CLOEXEC);
+        if (fd < 0) {
+            perror("Error opening file");
+            file->ok = 0;
+            continue;
+        }
+        file->ok = job->full ? hash_file_contents(fd, file->size, file->full)
+                             : hash_file_ends(fd, file->size, file->partial);
+        if (!file->ok) {
+            fprintf(stderr, "Error reading %s\n", file->path);
+        }
+        close(fd);
+    }
+    return NULL;
+}
+
+// Run one hashing pass over files on a pool of threads
+static void hash_files(FileEntry** files, size_t count, int full, int threads) {
+    HashJob job = { .files = files, .count = count, .full = full };
+    atomic_init(&job.next, 0);
+    pthread_t tids[MAX_WORKER_THREADS];
+    if ((size_t)threads > count) threads = count ? (int)count : 1;
+    for (int i = 0; i < threads; i++) {
+        pthread_create(&tids[i], NULL, hash_worker, &job);
+    }
+    for (int i = 0; i < threads; i++) {
+        pthread_join(tids[i], NULL);
+    }
+}
+
+// Grouping
+
+static int compare_size(const void* a, const void* b) {
+    const FileEntry* x = a;
+    const FileEntry* y = b;
+    return (x->size > y->size) - (x->size < y->size);
+}
+
+static int compare_partial(const void* a, const void* b) {
+    const FileEntry* x = *(FileEntry* const*)a;
+    const FileEntry* y = *(FileEntry* const*)b;
+    if (x->size != y->size) return (x->size > y->size) - (x->size < y->size);
+    return memcmp(x->partial, y->partial, SHA256_DIGEST_LENGTH);
+}
+
+static int compare_full(const void* a, const void* b) {
+    const FileEntry* x = *(FileEntry* const*)a;
+    const FileEntry* y = *(FileEntry* const*)b;
+    int c = compare_partial(a, b);
+    return c ? c : memcmp(x->full, y->full, SHA256_DIGEST_LENGTH);
+}
+
+// Keep only files that share their key with another readable file in the sorted
+// list. Returns the new count.
+static size_t keep_groups(FileEntry** files, size_t count, int (*compare)(const void*, const void*)) {
+    size_t kept = 0;
+    for (size_t i = 0; i < count;) {
+        size_t j = i + 1;
+        while (j < count && compare(&files[i], &files[j]) == 0) j++;
+        size_t readable = 0;
+        for (size_t k = i; k < j; k++) readable += files[k]->ok;
+        if (readable >= 2) {
+            for (size_t k = i; k < j; k++) {
+                if (files[k]->ok) files[kept++] = files[k];
+            }
+        }
+        i = j;
+    }
+    return kept;
+}
+
+static void file_list_free(FileList* list) {
+    for (size_t i = 0; i < list->count; i++) {
+        free(list->items[i].path);
+    }
+    free(list->items);
+}
+
+// Function to find duplicates in three passes, each only on the survivors of the last:
+// equal size, then equal first and last PARTIAL_HASH_BYTES, then equal full hash
 void find_duplicates(const char* directory) {
-    FILE* tempFile = fopen("file_hashes.txt", "w");
-    if (!tempFile) {
-        perror("Error creating temporary file");
+    int threads = worker_count();
+    FileList all = get_all_files(directory, threads);
+    FileEntry** candidates = malloc((all.count + 1) * sizeof(FileEntry*));
+    if (!candidates) {
+        fprintf(stderr, "Out of memory\n");
+        file_list_free(&all);
         return;
     }
-    
-    get_all_files(directory, tempFile);
-    fclose(tempFile);
-    
-    // Read stored hashes and detect duplicates
-    FILE* inputFile = fopen("file_hashes.txt", "r");
-    if (!inputFile) {
-        perror("Error opening hash file");
+
+    // Stage 1: a file whose size is unique cannot have a duplicate
+    qsort(all.items, all.count, sizeof(FileEntry), compare_size);
+    size_t count = 0;
+    for (size_t i = 0; i < all.count;) {
+        size_t j = i + 1;
+        while (j < all.count && all.items[j].size == all.items[i].size) j++;
+        if (j - i >= 2) {
+            for (size_t k = i; k < j; k++) candidates[count++] = &all.items[k];
+        }
+        i = j;
+    }
+
+    // Stage 2: hash both ends of the same-size candidates
+    hash_files(candidates, count, 0, threads);
+    qsort(candidates, count, sizeof(FileEntry*), compare_partial);
+    count = keep_groups(candidates, count, compare_partial);
+
+    // Stage 3: fully hash the survivors longer than the two ends already hashed
+    FileEntry** longer = malloc((count + 1) * sizeof(FileEntry*));
+    if (!longer) {
+        fprintf(stderr, "Out of memory\n");
+        file_list_free(&all);
+        free(candidates);
         return;
     }
-    
-    char hash[SHA256_DIGEST_LENGTH * 2 + 1];
-    char filePath[1024];
-    
-    struct HashNode {
-        char* hash;
-        char* filePath;
-        struct HashNode* next;
-    };
-    
-    struct HashNode* hashTable[10000] = {NULL};
-    
-    while (fscanf(inputFile, "%s %s", hash, filePath) != EOF) {
-        int index = (hash[0] + hash[1]) % 10000; // Simple hash function
-        struct HashNode* newNode = malloc(sizeof(struct HashNode));
-        newNode->hash = strdup(hash);
-        newNode->filePath = strdup(filePath);
-        newNode->next = hashTable[index];
-        hashTable[index] = newNode;
-    }
-    fclose(inputFile);
-    
+    size_t longerCount = 0;
+    for (size_t i = 0; i < count; i++) {
+        if (candidates[i]->size > 2 * PARTIAL_HASH_BYTES) {
+            longer[longerCount++] = candidates[i];
+        } else {
+            memcpy(candidates[i]->full, candidates[i]->partial, SHA256_DIGEST_LENGTH);
+        }
+    }
+    hash_files(longer, longerCount, 1, threads);
+    free(longer);
+    qsort(candidates, count, sizeof(FileEntry*), compare_full);
+    count = keep_groups(candidates, count, compare_full);
+
     // Print duplicates
     printf("Duplicate files found:\n");
-    for (int i = 0; i < 10000; i++) {
-        struct HashNode* current = hashTable[i];
-        while (current) {
-            struct HashNode* runner = current->next;
-            while (runner) {
-                if (strcmp(current->hash, runner->hash) == 0) {
-                    printf("%s and %s are duplicates\n", current->filePath, runner->filePath);
-                }
-                runner = runner->next;
+    for (size_t i = 0; i < count;) {
+        size_t j = i + 1;
+        while (j < count && compare_full(&candidates[i], &candidates[j]) == 0) j++;
+        for (size_t a = i; a < j; a++) {
+            for (size_t b = a + 1; b < j; b++) {
+                printf("%s and %s are duplicates\n", candidates[a]->path, candidates[b]->path);
             }
-            current = current->next;
         }
+        i = j;
     }
-    
+
     // Cleanup memory
-    for (int i = 0; i < 10000; i++) {
-        struct HashNode* current = hashTable[i];
-        while (current) {
-            struct HashNode* temp = current;
-            current = current->next;
-            free(temp->hash);
-            free(temp->filePath);
-            free(temp);
-        }
-    }
+    file_list_free(&all);
+    free(candidates);
 }
 
 int main(int argc, char* argv[]) {
@@ -147,7 +395,7 @@ int main(int argc, char* argv[]) {
         printf("Usage: %s <directory path>\n", argv[0]);
         return 1;
     }
-    
+
     find_duplicates(argv[1]);
     return 0;
 }
@@ -2,6 +2,16 @@
 #include <stdlib.h>
 #include <string.h>
 #include <stdint.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#endif
 
 #define LARGE_PRIME 105613
 
@@ -101,7 +111,488 @@ int contains_bytes_file_rolling_hash(const unsigned char* pattern, int pattern_l
     return count > 0;
 }
 
-int main() {
+#define SEARCH_CHUNK_SIZE (4 * 1024 * 1024)      // Bytes read per chunk when a file cannot be mapped
+#define PARALLEL_MIN_BYTES (64 * 1024 * 1024)    // Smaller files are not worth splitting across threads
+#define MAX_SEARCH_THREADS 64
+
+// Called once per match with the pattern index and the file offset the match starts at
+typedef void (*match_callback)(void* ctx, int pattern_id, uint64_t offset);
+
+// Compiled set of patterns. One pattern is searched with a SIMD first-and-last-byte
+// filter; several are searched together with an Aho-Corasick automaton, so the text
+// is scanned once however many patterns there are.
+typedef struct {
+    int pattern_count;
+    unsigned char** patterns;
+    int* lengths;
+    int max_len;
+
+    // Aho-Corasick automaton, built only for more than one pattern
+    int state_count;
+    int32_t* next;          // state_count * 256 full transition table
+    int32_t* output;        // First pattern ending at a state, or -1
+    int32_t* output_next;   // Next pattern ending at the same state (duplicate patterns)
+    int32_t* dict_link;     // Nearest proper suffix state with an output, or -1
+    unsigned char start_byte[256]; // Bytes that leave the root state
+} ByteSearcher;
+
+// Where to report matches while scanning one block of text
+typedef struct {
+    const ByteSearcher* searcher;
+    uint64_t begin, end;    // Only matches starting in [begin, end) are reported
+    uint64_t report_from;   // Matches ending before this were reported with the previous block
+    match_callback callback;
+    void* ctx;
+    uint64_t* counts;       // Per-pattern match counts
+    uint64_t total;
+} ScanState;
+
+static inline void report_match(ScanState* scan, int pattern_id, uint64_t start) {
+    uint64_t last = start + scan->searcher->lengths[pattern_id] - 1;
+    if (last < scan->report_from || start < scan->begin || start >= scan->end) {
+        return;
+    }
+    scan->counts[pattern_id]++;
+    scan->total++;
+    if (scan->callback) {
+        scan->callback(scan->ctx, pattern_id, start);
+    }
+}
+
+// Single pattern: compare the first and last pattern byte against a whole vector of
+// candidate positions at once, and only run memcmp where both match
+static void scan_single(ScanState* scan, const unsigned char* text, size_t len, uint64_t base) {
+    const unsigned char* pattern = scan->searcher->patterns[0];
+    size_t m = scan->searcher->lengths[0];
+    if (len < m) return;
+    size_t last_start = len - m; // Last position a match can start at
+    size_t i = 0;
+
+    if (m == 1) {
+        const unsigned char* p = text;
+        while ((p = memchr(p, pattern[0], text + len - p)) != NULL) {
+            report_match(scan, 0, base + (p - text));
+            p++;
+        }
+        return;
+    }
+
+#if defined(__AVX2__)
+    const __m256i first = _mm256_set1_epi8((char)pattern[0]);
+    const __m256i last = _mm256_set1_epi8((char)pattern[m - 1]);
+    for (; i + 32 <= last_start + 1; i += 32) {
+        __m256i block_first = _mm256_loadu_si256((const __m256i*)(text + i));
+        __m256i block_last = _mm256_loadu_si256((const __m256i*)(text + i + m - 1));
+        uint32_t mask = (uint32_t)_mm256_movemask_epi8(
+            _mm256_and_si256(_mm256_cmpeq_epi8(block_first, first), _mm256_cmpeq_epi8(block_last, last)));
+        while (mask) {
+            int bit = __builtin_ctz(mask);
+            if (memcmp(text + i + bit + 1, pattern + 1, m - 2) == 0) {
+                report_match(scan, 0, base + i + bit);
+            }
+            mask &= mask - 1;
+        }
+    }
+#elif defined(__SSE2__)
+    const __m128i first = _mm_set1_epi8((char)pattern[0]);
+    const __m128i last = _mm_set1_epi8((char)pattern[m - 1]);
+    for (; i + 16 <= last_start + 1; i += 16) {
+        __m128i block_first = _mm_loadu_si128((const __m128i*)(text + i));
+        __m128i block_last = _mm_loadu_si128((const __m128i*)(text + i + m - 1));
+        uint32_t mask = (uint32_t)_mm_movemask_epi8(
+            _mm_and_si128(_mm_cmpeq_epi8(block_first, first), _mm_cmpeq_epi8(block_last, last)));
+        while (mask) {
+            int bit = __builtin_ctz(mask);
+            if (memcmp(text + i + bit + 1, pattern + 1, m - 2) == 0) {
+                report_match(scan, 0, base + i + bit);
+            }
+            mask &= mask - 1;
+        }
+    }
+#endif
+
+    // Scalar fallback, and the tail the vector loop could not cover
+    for (; i <= last_start; i++) {
+        if (text[i] == pattern[0] && text[i + m - 1] == pattern[m - 1] &&
+            memcmp(text + i + 1, pattern + 1, m - 2) == 0) {
+            report_match(scan, 0, base + i);
+        }
+    }
+}
+
+// Several patterns: one table lookup per byte. The automaton restarts at the root for
+// every block; the caller overlaps blocks by max_len - 1 bytes so no match is lost.
+static void scan_multi(ScanState* scan, const unsigned char* text, size_t len, uint64_t base) {
+    const ByteSearcher* searcher = scan->searcher;
+    const int32_t* next = searcher->next;
+    int32_t state = 0;
+    size_t i = 0;
+    while (i < len) {
+        if (state == 0) {
+            // Skip bytes that cannot begin any pattern without touching the table
+            while (i < len && !searcher->start_byte[text[i]]) i++;
+            if (i == len) break;
+        }
+        state = next[(size_t)state * 256 + text[i]];
+        for (int32_t s = searcher->output[state] >= 0 ? state : searcher->dict_link[state]; s >= 0;
+             s = searcher->dict_link[s]) {
+            for (int32_t p = searcher->output[s]; p >= 0; p = searcher->output_next[p]) {
+                report_match(scan, p, base + i + 1 - searcher->lengths[p]);
+            }
+        }
+        i++;
+    }
+}
+
+static void scan_block(ScanState* scan, const unsigned char* text, size_t len, uint64_t base) {
+    if (scan->searcher->pattern_count == 1) {
+        scan_single(scan, text, len, base);
+    } else {
+        scan_multi(scan, text, len, base);
+    }
+    scan->report_from = base + len;
+}
+
+// Build the Aho-Corasick automaton: a trie of the patterns, then failure links
+// resolved breadth first into a full transition table
+static int build_automaton(ByteSearcher* searcher) {
+    size_t max_states = 1;
+    for (int i = 0; i < searcher->pattern_count; i++) {
+        max_states += searcher->lengths[i];
+    }
+    searcher->next = malloc(max_states * 256 * sizeof(int32_t));
+    searcher->output = malloc(max_states * sizeof(int32_t));
+    searcher->dict_link = malloc(max_states * sizeof(int32_t));
+    searcher->output_next = malloc(searcher->pattern_count * sizeof(int32_t));
+    int32_t* fail = malloc(max_states * sizeof(int32_t));
+    int32_t* queue = malloc(max_states * sizeof(int32_t));
+    if (!searcher->next || !searcher->output || !searcher->dict_link || !searcher->output_next || !fail || !queue) {
+        free(fail);
+        free(queue);
+        return 0;
+    }
+    memset(searcher->next, 0xff, max_states * 256 * sizeof(int32_t)); // -1: no trie edge yet
+    memset(searcher->output, 0xff, max_states * sizeof(int32_t));
+    memset(searcher->start_byte, 0, sizeof(searcher->start_byte));
+    searcher->state_count = 1;
+
+    for (int p = 0; p < searcher->pattern_count; p++) {
+        int32_t state = 0;
+        for (int j = 0; j < searcher->lengths[p]; j++) {
+            int32_t* edge = &searcher->next[(size_t)state * 256 + searcher->patterns[p][j]];
+            if (*edge < 0) {
+                *edge = searcher->state_count++;
+            }
+            state = *edge;
+        }
+        searcher->output_next[p] = searcher->output[state];
+        searcher->output[state] = p;
+        searcher->start_byte[searcher->patterns[p][0]] = 1;
+    }
+
+    int head = 0, tail = 0;
+    fail[0] = 0;
+    searcher->dict_link[0] = -1;
+    for (int c = 0; c < 256; c++) {
+        int32_t child = searcher->next[c];
+        if (child < 0) {
+            searcher->next[c] = 0;
+        } else {
+            fail[child] = 0;
+            searcher->dict_link[child] = -1;
+            queue[tail++] = child;
+        }
+    }
+    while (head < tail) {
+        int32_t state = queue[head++];
+        for (int c = 0; c < 256; c++) {
+            int32_t* edge = &searcher->next[(size_t)state * 256 + c];
+            int32_t via_fail = searcher->next[(size_t)fail[state] * 256 + c];
+            if (*edge < 0) {
+                *edge = via_fail;
+            } else {
+                int32_t child = *edge;
+                fail[child] = via_fail;
+                searcher->dict_link[child] = searcher->output[via_fail] >= 0 ? via_fail : searcher->dict_link[via_fail];
+                queue[tail++] = child;
+            }
+        }
+    }
+    free(fail);
+    free(queue);
+    int32_t* shrunk = realloc(searcher->next, (size_t)searcher->state_count * 256 * sizeof(int32_t));
+    if (shrunk) searcher->next = shrunk;
+    return 1;
+}
+
+void destroy_byte_searcher(ByteSearcher* searcher) {
+    if (!searcher) return;
+    for (int i = 0; i < searcher->pattern_count; i++) {
+        free(searcher->patterns[i]);
+    }
+    free(searcher->patterns);
+    free(searcher->lengths);
+    free(searcher->next);
+    free(searcher->output);
+    free(searcher->output_next);
+    free(searcher->dict_link);
+    free(searcher);
+}
+
+// Compile patterns for searching. Returns NULL if there are no patterns, one is
+// empty, or memory runs out.
+ByteSearcher* create_byte_searcher(const unsigned char** patterns, const int* lengths, int count) {
+    if (count <= 0) return NULL;
+    ByteSearcher* searcher = calloc(1, sizeof(ByteSearcher));
+    if (!searcher) return NULL;
+    searcher->patterns = calloc(count, sizeof(unsigned char*));
+    searcher->lengths = malloc(count * sizeof(int));
+    if (!searcher->patterns || !searcher->lengths) {
+        destroy_byte_searcher(searcher);
+        return NULL;
+    }
+    for (int i = 0; i < count; i++) {
+        if (lengths[i] <= 0 || !(searcher->patterns[i] = malloc(lengths[i]))) {
+            searcher->pattern_count = i;
+            destroy_byte_searcher(searcher);
+            return NULL;
+        }
+        memcpy(searcher->patterns[i], patterns[i], lengths[i]);
+        searcher->lengths[i] = lengths[i];
+        if (lengths[i] > searcher->max_len) searcher->max_len = lengths[i];
+    }
+    searcher->pattern_count = count;
+    if (count > 1 && !build_automaton(searcher)) {
+        destroy_byte_searcher(searcher);
+        return NULL;
+    }
+    return searcher;
+}
+
+// Search a buffer already in memory. counts must hold pattern_count entries and is
+// incremented; callback may be NULL. Returns the number of matches.
+uint64_t search_buffer(const ByteSearcher* searcher, const unsigned char* text, size_t len,
+                       match_callback callback, void* ctx, uint64_t* counts) {
+    ScanState scan = { searcher, 0, UINT64_MAX, 0, callback, ctx, counts, 0 };
+    scan_block(&scan, text, len, 0);
+    return scan.total;
+}
+
+// Read a stream in large chunks, carrying the last max_len - 1 bytes of each chunk
+// to the front of the next so matches straddling the boundary are still found
+static int scan_stream(ScanState* scan, int fd) {
+    size_t overlap = scan->searcher->max_len - 1;
+    unsigned char* buffer = malloc(SEARCH_CHUNK_SIZE + overlap);
+    if (!buffer) return 0;
+    size_t kept = 0;
+    uint64_t offset = 0; // File offset of buffer[0]
+    for (;;) {
+        ssize_t bytes_read = read(fd, buffer + kept, SEARCH_CHUNK_SIZE);
+        if (bytes_read < 0) {
+            free(buffer);
+            return 0;
+        }
+        if (bytes_read == 0) break;
+        size_t len = kept + bytes_read;
+        scan_block(scan, buffer, len, offset);
+        kept = len < overlap ? len : overlap;
+        memmove(buffer, buffer + len - kept, kept);
+        offset += len - kept;
+    }
+    free(buffer);
+    return 1;
+}
+
+// One thread's share of a file: matches starting in [begin, end), read from the
+// mapping if there is one, otherwise with pread in overlapping chunks
+typedef struct {
+    ScanState scan;
+    const unsigned char* map;
+    int fd;
+    uint64_t file_size;
+    int ok;
+    // Matches buffered for the callback, replayed in file order after all threads finish
+    struct { int pattern_id; uint64_t offset; }* matches;
+    size_t match_count, match_capacity;
+} RangeWorker;
+
+static void buffer_match(void* ctx, int pattern_id, uint64_t offset) {
+    RangeWorker* worker = ctx;
+    if (worker->match_count == worker->match_capacity) {
+        size_t capacity = worker->match_capacity ? worker->match_capacity * 2 : 1024;
+        void* matches = realloc(worker->matches, capacity * sizeof(*worker->matches));
+        if (!matches) {
+            worker->ok = 0;
+            return;
+        }
+        worker->matches = matches;
+        worker->match_capacity = capacity;
+    }
+    worker->matches[worker->match_count].pattern_id = pattern_id;
+    worker->matches[worker->match_count].offset = offset;
+    worker->match_count++;
+}
+
+static void* range_worker(void* arg) {
+    RangeWorker* worker = arg;
+    ScanState* scan = &worker->scan;
+    uint64_t overlap = scan->searcher->max_len - 1;
+    uint64_t from = scan->begin > overlap ? scan->begin - overlap : 0;
+    uint64_t to = scan->end + overlap < worker->file_size ? scan->end + overlap : worker->file_size;
+    scan->report_from = scan->begin;
+
+    if (worker->map) {
+        scan_block(scan, worker->map + from, to - from, from);
+        return NULL;
+    }
+    unsigned char* buffer = malloc(SEARCH_CHUNK_SIZE + overlap);
+    if (!buffer) {
+        worker->ok = 0;
+        return NULL;
+    }
+    while (from < to) {
+        size_t want = to - from < SEARCH_CHUNK_SIZE + overlap ? to - from : SEARCH_CHUNK_SIZE + overlap;
+        ssize_t bytes_read = pread(worker->fd, buffer, want, from);
+        if (bytes_read <= 0) {
+            worker->ok = 0;
+            break;
+        }
+        scan_block(scan, buffer, bytes_read, from);
+        if (from + bytes_read >= to) break;
+        from += (uint64_t)bytes_read > overlap ? (uint64_t)bytes_read - overlap : (uint64_t)bytes_read;
+    }
+    free(buffer);
+    return NULL;
+}
+
+// Search a file for every pattern. Regular files are mapped and, when large enough and
+// threads > 1, split into ranges searched in parallel; pipes and other streams are
+// read in chunks. The callback, if any, is only called from the calling thread, one
+// range after another. Returns the number of matches, or -1 on error.
+int64_t search_file(const ByteSearcher* searcher, const char* path, int threads,
+                    match_callback callback, void* ctx, uint64_t* counts) {
+    int fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        perror("Error opening file");
+        return -1;
+    }
+    struct stat file_stat;
+    if (fstat(fd, &file_stat) != 0) {
+        close(fd);
+        return -1;
+    }
+
+    if (!S_ISREG(file_stat.st_mode)) {
+        ScanState scan = { searcher, 0, UINT64_MAX, 0, callback, ctx, counts, 0 };
+        int ok = scan_stream(&scan, fd);
+        close(fd);
+        return ok ? (int64_t)scan.total : -1;
+    }
+
+    uint64_t file_size = file_stat.st_size;
+    const unsigned char* map = NULL;
+    if (file_size > 0) {
+        void* mapped = mmap(NULL, file_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (mapped != MAP_FAILED) {
+            map = mapped;
+            madvise(mapped, file_size, MADV_SEQUENTIAL);
+        }
+    }
+
+    if (threads < 1 || file_size < PARALLEL_MIN_BYTES) threads = 1;
+    if (threads > MAX_SEARCH_THREADS) threads = MAX_SEARCH_THREADS;
+    RangeWorker* workers = calloc(threads, sizeof(RangeWorker));
+    uint64_t* worker_counts = calloc((size_t)threads * searcher->pattern_count, sizeof(uint64_t));
+    pthread_t tids[MAX_SEARCH_THREADS];
+    int64_t total = -1;
+    if (workers && worker_counts) {
+        uint64_t range = (file_size + threads - 1) / threads;
+        for (int t = 0; t < threads; t++) {
+            RangeWorker* worker = &workers[t];
+            uint64_t begin = range * t < file_size ? range * t : file_size;
+            uint64_t end = begin + range < file_size ? begin + range : file_size;
+            worker->scan = (ScanState){ searcher, begin, end, begin,
+                                        threads > 1 && callback ? buffer_match : callback,
+                                        threads > 1 ? (void*)worker : ctx,
+                                        worker_counts + (size_t)t * searcher->pattern_count, 0 };
+            worker->map = map;
+            worker->fd = fd;
+            worker->file_size = file_size;
+            worker->ok = 1;
+        }
+        for (int t = 1; t < threads; t++) {
+            pthread_create(&tids[t], NULL, range_worker, &workers[t]);
+        }
+        range_worker(&workers[0]);
+        for (int t = 1; t < threads; t++) {
+            pthread_join(tids[t], NULL);
+        }
+
+        total = 0;
+        for (int t = 0; t < threads; t++) {
+            RangeWorker* worker = &workers[t];
+            if (!worker->ok) total = -1;
+            for (size_t i = 0; total >= 0 && i < worker->match_count; i++) {
+                callback(ctx, worker->matches[i].pattern_id, worker->matches[i].offset);
+            }
+            for (int p = 0; p < searcher->pattern_count; p++) {
+                counts[p] += worker->scan.counts[p];
+            }
+            if (total >= 0) total += worker->scan.total;
+            free(worker->matches);
+        }
+    }
+    free(workers);
+    free(worker_counts);
+    if (map) munmap((void*)map, file_size);
+    close(fd);
+    return total;
+}
+
+static void print_match(void* ctx, int pattern_id, uint64_t offset) {
+    const ByteSearcher* searcher = ctx;
+    printf("Pattern %d (%.*s) found at file position %llu\n", pattern_id, searcher->lengths[pattern_id],
+           (const char*)searcher->patterns[pattern_id], (unsigned long long)offset);
+}
+
+// Search a file for every pattern given on the command line and print per-pattern totals
+static int run_search_engine(const char* path, char** args, int count) {
+    const unsigned char** patterns = malloc(count * sizeof(unsigned char*));
+    int* lengths = malloc(count * sizeof(int));
+    uint64_t* counts = calloc(count, sizeof(uint64_t));
+    ByteSearcher* searcher = NULL;
+    int64_t total = -1;
+    if (patterns && lengths && counts) {
+        for (int i = 0; i < count; i++) {
+            patterns[i] = (const unsigned char*)args[i];
+            lengths[i] = strlen(args[i]);
+        }
+        searcher = create_byte_searcher(patterns, lengths, count);
+    }
+    if (searcher) {
+        long threads = sysconf(_SC_NPROCESSORS_ONLN);
+        total = search_file(searcher, path, threads > 0 ? (int)threads : 1,
+                            getenv("SEARCH_VERBOSE") ? print_match : NULL, searcher, counts);
+        for (int i = 0; total >= 0 && i < count; i++) {
+            printf("%s: %llu\n", args[i], (unsigned long long)counts[i]);
+        }
+        if (total >= 0) printf("Total occurrences in file: %lld\n", (long long)total);
+    } else {
+        printf("Invalid patterns.\n");
+    }
+    destroy_byte_searcher(searcher);
+    free(patterns);
+    free(lengths);
+    free(counts);
+    return total >= 0 ? 0 : 1;
+}
+
+int main(int argc, char* argv[]) {
+    // <file> <pattern>...: search with the engine instead of running the examples
+    if (argc >= 3) {
+        return run_search_engine(argv[1], argv + 2, argc - 2);
+    }
+
     // Example usage
     unsigned char text[] = "This is a sample text for testing substring search. substring is here again.";
     unsigned char pattern[] = "substring";
@@ -123,7 +614,21 @@ int main() {
     } else {
         printf("Error opening file.\n");
     }
-    
+
+    // Several patterns in one pass through the buffer
+    const unsigned char* patterns[] = { (const unsigned char*)"substring", (const unsigned char*)"text",
+                                        (const unsigned char*)"is" };
+    int lengths[] = { 9, 4, 2 };
+    uint64_t counts[3] = { 0 };
+    ByteSearcher* searcher = create_byte_searcher(patterns, lengths, 3);
+    if (searcher) {
+        search_buffer(searcher, text, strlen((char*)text), NULL, NULL, counts);
+        for (int i = 0; i < 3; i++) {
+            printf("%s: %llu occurrences using Aho-Corasick\n", (const char*)patterns[i], (unsigned long long)counts[i]);
+        }
+        destroy_byte_searcher(searcher);
+    }
+
     return 0;
 }
 
@@ -2,6 +2,8 @@
 #include <stdlib.h>
 #include <string.h>
 #include <stdbool.h>
+#include <stdint.h>
+#include <pthread.h>
 
 #define MAX_PHOTOS 10000
 
@@ -124,6 +126,288 @@ void printTopK(TopKPhoto* tracker) {
     }
 }
 
+// Streaming heavy hitters for 64-bit photo ids (Space-Saving). A fixed number of
+// counters is kept no matter how many distinct ids are seen: when a new id arrives
+// and every counter is taken, it replaces the photo with the fewest views and inherits
+// that count as its possible overestimate. Any photo viewed more than
+// totalViews / capacity times is guaranteed to hold a counter.
+#define LOCAL_COUNTER_SLOTS 512     // Distinct ids a thread buffers before merging
+#define LOCAL_FLUSH_VIEWS 4096      // Views a thread buffers before merging
+
+// One Space-Saving counter
+typedef struct {
+    uint64_t id;
+    uint64_t views;        // Estimated views, never below the true count
+    uint64_t error;        // Views inherited from the evicted photo, an upper bound on overcounting
+} HeavyHitter;
+
+// Shared summary: counters kept as a min-heap on views, plus an id -> heap position index
+typedef struct {
+    pthread_mutex_t lock;
+    HeavyHitter* heap;
+    int size;
+    int capacity;
+    uint32_t* index;       // Open addressing, heap position + 1, 0 when empty
+    uint32_t indexMask;
+    uint64_t totalViews;
+} HeavyHitterTracker;
+
+// Per-thread view buffer, merged into the shared summary in batches so threads take
+// the lock once per LOCAL_FLUSH_VIEWS views instead of once per view
+typedef struct {
+    HeavyHitterTracker* tracker;
+    uint64_t ids[LOCAL_COUNTER_SLOTS];
+    uint32_t counts[LOCAL_COUNTER_SLOTS]; // 0 when the slot is empty
+    int used;
+    int pending;
+} LocalViewCounter;
+
+static inline uint32_t photoHash(uint64_t id) {
+    id ^= id >> 33;
+    id *= 0xff51afd7ed558ccdULL;
+    id ^= id >> 33;
+    id *= 0xc4ceb9fe1a85ec53ULL;
+    id ^= id >> 33;
+    return (uint32_t)id;
+}
+
+// Find the index slot holding id, or the empty slot where it would go
+static uint32_t findIndexSlot(const HeavyHitterTracker* tracker, uint64_t id) {
+    uint32_t slot = photoHash(id) & tracker->indexMask;
+    while (tracker->index[slot] && tracker->heap[tracker->index[slot] - 1].id != id) {
+        slot = (slot + 1) & tracker->indexMask;
+    }
+    return slot;
+}
+
+// Remove an index slot, shifting later entries of the probe run back into the gap
+static void removeIndexSlot(HeavyHitterTracker* tracker, uint32_t slot) {
+    uint32_t next = (slot + 1) & tracker->indexMask;
+    while (tracker->index[next]) {
+        uint32_t home = photoHash(tracker->heap[tracker->index[next] - 1].id) & tracker->indexMask;
+        // Move the entry back if its home is not between the gap and its current slot
+        if (((next - home) & tracker->indexMask) >= ((next - slot) & tracker->indexMask)) {
+            tracker->index[slot] = tracker->index[next];
+            slot = next;
+        }
+        next = (next + 1) & tracker->indexMask;
+    }
+    tracker->index[slot] = 0;
+}
+
+static void swapHeapEntries(HeavyHitterTracker* tracker, int a, int b) {
+    uint32_t slotA = findIndexSlot(tracker, tracker->heap[a].id);
+    uint32_t slotB = findIndexSlot(tracker, tracker->heap[b].id);
+    HeavyHitter tmp = tracker->heap[a];
+    tracker->heap[a] = tracker->heap[b];
+    tracker->heap[b] = tmp;
+    tracker->index[slotA] = b + 1;
+    tracker->index[slotB] = a + 1;
+}
+
+// Restore the heap after heap[pos].views grew
+static void siftDown(HeavyHitterTracker* tracker, int pos) {
+    for (;;) {
+        int smallest = pos;
+        int left = 2 * pos + 1;
+        int right = left + 1;
+        if (left < tracker->size && tracker->heap[left].views < tracker->heap[smallest].views) smallest = left;
+        if (right < tracker->size && tracker->heap[right].views < tracker->heap[smallest].views) smallest = right;
+        if (smallest == pos) return;
+        swapHeapEntries(tracker, pos, smallest);
+        pos = smallest;
+    }
+}
+
+// Restore the heap after inserting at heap[pos]
+static void siftUp(HeavyHitterTracker* tracker, int pos) {
+    while (pos > 0 && tracker->heap[(pos - 1) / 2].views > tracker->heap[pos].views) {
+        swapHeapEntries(tracker, pos, (pos - 1) / 2);
+        pos = (pos - 1) / 2;
+    }
+}
+
+// Create a tracker with a fixed number of counters
+HeavyHitterTracker* createHeavyHitterTracker(int capacity) {
+    if (capacity < 1) return NULL;
+    HeavyHitterTracker* tracker = (HeavyHitterTracker*)calloc(1, sizeof(HeavyHitterTracker));
+    if (!tracker) return NULL;
+    uint32_t indexSize = 1;
+    while (indexSize < (uint32_t)capacity * 2) indexSize <<= 1;
+    tracker->heap = (HeavyHitter*)malloc(capacity * sizeof(HeavyHitter));
+    tracker->index = (uint32_t*)calloc(indexSize, sizeof(uint32_t));
+    if (!tracker->heap || !tracker->index) {
+        free(tracker->heap);
+        free(tracker->index);
+        free(tracker);
+        return NULL;
+    }
+    tracker->capacity = capacity;
+    tracker->indexMask = indexSize - 1;
+    pthread_mutex_init(&tracker->lock, NULL);
+    return tracker;
+}
+
+void destroyHeavyHitterTracker(HeavyHitterTracker* tracker) {
+    if (!tracker) return;
+    pthread_mutex_destroy(&tracker->lock);
+    free(tracker->heap);
+    free(tracker->index);
+    free(tracker);
+}
+
+// Add views for one photo. Caller holds the lock.
+static void addViewsLocked(HeavyHitterTracker* tracker, uint64_t id, uint64_t views) {
+    tracker->totalViews += views;
+    uint32_t slot = findIndexSlot(tracker, id);
+    if (tracker->index[slot]) {
+        int pos = tracker->index[slot] - 1;
+        tracker->heap[pos].views += views;
+        siftDown(tracker, pos);
+    } else if (tracker->size < tracker->capacity) {
+        int pos = tracker->size++;
+        tracker->heap[pos] = (HeavyHitter){ id, views, 0 };
+        tracker->index[slot] = pos + 1;
+        siftUp(tracker, pos);
+    } else {
+        // Replace the photo with the fewest views; the new one inherits its count
+        HeavyHitter* minimum = &tracker->heap[0];
+        removeIndexSlot(tracker, findIndexSlot(tracker, minimum->id));
+        minimum->error = minimum->views;
+        minimum->views += views;
+        minimum->id = id;
+        tracker->index[findIndexSlot(tracker, id)] = 1;
+        siftDown(tracker, 0);
+    }
+}
+
+// Record views directly in the shared summary
+void recordViews(HeavyHitterTracker* tracker, uint64_t id, uint64_t views) {
+    pthread_mutex_lock(&tracker->lock);
+    addViewsLocked(tracker, id, views);
+    pthread_mutex_unlock(&tracker->lock);
+}
+
+void initLocalViewCounter(LocalViewCounter* local, HeavyHitterTracker* tracker) {
+    memset(local, 0, sizeof(LocalViewCounter));
+    local->tracker = tracker;
+}
+
+// Merge a thread's buffered views into the shared summary and empty the buffer
+void flushLocalViewCounter(LocalViewCounter* local) {
+    if (local->used == 0) return;
+    pthread_mutex_lock(&local->tracker->lock);
+    for (int i = 0; i < LOCAL_COUNTER_SLOTS; i++) {
+        if (local->counts[i]) {
+            addViewsLocked(local->tracker, local->ids[i], local->counts[i]);
+            local->counts[i] = 0;
+        }
+    }
+    pthread_mutex_unlock(&local->tracker->lock);
+    local->used = 0;
+    local->pending = 0;
+}
+
+// Record one view in the calling thread's buffer, merging it when it is 3/4 full or
+// has held LOCAL_FLUSH_VIEWS views
+void viewPhotoLocal(LocalViewCounter* local, uint64_t id) {
+    uint32_t slot = photoHash(id) & (LOCAL_COUNTER_SLOTS - 1);
+    while (local->counts[slot] && local->ids[slot] != id) {
+        slot = (slot + 1) & (LOCAL_COUNTER_SLOTS - 1);
+    }
+    if (!local->counts[slot]) {
+        local->ids[slot] = id;
+        local->used++;
+    }
+    local->counts[slot]++;
+    if (++local->pending >= LOCAL_FLUSH_VIEWS || local->used * 4 >= LOCAL_COUNTER_SLOTS * 3) {
+        flushLocalViewCounter(local);
+    }
+}
+
+static int compareHeavyHitters(const void* a, const void* b) {
+    const HeavyHitter* x = (const HeavyHitter*)a;
+    const HeavyHitter* y = (const HeavyHitter*)b;
+    if (x->views != y->views) return x->views < y->views ? 1 : -1;
+    return (x->id > y->id) - (x->id < y->id);
+}
+
+// Copy out the k most viewed photos, most viewed first. The lock is held only for the
+// copy of the counters; sorting happens outside it. Views still buffered in local
+// counters are not included. Returns the number of entries written.
+int snapshotHeavyHitters(HeavyHitterTracker* tracker, HeavyHitter* out, int k, uint64_t* totalViews) {
+    HeavyHitter* copy = (HeavyHitter*)malloc(tracker->capacity * sizeof(HeavyHitter));
+    if (!copy) return 0;
+    pthread_mutex_lock(&tracker->lock);
+    int size = tracker->size;
+    memcpy(copy, tracker->heap, size * sizeof(HeavyHitter));
+    if (totalViews) *totalViews = tracker->totalViews;
+    pthread_mutex_unlock(&tracker->lock);
+
+    qsort(copy, size, sizeof(HeavyHitter), compareHeavyHitters);
+    if (k > size) k = size;
+    memcpy(out, copy, k * sizeof(HeavyHitter));
+    free(copy);
+    return k;
+}
+
+// Print the top k viewed photos from a snapshot of the shared summary
+void printTopKHeavyHitters(HeavyHitterTracker* tracker, int k) {
+    HeavyHitter* top = (HeavyHitter*)malloc((k > 0 ? k : 1) * sizeof(HeavyHitter));
+    if (!top) return;
+    uint64_t totalViews = 0;
+    int count = snapshotHeavyHitters(tracker, top, k, &totalViews);
+    printf("Top %d most viewed photos (of %llu views):\n", k, (unsigned long long)totalViews);
+    for (int i = 0; i < count; i++) {
+        printf("Photo ID: %llu, Views: %llu (overcount at most %llu)\n", (unsigned long long)top[i].id,
+               (unsigned long long)top[i].views, (unsigned long long)top[i].error);
+    }
+    free(top);
+}
+
+#define DEMO_THREADS 4
+#define DEMO_VIEWS_PER_THREAD 200000
+
+typedef struct {
+    HeavyHitterTracker* tracker;
+    unsigned int seed;
+} ViewerArgs;
+
+// Simulated viewer: a few popular photos among a long tail of random 64-bit ids
+static void* viewerThread(void* arg) {
+    ViewerArgs* args = (ViewerArgs*)arg;
+    LocalViewCounter local;
+    initLocalViewCounter(&local, args->tracker);
+    for (int i = 0; i < DEMO_VIEWS_PER_THREAD; i++) {
+        uint64_t id;
+        int r = rand_r(&args->seed) % 100;
+        if (r < 30) {
+            id = 0x9e3779b97f4a7c15ULL * (uint64_t)(1 + r % 5); // 5 popular photos
+        } else {
+            id = ((uint64_t)rand_r(&args->seed) << 32) ^ (uint64_t)rand_r(&args->seed);
+        }
+        viewPhotoLocal(&local, id);
+    }
+    flushLocalViewCounter(&local);
+    return NULL;
+}
+
+static void runHeavyHittersDemo(void) {
+    HeavyHitterTracker* tracker = createHeavyHitterTracker(256);
+    if (!tracker) return;
+    pthread_t threads[DEMO_THREADS];
+    ViewerArgs args[DEMO_THREADS];
+    for (int i = 0; i < DEMO_THREADS; i++) {
+        args[i] = (ViewerArgs){ tracker, (unsigned int)(i + 1) };
+        pthread_create(&threads[i], NULL, viewerThread, &args[i]);
+    }
+    for (int i = 0; i < DEMO_THREADS; i++) {
+        pthread_join(threads[i], NULL);
+    }
+    printTopKHeavyHitters(tracker, 5);
+    destroyHeavyHitterTracker(tracker);
+}
+
 int main() {
     TopKPhoto tracker;
     initTopK(&tracker, 4);
@@ -136,6 +420,8 @@ int main() {
     }
     
     printTopK(&tracker);
+
+    runHeavyHittersDemo();
     return 0;
 }
 
@@ -2,6 +2,11 @@
 #include <stdlib.h>
 #include <string.h>
 #include <stdbool.h>
+#include <stdint.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
 
 /* Trie Structure (TrieNode): Efficient prefix-based word search.
    Word Insertion (insertWord): Adds words to the Trie.
@@ -14,6 +19,15 @@
    
    This approach efficiently filters invalid paths in O(1) prefix lookup time, 
    reducing unnecessary DFS calls
+
+   Compact Trie (CompactTrie): Read-only minimized DAWG built from the Trie, with
+   equal subtrees (e.g. shared suffixes) stored once, in one contiguous buffer.
+   Each node is 16 bytes and each edge 4, instead of a 216-byte node with 26 pointers.
+   Serialization (saveCompactTrie / loadCompactTrie): The buffer is written as-is and
+   mmap'd back, so loading costs no parsing and pages are read on demand.
+   T9 Lookup (compactLetterCombinations): A node's edges are sorted by letter, so the
+   letters of each key are a contiguous range; each node stores those ranges per
+   digit and the traversal uses an explicit stack instead of recursion.
 */
 
 #define MAX_CHILDREN 26  // Alphabet size
@@ -110,6 +124,340 @@ char** letterCombinations(TrieNode* root, const char* digits, int* returnSize) {
     return results;
 }
 
+// Compact trie layout: header, then nodes, then edges
+#define COMPACT_TRIE_MAGIC 0x3139414457414454ULL // "TDAWDA91"
+#define COMPACT_TRIE_VERSION 1
+#define T9_DIGITS 8                  // Keys 2-9 carry letters
+#define MAX_WORD_LENGTH 256
+
+typedef struct {
+    uint64_t magic;
+    uint32_t version;
+    uint32_t nodeCount;
+    uint32_t edgeCount;
+    uint32_t root;
+} CompactTrieHeader;
+
+typedef struct {
+    uint32_t firstEdge;
+    uint8_t isWord;
+    uint8_t digitEnd[T9_DIGITS];     // Edges of keys 2..d are firstEdge + [0, digitEnd[d - 2])
+    uint8_t reserved[3];
+} CompactNode;
+
+// Edge: target node in the upper 27 bits, letter index in the lower 5
+typedef uint32_t CompactEdge;
+#define EDGE_LETTER(edge) ((edge) & 31)
+#define EDGE_TARGET(edge) ((edge) >> 5)
+
+typedef struct {
+    const CompactTrieHeader* header;
+    const CompactNode* nodes;
+    const CompactEdge* edges;
+    void* buffer;
+    size_t bufferSize;
+    bool mapped;                     // buffer is an mmap of a saved trie
+} CompactTrie;
+
+// Builder state: nodes and edges so far plus a hash of node signatures, so a subtree
+// equal to one already emitted is reused instead of stored again
+typedef struct {
+    CompactNode* nodes;
+    CompactEdge* edges;
+    uint32_t nodeCount, nodeCapacity;
+    uint32_t edgeCount, edgeCapacity;
+    uint32_t* table;                 // Node id + 1, 0 when empty
+    uint32_t tableMask;
+    bool failed;
+} CompactBuilder;
+
+// Key (2-9) for each letter
+static const uint8_t LETTER_DIGIT[MAX_CHILDREN] = {
+    2, 2, 2, 3, 3, 3, 4, 4, 4, 5, 5, 5, 6, 6, 6, 7, 7, 7, 7, 8, 8, 8, 9, 9, 9, 9
+};
+
+static uint32_t nodeSignatureHash(bool isWord, const CompactEdge* edges, int count) {
+    uint32_t hash = isWord ? 0x9e3779b9u : 0x7f4a7c15u;
+    for (int i = 0; i < count; i++) {
+        hash = (hash ^ edges[i]) * 0x01000193u;
+    }
+    return hash ^ (hash >> 16);
+}
+
+static uint32_t nodeEdgeCount(const CompactNode* node) {
+    return node->digitEnd[T9_DIGITS - 1];
+}
+
+static bool growBuilderTable(CompactBuilder* builder) {
+    uint32_t size = (builder->tableMask + 1) * 2;
+    uint32_t* table = (uint32_t*)calloc(size, sizeof(uint32_t));
+    if (!table) return false;
+    for (uint32_t i = 0; i <= builder->tableMask; i++) {
+        uint32_t id = builder->table[i];
+        if (!id) continue;
+        const CompactNode* node = &builder->nodes[id - 1];
+        uint32_t slot = nodeSignatureHash(node->isWord, builder->edges + node->firstEdge, nodeEdgeCount(node)) & (size - 1);
+        while (table[slot]) slot = (slot + 1) & (size - 1);
+        table[slot] = id;
+    }
+    free(builder->table);
+    builder->table = table;
+    builder->tableMask = size - 1;
+    return true;
+}
+
+// Emit a node with the given sorted edges, or return the id of an identical one
+static uint32_t internNode(CompactBuilder* builder, bool isWord, const CompactEdge* edges, int count) {
+    uint32_t slot = nodeSignatureHash(isWord, edges, count) & builder->tableMask;
+    while (builder->table[slot]) {
+        const CompactNode* node = &builder->nodes[builder->table[slot] - 1];
+        if (node->isWord == isWord && (int)nodeEdgeCount(node) == count &&
+            memcmp(builder->edges + node->firstEdge, edges, count * sizeof(CompactEdge)) == 0) {
+            return builder->table[slot] - 1;
+        }
+        slot = (slot + 1) & builder->tableMask;
+    }
+
+    if (builder->nodeCount == builder->nodeCapacity) {
+        uint32_t capacity = builder->nodeCapacity * 2;
+        CompactNode* nodes = (CompactNode*)realloc(builder->nodes, capacity * sizeof(CompactNode));
+        if (!nodes) { builder->failed = true; return 0; }
+        builder->nodes = nodes;
+        builder->nodeCapacity = capacity;
+    }
+    while (builder->edgeCount + count > builder->edgeCapacity) {
+        uint32_t capacity = builder->edgeCapacity * 2;
+        CompactEdge* grown = (CompactEdge*)realloc(builder->edges, capacity * sizeof(CompactEdge));
+        if (!grown) { builder->failed = true; return 0; }
+        builder->edges = grown;
+        builder->edgeCapacity = capacity;
+    }
+
+    if (builder->nodeCount >= (1u << 27)) { builder->failed = true; return 0; } // Edge target width
+    uint32_t id = builder->nodeCount++;
+    CompactNode* node = &builder->nodes[id];
+    memset(node, 0, sizeof(CompactNode));
+    node->firstEdge = builder->edgeCount;
+    node->isWord = isWord;
+    for (int i = 0; i < count; i++) {
+        node->digitEnd[LETTER_DIGIT[EDGE_LETTER(edges[i])] - 2] = i + 1;
+    }
+    for (int d = 1; d < T9_DIGITS; d++) {
+        if (node->digitEnd[d] < node->digitEnd[d - 1]) node->digitEnd[d] = node->digitEnd[d - 1];
+    }
+    memcpy(builder->edges + builder->edgeCount, edges, count * sizeof(CompactEdge));
+    builder->edgeCount += count;
+    builder->table[slot] = id + 1;
+    if (builder->nodeCount * 2 > builder->tableMask && !growBuilderTable(builder)) {
+        builder->failed = true;
+    }
+    return id;
+}
+
+// Post-order: children are interned before their parent so equal subtrees get equal ids
+static uint32_t buildCompactNode(CompactBuilder* builder, TrieNode* node) {
+    CompactEdge edges[MAX_CHILDREN];
+    int count = 0;
+    for (int i = 0; i < MAX_CHILDREN && !builder->failed; i++) {
+        if (node->children[i]) {
+            edges[count++] = (buildCompactNode(builder, node->children[i]) << 5) | (uint32_t)i;
+        }
+    }
+    if (builder->failed) return 0;
+    return internNode(builder, node->isWord, edges, count);
+}
+
+void freeCompactTrie(CompactTrie* trie) {
+    if (!trie) return;
+    if (trie->mapped) {
+        munmap(trie->buffer, trie->bufferSize);
+    } else {
+        free(trie->buffer);
+    }
+    free(trie);
+}
+
+static CompactTrie* wrapCompactTrie(void* buffer, size_t size, bool mapped) {
+    CompactTrie* trie = (CompactTrie*)malloc(sizeof(CompactTrie));
+    if (!trie) return NULL;
+    trie->buffer = buffer;
+    trie->bufferSize = size;
+    trie->mapped = mapped;
+    trie->header = (const CompactTrieHeader*)buffer;
+    trie->nodes = (const CompactNode*)((const char*)buffer + sizeof(CompactTrieHeader));
+    trie->edges = (const CompactEdge*)(trie->nodes + trie->header->nodeCount);
+    return trie;
+}
+
+// Build the read-only compact trie from a mutable one
+CompactTrie* buildCompactTrie(TrieNode* root) {
+    CompactBuilder builder = { 0 };
+    builder.nodeCapacity = builder.edgeCapacity = 1024;
+    builder.tableMask = 2047;
+    builder.nodes = (CompactNode*)malloc(builder.nodeCapacity * sizeof(CompactNode));
+    builder.edges = (CompactEdge*)malloc(builder.edgeCapacity * sizeof(CompactEdge));
+    builder.table = (uint32_t*)calloc(builder.tableMask + 1, sizeof(uint32_t));
+    uint32_t rootId = 0;
+    if (builder.nodes && builder.edges && builder.table) {
+        rootId = buildCompactNode(&builder, root);
+    } else {
+        builder.failed = true;
+    }
+
+    CompactTrie* trie = NULL;
+    size_t size = sizeof(CompactTrieHeader) + builder.nodeCount * sizeof(CompactNode) + builder.edgeCount * sizeof(CompactEdge);
+    char* buffer = builder.failed ? NULL : (char*)malloc(size);
+    if (buffer) {
+        CompactTrieHeader header = { COMPACT_TRIE_MAGIC, COMPACT_TRIE_VERSION, builder.nodeCount, builder.edgeCount, rootId };
+        memcpy(buffer, &header, sizeof(header));
+        memcpy(buffer + sizeof(header), builder.nodes, builder.nodeCount * sizeof(CompactNode));
+        memcpy(buffer + sizeof(header) + builder.nodeCount * sizeof(CompactNode), builder.edges,
+               builder.edgeCount * sizeof(CompactEdge));
+        trie = wrapCompactTrie(buffer, size, false);
+        if (!trie) free(buffer);
+    }
+    free(builder.nodes);
+    free(builder.edges);
+    free(builder.table);
+    return trie;
+}
+
+// Write the trie buffer to a file
+bool saveCompactTrie(const CompactTrie* trie, const char* path) {
+    FILE* file = fopen(path, "wb");
+    if (!file) return false;
+    bool ok = fwrite(trie->buffer, 1, trie->bufferSize, file) == trie->bufferSize;
+    return fclose(file) == 0 && ok;
+}
+
+// Every node's edge ranges must be sorted and lie inside the edge array; edge targets
+// are checked as they are followed
+static bool compactNodesValid(const CompactTrieHeader* header, const CompactNode* nodes) {
+    for (uint32_t i = 0; i < header->nodeCount; i++) {
+        for (int d = 1; d < T9_DIGITS; d++) {
+            if (nodes[i].digitEnd[d] < nodes[i].digitEnd[d - 1]) return false;
+        }
+        if ((uint64_t)nodes[i].firstEdge + nodes[i].digitEnd[T9_DIGITS - 1] > header->edgeCount) return false;
+    }
+    return true;
+}
+
+// Map a saved trie. The header and node ranges are checked; edges are paged in as the
+// trie is used.
+CompactTrie* loadCompactTrie(const char* path) {
+    int fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0) return NULL;
+    struct stat fileStat;
+    void* map = MAP_FAILED;
+    if (fstat(fd, &fileStat) == 0 && (size_t)fileStat.st_size >= sizeof(CompactTrieHeader)) {
+        map = mmap(NULL, fileStat.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    }
+    close(fd);
+    if (map == MAP_FAILED) return NULL;
+
+    const CompactTrieHeader* header = (const CompactTrieHeader*)map;
+    size_t expected = sizeof(CompactTrieHeader) + (size_t)header->nodeCount * sizeof(CompactNode) +
+                      (size_t)header->edgeCount * sizeof(CompactEdge);
+    if (header->magic != COMPACT_TRIE_MAGIC || header->version != COMPACT_TRIE_VERSION ||
+        expected != (size_t)fileStat.st_size || header->root >= header->nodeCount ||
+        !compactNodesValid(header, (const CompactNode*)(header + 1))) {
+        munmap(map, fileStat.st_size);
+        return NULL;
+    }
+    CompactTrie* trie = wrapCompactTrie(map, fileStat.st_size, true);
+    if (!trie) munmap(map, fileStat.st_size);
+    return trie;
+}
+
+// Follow the edge for one letter, or return -1
+static int64_t compactChild(const CompactTrie* trie, uint32_t nodeId, char letter) {
+    if (letter < 'a' || letter > 'z') return -1;
+    const CompactNode* node = &trie->nodes[nodeId];
+    int digit = LETTER_DIGIT[letter - 'a'] - 2;
+    uint32_t begin = node->firstEdge + (digit ? node->digitEnd[digit - 1] : 0);
+    uint32_t end = node->firstEdge + node->digitEnd[digit];
+    for (uint32_t e = begin; e < end; e++) {
+        if (EDGE_LETTER(trie->edges[e]) == (uint32_t)(letter - 'a')) {
+            uint32_t target = EDGE_TARGET(trie->edges[e]);
+            return target < trie->header->nodeCount ? (int64_t)target : -1;
+        }
+    }
+    return -1;
+}
+
+static int64_t compactWalk(const CompactTrie* trie, const char* word) {
+    int64_t node = trie->header->root;
+    while (*word && node >= 0) {
+        node = compactChild(trie, (uint32_t)node, *word++);
+    }
+    return node;
+}
+
+bool compactSearchWord(const CompactTrie* trie, const char* word) {
+    int64_t node = compactWalk(trie, word);
+    return node >= 0 && trie->nodes[node].isWord;
+}
+
+bool compactStartsWith(const CompactTrie* trie, const char* prefix) {
+    return compactWalk(trie, prefix) >= 0;
+}
+
+// Iterative T9 lookup: one stack frame per digit holding the remaining edge range of
+// that digit's letters at the node reached so far. Results grow as needed.
+char** compactLetterCombinations(const CompactTrie* trie, const char* digits, int* returnSize) {
+    *returnSize = 0;
+    int capacity = 16;
+    char** results = (char**)malloc(capacity * sizeof(char*));
+    size_t length = digits ? strlen(digits) : 0;
+    if (!results || length == 0 || length >= MAX_WORD_LENGTH) return results;
+    for (size_t i = 0; i < length; i++) {
+        if (digits[i] < '2' || digits[i] > '9') return results; // 0 and 1 carry no letters
+    }
+
+    struct { uint32_t next, end; } stack[MAX_WORD_LENGTH];
+    char buffer[MAX_WORD_LENGTH];
+    uint32_t nodeAt[MAX_WORD_LENGTH + 1];
+    int depth = 0;
+    nodeAt[0] = trie->header->root;
+
+    // Edge range of the letters of digits[depth] at nodeAt[depth]
+#define PUSH_RANGE() do { \
+        const CompactNode* node = &trie->nodes[nodeAt[depth]]; \
+        int digit = digits[depth] - '2'; \
+        stack[depth].next = node->firstEdge + (digit ? node->digitEnd[digit - 1] : 0); \
+        stack[depth].end = node->firstEdge + node->digitEnd[digit]; \
+    } while (0)
+
+    PUSH_RANGE();
+    while (depth >= 0) {
+        if (stack[depth].next == stack[depth].end) {
+            depth--;
+            continue;
+        }
+        CompactEdge edge = trie->edges[stack[depth].next++];
+        uint32_t target = EDGE_TARGET(edge);
+        if (target >= trie->header->nodeCount) continue;
+        buffer[depth] = (char)('a' + EDGE_LETTER(edge));
+        if ((size_t)depth + 1 == length) {
+            if (trie->nodes[target].isWord) {
+                if (*returnSize == capacity) {
+                    char** grown = (char**)realloc(results, capacity * 2 * sizeof(char*));
+                    if (!grown) break;
+                    results = grown;
+                    capacity *= 2;
+                }
+                buffer[length] = '\0';
+                results[(*returnSize)++] = strdup(buffer);
+            }
+            continue;
+        }
+        nodeAt[++depth] = target;
+        PUSH_RANGE();
+    }
+#undef PUSH_RANGE
+    return results;
+}
+
 // Main function for testing
 int main() {
     TrieNode* root = createTrieNode();
@@ -128,6 +476,25 @@ int main() {
         free(combinations[i]);
     }
     free(combinations);
+
+    // Same lookup through the compact trie, saved and mapped back
+    CompactTrie* compact = buildCompactTrie(root);
+    if (compact && saveCompactTrie(compact, "phone_dictionary.dawg")) {
+        freeCompactTrie(compact);
+        compact = loadCompactTrie("phone_dictionary.dawg");
+    }
+    if (compact) {
+        printf("Compact trie: %u nodes, %u edges, %zu bytes\n", compact->header->nodeCount,
+               compact->header->edgeCount, compact->bufferSize);
+        combinations = compactLetterCombinations(compact, "3767269", &resultSize);
+        printf("Valid words from phone number (compact trie):\n");
+        for (int i = 0; i < resultSize; i++) {
+            printf("%s\n", combinations[i]);
+            free(combinations[i]);
+        }
+        free(combinations);
+        freeCompactTrie(compact);
+    }
     
     return 0;
 }
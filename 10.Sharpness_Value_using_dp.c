@@ -1,6 +1,12 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <limits.h>
+#include <string.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#if defined(__AVX2__)
+#include <immintrin.h>
+#endif
 
 /* Standard DP Approach (findSharpnessValue):
    - Uses a 2D table to store sharpness values.
@@ -12,6 +18,16 @@
    - Uses a single array instead of a full DP table.
    - Keeps track of previous column values to update the next column.
 
+   Strided, Banded and Batched Kernel (findSharpnessValueStrided, findSharpnessValueBatch):
+   - Reads a contiguous row-major buffer with a row stride, no row pointers.
+   - Works on strips of SHARPNESS_STRIP columns, transposed into a column-major
+     scratch so each column step reads contiguous memory; the step itself is
+     vectorized with AVX2 (scalar otherwise).
+   - Splits rows into bands, one per thread. A band also computes SHARPNESS_STRIP
+     rows of halo from each neighbour, so rows inside the band stay exact for a
+     whole strip; halos are exchanged through the shared column state at strip edges.
+   - A batch with at least as many images as threads gives each thread whole images.
+
    Memory Management:
    - Dynamically allocates memory for the DP tables.
    - Frees allocated memory after computation.
@@ -105,6 +121,196 @@ int findSharpnessValueOptimized(int** matrix, int m, int n) {
     return maxSharpness;
 }
 
+#define SHARPNESS_STRIP 64     // Columns per strip, also the halo height of a band
+
+typedef struct {
+    const int* data;            // Row-major pixels
+    int rows, cols;
+    size_t stride;              // Elements from the start of one row to the next, >= cols
+} SharpnessImage;
+
+// One band of rows of one image
+typedef struct {
+    const SharpnessImage* image;
+    int* state;                 // Shared: sharpness of every row at the last strip edge
+    int rowBegin, rowEnd;       // Rows this band owns
+    int threads;
+    pthread_barrier_t* barrier; // NULL when the band covers the whole image
+    int result;                 // Max over owned rows of the last column
+    int ok;                     // Cleared when the band could not allocate its buffers
+} SharpnessBand;
+
+// One column step over rows [0, len) of a band: next[i] = min(max(prev[i-1..i+1]), pixel[i]).
+// Rows 0 and len-1 have only one neighbour; at band edges inside the image this is
+// wrong, but the error moves one row per step and never reaches the owned rows.
+static void sharpnessColumnStep(const int* prev, const int* pixel, int* next, int len) {
+    if (len == 1) {
+        next[0] = prev[0] < pixel[0] ? prev[0] : pixel[0];
+        return;
+    }
+    int first = prev[0] > prev[1] ? prev[0] : prev[1];
+    next[0] = first < pixel[0] ? first : pixel[0];
+    int i = 1;
+#if defined(__AVX2__)
+    for (; i + 8 <= len - 1; i += 8) {
+        __m256i up = _mm256_loadu_si256((const __m256i*)(prev + i - 1));
+        __m256i mid = _mm256_loadu_si256((const __m256i*)(prev + i));
+        __m256i down = _mm256_loadu_si256((const __m256i*)(prev + i + 1));
+        __m256i best = _mm256_max_epi32(_mm256_max_epi32(up, mid), down);
+        __m256i px = _mm256_loadu_si256((const __m256i*)(pixel + i));
+        _mm256_storeu_si256((__m256i*)(next + i), _mm256_min_epi32(best, px));
+    }
+#endif
+    for (; i < len - 1; i++) {
+        int best = prev[i - 1] > prev[i] ? prev[i - 1] : prev[i];
+        best = best > prev[i + 1] ? best : prev[i + 1];
+        next[i] = best < pixel[i] ? best : pixel[i];
+    }
+    int last = prev[len - 2] > prev[len - 1] ? prev[len - 2] : prev[len - 1];
+    next[len - 1] = last < pixel[len - 1] ? last : pixel[len - 1];
+}
+
+static void* sharpnessBandWorker(void* arg) {
+    SharpnessBand* band = (SharpnessBand*)arg;
+    const SharpnessImage* image = band->image;
+    int haloBegin = band->rowBegin - SHARPNESS_STRIP > 0 ? band->rowBegin - SHARPNESS_STRIP : 0;
+    int haloEnd = band->rowEnd + SHARPNESS_STRIP < image->rows ? band->rowEnd + SHARPNESS_STRIP : image->rows;
+    int len = haloEnd - haloBegin;
+    int* bufferA = (int*)malloc(len * sizeof(int));
+    int* bufferB = (int*)malloc(len * sizeof(int));
+    int* columns = (int*)malloc((size_t)SHARPNESS_STRIP * len * sizeof(int));
+    int ok = band->ok = bufferA && bufferB && columns;
+
+    // A band whose allocation failed still waits at every barrier so the others do not
+    // block; the image then reports -1. The first barrier also orders the initial state.
+    for (int i = band->rowBegin; i < band->rowEnd; i++) {
+        band->state[i] = image->data[(size_t)i * image->stride];
+    }
+    for (int j0 = 1; j0 < image->cols; j0 += SHARPNESS_STRIP) {
+        int width = image->cols - j0 < SHARPNESS_STRIP ? image->cols - j0 : SHARPNESS_STRIP;
+        if (band->barrier) pthread_barrier_wait(band->barrier);
+        if (ok) {
+            memcpy(bufferA, band->state + haloBegin, len * sizeof(int));
+            // Transpose the strip so each column is contiguous
+            for (int i = 0; i < len; i++) {
+                const int* row = image->data + (size_t)(haloBegin + i) * image->stride + j0;
+                for (int c = 0; c < width; c++) {
+                    columns[(size_t)c * len + i] = row[c];
+                }
+            }
+            for (int c = 0; c < width; c++) {
+                sharpnessColumnStep(bufferA, columns + (size_t)c * len, bufferB, len);
+                int* tmp = bufferA;
+                bufferA = bufferB;
+                bufferB = tmp;
+            }
+        }
+        // All bands have read their halos before any band overwrites its rows
+        if (band->barrier) pthread_barrier_wait(band->barrier);
+        if (ok) {
+            memcpy(band->state + band->rowBegin, bufferA + (band->rowBegin - haloBegin),
+                   (band->rowEnd - band->rowBegin) * sizeof(int));
+        }
+    }
+
+    band->result = INT_MIN;
+    for (int i = band->rowBegin; ok && i < band->rowEnd; i++) {
+        if (band->state[i] > band->result) band->result = band->state[i];
+    }
+    free(bufferA);
+    free(bufferB);
+    free(columns);
+    return NULL;
+}
+
+// Sharpness of one image, with its rows split into up to threads bands
+static int sharpnessBanded(const SharpnessImage* image, int threads) {
+    if (image->data == NULL || image->rows < 1 || image->cols < 1 || image->stride < (size_t)image->cols) return -1;
+    if (threads > image->rows) threads = image->rows;
+    if (threads < 1) threads = 1;
+    int* state = (int*)malloc(image->rows * sizeof(int));
+    SharpnessBand* bands = (SharpnessBand*)malloc(threads * sizeof(SharpnessBand));
+    pthread_t* tids = (pthread_t*)malloc(threads * sizeof(pthread_t));
+    if (!state || !bands || !tids) {
+        free(state);
+        free(bands);
+        free(tids);
+        return -1;
+    }
+    pthread_barrier_t barrier;
+    if (threads > 1) pthread_barrier_init(&barrier, NULL, threads);
+    for (int t = 0; t < threads; t++) {
+        bands[t] = (SharpnessBand){ image, state, (int)((long)image->rows * t / threads),
+                                    (int)((long)image->rows * (t + 1) / threads), threads,
+                                    threads > 1 ? &barrier : NULL, 0, 0 };
+    }
+    for (int t = 1; t < threads; t++) {
+        pthread_create(&tids[t], NULL, sharpnessBandWorker, &bands[t]);
+    }
+    sharpnessBandWorker(&bands[0]);
+    int result = bands[0].result;
+    for (int t = 1; t < threads; t++) {
+        pthread_join(tids[t], NULL);
+    }
+    for (int t = 0; t < threads; t++) {
+        if (bands[t].result > result) result = bands[t].result;
+    }
+    for (int t = 0; t < threads; t++) {
+        if (!bands[t].ok) result = -1;
+    }
+    if (threads > 1) pthread_barrier_destroy(&barrier);
+    free(state);
+    free(bands);
+    free(tids);
+    return result;
+}
+
+// Sharpness of an m x n image stored row-major with the given row stride (in elements)
+int findSharpnessValueStrided(const int* data, int m, int n, size_t stride, int threads) {
+    SharpnessImage image = { data, m, n, stride };
+    return sharpnessBanded(&image, threads);
+}
+
+typedef struct {
+    const SharpnessImage* images;
+    int* results;
+    int count;
+    atomic_int next;
+} SharpnessBatch;
+
+static void* sharpnessBatchWorker(void* arg) {
+    SharpnessBatch* batch = (SharpnessBatch*)arg;
+    int i;
+    while ((i = atomic_fetch_add(&batch->next, 1)) < batch->count) {
+        batch->results[i] = sharpnessBanded(&batch->images[i], 1);
+    }
+    return NULL;
+}
+
+// Sharpness of several images. With at least as many images as threads, each thread
+// takes whole images; otherwise the images are done one after another, each split into bands.
+void findSharpnessValueBatch(const SharpnessImage* images, int count, int* results, int threads) {
+    if (threads < 1) threads = 1;
+    if (count < threads) {
+        for (int i = 0; i < count; i++) {
+            results[i] = sharpnessBanded(&images[i], threads);
+        }
+        return;
+    }
+    SharpnessBatch batch = { .images = images, .results = results, .count = count };
+    atomic_init(&batch.next, 0);
+    pthread_t* tids = (pthread_t*)malloc(threads * sizeof(pthread_t));
+    int started = 0;
+    while (tids && started < threads - 1 && pthread_create(&tids[started], NULL, sharpnessBatchWorker, &batch) == 0) {
+        started++;
+    }
+    sharpnessBatchWorker(&batch);
+    for (int t = 0; t < started; t++) {
+        pthread_join(tids[t], NULL);
+    }
+    free(tids);
+}
+
 // Test the function
 int main() {
     int m = 3, n = 3;
@@ -121,6 +327,7 @@ int main() {
     
     printf("Max Sharpness Value (DP): %d\n", findSharpnessValue(matrix, m, n));
     printf("Max Sharpness Value (Optimized): %d\n", findSharpnessValueOptimized(matrix, m, n));
+    printf("Max Sharpness Value (Strided): %d\n", findSharpnessValueStrided(&matrixData[0][0], m, n, 3, 2));
     
     // Free allocated memory
     for (int i = 0; i < m; i++) {
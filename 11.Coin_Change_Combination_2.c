@@ -1,5 +1,8 @@
 #include <stdio.h>
 #include <stdlib.h>
+#include <stdbool.h>
+#include <limits.h>
+#include <string.h>
 
 /* This C implementation follows the original Java logic:
 
@@ -192,6 +195,237 @@ void freeResultSet(ResultSet resultSet) {
     free(resultSet.combinations);
 }
 
+/* Counting and Streaming Without Per-Result Allocation:
+
+   Counting (countCombinations):
+   - Classic coin change DP: ways[t] += ways[t - c] for each candidate c, O(n * target).
+   - No combination is built, so it works for targets far too large to enumerate.
+
+   Canonical Order Enumeration (CombinationIterator):
+   - Produces combinations directly in the order compareCombinations sorts them:
+     by length, then lexicographically. Lengths are walked 1, 2, ... and within a
+     length the non-decreasing choices are walked with an explicit stack.
+   - Branches are cut when the remaining sum cannot be reached with the remaining
+     number of elements (smallest * r > t or largest * r < t).
+   - nextCombination() returns a view of the iterator's buffer; nothing is allocated
+     per result and nothing needs sorting afterwards.
+
+   Streaming and Arena Storage:
+   - forEachCombination() calls back for each combination and stops when it returns nonzero.
+   - combinationSumArena() stores all values in one array with an offset per result.
+*/
+
+// Pull-style enumeration state
+typedef struct {
+    int* candidates;     // Sorted, distinct, positive
+    int count;
+    int target;
+    int* choice;         // Candidate index chosen at each position
+    int* combination;    // Values chosen so far
+    int* remaining;      // remaining[d]: target minus the values before position d
+    int length;          // Length being enumerated
+    int maxLength;
+    int depth;
+    bool done;
+} CombinationIterator;
+
+// Combinations stored back-to-back: combination i is values[offsets[i] .. offsets[i + 1])
+typedef struct {
+    int* values;
+    size_t valueCount, valueCapacity;
+    size_t* offsets;
+    int size, capacity;
+} CombinationArena;
+
+// Sorted copy of the positive candidates with duplicates removed. Returns the count.
+static int normalizeCandidates(const int* candidates, int candidatesSize, int** out) {
+    *out = (int*)malloc((candidatesSize > 0 ? candidatesSize : 1) * sizeof(int));
+    if (!*out) return -1;
+    int count = 0;
+    for (int i = 0; i < candidatesSize; i++) {
+        if (candidates[i] > 0) (*out)[count++] = candidates[i];
+    }
+    qsort(*out, count, sizeof(int), compareInts);
+    int unique = 0;
+    for (int i = 0; i < count; i++) {
+        if (unique == 0 || (*out)[unique - 1] != (*out)[i]) (*out)[unique++] = (*out)[i];
+    }
+    return unique;
+}
+
+// Number of combinations, saturating at ULLONG_MAX. Like the enumeration, the empty
+// combination is not counted, so a target of 0 gives 0.
+unsigned long long countCombinations(const int* candidates, int candidatesSize, int target) {
+    if (target <= 0) return 0;
+    int* sorted;
+    int count = normalizeCandidates(candidates, candidatesSize, &sorted);
+    unsigned long long* ways = (unsigned long long*)calloc((size_t)target + 1, sizeof(unsigned long long));
+    if (count < 0 || !ways) {
+        free(ways);
+        if (count >= 0) free(sorted);
+        return 0;
+    }
+    ways[0] = 1;
+    for (int i = 0; i < count; i++) {
+        for (int t = sorted[i]; t <= target; t++) {
+            unsigned long long sum = ways[t] + ways[t - sorted[i]];
+            ways[t] = sum < ways[t] ? ULLONG_MAX : sum;
+        }
+    }
+    unsigned long long result = ways[target];
+    free(ways);
+    free(sorted);
+    return result;
+}
+
+void freeCombinationIterator(CombinationIterator* it) {
+    free(it->candidates);
+    free(it->choice);
+    free(it->combination);
+    free(it->remaining);
+}
+
+// Returns false if memory runs out
+bool initCombinationIterator(CombinationIterator* it, const int* candidates, int candidatesSize, int target) {
+    it->count = normalizeCandidates(candidates, candidatesSize, &it->candidates);
+    if (it->count < 0) {
+        it->candidates = NULL;
+        it->choice = it->combination = it->remaining = NULL;
+        return false;
+    }
+    it->target = target;
+    it->maxLength = (it->count > 0 && target > 0) ? target / it->candidates[0] : 0;
+    int slots = it->maxLength + 1;
+    it->choice = (int*)malloc(slots * sizeof(int));
+    it->combination = (int*)malloc(slots * sizeof(int));
+    it->remaining = (int*)malloc(slots * sizeof(int));
+    it->length = 0;
+    it->depth = -1;
+    it->done = it->maxLength == 0;
+    if (!it->choice || !it->combination || !it->remaining) {
+        freeCombinationIterator(it);
+        return false;
+    }
+    return true;
+}
+
+// Next combination in canonical order, or NULL when there are no more. The returned
+// array belongs to the iterator and is overwritten by the next call.
+const int* nextCombination(CombinationIterator* it, int* size) {
+    const int* c = it->candidates;
+    while (!it->done) {
+        if (it->depth < 0) {
+            // Start the next length
+            if (++it->length > it->maxLength) {
+                it->done = true;
+                break;
+            }
+            it->depth = 0;
+            it->choice[0] = -1;
+            it->remaining[0] = it->target;
+        }
+        while (it->depth >= 0) {
+            int d = it->depth;
+            int j = ++it->choice[d];
+            long left = it->length - d;  // Elements still to choose, including this one
+            int t = it->remaining[d];
+            if (j >= it->count || c[j] * left > t || c[it->count - 1] * left < t) {
+                it->depth--;             // Larger candidates only overshoot further
+                continue;
+            }
+            it->combination[d] = c[j];
+            if (left == 1) {
+                if (c[j] == t) {
+                    *size = it->length;
+                    return it->combination;
+                }
+                continue;
+            }
+            it->remaining[d + 1] = t - c[j];
+            it->choice[d + 1] = j - 1;   // Non-decreasing: the next position starts at j
+            it->depth++;
+        }
+    }
+    *size = 0;
+    return NULL;
+}
+
+// Call back for every combination in canonical order. Stops early when the callback
+// returns nonzero. Returns the number of combinations visited, or -1 if memory runs out.
+long long forEachCombination(const int* candidates, int candidatesSize, int target,
+                             int (*callback)(const int* combination, int size, void* ctx), void* ctx) {
+    CombinationIterator it;
+    if (!initCombinationIterator(&it, candidates, candidatesSize, target)) return -1;
+    long long visited = 0;
+    const int* combination;
+    int size;
+    while ((combination = nextCombination(&it, &size)) != NULL) {
+        visited++;
+        if (callback(combination, size, ctx)) break;
+    }
+    freeCombinationIterator(&it);
+    return visited;
+}
+
+static int appendToArena(const int* combination, int size, void* ctx) {
+    CombinationArena* arena = (CombinationArena*)ctx;
+    if (arena->valueCount + size > arena->valueCapacity) {
+        size_t capacity = arena->valueCapacity * 2;
+        while (capacity < arena->valueCount + size) capacity *= 2;
+        int* values = (int*)realloc(arena->values, capacity * sizeof(int));
+        if (!values) return 1;
+        arena->values = values;
+        arena->valueCapacity = capacity;
+    }
+    if (arena->size + 1 == arena->capacity) {
+        size_t* offsets = (size_t*)realloc(arena->offsets, arena->capacity * 2 * sizeof(size_t));
+        if (!offsets) return 1;
+        arena->offsets = offsets;
+        arena->capacity *= 2;
+    }
+    memcpy(arena->values + arena->valueCount, combination, size * sizeof(int));
+    arena->valueCount += size;
+    arena->offsets[++arena->size] = arena->valueCount;
+    return 0;
+}
+
+// All combinations in canonical order, stored in one arena
+CombinationArena combinationSumArena(const int* candidates, int candidatesSize, int target) {
+    CombinationArena arena = { 0 };
+    arena.valueCapacity = 64;
+    arena.capacity = 16;
+    arena.values = (int*)malloc(arena.valueCapacity * sizeof(int));
+    arena.offsets = (size_t*)malloc(arena.capacity * sizeof(size_t));
+    if (arena.values && arena.offsets) {
+        arena.offsets[0] = 0;
+        forEachCombination(candidates, candidatesSize, target, appendToArena, &arena);
+    } else {
+        arena.capacity = 0;
+    }
+    return arena;
+}
+
+void printCombinationArena(const CombinationArena* arena) {
+    printf("[\n");
+    for (int i = 0; i < arena->size; i++) {
+        printf("  [");
+        for (size_t j = arena->offsets[i]; j < arena->offsets[i + 1]; j++) {
+            printf("%d", arena->values[j]);
+            if (j + 1 < arena->offsets[i + 1]) printf(", ");
+        }
+        printf("]\n");
+    }
+    printf("]\n");
+}
+
+void freeCombinationArena(CombinationArena* arena) {
+    free(arena->values);
+    free(arena->offsets);
+    arena->values = NULL;
+    arena->offsets = NULL;
+    arena->size = 0;
+}
+
 int main() {
     int candidates[] = {2, 3, 6, 7};
     int target = 7;
@@ -200,6 +434,12 @@ int main() {
     ResultSet resultSet = combinationSum(candidates, candidatesSize, target);
     printResultSet(resultSet);
     freeResultSet(resultSet);
+
+    CombinationArena arena = combinationSumArena(candidates, candidatesSize, target);
+    printCombinationArena(&arena);
+    freeCombinationArena(&arena);
+
+    printf("Combinations for target 500: %llu\n", countCombinations(candidates, candidatesSize, 500));
     
     return 0;
 }
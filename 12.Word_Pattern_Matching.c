@@ -2,6 +2,9 @@
 #include <stdlib.h>
 #include <string.h>
 #include <stdbool.h>
+#include <stdint.h>
+#include <pthread.h>
+#include <stdatomic.h>
 
 /* This C implementation covers three key functionalities:
 
@@ -18,6 +21,14 @@
    - Implements Dynamic Programming (DP) to check if a string can be broken into dictionary words.
    - Uses a boolean DP table to determine valid segmentations.
 
+   Compiled Dictionary (compileWordDictionary, wordBreakCompiled):
+   - Builds the dictionary once into a trie stored as flat arrays: each node's edges are
+     contiguous and sorted by byte, and the root has a direct 256-entry table.
+   - The DP walks the trie forward from each reachable position and only marks the
+     positions where a dictionary word actually ends: O(n * longest word) per string
+     instead of O(n^2 * |dict|).
+   - wordBreakBatch() segments many strings against the same dictionary across threads.
+
    Word Pattern Matching:
    1
    0
@@ -121,6 +132,219 @@ bool wordBreak(char* s, char* wordDict[], int wordCount) {
     return dp[len];
 }
 
+// Read-only trie compiled from a word list. Node 0 is the root.
+typedef struct {
+    uint32_t* firstEdge;        // Edges of node v are [firstEdge[v], firstEdge[v + 1])
+    unsigned char* labels;      // Edge bytes, sorted within each node
+    uint32_t* targets;
+    bool* isWord;
+    uint32_t rootChild[MAX_CHAR]; // 0 when the root has no edge for the byte
+    uint32_t nodeCount;
+} WordDictionary;
+
+// (node, byte) -> child map used while inserting words
+typedef struct {
+    uint64_t* keys;             // (node << 8 | byte) + 1, 0 when empty
+    uint32_t* children;
+    uint32_t mask;
+    uint32_t used;
+} EdgeMap;
+
+static uint32_t edgeSlot(const EdgeMap* map, uint64_t key) {
+    uint64_t h = key * 0x9e3779b97f4a7c15ULL;
+    uint32_t slot = (uint32_t)(h >> 32) & map->mask;
+    while (map->keys[slot] && map->keys[slot] != key) slot = (slot + 1) & map->mask;
+    return slot;
+}
+
+static bool growEdgeMap(EdgeMap* map) {
+    EdgeMap bigger = { NULL, NULL, map->mask * 2 + 1, map->used };
+    bigger.keys = (uint64_t*)calloc((size_t)bigger.mask + 1, sizeof(uint64_t));
+    bigger.children = (uint32_t*)malloc(((size_t)bigger.mask + 1) * sizeof(uint32_t));
+    if (!bigger.keys || !bigger.children) {
+        free(bigger.keys);
+        free(bigger.children);
+        return false;
+    }
+    for (uint32_t i = 0; i <= map->mask; i++) {
+        if (!map->keys[i]) continue;
+        uint32_t slot = edgeSlot(&bigger, map->keys[i]);
+        bigger.keys[slot] = map->keys[i];
+        bigger.children[slot] = map->children[i];
+    }
+    free(map->keys);
+    free(map->children);
+    *map = bigger;
+    return true;
+}
+
+void freeWordDictionary(WordDictionary* dict) {
+    if (!dict) return;
+    free(dict->firstEdge);
+    free(dict->labels);
+    free(dict->targets);
+    free(dict->isWord);
+    free(dict);
+}
+
+// Compile a dictionary. Empty words are ignored. Returns NULL if memory runs out.
+WordDictionary* compileWordDictionary(char* wordDict[], int wordCount) {
+    size_t maxNodes = 1;
+    for (int k = 0; k < wordCount; k++) maxNodes += strlen(wordDict[k]);
+    if (maxNodes > UINT32_MAX) return NULL;
+
+    WordDictionary* dict = (WordDictionary*)calloc(1, sizeof(WordDictionary));
+    EdgeMap map = { NULL, NULL, 1023, 0 };
+    map.keys = (uint64_t*)calloc(map.mask + 1, sizeof(uint64_t));
+    map.children = (uint32_t*)malloc((map.mask + 1) * sizeof(uint32_t));
+    bool* isWord = (bool*)calloc(maxNodes, sizeof(bool));
+    bool ok = dict && map.keys && map.children && isWord;
+
+    // Insert every word, creating nodes on first use
+    uint32_t nodeCount = 1;
+    for (int k = 0; ok && k < wordCount; k++) {
+        uint32_t node = 0;
+        for (const unsigned char* c = (const unsigned char*)wordDict[k]; ok && *c; c++) {
+            uint64_t key = ((uint64_t)node << 8 | *c) + 1;
+            uint32_t slot = edgeSlot(&map, key);
+            if (!map.keys[slot]) {
+                if ((map.used + 1) * 2 > map.mask && !(ok = growEdgeMap(&map))) break;
+                slot = edgeSlot(&map, key);
+                map.keys[slot] = key;
+                map.children[slot] = nodeCount++;
+                map.used++;
+            }
+            node = map.children[slot];
+        }
+        if (ok && node != 0) isWord[node] = true;
+    }
+
+    // Flatten: count edges per node, prefix sum, then place each edge in label order
+    if (ok) {
+        dict->nodeCount = nodeCount;
+        dict->isWord = isWord;
+        dict->firstEdge = (uint32_t*)calloc((size_t)nodeCount + 1, sizeof(uint32_t));
+        dict->labels = (unsigned char*)malloc(map.used ? map.used : 1);
+        dict->targets = (uint32_t*)malloc((map.used ? map.used : 1) * sizeof(uint32_t));
+        ok = dict->firstEdge && dict->labels && dict->targets;
+    }
+    if (ok) {
+        for (uint32_t i = 0; i <= map.mask; i++) {
+            if (map.keys[i]) dict->firstEdge[((map.keys[i] - 1) >> 8) + 1]++;
+        }
+        for (uint32_t v = 0; v < nodeCount; v++) dict->firstEdge[v + 1] += dict->firstEdge[v];
+        uint32_t* fill = (uint32_t*)malloc((size_t)nodeCount * sizeof(uint32_t));
+        ok = fill != NULL;
+        if (ok) {
+            memcpy(fill, dict->firstEdge, (size_t)nodeCount * sizeof(uint32_t));
+            for (uint32_t i = 0; i <= map.mask; i++) {
+                if (!map.keys[i]) continue;
+                uint32_t node = (uint32_t)((map.keys[i] - 1) >> 8);
+                unsigned char label = (unsigned char)((map.keys[i] - 1) & 0xff);
+                // Insertion sort into place; nodes rarely have many edges
+                uint32_t e = fill[node]++;
+                while (e > dict->firstEdge[node] && dict->labels[e - 1] > label) {
+                    dict->labels[e] = dict->labels[e - 1];
+                    dict->targets[e] = dict->targets[e - 1];
+                    e--;
+                }
+                dict->labels[e] = label;
+                dict->targets[e] = map.children[i];
+                if (node == 0) dict->rootChild[label] = map.children[i];
+            }
+            free(fill);
+        }
+    }
+    free(map.keys);
+    free(map.children);
+    if (!ok) {
+        if (dict && dict->isWord == NULL) free(isWord);
+        freeWordDictionary(dict);
+        return NULL;
+    }
+    return dict;
+}
+
+// Child of node along byte c, or 0 if there is none
+static inline uint32_t dictionaryChild(const WordDictionary* dict, uint32_t node, unsigned char c) {
+    if (node == 0) return dict->rootChild[c];
+    uint32_t lo = dict->firstEdge[node], hi = dict->firstEdge[node + 1];
+    while (hi - lo > 8) {
+        uint32_t mid = lo + (hi - lo) / 2;
+        if (dict->labels[mid] <= c) lo = mid; else hi = mid;
+    }
+    for (uint32_t e = lo; e < hi; e++) {
+        if (dict->labels[e] == c) return dict->targets[e];
+    }
+    return 0;
+}
+
+// Word break against a compiled dictionary: from every position the DP has reached,
+// follow the trie and mark each position where a dictionary word ends
+bool wordBreakCompiled(const WordDictionary* dict, const char* s) {
+    size_t len = strlen(s);
+    bool stackDp[1024];
+    bool* dp = len + 1 <= sizeof(stackDp) ? stackDp : (bool*)malloc(len + 1);
+    if (!dp) return false;
+    memset(dp, false, len + 1);
+    dp[0] = true;
+    const unsigned char* text = (const unsigned char*)s;
+    for (size_t j = 0; j < len && !dp[len]; j++) {
+        if (!dp[j]) continue;
+        uint32_t node = 0;
+        for (size_t i = j; i < len; i++) {
+            node = dictionaryChild(dict, node, text[i]);
+            if (node == 0) break;
+            if (dict->isWord[node]) dp[i + 1] = true;
+        }
+    }
+    bool result = dp[len];
+    if (dp != stackDp) free(dp);
+    return result;
+}
+
+typedef struct {
+    const WordDictionary* dict;
+    char** inputs;
+    bool* results;
+    int count;
+    atomic_int next;
+} WordBreakBatch;
+
+#define WORD_BREAK_BATCH_GRAIN 256  // Strings claimed per atomic increment
+
+static void* wordBreakBatchWorker(void* arg) {
+    WordBreakBatch* batch = (WordBreakBatch*)arg;
+    int begin;
+    while ((begin = atomic_fetch_add(&batch->next, WORD_BREAK_BATCH_GRAIN)) < batch->count) {
+        int end = begin + WORD_BREAK_BATCH_GRAIN < batch->count ? begin + WORD_BREAK_BATCH_GRAIN : batch->count;
+        for (int i = begin; i < end; i++) {
+            batch->results[i] = wordBreakCompiled(batch->dict, batch->inputs[i]);
+        }
+    }
+    return NULL;
+}
+
+// Segment many strings against one compiled dictionary, results[i] for inputs[i]
+void wordBreakBatch(const WordDictionary* dict, char* inputs[], int count, bool* results, int threads) {
+    WordBreakBatch batch = { .dict = dict, .inputs = inputs, .results = results, .count = count };
+    atomic_init(&batch.next, 0);
+    if (threads < 1) threads = 1;
+    if (threads > (count + WORD_BREAK_BATCH_GRAIN - 1) / WORD_BREAK_BATCH_GRAIN) {
+        threads = (count + WORD_BREAK_BATCH_GRAIN - 1) / WORD_BREAK_BATCH_GRAIN;
+    }
+    pthread_t* tids = threads > 1 ? (pthread_t*)malloc((threads - 1) * sizeof(pthread_t)) : NULL;
+    int started = 0;
+    while (tids && started < threads - 1 && pthread_create(&tids[started], NULL, wordBreakBatchWorker, &batch) == 0) {
+        started++;
+    }
+    wordBreakBatchWorker(&batch);
+    for (int t = 0; t < started; t++) {
+        pthread_join(tids[t], NULL);
+    }
+    free(tids);
+}
+
 int main() {
     printf("Word Pattern Matching:\n");
     printf("%d\n", wordPattern("abba", "dog cat cat dog")); // Expected output: 1 (true)
@@ -132,6 +356,18 @@ int main() {
     printf("\nWord Break:\n");
     char* wordDict[] = {"leet", "code"};
     printf("%d\n", wordBreak("leetcode", wordDict, 2)); // Expected output: 1 (true)
+
+    printf("\nWord Break (Compiled Dictionary):\n");
+    WordDictionary* dict = compileWordDictionary(wordDict, 2);
+    if (dict) {
+        char* inputs[] = {"leetcode", "codeleet", "leetcod"};
+        bool results[3];
+        wordBreakBatch(dict, inputs, 3, results, 2);
+        for (int i = 0; i < 3; i++) {
+            printf("%d\n", results[i]); // Expected output: 1, 1, 0
+        }
+        freeWordDictionary(dict);
+    }
     
     return 0;
 }
@@ -1,6 +1,10 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <pthread.h>
+#include <stdatomic.h>
 
 #define ISLAND '1'
 #define WATER '0'
@@ -59,18 +63,57 @@
 
    the implementation runs without segmentation faults and correctly modifies the grid.
 
+   Bit Grid Labeling (numIslandsParallel):
+   - Stores the grid as a BitGrid, 1 bit per cell, rows padded to 64-bit words.
+   - Splits the rows into tiles labeled in parallel. Within a tile, each horizontal run
+     of land is one union-find node (union by rank, path halving), found with ctz on
+     whole words and joined with the overlapping runs of the row above.
+   - Only the runs of each tile's first and last rows are kept; a second pass unions
+     them across tile borders, so memory does not grow with the number of cells.
+
+   Batch Dynamic Islands (addLands):
+   - Applies many positions at once and writes the island count after each.
+   - Keeps only land cells, in a hash map from cell to union-find node, so
+     the grid size does not decide the memory used.
+
 */   
 
 
-// Function to mark connected land as visited using DFS
+// Function to mark connected land as visited using DFS. An explicit stack replaces
+// recursion so a large island cannot overflow the call stack.
 void markIsland(char** grid, int rows, int cols, int i, int j) {
     if (i < 0 || i >= rows || j < 0 || j >= cols || grid[i][j] == WATER) return;
-    
+
+    size_t capacity = 64, size = 0;
+    int (*stack)[2] = malloc(capacity * sizeof(*stack));
+    if (!stack) return;
     grid[i][j] = WATER; // Mark as visited
-    markIsland(grid, rows, cols, i - 1, j); // Up
-    markIsland(grid, rows, cols, i + 1, j); // Down
-    markIsland(grid, rows, cols, i, j - 1); // Left
-    markIsland(grid, rows, cols, i, j + 1); // Right
+    stack[size][0] = i;
+    stack[size][1] = j;
+    size++;
+    int directions[4][2] = {{-1,0}, {1,0}, {0,-1}, {0,1}}; // Up, down, left, right
+    while (size > 0) {
+        size--;
+        int ci = stack[size][0], cj = stack[size][1];
+        for (int d = 0; d < 4; d++) {
+            int ni = ci + directions[d][0], nj = cj + directions[d][1];
+            if (ni < 0 || ni >= rows || nj < 0 || nj >= cols || grid[ni][nj] == WATER) continue;
+            if (size == capacity) {
+                void* grown = realloc(stack, capacity * 2 * sizeof(*stack));
+                if (!grown) {
+                    free(stack);
+                    return;
+                }
+                stack = grown;
+                capacity *= 2;
+            }
+            grid[ni][nj] = WATER;
+            stack[size][0] = ni;
+            stack[size][1] = nj;
+            size++;
+        }
+    }
+    free(stack);
 }
 
 // Function to count the number of islands
@@ -150,6 +193,397 @@ void numIslands2(int rows, int cols, int positions[][2], int positionsSize) {
     free(rank);
 }
 
+// Packed land mask: bit (j % 64) of words[i * wordsPerRow + j / 64] is cell (i, j)
+typedef struct {
+    int rows, cols;
+    size_t wordsPerRow;
+    uint64_t* words;
+} BitGrid;
+
+#define TILE_ROWS 256           // Rows labeled together by one thread
+
+BitGrid* createBitGrid(int rows, int cols) {
+    if (rows < 0 || cols < 0) return NULL;
+    BitGrid* grid = (BitGrid*)malloc(sizeof(BitGrid));
+    if (!grid) return NULL;
+    grid->rows = rows;
+    grid->cols = cols;
+    grid->wordsPerRow = ((size_t)cols + 63) / 64;
+    grid->words = (uint64_t*)calloc(grid->wordsPerRow * rows + 1, sizeof(uint64_t));
+    if (!grid->words) {
+        free(grid);
+        return NULL;
+    }
+    return grid;
+}
+
+void freeBitGrid(BitGrid* grid) {
+    if (!grid) return;
+    free(grid->words);
+    free(grid);
+}
+
+static inline void setBitGridCell(BitGrid* grid, int i, int j, bool land) {
+    uint64_t* word = &grid->words[(size_t)i * grid->wordsPerRow + j / 64];
+    uint64_t bit = 1ULL << (j % 64);
+    *word = land ? (*word | bit) : (*word & ~bit);
+}
+
+// Horizontal run of land [begin, end) in one row, with its union-find node
+typedef struct {
+    int begin, end;
+    uint32_t label;
+} LandRun;
+
+// Growable run list
+typedef struct {
+    LandRun* runs;
+    size_t size, capacity;
+} RunList;
+
+static bool pushRun(RunList* list, int begin, int end) {
+    if (list->size == list->capacity) {
+        size_t capacity = list->capacity ? list->capacity * 2 : 256;
+        LandRun* runs = (LandRun*)realloc(list->runs, capacity * sizeof(LandRun));
+        if (!runs) return false;
+        list->runs = runs;
+        list->capacity = capacity;
+    }
+    list->runs[list->size] = (LandRun){ begin, end, (uint32_t)list->size };
+    list->size++;
+    return true;
+}
+
+// Append the runs of one row, jumping over whole words of water or land with ctz
+static bool extractRuns(const BitGrid* grid, int row, RunList* list) {
+    const uint64_t* words = grid->words + (size_t)row * grid->wordsPerRow;
+    int j = 0;
+    while (j < grid->cols) {
+        // Next land cell at or after j
+        size_t w = j / 64;
+        uint64_t bits = words[w] & (~0ULL << (j % 64));
+        while (!bits && ++w < grid->wordsPerRow) bits = words[w];
+        if (!bits) break;
+        int begin = (int)(w * 64 + __builtin_ctzll(bits));
+        if (begin >= grid->cols) break;
+        // Next water cell after begin
+        bits = ~words[w] & (~0ULL << (begin % 64));
+        while (!bits && ++w < grid->wordsPerRow) bits = ~words[w];
+        int end = bits ? (int)(w * 64 + __builtin_ctzll(bits)) : grid->cols;
+        if (end > grid->cols) end = grid->cols;
+        if (!pushRun(list, begin, end)) return false;
+        j = end;
+    }
+    return true;
+}
+
+// Union-find over uint32 nodes, union by rank with path halving
+typedef struct {
+    uint32_t* parent;
+    uint8_t* rank;
+    size_t size, capacity;
+} RunForest;
+
+static bool growForest(RunForest* forest, size_t size) {
+    if (size <= forest->capacity) return true;
+    size_t capacity = forest->capacity ? forest->capacity : 256;
+    while (capacity < size) capacity *= 2;
+    uint32_t* parent = (uint32_t*)realloc(forest->parent, capacity * sizeof(uint32_t));
+    if (!parent) return false;
+    forest->parent = parent;
+    uint8_t* rank = (uint8_t*)realloc(forest->rank, capacity);
+    if (!rank) return false;
+    forest->rank = rank;
+    forest->capacity = capacity;
+    return true;
+}
+
+static bool addForestNode(RunForest* forest) {
+    if (!growForest(forest, forest->size + 1)) return false;
+    forest->parent[forest->size] = (uint32_t)forest->size;
+    forest->rank[forest->size] = 0;
+    forest->size++;
+    return true;
+}
+
+static uint32_t findRoot(RunForest* forest, uint32_t x) {
+    while (forest->parent[x] != x) {
+        forest->parent[x] = forest->parent[forest->parent[x]];
+        x = forest->parent[x];
+    }
+    return x;
+}
+
+// Returns true if x and y were in different sets
+static bool unionRoots(RunForest* forest, uint32_t x, uint32_t y) {
+    x = findRoot(forest, x);
+    y = findRoot(forest, y);
+    if (x == y) return false;
+    if (forest->rank[x] < forest->rank[y]) {
+        uint32_t tmp = x;
+        x = y;
+        y = tmp;
+    }
+    forest->parent[y] = x;
+    if (forest->rank[x] == forest->rank[y]) forest->rank[x]++;
+    return true;
+}
+
+// Union every run of the lower row with the runs of the upper row it shares a column with
+static long long unionOverlappingRuns(RunForest* forest, const LandRun* upper, size_t upperCount,
+                                      const LandRun* lower, size_t lowerCount) {
+    long long merged = 0;
+    size_t u = 0;
+    for (size_t l = 0; l < lowerCount; l++) {
+        while (u < upperCount && upper[u].end <= lower[l].begin) u++;
+        for (size_t k = u; k < upperCount && upper[k].begin < lower[l].end; k++) {
+            merged += unionRoots(forest, upper[k].label, lower[l].label);
+        }
+    }
+    return merged;
+}
+
+// Result of labeling one tile: its island count and the runs of its edge rows, with
+// labels renumbered 0..borderLabels-1 over the islands that reach an edge row
+typedef struct {
+    long long islands;
+    RunList top, bottom;
+    uint32_t borderLabels;
+    bool ok;
+} TileResult;
+
+typedef struct {
+    const BitGrid* grid;
+    TileResult* tiles;
+    int tileCount;
+    atomic_int next;
+} LabelJob;
+
+static void labelTile(const BitGrid* grid, int rowBegin, int rowEnd, TileResult* result) {
+    RunList runs = { 0 };
+    RunForest forest = { 0 };
+    long long merged = 0;
+    size_t previousRow = 0, currentRow = 0, lastRow = 0;
+    size_t firstRowEnd = 0;
+    result->ok = true;
+    for (int i = rowBegin; i < rowEnd && result->ok; i++) {
+        currentRow = runs.size;
+        if (!extractRuns(grid, i, &runs) || !growForest(&forest, runs.size)) {
+            result->ok = false;
+            break;
+        }
+        while (forest.size < runs.size) addForestNode(&forest);
+        if (i > rowBegin) {
+            merged += unionOverlappingRuns(&forest, runs.runs + previousRow, currentRow - previousRow,
+                                           runs.runs + currentRow, runs.size - currentRow);
+        } else {
+            firstRowEnd = runs.size;
+        }
+        lastRow = currentRow;
+        previousRow = currentRow;
+    }
+    result->islands = (long long)runs.size - merged;
+
+    // Renumber the roots reached from the edge rows densely
+    uint32_t* dense = result->ok ? (uint32_t*)malloc((runs.size ? runs.size : 1) * sizeof(uint32_t)) : NULL;
+    if (result->ok && dense) {
+        memset(dense, 0xff, runs.size * sizeof(uint32_t));
+        result->borderLabels = 0;
+        RunList* edges[2] = { &result->top, &result->bottom };
+        size_t begins[2] = { 0, lastRow }, ends[2] = { firstRowEnd, runs.size };
+        for (int e = 0; e < 2 && result->ok; e++) {
+            for (size_t r = begins[e]; r < ends[e]; r++) {
+                uint32_t root = findRoot(&forest, runs.runs[r].label);
+                if (dense[root] == UINT32_MAX) dense[root] = result->borderLabels++;
+                if (!pushRun(edges[e], runs.runs[r].begin, runs.runs[r].end)) {
+                    result->ok = false;
+                    break;
+                }
+                edges[e]->runs[edges[e]->size - 1].label = dense[root];
+            }
+        }
+    } else {
+        result->ok = false;
+    }
+    free(dense);
+    free(runs.runs);
+    free(forest.parent);
+    free(forest.rank);
+}
+
+static void* labelWorker(void* arg) {
+    LabelJob* job = (LabelJob*)arg;
+    int t;
+    while ((t = atomic_fetch_add(&job->next, 1)) < job->tileCount) {
+        int rowBegin = t * TILE_ROWS;
+        int rowEnd = rowBegin + TILE_ROWS < job->grid->rows ? rowBegin + TILE_ROWS : job->grid->rows;
+        labelTile(job->grid, rowBegin, rowEnd, &job->tiles[t]);
+    }
+    return NULL;
+}
+
+// Count islands on a bit grid: tiles of TILE_ROWS rows are labeled on up to threads
+// threads, then their edge rows are unioned across tile borders. Returns -1 if memory runs out.
+long long numIslandsParallel(const BitGrid* grid, int threads) {
+    if (grid == NULL || grid->rows == 0 || grid->cols == 0) return 0;
+    int tileCount = (grid->rows + TILE_ROWS - 1) / TILE_ROWS;
+    LabelJob job = { .grid = grid, .tileCount = tileCount };
+    job.tiles = (TileResult*)calloc(tileCount, sizeof(TileResult));
+    if (!job.tiles) return -1;
+    atomic_init(&job.next, 0);
+
+    if (threads > tileCount) threads = tileCount;
+    if (threads < 1) threads = 1;
+    pthread_t* tids = threads > 1 ? (pthread_t*)malloc((threads - 1) * sizeof(pthread_t)) : NULL;
+    int started = 0;
+    while (tids && started < threads - 1 && pthread_create(&tids[started], NULL, labelWorker, &job) == 0) {
+        started++;
+    }
+    labelWorker(&job);
+    for (int t = 0; t < started; t++) {
+        pthread_join(tids[t], NULL);
+    }
+    free(tids);
+
+    // Second pass: one union-find node per border label, offset by tile
+    long long islands = 0;
+    size_t labels = 0;
+    bool ok = true;
+    for (int t = 0; t < tileCount; t++) {
+        ok = ok && job.tiles[t].ok;
+        islands += job.tiles[t].islands;
+        labels += job.tiles[t].borderLabels;
+    }
+    RunForest forest = { 0 };
+    if (ok && labels < UINT32_MAX && growForest(&forest, labels)) {
+        while (forest.size < labels) addForestNode(&forest);
+        uint32_t base = 0;
+        for (int t = 0; t < tileCount; t++) {
+            TileResult* tile = &job.tiles[t];
+            for (size_t r = 0; r < tile->top.size; r++) tile->top.runs[r].label += base;
+            for (size_t r = 0; r < tile->bottom.size; r++) tile->bottom.runs[r].label += base;
+            base += tile->borderLabels;
+            if (t > 0) {
+                TileResult* above = &job.tiles[t - 1];
+                islands -= unionOverlappingRuns(&forest, above->bottom.runs, above->bottom.size,
+                                                tile->top.runs, tile->top.size);
+            }
+        }
+    } else {
+        islands = -1;
+    }
+    for (int t = 0; t < tileCount; t++) {
+        free(job.tiles[t].top.runs);
+        free(job.tiles[t].bottom.runs);
+    }
+    free(job.tiles);
+    free(forest.parent);
+    free(forest.rank);
+    return islands;
+}
+
+// Dynamic islands over a grid of any size: only land cells have union-find nodes
+typedef struct {
+    int rows, cols;
+    uint64_t* cells;            // Open addressing: cell id + 1, 0 when empty
+    uint32_t* nodes;            // Union-find node of each occupied slot
+    size_t mask, used;
+    RunForest forest;
+    long long islands;
+} IslandTracker;
+
+static size_t cellSlot(const IslandTracker* tracker, uint64_t key) {
+    size_t slot = (size_t)((key * 0x9e3779b97f4a7c15ULL) >> 20) & tracker->mask;
+    while (tracker->cells[slot] && tracker->cells[slot] != key) slot = (slot + 1) & tracker->mask;
+    return slot;
+}
+
+static bool growCells(IslandTracker* tracker) {
+    IslandTracker bigger = *tracker;
+    bigger.mask = tracker->mask * 2 + 1;
+    bigger.cells = (uint64_t*)calloc(bigger.mask + 1, sizeof(uint64_t));
+    bigger.nodes = (uint32_t*)malloc((bigger.mask + 1) * sizeof(uint32_t));
+    if (!bigger.cells || !bigger.nodes) {
+        free(bigger.cells);
+        free(bigger.nodes);
+        return false;
+    }
+    for (size_t i = 0; i <= tracker->mask; i++) {
+        if (!tracker->cells[i]) continue;
+        size_t slot = cellSlot(&bigger, tracker->cells[i]);
+        bigger.cells[slot] = tracker->cells[i];
+        bigger.nodes[slot] = tracker->nodes[i];
+    }
+    free(tracker->cells);
+    free(tracker->nodes);
+    tracker->cells = bigger.cells;
+    tracker->nodes = bigger.nodes;
+    tracker->mask = bigger.mask;
+    return true;
+}
+
+IslandTracker* createIslandTracker(int rows, int cols) {
+    IslandTracker* tracker = (IslandTracker*)calloc(1, sizeof(IslandTracker));
+    if (!tracker) return NULL;
+    tracker->rows = rows;
+    tracker->cols = cols;
+    tracker->mask = 1023;
+    tracker->cells = (uint64_t*)calloc(tracker->mask + 1, sizeof(uint64_t));
+    tracker->nodes = (uint32_t*)malloc((tracker->mask + 1) * sizeof(uint32_t));
+    if (!tracker->cells || !tracker->nodes) {
+        free(tracker->cells);
+        free(tracker->nodes);
+        free(tracker);
+        return NULL;
+    }
+    return tracker;
+}
+
+void freeIslandTracker(IslandTracker* tracker) {
+    if (!tracker) return;
+    free(tracker->cells);
+    free(tracker->nodes);
+    free(tracker->forest.parent);
+    free(tracker->forest.rank);
+    free(tracker);
+}
+
+// Apply positions in order; counts[p] receives the island count after positions[p].
+// Positions outside the grid or already land leave the count unchanged. Returns the
+// number of positions applied, which is less than positionsSize only if memory runs out.
+int addLands(IslandTracker* tracker, int positions[][2], int positionsSize, long long* counts) {
+    int directions[4][2] = {{0,1}, {1,0}, {-1,0}, {0,-1}};
+    for (int p = 0; p < positionsSize; p++) {
+        int i = positions[p][0], j = positions[p][1];
+        if (i >= 0 && i < tracker->rows && j >= 0 && j < tracker->cols) {
+            uint64_t key = (uint64_t)i * tracker->cols + j + 1;
+            size_t slot = cellSlot(tracker, key);
+            if (!tracker->cells[slot]) {
+                if ((tracker->used + 1) * 2 > tracker->mask) {
+                    if (!growCells(tracker)) return p;
+                    slot = cellSlot(tracker, key);
+                }
+                if (tracker->forest.size >= UINT32_MAX || !addForestNode(&tracker->forest)) return p;
+                uint32_t node = (uint32_t)(tracker->forest.size - 1);
+                tracker->cells[slot] = key;
+                tracker->nodes[slot] = node;
+                tracker->used++;
+                tracker->islands++;
+                for (int d = 0; d < 4; d++) {
+                    int ni = i + directions[d][0], nj = j + directions[d][1];
+                    if (ni < 0 || ni >= tracker->rows || nj < 0 || nj >= tracker->cols) continue;
+                    size_t neighbor = cellSlot(tracker, (uint64_t)ni * tracker->cols + nj + 1);
+                    if (tracker->cells[neighbor] && unionRoots(&tracker->forest, node, tracker->nodes[neighbor])) {
+                        tracker->islands--;
+                    }
+                }
+            }
+        }
+        if (counts) counts[p] = tracker->islands;
+    }
+    return positionsSize;
+}
+
 // Main function to test the implementation
 int main() {
     int rows = 4, cols = 5;
@@ -167,6 +601,17 @@ int main() {
         memcpy(grid[i], gridData[i], cols * sizeof(char));
     }
     
+    BitGrid* bitGrid = createBitGrid(rows, cols);
+    if (bitGrid) {
+        for (int i = 0; i < rows; i++) {
+            for (int j = 0; j < cols; j++) {
+                setBitGridCell(bitGrid, i, j, gridData[i][j] == ISLAND);
+            }
+        }
+        printf("Number of Islands (Bit Grid): %lld\n", numIslandsParallel(bitGrid, 2));
+        freeBitGrid(bitGrid);
+    }
+
     printf("Number of Islands (DFS): %d\n", numIslands(grid, rows, cols));
     
     // Free allocated grid memory
@@ -179,6 +624,16 @@ int main() {
     int positions[][2] = {{0,0}, {0,1}, {1,2}, {2,1}};
     printf("\nNumber of Islands (Union-Find):\n");
     numIslands2(3, 3, positions, 4);
+
+    printf("\nNumber of Islands (Batch addLands):\n");
+    IslandTracker* tracker = createIslandTracker(3, 3);
+    long long counts[4];
+    if (tracker && addLands(tracker, positions, 4, counts) == 4) {
+        for (int p = 0; p < 4; p++) {
+            printf("%lld\n", counts[p]);
+        }
+    }
+    freeIslandTracker(tracker);
     
     return 0;
 }
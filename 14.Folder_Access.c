@@ -2,6 +2,7 @@
 #include <stdlib.h>
 #include <string.h>
 #include <stdbool.h>
+#include <stdint.h>
 
 /* This C implementation follows the Java logic and includes:
 
@@ -21,6 +22,15 @@
    - Uses fixed-size arrays for simplicity.
    - Could be improved with dynamic memory allocation for scalability.
 
+   Indexed Folder Tree (FolderIndex):
+   - Interns folder names into ids through a hash map; names live in one arena.
+   - Keeps a parent array and child lists; buildFolderIndex() numbers the folders
+     by an iterative Euler tour, so each subtree is one interval [tin, tout).
+   - A bitmap over tour positions marks every folder that is granted or has a
+     granted ancestor: hasAccessIndexed() is a hash lookup and one bit test.
+   - Granting access after the build sets the subtree's interval in the bitmap.
+   - simplifyAccessIndexed() keeps a grant only if its parent is not covered: one pass.
+
    Expected Output:
 
    Access to B: false
@@ -139,6 +149,277 @@ void simplifyAccess(FolderAccess* fa) {
     }
 }
 
+// Interned, indexed folder tree for large hierarchies
+typedef struct {
+    char* names;                 // Arena of NUL-terminated names
+    size_t namesSize, namesCapacity;
+    size_t* nameOffset;          // Per folder id
+    int32_t* parent;             // -1 for a root
+    int32_t* firstChild;
+    int32_t* nextSibling;
+    uint8_t* granted;            // Access granted directly on the folder
+    uint32_t* tin;               // Euler tour: subtree of id is positions [tin[id], tout[id])
+    uint32_t* tout;
+    uint64_t* covered;           // Bit per tour position: granted on the folder or an ancestor
+    int32_t* table;              // Open addressing, folder id + 1, 0 when empty
+    size_t tableMask;
+    int32_t* accessList;         // Granted folders, in the order they were granted
+    int accessCount, accessCapacity;
+    int count, capacity;
+    bool indexed;                // tin/tout/covered match the current tree
+} FolderIndex;
+
+static uint64_t folderNameHash(const char* name) {
+    uint64_t hash = 0xcbf29ce484222325ULL; // FNV-1a
+    for (; *name; name++) {
+        hash = (hash ^ (unsigned char)*name) * 0x100000001b3ULL;
+    }
+    return hash ^ (hash >> 29);
+}
+
+static const char* folderName(const FolderIndex* fi, int id) {
+    return fi->names + fi->nameOffset[id];
+}
+
+void initFolderIndex(FolderIndex* fi) {
+    memset(fi, 0, sizeof(FolderIndex));
+}
+
+void freeFolderIndex(FolderIndex* fi) {
+    free(fi->names);
+    free(fi->nameOffset);
+    free(fi->parent);
+    free(fi->firstChild);
+    free(fi->nextSibling);
+    free(fi->granted);
+    free(fi->tin);
+    free(fi->tout);
+    free(fi->covered);
+    free(fi->table);
+    free(fi->accessList);
+    initFolderIndex(fi);
+}
+
+// Id of a folder, or -1 if it was never mentioned
+int findFolderId(const FolderIndex* fi, const char* name) {
+    if (!fi->table) return -1;
+    size_t slot = folderNameHash(name) & fi->tableMask;
+    while (fi->table[slot]) {
+        int id = fi->table[slot] - 1;
+        if (strcmp(folderName(fi, id), name) == 0) return id;
+        slot = (slot + 1) & fi->tableMask;
+    }
+    return -1;
+}
+
+static bool growFolderTable(FolderIndex* fi) {
+    size_t size = fi->table ? (fi->tableMask + 1) * 2 : 1024;
+    int32_t* table = (int32_t*)calloc(size, sizeof(int32_t));
+    if (!table) return false;
+    for (int id = 0; id < fi->count; id++) {
+        size_t slot = folderNameHash(folderName(fi, id)) & (size - 1);
+        while (table[slot]) slot = (slot + 1) & (size - 1);
+        table[slot] = id + 1;
+    }
+    free(fi->table);
+    fi->table = table;
+    fi->tableMask = size - 1;
+    return true;
+}
+
+#define GROW_ARRAY(array, capacity) \
+    do { void* grown = realloc((array), (capacity) * sizeof(*(array))); if (!grown) return -1; (array) = grown; } while (0)
+
+// Id of a folder, adding it (as a root with no access) if it is new. Returns -1 if
+// memory runs out.
+int internFolder(FolderIndex* fi, const char* name) {
+    int id = findFolderId(fi, name);
+    if (id >= 0) return id;
+
+    if (fi->count == INT32_MAX - 1) return -1;
+    if (fi->count == fi->capacity) {
+        int capacity = fi->capacity ? fi->capacity * 2 : 64;
+        GROW_ARRAY(fi->nameOffset, capacity);
+        GROW_ARRAY(fi->parent, capacity);
+        GROW_ARRAY(fi->firstChild, capacity);
+        GROW_ARRAY(fi->nextSibling, capacity);
+        GROW_ARRAY(fi->granted, capacity);
+        fi->capacity = capacity;
+    }
+    size_t length = strlen(name) + 1;
+    if (fi->namesSize + length > fi->namesCapacity) {
+        size_t capacity = fi->namesCapacity ? fi->namesCapacity * 2 : 4096;
+        while (capacity < fi->namesSize + length) capacity *= 2;
+        GROW_ARRAY(fi->names, capacity);
+        fi->namesCapacity = capacity;
+    }
+    if ((size_t)(fi->count + 1) * 2 > (fi->table ? fi->tableMask + 1 : 0) && !growFolderTable(fi)) return -1;
+
+    id = fi->count++;
+    memcpy(fi->names + fi->namesSize, name, length);
+    fi->nameOffset[id] = fi->namesSize;
+    fi->namesSize += length;
+    fi->parent[id] = -1;
+    fi->firstChild[id] = -1;
+    fi->nextSibling[id] = -1;
+    fi->granted[id] = 0;
+    size_t slot = folderNameHash(name) & fi->tableMask;
+    while (fi->table[slot]) slot = (slot + 1) & fi->tableMask;
+    fi->table[slot] = id + 1;
+    fi->indexed = false;
+    return id;
+}
+
+// Function to add a folder relationship. A folder added again moves to the new parent.
+bool addFolderIndexed(FolderIndex* fi, const char* folder, const char* parent) {
+    int id = internFolder(fi, folder);
+    int parentId = parent != NULL ? internFolder(fi, parent) : -1;
+    if (id < 0 || (parent != NULL && parentId < 0)) return false;
+    if (fi->parent[id] == parentId) return true;
+
+    // Unlink from the old parent's child list
+    if (fi->parent[id] >= 0) {
+        int32_t* link = &fi->firstChild[fi->parent[id]];
+        while (*link != id) link = &fi->nextSibling[*link];
+        *link = fi->nextSibling[id];
+    }
+    fi->parent[id] = parentId;
+    if (parentId >= 0) {
+        fi->nextSibling[id] = fi->firstChild[parentId];
+        fi->firstChild[parentId] = id;
+    }
+    fi->indexed = false;
+    return true;
+}
+
+static void setCoveredRange(FolderIndex* fi, uint32_t begin, uint32_t end) {
+    for (uint32_t pos = begin; pos < end;) {
+        if (pos % 64 == 0 && end - pos >= 64) {
+            fi->covered[pos / 64] = ~0ULL;
+            pos += 64;
+        } else {
+            fi->covered[pos / 64] |= 1ULL << (pos % 64);
+            pos++;
+        }
+    }
+}
+
+static inline bool isCovered(const FolderIndex* fi, int id) {
+    return (fi->covered[fi->tin[id] / 64] >> (fi->tin[id] % 64)) & 1;
+}
+
+// Number folders by an iterative Euler tour and fill the coverage bitmap. Folders on a
+// parent cycle are not reachable from any root; each gets its own position and is
+// covered only by a direct grant.
+bool buildFolderIndex(FolderIndex* fi) {
+    free(fi->tin);
+    free(fi->tout);
+    free(fi->covered);
+    int n = fi->count;
+    fi->tin = (uint32_t*)malloc((n ? n : 1) * sizeof(uint32_t));
+    fi->tout = (uint32_t*)malloc((n ? n : 1) * sizeof(uint32_t));
+    fi->covered = (uint64_t*)calloc((size_t)n / 64 + 1, sizeof(uint64_t));
+    int32_t* stack = (int32_t*)malloc((n ? n : 1) * sizeof(int32_t));
+    int32_t* cursor = (int32_t*)malloc((n ? n : 1) * sizeof(int32_t)); // Next child to visit
+    uint8_t* inherited = (uint8_t*)malloc(n ? n : 1);                   // Granted on self or above
+    if (!fi->tin || !fi->tout || !fi->covered || !stack || !cursor || !inherited) {
+        free(stack);
+        free(cursor);
+        free(inherited);
+        fi->indexed = false;
+        return false;
+    }
+
+    uint32_t position = 0;
+    for (int id = 0; id < n; id++) fi->tin[id] = UINT32_MAX;
+    for (int root = 0; root < n; root++) {
+        if (fi->parent[root] >= 0) continue;
+        int depth = 0;
+        stack[0] = root;
+        cursor[root] = fi->firstChild[root];
+        fi->tin[root] = position++;
+        inherited[root] = fi->granted[root];
+        while (depth >= 0) {
+            int node = stack[depth];
+            int child = cursor[node];
+            if (child < 0) {
+                fi->tout[node] = position;
+                depth--;
+                continue;
+            }
+            cursor[node] = fi->nextSibling[child];
+            fi->tin[child] = position++;
+            inherited[child] = fi->granted[child] || inherited[node];
+            cursor[child] = fi->firstChild[child];
+            stack[++depth] = child;
+        }
+    }
+    for (int id = 0; id < n; id++) {
+        if (fi->tin[id] == UINT32_MAX) {
+            fi->tin[id] = position++;
+            fi->tout[id] = position;
+            inherited[id] = fi->granted[id];
+        }
+        if (inherited[id]) {
+            fi->covered[fi->tin[id] / 64] |= 1ULL << (fi->tin[id] % 64);
+        }
+    }
+    free(stack);
+    free(cursor);
+    free(inherited);
+    fi->indexed = true;
+    return true;
+}
+
+// Function to add an accessible folder. After the index is built this also covers the
+// folder's subtree in place, without a rebuild.
+bool addAccessIndexed(FolderIndex* fi, const char* folder) {
+    int id = internFolder(fi, folder);
+    if (id < 0) return false;
+    if (fi->granted[id]) return true;
+    if (fi->accessCount == fi->accessCapacity) {
+        int capacity = fi->accessCapacity ? fi->accessCapacity * 2 : 64;
+        int32_t* list = (int32_t*)realloc(fi->accessList, capacity * sizeof(int32_t));
+        if (!list) return false;
+        fi->accessList = list;
+        fi->accessCapacity = capacity;
+    }
+    fi->accessList[fi->accessCount++] = id;
+    fi->granted[id] = 1;
+    if (fi->indexed) setCoveredRange(fi, fi->tin[id], fi->tout[id]);
+    return true;
+}
+
+// Constant-time access check (one name lookup and one bit test). Rebuilds the index
+// first if folders changed since the last build; once built, concurrent readers are safe.
+bool hasAccessIndexed(FolderIndex* fi, const char* folder) {
+    if (!fi->indexed && !buildFolderIndex(fi)) return false;
+    int id = findFolderId(fi, folder);
+    return id >= 0 && isCovered(fi, id);
+}
+
+// True if ancestor is folder itself or above it
+bool isAncestorFolder(FolderIndex* fi, int ancestor, int folder) {
+    if (!fi->indexed && !buildFolderIndex(fi)) return false;
+    return fi->tin[ancestor] <= fi->tin[folder] && fi->tout[folder] <= fi->tout[ancestor];
+}
+
+// Drop grants already implied by a granted ancestor: a grant stays only if its parent
+// is not covered. One pass over the access list.
+void simplifyAccessIndexed(FolderIndex* fi) {
+    if (!fi->indexed && !buildFolderIndex(fi)) return;
+    int kept = 0;
+    for (int i = 0; i < fi->accessCount; i++) {
+        int id = fi->accessList[i];
+        if (fi->parent[id] >= 0 && isCovered(fi, fi->parent[id])) {
+            fi->granted[id] = 0;
+        } else {
+            fi->accessList[kept++] = id;
+        }
+    }
+    fi->accessCount = kept;
+}
+
 // Main function for testing
 int main() {
     FolderAccess fa;
@@ -168,6 +449,28 @@ int main() {
     for (int i = 0; i < fa.accessCount; i++) {
         printf("%s\n", fa.access[i]);
     }
+
+    // Same checks through the indexed tree
+    FolderIndex fi;
+    initFolderIndex(&fi);
+    const char* hierarchy[][2] = {{"A", NULL}, {"B", "A"}, {"C", "B"}, {"D", "B"}, {"E", "A"}, {"F", "E"}};
+    for (int i = 0; i < 6; i++) {
+        addFolderIndexed(&fi, hierarchy[i][0], hierarchy[i][1]);
+    }
+    addAccessIndexed(&fi, "C");
+    addAccessIndexed(&fi, "E");
+    addAccessIndexed(&fi, "F");
+    buildFolderIndex(&fi);
+    printf("\nAccess to B (indexed): %s\n", hasAccessIndexed(&fi, "B") ? "true" : "false");
+    printf("Access to C (indexed): %s\n", hasAccessIndexed(&fi, "C") ? "true" : "false");
+    printf("Access to F (indexed): %s\n", hasAccessIndexed(&fi, "F") ? "true" : "false");
+    printf("Access to G (indexed): %s\n", hasAccessIndexed(&fi, "G") ? "true" : "false");
+    simplifyAccessIndexed(&fi);
+    printf("\nSimplified Access List (indexed):\n");
+    for (int i = 0; i < fi.accessCount; i++) {
+        printf("%s\n", folderName(&fi, fi.accessList[i]));
+    }
+    freeFolderIndex(&fi);
     
     return 0;
 }
@@ -1,9 +1,22 @@
+#define _GNU_SOURCE
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <pthread.h>
 #include <unistd.h>
 #include <stdbool.h>
+#include <stdint.h>
+#include <stdatomic.h>
+#include <sched.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <netdb.h>
+#include <strings.h>
+#include <time.h>
+#include <netinet/in.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
 
 /* This C implementation mirrors the Java multithreaded web crawler using POSIX threads (pthread):
 
@@ -12,11 +25,13 @@
    - Stores URLs and their connected links dynamically.
 
    Multithreading with pthread (crawl):
-   - Each thread crawls a single URL and fetches linked URLs.
+   - FETCH_THREADS fetcher event loops download pages, PARSE_THREADS parse workers
+     (crawl) extract links into their frontier deques, and one resolver thread does DNS.
 
    Thread Management (crawlManager):
-   - Controls THREAD_COUNT crawlers.
-   - Uses sleep(PAUSE_TIME) to throttle requests.
+   - Starts the fetch, parse and resolver threads and waits for the crawl to finish.
+   - Requests are throttled per host by a token bucket (HOST_REQUESTS_PER_SECOND,
+     HOST_BURST) and a HOST_MAX_CONNECTIONS limit, not by sleeping.
 
    Synchronization (pthread_mutex_t):
    - Protects shared visited URLs with a mutex lock.
@@ -66,11 +81,81 @@
 
    Now, the crawler ensures full URL coverage in a controlled multithreaded manner
 
+   =================================================
+   Scaling to Millions of URLs
+
+   Work-Stealing Frontier (WorkDeque):
+   - Each parse worker owns a lock-free Chase-Lev deque and pushes the links it finds at
+     the bottom; fetchers steal the oldest ones from the top of a random deque with one CAS.
+   - Popping is O(1); nothing is shifted or copied, the deques hold URL pointers.
+   - Every URL is crawled exactly once, but the output order varies from run to run.
+
+   Sharded Visited Set (addVisitedUrl):
+   - VISITED_SHARDS independently locked open-addressing tables keyed by a 64-bit hash.
+   - A URL is marked when it is discovered, so it is queued once instead of being
+     filtered again when popped; lookups are O(1) instead of a scan.
+   - The set keeps its own copy of every URL; the pipeline passes that pointer around.
+
+   Quiescence Detection (pendingUrls):
+   - Counts URLs discovered but not yet parsed or failed. Links are counted before they
+     become visible and a page is only uncounted after its links are queued, so zero
+     means the crawl is over: the thread that reaches it stops every stage and
+     crawlManager() returns.
+
+   =================================================
+   Politeness-Bound Fetch Pipeline
+
+   frontier deques -> per-host scheduler -> fetchers (epoll) -> page queue -> parse workers
+
+   Per-Host Scheduler (HostScheduler):
+   - Fetchers move frontier URLs into per-host FIFOs, up to SCHEDULER_CAPACITY in total.
+   - Each host has a token bucket (HOST_REQUESTS_PER_SECOND, HOST_BURST) and at most
+     HOST_MAX_CONNECTIONS requests in flight. Hosts with queued URLs sit in a min-heap
+     keyed by when their bucket next allows a request, so picking the next request is
+     O(log hosts) and crawl speed is set by the politeness policy, not by thread count.
+
+   DNS Cache (resolver):
+   - Addresses are cached per host for DNS_TTL_SECONDS; failures for
+     DNS_NEGATIVE_TTL_SECONDS. A resolver thread runs getaddrinfo() so no fetch loop
+     ever blocks on a lookup, and a host is only scheduled once it has an address.
+
+   Fetch Stage (fetcherLoop):
+   - FETCH_THREADS event loops, each keeping up to FETCH_MAX_IN_FLIGHT non-blocking
+     HTTP/1.0 GETs in flight over epoll, with a FETCH_TIMEOUT_MS deadline per request
+     and responses capped at MAX_PAGE_BYTES.
+   - Bare names such as "a" have no scheme and are served from the in-memory urlGraph
+     through the same scheduler, so the sample graph in main() still crawls offline.
+   - Only http:// is fetched; other schemes are reported as failures.
+
+   Parse Stage (crawl):
+   - PARSE_THREADS workers take pages from a bounded queue (PAGE_QUEUE_CAPACITY) and
+     extract href links and redirect targets. Fetchers stop starting requests while the
+     queue is full, so a slow parse stage throttles the fetch stage instead of piling up.
+   - Prints "Crawled: <url>" per page and "Failed: <url> (<reason>)" per failure.
+
 */
 
 
 #define MAX_URLS 100
-#define THREAD_COUNT 5
+#define PARSE_THREADS 4             // Parse/extract stage workers (each owns a frontier deque)
+#define FETCH_THREADS 2             // Fetch stage event loops
+#define FETCH_MAX_IN_FLIGHT 64      // Concurrent requests per fetch thread
+#define FETCH_TIMEOUT_MS 10000      // Connect + send + receive budget for one request
+#define FETCH_IDLE_POLL_MS 5        // Backstop for an idle fetcher that missed a wakeup
+#define MAX_PAGE_BYTES (1024 * 1024) // Longer responses are truncated
+#define MAX_LINK_LENGTH 1024        // Longer extracted links are skipped
+#define HOST_NAME_LENGTH 256        // host[:port]
+#define HOST_REQUESTS_PER_SECOND 2.0 // Politeness: sustained request rate per host
+#define HOST_BURST 4.0              // Politeness: requests a quiet host may get back to back
+#define HOST_MAX_CONNECTIONS 2      // Politeness: concurrent requests per host
+#define DNS_TTL_SECONDS 300         // How long a resolved address is reused
+#define DNS_NEGATIVE_TTL_SECONDS 60 // How long a failed lookup is remembered
+#define SCHEDULER_CAPACITY 65536    // URLs held in per-host queues before fetchers stop pulling
+#define PAGE_QUEUE_CAPACITY 256     // Fetched pages waiting for the parse stage
+#define DEQUE_INITIAL_CAPACITY 64   // Slots per worker deque before it first grows (power of two)
+#define VISITED_SHARDS 64           // Independent locks in the visited set (power of two)
+#define VISITED_INITIAL_CAPACITY 64 // Slots per visited shard before it first grows (power of two)
+#define STEAL_ROUNDS 2              // Passes over the frontier deques per refill
 
 // Structure to represent a URL and its connected links
 typedef struct {
@@ -79,15 +164,154 @@ typedef struct {
     int count;
 } UrlNode;
 
+// Circular buffer behind a work-stealing deque. Replaced (never shrunk) when full.
+typedef struct DequeArray {
+    long capacity;                          // Power of two
+    struct DequeArray* previous;            // Older buffer a thief may still read; freed after the crawl
+    const char* _Atomic slots[];
+} DequeArray;
+
+// Chase-Lev work-stealing deque of URLs. The owning parse worker pushes at
+// the bottom without locking; fetchers steal the oldest URL from the top with one CAS.
+typedef struct {
+    _Atomic long top;
+    char pad[64 - sizeof(long)];            // Keep thieves' top off the owner's cache line
+    _Atomic long bottom;
+    DequeArray* _Atomic array;
+} WorkDeque;
+
+// One parse-stage thread and the frontier deque it fills
+typedef struct {
+    WorkDeque deque;
+    pthread_t thread;
+    int id;
+} CrawlWorker;
+
+// One shard of the visited set: open addressing over cached hashes
+typedef struct {
+    pthread_mutex_t lock;
+    uint64_t* hashes;
+    char** urls;                            // The set's own copies, stable until the crawl ends
+    size_t capacity;
+    size_t count;
+    char pad[64];
+} VisitedShard;
+
+// Fixed-capacity blocking queue between two pipeline stages
+typedef struct {
+    pthread_mutex_t lock;
+    pthread_cond_t notEmpty;
+    pthread_cond_t notFull;
+    void** items;
+    size_t capacity;
+    size_t head;
+    size_t count;
+    bool closed;                            // Pops drain what is left, then return NULL
+} BoundedQueue;
+
+enum { DNS_UNRESOLVED = 0, DNS_PENDING, DNS_OK, DNS_FAILED };
+
+typedef struct QueuedUrl {
+    const char* url;
+    struct QueuedUrl* next;
+} QueuedUrl;
+
+// Politeness and DNS state of one host. Guarded by the scheduler lock, kept
+// for the whole crawl, so it doubles as the DNS cache.
+typedef struct HostState {
+    struct HostState* next;                 // Hash chain
+    struct HostState* dnsNext;              // Resolver queue link
+    char name[HOST_NAME_LENGTH];            // host[:port]
+    uint64_t hash;
+    bool isGraph;                           // Bare name served from urlGraph: no DNS, no sockets
+    int dnsState;
+    struct sockaddr_in addr;
+    uint64_t dnsExpiresNs;
+    double tokens;                          // Token bucket: one request per token
+    uint64_t refilledNs;
+    int inFlight;
+    long heapIndex;                         // Position in the ready heap, -1 if not in it
+    uint64_t readyAtNs;                     // When its next request may start
+    QueuedUrl* head;
+    QueuedUrl* tail;
+} HostState;
+
+// Shared per-host scheduler: hosts with queued URLs sit in a min-heap keyed
+// by the time their token bucket next allows a request
+typedef struct {
+    pthread_mutex_t lock;
+    pthread_cond_t dnsCond;                 // Wakes the resolver
+    HostState** buckets;
+    size_t bucketCount;                     // Power of two
+    size_t hostCount;
+    HostState** ready;
+    size_t readyCount;
+    size_t readyCapacity;
+    HostState* dnsHead;
+    HostState* dnsTail;
+    _Atomic size_t queuedUrls;              // Across all hosts, bounded by SCHEDULER_CAPACITY
+} HostScheduler;
+
+// A URL the scheduler released for fetching
+typedef struct {
+    const char* url;
+    HostState* host;
+    struct sockaddr_in addr;                // Copied so the fetch needs no scheduler lock
+} FetchTask;
+
+// A fetched page on its way to the parse stage
+typedef struct {
+    const char* url;
+    const char* host;                       // For resolving root-relative links
+    char** graphLinks;                      // In-memory graph page
+    int graphCount;
+    char* body;                             // HTTP response, headers included
+    size_t length;
+} Page;
+
+enum { FETCH_CONNECTING = 0, FETCH_SENDING, FETCH_READING };
+
+// One request in flight on a fetcher's event loop
+typedef struct Fetch {
+    FetchTask task;
+    int fd;
+    int state;
+    char request[MAX_LINK_LENGTH + HOST_NAME_LENGTH + 128];
+    size_t requestLength;
+    size_t requestSent;
+    char* body;
+    size_t length;
+    size_t capacity;
+    uint64_t deadlineNs;
+    struct Fetch* prev;                     // Start order, which is also deadline order
+    struct Fetch* next;
+} Fetch;
+
+typedef struct {
+    pthread_t thread;
+    int epollFd;
+    int inFlight;
+    unsigned int seed;                      // Picks where each steal pass starts
+    Fetch* oldest;
+    Fetch* newest;
+} Fetcher;
+
 // Global Variables
 UrlNode urlGraph[MAX_URLS];
 int urlGraphSize = 0;
-char visitedUrls[MAX_URLS][100];
-int visitedCount = 0;
-char queue[MAX_URLS][100];
-int queueSize = 0;
-pthread_mutex_t lock;
-pthread_cond_t cond;
+VisitedShard visitedShards[VISITED_SHARDS];
+CrawlWorker workers[PARSE_THREADS];
+Fetcher fetchers[FETCH_THREADS];
+HostScheduler scheduler;
+BoundedQueue pageQueue;
+pthread_t resolverThread;
+int fetchWakeFd = -1;                       // eventfd every fetcher polls
+_Atomic long pendingUrls = 0;               // Discovered URLs not yet fully crawled
+_Atomic int idleFetchers = 0;
+_Atomic bool crawlDone = false;
+
+// Returned by stealUrl when it lost a race and the victim may still have work
+static const char stealAborted[] = "";
 
 // Function to add URL relationships
 void addUrlNode(const char* url, const char* connections[], int count) {
@@ -111,96 +335,883 @@ char** getUrls(const char* url, int* count) {
     return NULL;
 }
 
+static uint64_t nowNs(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+}
+
+// 64-bit FNV-1a with a murmur3 finalizer: high bits pick the shard, low bits the slot
+static uint64_t hashUrl(const char* url) {
+    uint64_t h = 1469598103934665603ULL;
+    for (const unsigned char* p = (const unsigned char*)url; *p; p++) {
+        h ^= *p;
+        h *= 1099511628211ULL;
+    }
+    h ^= h >> 33;
+    h *= 0xff51afd7ed558ccdULL;
+    h ^= h >> 33;
+    h *= 0xc4ceb9fe1a85ec53ULL;
+    h ^= h >> 33;
+    return h;
+}
+
+/* ========== Visited Set ========== */
+
+static VisitedShard* visitedShardOf(uint64_t hash) {
+    return &visitedShards[(hash >> 58) & (VISITED_SHARDS - 1)];
+}
+
+// Slot holding url in a shard, or the empty slot where it belongs. Caller holds the shard lock.
+static size_t visitedProbe(const VisitedShard* shard, const char* url, uint64_t hash) {
+    size_t mask = shard->capacity - 1;
+    size_t i = hash & mask;
+    while (shard->urls[i] && (shard->hashes[i] != hash || strcmp(shard->urls[i], url) != 0)) i = (i + 1) & mask;
+    return i;
+}
+
+// Double a shard's table. Caller holds the shard lock. Returns false on OOM.
+static bool visitedGrow(VisitedShard* shard) {
+    size_t capacity = shard->capacity ? shard->capacity * 2 : VISITED_INITIAL_CAPACITY;
+    uint64_t* hashes = calloc(capacity, sizeof(uint64_t));
+    char** urls = calloc(capacity, sizeof(char*));
+    if (!hashes || !urls) {
+        free(hashes);
+        free(urls);
+        return false;
+    }
+    for (size_t j = 0; j < shard->capacity; j++) {
+        if (!shard->urls[j]) continue;
+        size_t i = shard->hashes[j] & (capacity - 1);
+        while (urls[i]) i = (i + 1) & (capacity - 1);
+        hashes[i] = shard->hashes[j];
+        urls[i] = shard->urls[j];
+    }
+    free(shard->hashes);
+    free(shard->urls);
+    shard->hashes = hashes;
+    shard->urls = urls;
+    shard->capacity = capacity;
+    return true;
+}
+
 // Function to check if URL has been visited
 bool isVisited(const char* url) {
-    for (int i = 0; i < visitedCount; i++) {
-        if (strcmp(visitedUrls[i], url) == 0) {
-            return true;
+    uint64_t hash = hashUrl(url);
+    VisitedShard* shard = visitedShardOf(hash);
+    pthread_mutex_lock(&shard->lock);
+    bool found = shard->capacity && shard->urls[visitedProbe(shard, url, hash)] != NULL;
+    pthread_mutex_unlock(&shard->lock);
+    return found;
+}
+
+// Function to add URL to the visited list. Returns the set's own copy of url
+// to the one caller that added it, so each URL is queued exactly once, and
+// NULL if it was already there (or on OOM). The copy lives until the crawl ends.
+const char* addVisitedUrl(const char* url) {
+    uint64_t hash = hashUrl(url);
+    VisitedShard* shard = visitedShardOf(hash);
+    pthread_mutex_lock(&shard->lock);
+    char* added = NULL;
+    // Stay under a 50% load factor so probe runs stay short
+    if ((shard->count + 1) * 2 <= shard->capacity || visitedGrow(shard)) {
+        size_t i = visitedProbe(shard, url, hash);
+        if (!shard->urls[i] && (added = strdup(url)) != NULL) {
+            shard->hashes[i] = hash;
+            shard->urls[i] = added;
+            shard->count++;
         }
     }
-    return false;
+    pthread_mutex_unlock(&shard->lock);
+    return added;
 }
 
-// Function to add URL to the visited list
-void addVisitedUrl(const char* url) {
-    strcpy(visitedUrls[visitedCount++], url);
+static void initVisitedSet(void) {
+    for (int i = 0; i < VISITED_SHARDS; i++) {
+        pthread_mutex_init(&visitedShards[i].lock, NULL);
+        visitedShards[i].hashes = NULL;
+        visitedShards[i].urls = NULL;
+        visitedShards[i].capacity = 0;
+        visitedShards[i].count = 0;
+    }
 }
 
-// Function to add URLs to the queue
-void enqueueUrl(const char* url) {
-    strcpy(queue[queueSize++], url);
+static void destroyVisitedSet(void) {
+    for (int i = 0; i < VISITED_SHARDS; i++) {
+        for (size_t j = 0; j < visitedShards[i].capacity; j++) free(visitedShards[i].urls[j]);
+        free(visitedShards[i].hashes);
+        free(visitedShards[i].urls);
+        pthread_mutex_destroy(&visitedShards[i].lock);
+    }
 }
 
-// Function to dequeue a URL
-bool dequeueUrl(char* url) {
-    if (queueSize == 0) return false;
-    strcpy(url, queue[0]);
-    for (int i = 1; i < queueSize; i++) {
-        strcpy(queue[i - 1], queue[i]);
+/* ========== Frontier Deques ========== */
+
+static DequeArray* dequeArrayNew(long capacity) {
+    DequeArray* a = malloc(sizeof(DequeArray) + capacity * sizeof(const char*));
+    if (a) {
+        a->capacity = capacity;
+        a->previous = NULL;
+    }
+    return a;
+}
+
+static bool initDeque(WorkDeque* d) {
+    atomic_init(&d->top, 0);
+    atomic_init(&d->bottom, 0);
+    DequeArray* a = dequeArrayNew(DEQUE_INITIAL_CAPACITY);
+    atomic_init(&d->array, a);
+    return a != NULL;
+}
+
+static void destroyDeque(WorkDeque* d) {
+    DequeArray* a = atomic_load_explicit(&d->array, memory_order_relaxed);
+    while (a) {
+        DequeArray* previous = a->previous;
+        free(a);
+        a = previous;
+    }
+}
+
+// Owner only: push url at the bottom, doubling the buffer when full.
+// Returns false on OOM.
+static bool dequePush(WorkDeque* d, const char* url) {
+    long b = atomic_load_explicit(&d->bottom, memory_order_relaxed);
+    long t = atomic_load_explicit(&d->top, memory_order_acquire);
+    DequeArray* a = atomic_load_explicit(&d->array, memory_order_relaxed);
+    if (b - t > a->capacity - 1) {
+        // Thieves may still be reading the old buffer, so it is kept until the crawl ends
+        DequeArray* bigger = dequeArrayNew(a->capacity * 2);
+        if (!bigger) return false;
+        for (long i = t; i < b; i++) {
+            const char* x = atomic_load_explicit(&a->slots[i & (a->capacity - 1)], memory_order_relaxed);
+            atomic_store_explicit(&bigger->slots[i & (bigger->capacity - 1)], x, memory_order_relaxed);
+        }
+        bigger->previous = a;
+        atomic_store_explicit(&d->array, bigger, memory_order_release);
+        a = bigger;
     }
-    queueSize--;
+    atomic_store_explicit(&a->slots[b & (a->capacity - 1)], url, memory_order_relaxed);
+    atomic_store_explicit(&d->bottom, b + 1, memory_order_release);
     return true;
 }
 
-// Function executed by each crawler thread
-void* crawl(void* args) {
-    while (1) {
-        pthread_mutex_lock(&lock);
-        while (queueSize == 0) {
-            pthread_cond_wait(&cond, &lock);
-        }
-        
-        char url[100];
-        if (!dequeueUrl(url)) {
-            pthread_mutex_unlock(&lock);
+// Any thread: take the oldest URL. Returns NULL if the deque is empty, or
+// stealAborted if another thread won the race for it.
+static const char* stealUrl(WorkDeque* d) {
+    long t = atomic_load_explicit(&d->top, memory_order_acquire);
+    atomic_thread_fence(memory_order_seq_cst);
+    long b = atomic_load_explicit(&d->bottom, memory_order_acquire);
+    if (t >= b) return NULL;
+    DequeArray* a = atomic_load_explicit(&d->array, memory_order_acquire);
+    const char* url = atomic_load_explicit(&a->slots[t & (a->capacity - 1)], memory_order_relaxed);
+    if (!atomic_compare_exchange_strong_explicit(&d->top, &t, t + 1, memory_order_seq_cst, memory_order_relaxed)) {
+        return stealAborted;
+    }
+    return url;
+}
+
+// Take one URL from the parse workers' deques, starting at a random one
+static const char* stealFrontier(Fetcher* self) {
+    for (int round = 0; round < STEAL_ROUNDS; round++) {
+        int start = (int)(rand_r(&self->seed) % PARSE_THREADS);
+        bool aborted = false;
+        for (int k = 0; k < PARSE_THREADS; k++) {
+            const char* url = stealUrl(&workers[(start + k) % PARSE_THREADS].deque);
+            if (url == stealAborted) {
+                aborted = true;
+            } else if (url) {
+                return url;
+            }
+        }
+        if (!aborted) break;
+    }
+    return NULL;
+}
+
+/* ========== Bounded Queues ========== */
+
+static bool boundedQueueInit(BoundedQueue* q, size_t capacity) {
+    pthread_mutex_init(&q->lock, NULL);
+    pthread_cond_init(&q->notEmpty, NULL);
+    pthread_cond_init(&q->notFull, NULL);
+    q->items = malloc(capacity * sizeof(void*));
+    q->capacity = capacity;
+    q->head = 0;
+    q->count = 0;
+    q->closed = false;
+    return q->items != NULL;
+}
+
+static void boundedQueueDestroy(BoundedQueue* q) {
+    free(q->items);
+    pthread_mutex_destroy(&q->lock);
+    pthread_cond_destroy(&q->notEmpty);
+    pthread_cond_destroy(&q->notFull);
+}
+
+// Block while the queue is full: a slow stage holds back the one feeding it.
+// Returns false, leaving the item to the caller, once the queue is closed.
+static bool boundedQueuePush(BoundedQueue* q, void* item) {
+    pthread_mutex_lock(&q->lock);
+    while (q->count == q->capacity && !q->closed) pthread_cond_wait(&q->notFull, &q->lock);
+    bool pushed = !q->closed;
+    if (pushed) {
+        q->items[(q->head + q->count++) % q->capacity] = item;
+        pthread_cond_signal(&q->notEmpty);
+    }
+    pthread_mutex_unlock(&q->lock);
+    return pushed;
+}
+
+// Next item, or NULL once the queue is closed and drained
+static void* boundedQueuePop(BoundedQueue* q) {
+    pthread_mutex_lock(&q->lock);
+    while (q->count == 0 && !q->closed) pthread_cond_wait(&q->notEmpty, &q->lock);
+    void* item = NULL;
+    if (q->count) {
+        item = q->items[q->head];
+        q->head = (q->head + 1) % q->capacity;
+        q->count--;
+        pthread_cond_signal(&q->notFull);
+    }
+    pthread_mutex_unlock(&q->lock);
+    return item;
+}
+
+static bool boundedQueueFull(BoundedQueue* q) {
+    pthread_mutex_lock(&q->lock);
+    bool full = q->count == q->capacity;
+    pthread_mutex_unlock(&q->lock);
+    return full;
+}
+
+static void boundedQueueClose(BoundedQueue* q) {
+    pthread_mutex_lock(&q->lock);
+    q->closed = true;
+    pthread_cond_broadcast(&q->notEmpty);
+    pthread_cond_broadcast(&q->notFull);
+    pthread_mutex_unlock(&q->lock);
+}
+
+/* ========== Quiescence ========== */
+
+static void wakeFetchers(void) {
+    atomic_thread_fence(memory_order_seq_cst);
+    if (atomic_load(&idleFetchers) > 0) {
+        uint64_t one = 1;
+        if (write(fetchWakeFd, &one, sizeof(one)) < 0) {
+            // Already signalled; idle fetchers also poll every FETCH_IDLE_POLL_MS
+        }
+    }
+}
+
+// The last pending URL finished: nothing is queued, in flight or being parsed
+// anywhere, so nothing can be discovered any more. Stop every stage.
+static void finishCrawl(void) {
+    atomic_store(&crawlDone, true);
+    boundedQueueClose(&pageQueue);
+    pthread_mutex_lock(&scheduler.lock);
+    pthread_cond_broadcast(&scheduler.dnsCond);
+    pthread_mutex_unlock(&scheduler.lock);
+    uint64_t one = 1;
+    if (write(fetchWakeFd, &one, sizeof(one)) < 0) {
+        // Fetchers also notice crawlDone on their next poll timeout
+    }
+}
+
+// A URL left the pipeline: parsed, or failed to fetch
+static void urlFinished(void) {
+    if (atomic_fetch_sub(&pendingUrls, 1) == 1) finishCrawl();
+}
+
+static void failUrl(const char* url, const char* reason) {
+    printf("Failed: %s (%s)\n", url, reason);
+    urlFinished();
+}
+
+/* ========== Per-Host Scheduler ========== */
+
+// Split a URL into host[:port] and path. http:// URLs are fetched over the
+// network; a bare name ("a") is a page of the in-memory urlGraph. Returns
+// false for schemes the fetcher cannot speak.
+static bool splitUrl(const char* url, char* host, size_t hostSize, const char** path, bool* isGraph) {
+    const char* start = url;
+    *isGraph = strstr(url, "://") == NULL;
+    if (!*isGraph) {
+        if (strncasecmp(url, "http://", 7) != 0) return false;
+        start = url + 7;
+    }
+    size_t n = strcspn(start, "/?#");
+    if (n == 0 || n >= hostSize) return false;
+    memcpy(host, start, n);
+    host[n] = '\0';
+    *path = start[n] == '/' ? start + n : "/";
+    return true;
+}
+
+static void heapSwap(HostScheduler* s, size_t i, size_t j) {
+    HostState* h = s->ready[i];
+    s->ready[i] = s->ready[j];
+    s->ready[j] = h;
+    s->ready[i]->heapIndex = (long)i;
+    s->ready[j]->heapIndex = (long)j;
+}
+
+static void heapSiftUp(HostScheduler* s, size_t i) {
+    while (i > 0 && s->ready[(i - 1) / 2]->readyAtNs > s->ready[i]->readyAtNs) {
+        heapSwap(s, i, (i - 1) / 2);
+        i = (i - 1) / 2;
+    }
+}
+
+static void heapSiftDown(HostScheduler* s, size_t i) {
+    for (;;) {
+        size_t smallest = i, l = 2 * i + 1, r = 2 * i + 2;
+        if (l < s->readyCount && s->ready[l]->readyAtNs < s->ready[smallest]->readyAtNs) smallest = l;
+        if (r < s->readyCount && s->ready[r]->readyAtNs < s->ready[smallest]->readyAtNs) smallest = r;
+        if (smallest == i) return;
+        heapSwap(s, i, smallest);
+        i = smallest;
+    }
+}
+
+static void heapPopTop(HostScheduler* s) {
+    s->ready[0]->heapIndex = -1;
+    if (--s->readyCount) {
+        s->ready[0] = s->ready[s->readyCount];
+        s->ready[0]->heapIndex = 0;
+        heapSiftDown(s, 0);
+    }
+}
+
+static void refillTokens(HostState* h, uint64_t now) {
+    h->tokens += (double)(now - h->refilledNs) * HOST_REQUESTS_PER_SECOND / 1e9;
+    if (h->tokens > HOST_BURST) h->tokens = HOST_BURST;
+    h->refilledNs = now;
+}
+
+// Put a host with queued URLs in the ready heap, keyed by when its bucket next
+// has a token, unless it is resolving, at its connection limit or already there.
+// Caller holds the scheduler lock.
+static void scheduleHost(HostScheduler* s, HostState* h, uint64_t now) {
+    if (!h->head || h->heapIndex >= 0 || h->inFlight >= HOST_MAX_CONNECTIONS) return;
+    if (!h->isGraph && h->dnsState != DNS_OK) return;
+    refillTokens(h, now);
+    h->readyAtNs = h->tokens >= 1.0 ? now : now + (uint64_t)((1.0 - h->tokens) * 1e9 / HOST_REQUESTS_PER_SECOND);
+    if (s->readyCount == s->readyCapacity) {
+        size_t capacity = s->readyCapacity ? s->readyCapacity * 2 : 64;
+        HostState** ready = realloc(s->ready, capacity * sizeof(HostState*));
+        if (!ready) return;                // Picked up again when one of its requests completes
+        s->ready = ready;
+        s->readyCapacity = capacity;
+    }
+    h->heapIndex = (long)s->readyCount;
+    s->ready[s->readyCount++] = h;
+    heapSiftUp(s, (size_t)h->heapIndex);
+}
+
+// Queue the host for the resolver. Caller holds the scheduler lock.
+static void requestDns(HostScheduler* s, HostState* h) {
+    h->dnsState = DNS_PENDING;
+    h->dnsNext = NULL;
+    if (s->dnsTail) s->dnsTail->dnsNext = h; else s->dnsHead = h;
+    s->dnsTail = h;
+    pthread_cond_signal(&s->dnsCond);
+}
+
+// Find or create a host. Caller holds the scheduler lock. Returns NULL on OOM.
+static HostState* lookupHost(HostScheduler* s, const char* name, bool isGraph) {
+    uint64_t hash = hashUrl(name);
+    for (HostState* h = s->buckets[hash & (s->bucketCount - 1)]; h; h = h->next) {
+        if (h->hash == hash && strcmp(h->name, name) == 0) return h;
+    }
+    if (s->hostCount + 1 > s->bucketCount) {
+        size_t count = s->bucketCount * 2;
+        HostState** buckets = calloc(count, sizeof(HostState*));
+        if (buckets) {
+            for (size_t i = 0; i < s->bucketCount; i++) {
+                for (HostState* h = s->buckets[i], *next; h; h = next) {
+                    next = h->next;
+                    h->next = buckets[h->hash & (count - 1)];
+                    buckets[h->hash & (count - 1)] = h;
+                }
+            }
+            free(s->buckets);
+            s->buckets = buckets;
+            s->bucketCount = count;
+        }
+    }
+    HostState* h = calloc(1, sizeof(HostState));
+    if (!h) return NULL;
+    snprintf(h->name, sizeof(h->name), "%s", name);
+    h->hash = hash;
+    h->isGraph = isGraph;
+    h->tokens = HOST_BURST;
+    h->refilledNs = nowNs();
+    h->heapIndex = -1;
+    h->next = s->buckets[hash & (s->bucketCount - 1)];
+    s->buckets[hash & (s->bucketCount - 1)] = h;
+    s->hostCount++;
+    return h;
+}
+
+// Append a frontier URL to its host's queue. Fails the URL if it cannot be fetched.
+static void schedulerSubmit(HostScheduler* s, const char* url) {
+    char name[HOST_NAME_LENGTH];
+    const char* path;
+    bool isGraph;
+    if (!splitUrl(url, name, sizeof(name), &path, &isGraph)) {
+        failUrl(url, "unsupported URL");
+        return;
+    }
+    QueuedUrl* q = malloc(sizeof(QueuedUrl));
+    uint64_t now = nowNs();
+    pthread_mutex_lock(&s->lock);
+    HostState* h = q ? lookupHost(s, name, isGraph) : NULL;
+    const char* error = !h ? "out of memory" : NULL;
+    if (h && h->dnsState == DNS_FAILED && now < h->dnsExpiresNs) error = "DNS lookup failed";
+    if (error) {
+        pthread_mutex_unlock(&s->lock);
+        free(q);
+        failUrl(url, error);
+        return;
+    }
+    q->url = url;
+    q->next = NULL;
+    if (h->tail) h->tail->next = q; else h->head = q;
+    h->tail = q;
+    atomic_fetch_add(&s->queuedUrls, 1);
+    if (!isGraph && h->dnsState != DNS_PENDING && (h->dnsState == DNS_UNRESOLVED || now >= h->dnsExpiresNs)) {
+        requestDns(s, h);
+    }
+    scheduleHost(s, h, now);
+    pthread_mutex_unlock(&s->lock);
+}
+
+// Release the next URL whose host is allowed a request now. Returns false if
+// none is; *waitNs is then how long until one is (0 if nothing is queued).
+static bool schedulerNext(HostScheduler* s, FetchTask* task, uint64_t* waitNs) {
+    uint64_t now = nowNs();
+    *waitNs = 0;
+    pthread_mutex_lock(&s->lock);
+    while (s->readyCount) {
+        HostState* h = s->ready[0];
+        if (h->readyAtNs > now) {
+            *waitNs = h->readyAtNs - now;
+            break;
+        }
+        heapPopTop(s);
+        if (!h->head) continue;            // Its URLs failed a DNS lookup
+        if (!h->isGraph && h->dnsState != DNS_OK) continue; // Rescheduled once resolved
+        if (!h->isGraph && now >= h->dnsExpiresNs) {
+            requestDns(s, h);              // Cached address expired: re-resolve first
+            continue;
+        }
+        refillTokens(h, now);
+        if (h->tokens < 1.0) {
+            scheduleHost(s, h, now);
             continue;
         }
-        
-        if (isVisited(url)) {
-            pthread_mutex_unlock(&lock);
+        QueuedUrl* q = h->head;
+        h->head = q->next;
+        if (!h->head) h->tail = NULL;
+        h->tokens -= 1.0;
+        h->inFlight++;
+        atomic_fetch_sub(&s->queuedUrls, 1);
+        task->url = q->url;
+        task->host = h;
+        task->addr = h->addr;
+        free(q);
+        scheduleHost(s, h, now);
+        pthread_mutex_unlock(&s->lock);
+        return true;
+    }
+    pthread_mutex_unlock(&s->lock);
+    return false;
+}
+
+// A request to host finished, freeing one of its connections
+static void schedulerRelease(HostScheduler* s, HostState* h) {
+    pthread_mutex_lock(&s->lock);
+    h->inFlight--;
+    scheduleHost(s, h, nowNs());
+    pthread_mutex_unlock(&s->lock);
+}
+
+// Resolver thread: serves the DNS cache misses so fetch loops never block on
+// getaddrinfo(). A failed lookup fails the host's queued URLs and is
+// remembered for DNS_NEGATIVE_TTL_SECONDS.
+static void* resolver(void* args) {
+    HostScheduler* s = args;
+    pthread_mutex_lock(&s->lock);
+    while (!atomic_load(&crawlDone)) {
+        HostState* h = s->dnsHead;
+        if (!h) {
+            pthread_cond_wait(&s->dnsCond, &s->lock);
             continue;
         }
-        
-        addVisitedUrl(url);
-        printf("Crawled: %s\n", url);
-        
-        int urlCount;
-        char** urls = getUrls(url, &urlCount);
-        pthread_mutex_unlock(&lock);
-        
-        if (urls) {
-            pthread_mutex_lock(&lock);
-            for (int i = 0; i < urlCount; i++) {
-                if (!isVisited(urls[i])) {
-                    enqueueUrl(urls[i]);
+        s->dnsHead = h->dnsNext;
+        if (!s->dnsHead) s->dnsTail = NULL;
+        char node[HOST_NAME_LENGTH];
+        snprintf(node, sizeof(node), "%s", h->name);
+        pthread_mutex_unlock(&s->lock);
+
+        char* port = strrchr(node, ':');
+        if (port) *port++ = '\0';
+        struct addrinfo hints, *result = NULL;
+        memset(&hints, 0, sizeof(hints));
+        hints.ai_family = AF_INET;
+        hints.ai_socktype = SOCK_STREAM;
+        int rc = getaddrinfo(node, port ? port : "80", &hints, &result);
+
+        QueuedUrl* failed = NULL;
+        pthread_mutex_lock(&s->lock);
+        uint64_t now = nowNs();
+        if (rc == 0 && result) {
+            memcpy(&h->addr, result->ai_addr, sizeof(h->addr));
+            h->dnsState = DNS_OK;
+            h->dnsExpiresNs = now + DNS_TTL_SECONDS * 1000000000ull;
+            scheduleHost(s, h, now);
+        } else {
+            h->dnsState = DNS_FAILED;
+            h->dnsExpiresNs = now + DNS_NEGATIVE_TTL_SECONDS * 1000000000ull;
+            failed = h->head;
+            h->head = h->tail = NULL;
+        }
+        if (result) freeaddrinfo(result);
+        pthread_mutex_unlock(&s->lock);
+
+        if (rc == 0) wakeFetchers();
+        while (failed) {
+            QueuedUrl* next = failed->next;
+            atomic_fetch_sub(&s->queuedUrls, 1);
+            failUrl(failed->url, "DNS lookup failed");
+            free(failed);
+            failed = next;
+        }
+        pthread_mutex_lock(&s->lock);
+    }
+    pthread_mutex_unlock(&s->lock);
+    return NULL;
+}
+
+static bool initScheduler(HostScheduler* s) {
+    memset(s, 0, sizeof(*s));
+    pthread_mutex_init(&s->lock, NULL);
+    pthread_cond_init(&s->dnsCond, NULL);
+    s->bucketCount = 64;
+    s->buckets = calloc(s->bucketCount, sizeof(HostState*));
+    return s->buckets != NULL;
+}
+
+static void destroyScheduler(HostScheduler* s) {
+    for (size_t i = 0; i < s->bucketCount; i++) {
+        for (HostState* h = s->buckets[i], *next; h; h = next) {
+            next = h->next;
+            while (h->head) {
+                QueuedUrl* q = h->head;
+                h->head = q->next;
+                free(q);
+            }
+            free(h);
+        }
+    }
+    free(s->buckets);
+    free(s->ready);
+    pthread_mutex_destroy(&s->lock);
+    pthread_cond_destroy(&s->dnsCond);
+}
+
+/* ========== Fetch Stage ========== */
+
+// Hand a page to the parse stage. The queue only closes once the crawl is
+// over, so a page that arrives after that is dropped.
+static void pushPage(Page* page) {
+    if (!boundedQueuePush(&pageQueue, page)) {
+        free(page->body);
+        free(page);
+    }
+}
+
+static void fetchUnlink(Fetcher* self, Fetch* f) {
+    if (f->prev) f->prev->next = f->next; else self->oldest = f->next;
+    if (f->next) f->next->prev = f->prev; else self->newest = f->prev;
+    self->inFlight--;
+}
+
+// Tear down a request. With ok set, the response goes to the parse stage.
+static void fetchFinish(Fetcher* self, Fetch* f, bool ok, const char* reason) {
+    close(f->fd);
+    fetchUnlink(self, f);
+    schedulerRelease(&scheduler, f->task.host);
+    Page* page = ok ? calloc(1, sizeof(Page)) : NULL;
+    if (page) {
+        page->url = f->task.url;
+        page->host = f->task.host->name;
+        page->body = f->body;
+        page->length = f->length;
+        pushPage(page);
+    } else {
+        free(f->body);
+        failUrl(f->task.url, ok ? "out of memory" : reason);
+    }
+    free(f);
+}
+
+// Start a released URL. Graph pages complete at once; HTTP requests connect
+// without blocking and continue on the event loop.
+static void fetchStart(Fetcher* self, const FetchTask* task) {
+    if (task->host->isGraph) {
+        schedulerRelease(&scheduler, task->host);
+        Page* page = calloc(1, sizeof(Page));
+        if (!page) {
+            failUrl(task->url, "out of memory");
+            return;
+        }
+        page->url = task->url;
+        page->graphLinks = getUrls(task->url, &page->graphCount);
+        pushPage(page);
+        return;
+    }
+
+    char host[HOST_NAME_LENGTH];
+    const char* path;
+    bool isGraph;
+    Fetch* f = calloc(1, sizeof(Fetch));
+    splitUrl(task->url, host, sizeof(host), &path, &isGraph);
+    int fd = f ? socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0) : -1;
+    if (fd < 0 || (connect(fd, (const struct sockaddr*)&task->addr, sizeof(task->addr)) != 0 && errno != EINPROGRESS)) {
+        if (fd >= 0) close(fd);
+        free(f);
+        schedulerRelease(&scheduler, task->host);
+        failUrl(task->url, "connect failed");
+        return;
+    }
+    f->task = *task;
+    f->fd = fd;
+    f->state = FETCH_CONNECTING;
+    int n = snprintf(f->request, sizeof(f->request),
+                     "GET %.*s HTTP/1.0\r\nHost: %s\r\nUser-Agent: MultiThreadedCrawler/1.0\r\nConnection: close\r\n\r\n",
+                     (int)strcspn(path, "#"), path, host);
+    f->requestLength = (size_t)n < sizeof(f->request) ? (size_t)n : sizeof(f->request) - 1;
+    f->deadlineNs = nowNs() + FETCH_TIMEOUT_MS * 1000000ull;
+    f->prev = self->newest;
+    if (self->newest) self->newest->next = f; else self->oldest = f;
+    self->newest = f;
+    self->inFlight++;
+    struct epoll_event ev = { .events = EPOLLOUT, .data.ptr = f };
+    if (epoll_ctl(self->epollFd, EPOLL_CTL_ADD, fd, &ev) != 0) fetchFinish(self, f, false, "epoll failed");
+}
+
+// Advance one request as far as its socket allows
+static void fetchProgress(Fetcher* self, Fetch* f) {
+    if (f->state == FETCH_CONNECTING) {
+        int err = 0;
+        socklen_t len = sizeof(err);
+        if (getsockopt(f->fd, SOL_SOCKET, SO_ERROR, &err, &len) != 0 || err != 0) {
+            fetchFinish(self, f, false, "connect failed");
+            return;
+        }
+        f->state = FETCH_SENDING;
+    }
+    if (f->state == FETCH_SENDING) {
+        while (f->requestSent < f->requestLength) {
+            ssize_t n = send(f->fd, f->request + f->requestSent, f->requestLength - f->requestSent, MSG_NOSIGNAL);
+            if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) return;
+            if (n < 0) {
+                fetchFinish(self, f, false, "send failed");
+                return;
+            }
+            f->requestSent += (size_t)n;
+        }
+        f->state = FETCH_READING;
+        struct epoll_event ev = { .events = EPOLLIN, .data.ptr = f };
+        epoll_ctl(self->epollFd, EPOLL_CTL_MOD, f->fd, &ev);
+    }
+    for (;;) {
+        if (f->capacity - f->length < 4096) {
+            size_t capacity = f->capacity ? f->capacity * 2 : 16384;
+            char* body = capacity <= MAX_PAGE_BYTES + 1 ? realloc(f->body, capacity) : NULL;
+            if (!body && !f->body) {
+                fetchFinish(self, f, false, "out of memory");
+                return;
+            }
+            if (!body) {
+                f->length = f->length < MAX_PAGE_BYTES ? f->length : MAX_PAGE_BYTES;
+                break;                     // Too long: parse what arrived
+            }
+            f->body = body;
+            f->capacity = capacity;
+        }
+        ssize_t n = recv(f->fd, f->body + f->length, f->capacity - f->length - 1, 0);
+        if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) return;
+        if (n < 0) {
+            fetchFinish(self, f, false, "receive failed");
+            return;
+        }
+        if (n == 0) break;
+        f->length += (size_t)n;
+    }
+    f->body[f->length] = '\0';
+    fetchFinish(self, f, true, NULL);
+}
+
+// Fetch thread: pull URLs from the frontier into the scheduler, start every
+// request the politeness policy allows (up to FETCH_MAX_IN_FLIGHT), and drive
+// the sockets with epoll until the crawl is over
+void* fetcherLoop(void* args) {
+    Fetcher* self = args;
+    struct epoll_event events[64];
+    struct epoll_event wake = { .events = EPOLLIN, .data.ptr = NULL };
+    epoll_ctl(self->epollFd, EPOLL_CTL_ADD, fetchWakeFd, &wake);
+
+    while (!atomic_load(&crawlDone)) {
+        const char* url;
+        while (atomic_load(&scheduler.queuedUrls) < SCHEDULER_CAPACITY && (url = stealFrontier(self)) != NULL) {
+            schedulerSubmit(&scheduler, url);
+        }
+        FetchTask task;
+        uint64_t waitNs = 0;
+        while (self->inFlight < FETCH_MAX_IN_FLIGHT && !boundedQueueFull(&pageQueue) &&
+               schedulerNext(&scheduler, &task, &waitNs)) {
+            fetchStart(self, &task);
+        }
+
+        int timeoutMs = FETCH_IDLE_POLL_MS;
+        if (waitNs && waitNs / 1000000 < (uint64_t)timeoutMs) timeoutMs = (int)(waitNs / 1000000) + 1;
+        bool idle = self->inFlight == 0;
+        if (idle) atomic_fetch_add(&idleFetchers, 1);
+        int n = epoll_wait(self->epollFd, events, 64, timeoutMs);
+        if (idle) atomic_fetch_sub(&idleFetchers, 1);
+        for (int i = 0; i < n; i++) {
+            if (events[i].data.ptr) {
+                fetchProgress(self, events[i].data.ptr);
+            } else {
+                uint64_t count;
+                if (read(fetchWakeFd, &count, sizeof(count)) < 0) {
+                    // Another fetcher consumed the wakeup
                 }
             }
-            pthread_cond_broadcast(&cond);
-            pthread_mutex_unlock(&lock);
         }
+        uint64_t now = nowNs();
+        while (self->oldest && self->oldest->deadlineNs <= now) fetchFinish(self, self->oldest, false, "timed out");
     }
+    while (self->oldest) fetchFinish(self, self->oldest, false, "crawl stopped");
     return NULL;
 }
 
-// Function to manage the crawling process
+/* ========== Parse Stage ========== */
+
+// Queue a discovered link once: mark it visited, count it, publish it on our deque
+static void discoverUrl(CrawlWorker* self, const char* link) {
+    const char* url = addVisitedUrl(link);
+    if (!url) return;
+    // Counted before it is visible, so pendingUrls never reaches zero early
+    atomic_fetch_add(&pendingUrls, 1);
+    if (!dequePush(&self->deque, url)) failUrl(url, "out of memory");
+}
+
+// Pull links out of an HTTP response: the Location of a redirect, or every
+// href="..." of the body. Absolute http:// links are kept as they are and
+// root-relative ones are resolved against the page's host.
+static void extractLinks(CrawlWorker* self, const Page* page) {
+    int status = 0;
+    sscanf(page->body, "HTTP/%*d.%*d %d", &status);
+    const char* body = strstr(page->body, "\r\n\r\n");
+    const char* p = page->body;
+    const char* marker = "href=\"";
+    if (status >= 300 && status < 400) {
+        marker = "\nLocation: ";
+    } else if (status < 200 || status >= 300 || !body) {
+        return;
+    } else {
+        p = body;
+    }
+    size_t markerLength = strlen(marker);
+    while ((p = strcasestr(p, marker)) != NULL) {
+        p += markerLength;
+        size_t n = strcspn(p, "\"#\r\n ");
+        char link[MAX_LINK_LENGTH];
+        if (strncasecmp(p, "http://", 7) == 0 && n < sizeof(link)) {
+            memcpy(link, p, n);
+            link[n] = '\0';
+            discoverUrl(self, link);
+        } else if (p[0] == '/' && p[1] != '/' && n + strlen(page->host) + 7 < sizeof(link)) {
+            snprintf(link, sizeof(link), "http://%s%.*s", page->host, (int)n, p);
+            discoverUrl(self, link);
+        }
+        p += n;
+    }
+}
+
+// Function executed by each parse thread: take fetched pages, queue their new
+// links on our deque, and retire the page's URL
+void* crawl(void* args) {
+    CrawlWorker* self = args;
+    Page* page;
+    while ((page = boundedQueuePop(&pageQueue)) != NULL) {
+        printf("Crawled: %s\n", page->url);
+        if (page->body) {
+            extractLinks(self, page);
+        } else {
+            for (int i = 0; i < page->graphCount; i++) discoverUrl(self, page->graphLinks[i]);
+        }
+        wakeFetchers();
+        free(page->body);
+        free(page);
+        urlFinished();
+    }
+    return NULL;
+}
+
+// Function to manage the crawling process. Returns once every reachable URL
+// has been crawled or has failed.
 void crawlManager(const char* startUrl) {
-    pthread_t threads[THREAD_COUNT];
-    pthread_mutex_init(&lock, NULL);
-    pthread_cond_init(&cond, NULL);
-    
-    enqueueUrl(startUrl);
-    pthread_cond_broadcast(&cond);
-    
-    for (int i = 0; i < THREAD_COUNT; i++) {
-        pthread_create(&threads[i], NULL, crawl, NULL);
+    initVisitedSet();
+    atomic_store(&crawlDone, false);
+    atomic_store(&pendingUrls, 0);
+    fetchWakeFd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (fetchWakeFd < 0 || !initScheduler(&scheduler) || !boundedQueueInit(&pageQueue, PAGE_QUEUE_CAPACITY)) {
+        fprintf(stderr, "Failed to set up the crawl\n");
+        exit(1);
     }
-    
-    for (int i = 0; i < THREAD_COUNT; i++) {
-        pthread_join(threads[i], NULL);
+    for (int i = 0; i < PARSE_THREADS; i++) {
+        workers[i].id = i;
+        if (!initDeque(&workers[i].deque)) {
+            fprintf(stderr, "Out of memory starting the crawl\n");
+            exit(1);
+        }
     }
-    
-    pthread_mutex_destroy(&lock);
-    pthread_cond_destroy(&cond);
+    for (int i = 0; i < FETCH_THREADS; i++) {
+        memset(&fetchers[i], 0, sizeof(Fetcher));
+        fetchers[i].seed = (unsigned int)i * 2654435761u + 1;
+        fetchers[i].epollFd = epoll_create1(EPOLL_CLOEXEC);
+        if (fetchers[i].epollFd < 0) {
+            fprintf(stderr, "Failed to create an epoll instance\n");
+            exit(1);
+        }
+    }
+
+    // Seed the first deque before any thread runs
+    const char* start = addVisitedUrl(startUrl);
+    atomic_store(&pendingUrls, 1);
+    dequePush(&workers[0].deque, start);
+
+    pthread_create(&resolverThread, NULL, resolver, &scheduler);
+    for (int i = 0; i < PARSE_THREADS; i++) pthread_create(&workers[i].thread, NULL, crawl, &workers[i]);
+    for (int i = 0; i < FETCH_THREADS; i++) pthread_create(&fetchers[i].thread, NULL, fetcherLoop, &fetchers[i]);
+
+    for (int i = 0; i < FETCH_THREADS; i++) pthread_join(fetchers[i].thread, NULL);
+    for (int i = 0; i < PARSE_THREADS; i++) pthread_join(workers[i].thread, NULL);
+    pthread_join(resolverThread, NULL);
+
+    for (int i = 0; i < FETCH_THREADS; i++) close(fetchers[i].epollFd);
+    for (int i = 0; i < PARSE_THREADS; i++) destroyDeque(&workers[i].deque);
+    boundedQueueDestroy(&pageQueue);
+    destroyScheduler(&scheduler);
+    destroyVisitedSet();
+    close(fetchWakeFd);
 }
 
 // Main function for testing
@@ -3,6 +3,9 @@
 #include <pthread.h>
 #include <unistd.h>
 #include <time.h>
+#include <stdbool.h>
+#include <stdatomic.h>
+#include <sched.h>
 
 /* Your output confirms that the writer prioritization mechanism is now functioning correctly:
 
@@ -10,20 +13,47 @@
    After several reads, a writer is prioritized, preventing writer starvation.
    Writers execute one at a time, ensuring fairness.
    Once all writers finish, new readers can start again.
+
+   Reader-Biased Mode (RW_POLICY_READER_BIASED):
+   The mutex above is touched by every acquire and release, so on many cores its cache
+   line becomes the bottleneck. In reader-biased mode a reader only increments one of
+   RW_READER_SLOTS cache-line-padded counters (each thread keeps its own slot) and checks
+   a writer flag; no shared line is written. A writer raises the flag under the mutex and
+   waits for every counter to drain back to zero. Readers that see the flag back off and
+   sleep on readCondition until the writer is done, so writers cannot be starved.
+   Writer priority with READ_LIMIT remains the default policy (RW_POLICY_WRITER_PRIORITY).
+   Logging happens in the example threads, outside the lock functions.
 */   
 
+#define READ_LIMIT 5  // Limit number of continuous reads before a writer gets priority
+#define RW_READER_SLOTS 64  // Reader counters in reader-biased mode (power of two)
+
+typedef enum {
+    RW_POLICY_WRITER_PRIORITY,  // One mutex, writers let in after READ_LIMIT reads
+    RW_POLICY_READER_BIASED     // Per-thread reader counters, writers drain them
+} RwPolicy;
+
+// One reader counter, alone on its cache line
+typedef struct {
+    _Alignas(64) atomic_long active;
+} ReaderSlot;
+
 // Read-Write Lock structure with writer prioritization
 typedef struct {
     int readers;          // Number of active readers
     int writers;          // Number of active writers (should be 0 or 1)
     int writeRequests;    // Number of writers waiting
     int readCount;        // Number of reads completed before allowing a writer
+    RwPolicy policy;
     pthread_mutex_t mutex;
     pthread_cond_t readCondition;
     pthread_cond_t writeCondition;
+    atomic_bool writerActive;                   // Reader-biased: a writer holds or is draining the lock
+    ReaderSlot readerSlots[RW_READER_SLOTS];    // Reader-biased: active readers per slot
 } ReadWriteLock;
 
-#define READ_LIMIT 5  // Limit number of continuous reads before a writer gets priority
+static atomic_int nextReaderSlot;
+static _Thread_local int readerSlotIndex = -1;
 
 // Get the current timestamp for debugging purposes
 void printTimestamp(const char* msg, pthread_t threadId) {
@@ -32,19 +62,98 @@ void printTimestamp(const char* msg, pthread_t threadId) {
     printf("[%ld.%ld] %s - Thread %lu\n", ts.tv_sec, ts.tv_nsec / 1000000, msg, threadId);
 }
 
-// Initialize the Read-Write Lock
-void initReadWriteLock(ReadWriteLock* lock) {
+// Initialize the Read-Write Lock with the given policy
+void initReadWriteLockWithPolicy(ReadWriteLock* lock, RwPolicy policy) {
     lock->readers = 0;
     lock->writers = 0;
     lock->writeRequests = 0;
     lock->readCount = 0;
+    lock->policy = policy;
     pthread_mutex_init(&lock->mutex, NULL);
     pthread_cond_init(&lock->readCondition, NULL);
     pthread_cond_init(&lock->writeCondition, NULL);
+    atomic_init(&lock->writerActive, false);
+    for (int i = 0; i < RW_READER_SLOTS; i++) {
+        atomic_init(&lock->readerSlots[i].active, 0);
+    }
+}
+
+// Initialize the Read-Write Lock (writer prioritization)
+void initReadWriteLock(ReadWriteLock* lock) {
+    initReadWriteLockWithPolicy(lock, RW_POLICY_WRITER_PRIORITY);
+}
+
+// Release the lock's resources
+void destroyReadWriteLock(ReadWriteLock* lock) {
+    pthread_mutex_destroy(&lock->mutex);
+    pthread_cond_destroy(&lock->readCondition);
+    pthread_cond_destroy(&lock->writeCondition);
+}
+
+// Counter slot of the calling thread: assigned round-robin on first use and kept,
+// so a reader that migrates CPUs still releases the slot it acquired
+static ReaderSlot* readerSlot(ReadWriteLock* lock) {
+    if (readerSlotIndex < 0) {
+        readerSlotIndex = atomic_fetch_add_explicit(&nextReaderSlot, 1, memory_order_relaxed) & (RW_READER_SLOTS - 1);
+    }
+    return &lock->readerSlots[readerSlotIndex];
+}
+
+// Reader-biased acquire: announce ourselves on our slot, then check for a writer.
+// Both sides use seq_cst, so either the writer sees our count or we see its flag.
+static void lockReadBiased(ReadWriteLock* lock) {
+    ReaderSlot* slot = readerSlot(lock);
+    for (;;) {
+        atomic_fetch_add(&slot->active, 1);
+        if (!atomic_load(&lock->writerActive)) return;
+
+        // A writer is in or draining: step aside and sleep until it is done
+        atomic_fetch_sub(&slot->active, 1);
+        pthread_mutex_lock(&lock->mutex);
+        while (atomic_load(&lock->writerActive)) {
+            pthread_cond_wait(&lock->readCondition, &lock->mutex);
+        }
+        pthread_mutex_unlock(&lock->mutex);
+    }
+}
+
+// Reader-biased write acquire: take the flag from other writers, then wait for
+// readers already inside to leave
+static void lockWriteBiased(ReadWriteLock* lock) {
+    pthread_mutex_lock(&lock->mutex);
+    lock->writeRequests++;
+    while (lock->writers > 0) {
+        pthread_cond_wait(&lock->writeCondition, &lock->mutex);
+    }
+    lock->writeRequests--;
+    lock->writers++;
+    atomic_store(&lock->writerActive, true);
+    pthread_mutex_unlock(&lock->mutex);
+
+    for (int i = 0; i < RW_READER_SLOTS; i++) {
+        while (atomic_load(&lock->readerSlots[i].active) > 0) {
+            sched_yield();
+        }
+    }
+}
+
+static void unlockWriteBiased(ReadWriteLock* lock) {
+    pthread_mutex_lock(&lock->mutex);
+    lock->writers--;
+    atomic_store(&lock->writerActive, false);
+    if (lock->writeRequests > 0) {
+        pthread_cond_signal(&lock->writeCondition);
+    }
+    pthread_cond_broadcast(&lock->readCondition);
+    pthread_mutex_unlock(&lock->mutex);
 }
 
 // Acquire read lock (with writer prioritization)
 void lockRead(ReadWriteLock* lock) {
+    if (lock->policy == RW_POLICY_READER_BIASED) {
+        lockReadBiased(lock);
+        return;
+    }
     pthread_mutex_lock(&lock->mutex);
     
     // If there are write requests, wait to allow writers priority
@@ -56,11 +165,14 @@ void lockRead(ReadWriteLock* lock) {
     lock->readCount++;
     
     pthread_mutex_unlock(&lock->mutex);
-    printTimestamp("Reader started", pthread_self());
 }
 
 // Release read lock
 void unlockRead(ReadWriteLock* lock) {
+    if (lock->policy == RW_POLICY_READER_BIASED) {
+        atomic_fetch_sub_explicit(&readerSlot(lock)->active, 1, memory_order_release);
+        return;
+    }
     pthread_mutex_lock(&lock->mutex);
     
     lock->readers--;
@@ -72,11 +184,14 @@ void unlockRead(ReadWriteLock* lock) {
     }
     
     pthread_mutex_unlock(&lock->mutex);
-    printTimestamp("Reader finished", pthread_self());
 }
 
 // Acquire write lock (writer prioritization included)
 void lockWrite(ReadWriteLock* lock) {
+    if (lock->policy == RW_POLICY_READER_BIASED) {
+        lockWriteBiased(lock);
+        return;
+    }
     pthread_mutex_lock(&lock->mutex);
     lock->writeRequests++;
     
@@ -88,11 +203,14 @@ void lockWrite(ReadWriteLock* lock) {
     lock->writeRequests--;
     lock->writers++;
     pthread_mutex_unlock(&lock->mutex);
-    printTimestamp("Writer started", pthread_self());
 }
 
 // Release write lock
 void unlockWrite(ReadWriteLock* lock) {
+    if (lock->policy == RW_POLICY_READER_BIASED) {
+        unlockWriteBiased(lock);
+        return;
+    }
     pthread_mutex_lock(&lock->mutex);
     
     lock->writers--;
@@ -105,14 +223,15 @@ void unlockWrite(ReadWriteLock* lock) {
     }
     
     pthread_mutex_unlock(&lock->mutex);
-    printTimestamp("Writer finished", pthread_self());
 }
 
 // Example usage - Reader thread function
 void* reader(void* arg) {
     ReadWriteLock* lock = (ReadWriteLock*)arg;
     lockRead(lock);
+    printTimestamp("Reader started", pthread_self());
     sleep(1); // Simulate reading
+    printTimestamp("Reader finished", pthread_self());
     unlockRead(lock);
     return NULL;
 }
@@ -121,14 +240,17 @@ void* reader(void* arg) {
 void* writer(void* arg) {
     ReadWriteLock* lock = (ReadWriteLock*)arg;
     lockWrite(lock);
+    printTimestamp("Writer started", pthread_self());
     sleep(2); // Simulate writing
+    printTimestamp("Writer finished", pthread_self());
     unlockWrite(lock);
     return NULL;
 }
 
-int main() {
-    ReadWriteLock lock;
-    initReadWriteLock(&lock);
+// Run the example readers and writers against a lock with the given policy
+void runExample(RwPolicy policy) {
+    static ReadWriteLock lock;
+    initReadWriteLockWithPolicy(&lock, policy);
     
     pthread_t readers[5], writers[2];
     
@@ -152,5 +274,15 @@ int main() {
         pthread_join(writers[i], NULL);
     }
     
+    destroyReadWriteLock(&lock);
+}
+
+int main() {
+    printf("Writer-priority policy:\n");
+    runExample(RW_POLICY_WRITER_PRIORITY);
+    
+    printf("Reader-biased policy:\n");
+    runExample(RW_POLICY_READER_BIASED);
+    
     return 0;
 }
@@ -3,6 +3,9 @@
 #include <pthread.h>
 #include <unistd.h>
 #include <time.h>
+#include <stdint.h>
+#include <stdatomic.h>
+#include <string.h>
 
 /* Observations & Final Tweaks
   
@@ -46,6 +49,42 @@
       - The logging is concise and not spammy.
       - No unnecessary "WARNING: Burst protection activated!" logs, indicating optimal demand handling.
 */
+/*  Lazy Refill Mode (initLazyTokenBucket, tryGetTokens)
+
+    No Fill Thread
+    - Tokens are added at acquire time from the elapsed monotonic time, so no thread
+      has to wake every 200-500 ms and idle buckets cost nothing.
+
+    One Atomic Word
+    - Tokens (fixed point, 1/LAZY_TOKEN_SCALE of a token), the last refill time and the
+      burst protection flag are packed in one 64-bit word updated with a single CAS.
+      No mutex, no condition variables and no logging on the request path.
+
+    Same Burst Protection
+    - Below BURST_PROTECTION_THRESHOLD tokens the flag is raised and requests are cut to
+      2 tokens; it is cleared once a request leaves more than the threshold. Refills
+      still stop at BURST_CAPACITY.
+
+    tryGetTokens() never blocks: it returns the tokens granted, or 0 if there were not
+    enough. getTokens() on a lazy bucket sleeps until enough tokens have accumulated.
+*/
+/*  Keyed Rate Limiter (RateLimiter)
+
+    Per-Client Buckets
+    - One lazy bucket per client key (IP address, user or tenant id): a 16-byte
+      KeyedBucket holding the key and the packed state word, so millions of clients fit
+      where one mutex and two condition variables each would not.
+    - Keys live in RL_SHARDS independently locked open-addressing tables.
+
+    Idle Expiry
+    - Once a client's bucket has refilled to MAX_CAPACITY it behaves like a new one, so
+      it is dropped. Each key has one entry in its shard's timing wheel for that time;
+      keys used since they were scheduled are moved to their new slot instead.
+    - Shards advance their wheel whenever they are used; rateLimiterExpire() sweeps them all.
+
+    Batch Checks
+    - rateLimiterTryAcquireBatch() groups keys by shard and takes each shard lock once.
+*/
 
 #define MAX_CAPACITY 100      // Normal max capacity of the bucket
 #define BURST_CAPACITY 120    // Temporary burst mode allows extra tokens
@@ -54,6 +93,15 @@
 #define HIGH_CONSUMPTION_THRESHOLD 50 // Tokens consumed quickly threshold
 #define BURST_PROTECTION_THRESHOLD 75 // If >75% of tokens are consumed too fast, restrict usage
 
+// Packed lazy-refill state: [63] burst flag | [62..40] tokens in fixed point | [39..0] refill time (ms)
+#define LAZY_TOKEN_SCALE 65536        // Fixed-point units per token
+#define LAZY_TIME_BITS 40             // ~34 years of milliseconds since the bucket was created
+#define LAZY_TOKEN_BITS 23
+#define LAZY_FLAG_BIT 63
+
+_Static_assert((uint64_t)BURST_CAPACITY * LAZY_TOKEN_SCALE < (1ull << LAZY_TOKEN_BITS),
+               "BURST_CAPACITY does not fit the packed token field");
+
 // Token Bucket structure
 typedef struct {
     double tokens;               // Current number of tokens in the bucket
@@ -64,6 +112,9 @@ typedef struct {
     pthread_mutex_t lock;        // Mutex for thread synchronization
     pthread_cond_t notFull;      // Condition variable to signal when bucket is not full
     pthread_cond_t notEmpty;     // Condition variable to signal when bucket is not empty
+    int lazyRefill;              // Set by initLazyTokenBucket: no fill thread, lock-free acquire
+    long epochMillis;            // Lazy mode: monotonic time the packed timestamps count from
+    _Atomic uint64_t state;      // Lazy mode: packed tokens, refill time and burst flag
 } TokenBucket;
 
 // Get current time in milliseconds
@@ -73,6 +124,40 @@ long currentTimeMillis() {
     return ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
 }
 
+// Get monotonic time in milliseconds (never jumps with wall-clock changes)
+long monotonicTimeMillis() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+static uint64_t packLazyState(uint64_t units, uint64_t stamp, int flag) {
+    return ((uint64_t)(flag != 0) << LAZY_FLAG_BIT) | (units << LAZY_TIME_BITS) | stamp;
+}
+
+static uint64_t lazyUnits(uint64_t state) {
+    return (state >> LAZY_TIME_BITS) & ((1ull << LAZY_TOKEN_BITS) - 1);
+}
+
+static uint64_t lazyStamp(uint64_t state) {
+    return state & ((1ull << LAZY_TIME_BITS) - 1);
+}
+
+static int lazyFlag(uint64_t state) {
+    return (int)(state >> LAZY_FLAG_BIT);
+}
+
+// Tokens in fixed point after refilling state up to now, capped at BURST_CAPACITY
+static uint64_t lazyRefilledUnits(double fillRate, uint64_t state, uint64_t now) {
+    uint64_t units = lazyUnits(state);
+    uint64_t stamp = lazyStamp(state);
+    if (now > stamp) {
+        units += (uint64_t)((now - stamp) * fillRate * LAZY_TOKEN_SCALE / 1000.0);
+    }
+    uint64_t cap = (uint64_t)BURST_CAPACITY * LAZY_TOKEN_SCALE;
+    return units > cap ? cap : units;
+}
+
 // Initialize the Token Bucket
 void initTokenBucket(TokenBucket* bucket) {
     bucket->tokens = MAX_CAPACITY;
@@ -83,6 +168,76 @@ void initTokenBucket(TokenBucket* bucket) {
     pthread_mutex_init(&bucket->lock, NULL);
     pthread_cond_init(&bucket->notFull, NULL);
     pthread_cond_init(&bucket->notEmpty, NULL);
+    bucket->lazyRefill = 0;
+}
+
+// Initialize a Token Bucket in lazy refill mode: no fillBucket thread is needed
+void initLazyTokenBucket(TokenBucket* bucket) {
+    initTokenBucket(bucket);
+    bucket->lazyRefill = 1;
+    bucket->epochMillis = monotonicTimeMillis();
+    atomic_init(&bucket->state, packLazyState((uint64_t)MAX_CAPACITY * LAZY_TOKEN_SCALE, 0, 0));
+}
+
+// Refill a packed state up to now (ms since the epoch) and take n tokens with
+// burst protection. Returns the tokens granted (n, or at most 2 under burst
+// protection), or 0 if there are not that many; *next is the updated state.
+static int lazyConsume(uint64_t state, uint64_t now, double fillRate, int n, uint64_t* next) {
+    uint64_t stamp = lazyStamp(state);
+    if (now < stamp) now = stamp;  // Another thread already refilled up to a later time
+    uint64_t units = lazyRefilledUnits(fillRate, state, now);
+    int flag = lazyFlag(state);
+
+    // Burst protection: if consumption exceeds 75% of bucket capacity too quickly, restrict requests
+    if (units < (uint64_t)BURST_PROTECTION_THRESHOLD * LAZY_TOKEN_SCALE) {
+        flag = 1;
+    }
+    int granted = (flag && n > 2) ? 2 : n;
+    uint64_t cost = (uint64_t)granted * LAZY_TOKEN_SCALE;
+    if (units < cost) {
+        *next = packLazyState(units, now, flag);
+        return 0;
+    }
+
+    units -= cost;
+    // Reset burst protection flag if the bucket stabilizes
+    if (units > (uint64_t)BURST_PROTECTION_THRESHOLD * LAZY_TOKEN_SCALE) {
+        flag = 0;
+    }
+    *next = packLazyState(units, now, flag);
+    return granted;
+}
+
+// Take n tokens from a lazy bucket without blocking, with burst protection.
+// Returns the number of tokens granted (n, or at most 2 under burst protection),
+// or 0 if the bucket does not hold that many.
+int tryGetTokens(TokenBucket* bucket, int n) {
+    uint64_t state = atomic_load_explicit(&bucket->state, memory_order_relaxed);
+    for (;;) {
+        uint64_t now = (uint64_t)(monotonicTimeMillis() - bucket->epochMillis);
+        uint64_t next;
+        int granted = lazyConsume(state, now, bucket->fillRate, n, &next);
+
+        // Not enough tokens: only publish a newly raised flag, the refill can wait
+        if (granted == 0 && lazyFlag(next) == lazyFlag(state)) {
+            return 0;
+        }
+        if (atomic_compare_exchange_weak_explicit(&bucket->state, &state, next,
+                                                  memory_order_relaxed, memory_order_relaxed)) {
+            return granted;
+        }
+    }
+}
+
+// Blocking acquire on a lazy bucket: sleep until enough tokens have accumulated
+static void getTokensLazy(TokenBucket* bucket, int n) {
+    while (tryGetTokens(bucket, n) == 0) {
+        uint64_t state = atomic_load_explicit(&bucket->state, memory_order_relaxed);
+        uint64_t now = (uint64_t)(monotonicTimeMillis() - bucket->epochMillis);
+        double tokens = (double)lazyRefilledUnits(bucket->fillRate, state, now) / LAZY_TOKEN_SCALE;
+        double missing = ((lazyFlag(state) && n > 2) ? 2 : n) - tokens;
+        usleep(missing > 0 ? (useconds_t)(missing / bucket->fillRate * 1e6) + 1000 : 1000);
+    }
 }
 
 // Fill the bucket with tokens based on elapsed time, allowing temporary burst handling
@@ -115,6 +270,10 @@ void* fillBucket(void* arg) {
 
 // Get tokens from the bucket with burst protection
 void getTokens(TokenBucket* bucket, int n) {
+    if (bucket->lazyRefill) {
+        getTokensLazy(bucket, n);
+        return;
+    }
     pthread_mutex_lock(&bucket->lock);
     
     // Burst protection: if consumption exceeds 75% of bucket capacity too quickly, restrict requests
@@ -149,6 +308,302 @@ void getTokens(TokenBucket* bucket, int n) {
     pthread_mutex_unlock(&bucket->lock);
 }
 
+// Keyed rate limiter: one lazy bucket per client (IP, user or tenant id).
+// Each key costs a 16-byte KeyedBucket in a sharded open-addressing table plus
+// one 8-byte timing-wheel entry; there is no mutex or condition variable per key.
+#define RL_SHARDS 256                 // Independently locked shards (power of two)
+#define RL_SHARD_INITIAL_CAPACITY 64  // Slots per shard before it first grows (power of two)
+#define RL_WHEEL_SLOTS 256            // Timing wheel slots per shard
+#define RL_WHEEL_TICK_MS 1000         // Time covered by one wheel slot
+#define RL_BATCH_CHUNK 256            // Keys sorted by shard at a time in a batch check
+#define RL_EMPTY_STATE UINT64_MAX     // Marks a free slot: its token field exceeds BURST_CAPACITY
+
+// Packed lazy-refill state of one key
+typedef struct {
+    uint64_t key;
+    uint64_t state;               // Same layout as TokenBucket.state
+} KeyedBucket;
+
+// Keys whose bucket may have refilled to MAX_CAPACITY during one tick
+typedef struct {
+    uint64_t* keys;
+    size_t count;
+    size_t capacity;
+} WheelSlot;
+
+typedef struct {
+    pthread_mutex_t lock;
+    KeyedBucket* buckets;
+    size_t capacity;
+    size_t count;
+    WheelSlot wheel[RL_WHEEL_SLOTS];
+    uint64_t wheelTick;           // Next tick to expire
+    char pad[64];
+} RateLimiterShard;
+
+typedef struct {
+    double fillRate;              // Tokens added per second to every key
+    long epochMillis;             // Monotonic time the packed timestamps count from
+    RateLimiterShard shards[RL_SHARDS];
+} RateLimiter;
+
+// Mix a key so neighbouring ids (consecutive IPs) spread over shards and slots
+static uint64_t rateLimiterHash(uint64_t key) {
+    key ^= key >> 33;
+    key *= 0xff51afd7ed558ccdULL;
+    key ^= key >> 33;
+    key *= 0xc4ceb9fe1a85ec53ULL;
+    key ^= key >> 33;
+    return key;
+}
+
+// Key for a client identified by a string (user name, tenant, IPv6 text)
+uint64_t rateLimiterKey(const char* client) {
+    uint64_t h = 1469598103934665603ULL;
+    for (const unsigned char* p = (const unsigned char*)client; *p; p++) {
+        h ^= *p;
+        h *= 1099511628211ULL;
+    }
+    return h;
+}
+
+static RateLimiterShard* rateLimiterShardOf(RateLimiter* limiter, uint64_t hash) {
+    return &limiter->shards[hash >> 56 & (RL_SHARDS - 1)];
+}
+
+// Slot holding key, or the free slot where it belongs. Caller holds the shard lock.
+static size_t rateLimiterProbe(const RateLimiterShard* shard, uint64_t key, uint64_t hash) {
+    size_t mask = shard->capacity - 1;
+    size_t i = hash & mask;
+    while (shard->buckets[i].state != RL_EMPTY_STATE && shard->buckets[i].key != key) i = (i + 1) & mask;
+    return i;
+}
+
+// Double a shard's table. Caller holds the shard lock. Returns 0 on OOM.
+static int rateLimiterGrow(RateLimiterShard* shard) {
+    size_t capacity = shard->capacity * 2;
+    KeyedBucket* buckets = malloc(capacity * sizeof(KeyedBucket));
+    if (!buckets) return 0;
+    memset(buckets, 0xff, capacity * sizeof(KeyedBucket));
+    for (size_t j = 0; j < shard->capacity; j++) {
+        if (shard->buckets[j].state == RL_EMPTY_STATE) continue;
+        size_t i = rateLimiterHash(shard->buckets[j].key) & (capacity - 1);
+        while (buckets[i].state != RL_EMPTY_STATE) i = (i + 1) & (capacity - 1);
+        buckets[i] = shard->buckets[j];
+    }
+    free(shard->buckets);
+    shard->buckets = buckets;
+    shard->capacity = capacity;
+    return 1;
+}
+
+// Remove slot i, shifting later entries of its probe run back so lookups need no tombstones
+static void rateLimiterRemove(RateLimiterShard* shard, size_t i) {
+    size_t mask = shard->capacity - 1;
+    size_t j = i;
+    for (;;) {
+        j = (j + 1) & mask;
+        if (shard->buckets[j].state == RL_EMPTY_STATE) break;
+        size_t home = rateLimiterHash(shard->buckets[j].key) & mask;
+        // Move j into the hole unless its home lies cyclically in (i, j]
+        if (((j - home) & mask) >= ((j - i) & mask)) {
+            shard->buckets[i] = shard->buckets[j];
+            i = j;
+        }
+    }
+    shard->buckets[i].state = RL_EMPTY_STATE;
+    shard->count--;
+}
+
+// When a key's bucket is back to at least MAX_CAPACITY tokens. From then on it
+// is no more restrictive than a fresh bucket, so it can be dropped.
+static uint64_t rateLimiterIdleAt(const RateLimiter* limiter, uint64_t state) {
+    uint64_t units = lazyUnits(state);
+    uint64_t full = (uint64_t)MAX_CAPACITY * LAZY_TOKEN_SCALE;
+    if (units >= full) return lazyStamp(state);
+    double unitsPerMs = limiter->fillRate * LAZY_TOKEN_SCALE / 1000.0;
+    return lazyStamp(state) + (uint64_t)((full - units) / unitsPerMs) + 1;
+}
+
+// Put key in the slot of the tick its bucket goes idle, or the farthest slot
+// if that is beyond the wheel. Caller holds the shard lock.
+static void rateLimiterSchedule(RateLimiterShard* shard, uint64_t key, uint64_t idleAt) {
+    uint64_t tick = (idleAt + RL_WHEEL_TICK_MS - 1) / RL_WHEEL_TICK_MS;
+    if (tick < shard->wheelTick) tick = shard->wheelTick;
+    if (tick > shard->wheelTick + RL_WHEEL_SLOTS - 1) tick = shard->wheelTick + RL_WHEEL_SLOTS - 1;
+    WheelSlot* slot = &shard->wheel[tick % RL_WHEEL_SLOTS];
+    if (slot->count == slot->capacity) {
+        size_t capacity = slot->capacity ? slot->capacity * 2 : 16;
+        uint64_t* keys = realloc(slot->keys, capacity * sizeof(uint64_t));
+        if (!keys) return;        // Unscheduled keys are never expired, only kept
+        slot->keys = keys;
+        slot->capacity = capacity;
+    }
+    slot->keys[slot->count++] = key;
+}
+
+// Expire the keys of every tick up to now: idle ones are removed, those used
+// since they were scheduled move to the slot of their new idle time.
+// Caller holds the shard lock.
+static void rateLimiterAdvance(RateLimiter* limiter, RateLimiterShard* shard, uint64_t now) {
+    uint64_t target = now / RL_WHEEL_TICK_MS;
+    for (int processed = 0; shard->wheelTick <= target; processed++) {
+        if (processed == RL_WHEEL_SLOTS) {
+            // Idle for a whole turn: every slot was visited once, keys left behind
+            // are picked up when their slot comes round again
+            shard->wheelTick = target + 1;
+            break;
+        }
+        WheelSlot* slot = &shard->wheel[shard->wheelTick % RL_WHEEL_SLOTS];
+        WheelSlot due = *slot;
+        slot->keys = NULL;
+        slot->count = slot->capacity = 0;
+        shard->wheelTick++;
+        for (size_t k = 0; k < due.count; k++) {
+            uint64_t key = due.keys[k];
+            size_t i = rateLimiterProbe(shard, key, rateLimiterHash(key));
+            if (shard->buckets[i].state == RL_EMPTY_STATE) continue;
+            uint64_t idleAt = rateLimiterIdleAt(limiter, shard->buckets[i].state);
+            if (idleAt <= now) {
+                rateLimiterRemove(shard, i);
+            } else {
+                rateLimiterSchedule(shard, key, idleAt);
+            }
+        }
+        // Rescheduled keys land in later ticks, so the slot is free to reuse its buffer
+        if (slot->keys == NULL) {
+            due.count = 0;
+            *slot = due;
+        } else {
+            free(due.keys);
+        }
+    }
+}
+
+// Take n tokens for key. Caller holds the shard lock.
+static int rateLimiterTake(RateLimiter* limiter, RateLimiterShard* shard, uint64_t key, uint64_t hash,
+                           int n, uint64_t now) {
+    size_t i = rateLimiterProbe(shard, key, hash);
+    if (shard->buckets[i].state == RL_EMPTY_STATE) {
+        // Stay under a 75% load factor so probe runs stay short
+        if ((shard->count + 1) * 4 > shard->capacity * 3) {
+            if (!rateLimiterGrow(shard)) return 0;
+            i = rateLimiterProbe(shard, key, hash);
+        }
+        shard->buckets[i].key = key;
+        shard->buckets[i].state = packLazyState((uint64_t)MAX_CAPACITY * LAZY_TOKEN_SCALE, now, 0);
+        shard->count++;
+        rateLimiterSchedule(shard, key, now);
+    }
+    return lazyConsume(shard->buckets[i].state, now, limiter->fillRate, n, &shard->buckets[i].state);
+}
+
+// Create a keyed limiter whose keys each refill at fillRate tokens per second.
+// Returns NULL on OOM.
+RateLimiter* createRateLimiter(double fillRate) {
+    RateLimiter* limiter = calloc(1, sizeof(RateLimiter));
+    if (!limiter) return NULL;
+    limiter->fillRate = fillRate;
+    limiter->epochMillis = monotonicTimeMillis();
+    for (int s = 0; s < RL_SHARDS; s++) {
+        RateLimiterShard* shard = &limiter->shards[s];
+        pthread_mutex_init(&shard->lock, NULL);
+        shard->capacity = RL_SHARD_INITIAL_CAPACITY;
+        shard->buckets = malloc(shard->capacity * sizeof(KeyedBucket));
+        if (!shard->buckets) {
+            limiter->shards[s].capacity = 0;
+            for (int t = 0; t <= s; t++) free(limiter->shards[t].buckets);
+            free(limiter);
+            return NULL;
+        }
+        memset(shard->buckets, 0xff, shard->capacity * sizeof(KeyedBucket));
+    }
+    return limiter;
+}
+
+void destroyRateLimiter(RateLimiter* limiter) {
+    for (int s = 0; s < RL_SHARDS; s++) {
+        RateLimiterShard* shard = &limiter->shards[s];
+        for (int w = 0; w < RL_WHEEL_SLOTS; w++) free(shard->wheel[w].keys);
+        free(shard->buckets);
+        pthread_mutex_destroy(&shard->lock);
+    }
+    free(limiter);
+}
+
+// Take n tokens from key's bucket without blocking, with the same burst
+// protection as tryGetTokens(). Returns the tokens granted, or 0 if rejected.
+int rateLimiterTryAcquire(RateLimiter* limiter, uint64_t key, int n) {
+    uint64_t now = (uint64_t)(monotonicTimeMillis() - limiter->epochMillis);
+    uint64_t hash = rateLimiterHash(key);
+    RateLimiterShard* shard = rateLimiterShardOf(limiter, hash);
+    pthread_mutex_lock(&shard->lock);
+    rateLimiterAdvance(limiter, shard, now);
+    int granted = rateLimiterTake(limiter, shard, key, hash, n, now);
+    pthread_mutex_unlock(&shard->lock);
+    return granted;
+}
+
+// Check many keys at once: granted[i] receives what rateLimiterTryAcquire(keys[i], costs[i])
+// would return. Keys are grouped by shard so each shard lock is taken once per chunk.
+// Repeated keys are charged in order.
+void rateLimiterTryAcquireBatch(RateLimiter* limiter, const uint64_t* keys, const int* costs,
+                                size_t count, int* granted) {
+    uint64_t now = (uint64_t)(monotonicTimeMillis() - limiter->epochMillis);
+    uint64_t hashes[RL_BATCH_CHUNK];
+    uint16_t order[RL_BATCH_CHUNK];
+    uint16_t starts[RL_SHARDS + 1];
+
+    for (size_t base = 0; base < count; base += RL_BATCH_CHUNK) {
+        size_t n = count - base < RL_BATCH_CHUNK ? count - base : RL_BATCH_CHUNK;
+
+        // Counting sort of the chunk by shard, stable so repeated keys keep their order
+        memset(starts, 0, sizeof(starts));
+        for (size_t i = 0; i < n; i++) {
+            hashes[i] = rateLimiterHash(keys[base + i]);
+            starts[(hashes[i] >> 56 & (RL_SHARDS - 1)) + 1]++;
+        }
+        for (int s = 0; s < RL_SHARDS; s++) starts[s + 1] += starts[s];
+        uint16_t fill[RL_SHARDS];
+        memcpy(fill, starts, sizeof(fill));
+        for (size_t i = 0; i < n; i++) order[fill[hashes[i] >> 56 & (RL_SHARDS - 1)]++] = (uint16_t)i;
+
+        for (int s = 0; s < RL_SHARDS; s++) {
+            if (starts[s] == starts[s + 1]) continue;
+            RateLimiterShard* shard = &limiter->shards[s];
+            pthread_mutex_lock(&shard->lock);
+            rateLimiterAdvance(limiter, shard, now);
+            for (uint16_t k = starts[s]; k < starts[s + 1]; k++) {
+                size_t i = order[k];
+                granted[base + i] = rateLimiterTake(limiter, shard, keys[base + i], hashes[i], costs[base + i], now);
+            }
+            pthread_mutex_unlock(&shard->lock);
+        }
+    }
+}
+
+// Expire idle keys in every shard. Shards also expire their own keys whenever
+// they are used; this is for reclaiming memory while traffic is quiet.
+void rateLimiterExpire(RateLimiter* limiter) {
+    uint64_t now = (uint64_t)(monotonicTimeMillis() - limiter->epochMillis);
+    for (int s = 0; s < RL_SHARDS; s++) {
+        pthread_mutex_lock(&limiter->shards[s].lock);
+        rateLimiterAdvance(limiter, &limiter->shards[s], now);
+        pthread_mutex_unlock(&limiter->shards[s].lock);
+    }
+}
+
+// Number of keys currently tracked
+size_t rateLimiterKeyCount(RateLimiter* limiter) {
+    size_t total = 0;
+    for (int s = 0; s < RL_SHARDS; s++) {
+        pthread_mutex_lock(&limiter->shards[s].lock);
+        total += limiter->shards[s].count;
+        pthread_mutex_unlock(&limiter->shards[s].lock);
+    }
+    return total;
+}
+
 // Multi-threaded consumer function
 void* consumer(void* arg) {
     TokenBucket* bucket = (TokenBucket*) arg;
@@ -160,21 +615,88 @@ void* consumer(void* arg) {
     return NULL;
 }
 
-// Main function to simulate multiple consumers
-int main() {
+// Multi-threaded consumer on a lazy bucket: never blocks, just reports what it got
+void* lazyConsumer(void* arg) {
+    TokenBucket* bucket = (TokenBucket*) arg;
+    while (1) {
+        int requestTokens = (rand() % 5) + 1;
+        int granted = tryGetTokens(bucket, requestTokens);
+        if (granted) {
+            printf("Granted %d of %d tokens\n", granted, requestTokens);
+        } else {
+            printf("Rejected request for %d tokens\n", requestTokens);
+        }
+        sleep(3);
+    }
+    return NULL;
+}
+
+// Per-client limiting: a million well-behaved clients plus one abusive client
+void runKeyedDemo() {
+    enum { CLIENTS = 1000000, BATCH = 1024 };
+    RateLimiter* limiter = createRateLimiter(BASE_FILL_RATE);
+    if (!limiter) {
+        fprintf(stderr, "Failed to create rate limiter\n");
+        exit(1);
+    }
+    uint64_t keys[BATCH];
+    int costs[BATCH], granted[BATCH];
+    long accepted = 0, rejected = 0;
+    
+    // Every client sends a few 3-token requests, checked in batches
+    for (int round = 0; round < 5; round++) {
+        for (int base = 0; base < CLIENTS; base += BATCH) {
+            int n = (CLIENTS - base < BATCH) ? CLIENTS - base : BATCH;
+            for (int i = 0; i < n; i++) {
+                keys[i] = 0x0a000000u + (uint64_t)(base + i);  // Client IPv4 address 10.x.y.z
+                costs[i] = 3;
+            }
+            rateLimiterTryAcquireBatch(limiter, keys, costs, n, granted);
+            for (int i = 0; i < n; i++) {
+                if (granted[i]) accepted++; else rejected++;
+            }
+        }
+    }
+    printf("Keyed limiter: %zu clients tracked, %ld requests accepted, %ld rejected\n",
+           rateLimiterKeyCount(limiter), accepted, rejected);
+    
+    // One client floods: burst protection cuts it to 2 tokens per request, then it runs dry
+    uint64_t abuser = rateLimiterKey("tenant-42");
+    int abuserAccepted = 0;
+    for (int i = 0; i < 200; i++) {
+        if (rateLimiterTryAcquire(limiter, abuser, 3)) abuserAccepted++;
+    }
+    printf("Abusive client: %d of 200 requests accepted\n", abuserAccepted);
+    destroyRateLimiter(limiter);
+}
+
+// Main function to simulate multiple consumers. Run with "lazy" to use lazy refill mode,
+// or "keyed" for the per-client rate limiter.
+int main(int argc, char* argv[]) {
     srand(time(NULL));
+    if (argc > 1 && strcmp(argv[1], "keyed") == 0) {
+        runKeyedDemo();
+        return 0;
+    }
     TokenBucket bucket;
-    initTokenBucket(&bucket);
-    
+    int lazy = argc > 1 && strcmp(argv[1], "lazy") == 0;
     pthread_t fillThread, consumers[3];
-    pthread_create(&fillThread, NULL, fillBucket, &bucket);
+    
+    if (lazy) {
+        initLazyTokenBucket(&bucket);
+    } else {
+        initTokenBucket(&bucket);
+        pthread_create(&fillThread, NULL, fillBucket, &bucket);
+    }
     
     // Create multiple consumer threads
     for (int i = 0; i < 3; i++) {
-        pthread_create(&consumers[i], NULL, consumer, &bucket);
+        pthread_create(&consumers[i], NULL, lazy ? lazyConsumer : consumer, &bucket);
     }
     
-    pthread_join(fillThread, NULL);
+    if (!lazy) {
+        pthread_join(fillThread, NULL);
+    }
     for (int i = 0; i < 3; i++) {
         pthread_join(consumers[i], NULL);
     }
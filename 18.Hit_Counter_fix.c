@@ -3,6 +3,9 @@
 #include <pthread.h>
 #include <unistd.h>
 #include <time.h>
+#include <stdatomic.h>
+#include <stdint.h>
+#include <string.h>
 
 /* Key Features Implemented
 
@@ -98,9 +101,47 @@
   This would make the hit counter more scalable, accurate, and adaptable to high-traffic applications. 
 
 */
+/* Striped Hit Counter (StripedHitCounter)
+
+   hit() above clears all WINDOW_LENGTH slots under one mutex on every call, and getHits()
+   scans them again, so every request pays a locked O(WINDOW_LENGTH) loop.
+
+   Striped Counters
+   - HIT_STRIPES cache-line-aligned stripes, each with its own circular array and lock.
+     A thread always records into its own stripe, so hits from different threads
+     never touch the same cache line or contend on a lock.
+
+   Lazy Expiry
+   - A stripe only clears the slots between its lastHitTime and now, once each,
+     instead of sweeping the whole window.
+
+   Running Window Total
+   - Each stripe keeps the sum of its live slots, so stripedGetHits() is O(HIT_STRIPES)
+     and stripedHit() is O(1) amortized.
+*/
+/* Multi-Resolution Hit Counter (MultiResHitCounter)
+
+   Hierarchical Ring Buffers
+   - Every hit is counted at 1 second (WINDOW_LENGTH slots), 1 minute (1 hour of slots)
+     and 1 hour (1 day of slots) resolution, so one structure answers any window up to
+     a day: the finest level that covers the window is summed, and its oldest slot is
+     prorated when the window starts inside it.
+
+   Latency Percentiles
+   - Optionally each slot also keeps an HDR-style histogram: exact below 8 us, then 8
+     logarithmic sub-buckets per power of two (~12% precision). Percentiles merge the
+     histograms of the window's slots.
+
+   Spike Detection
+   - The "spike by 500% in 10 seconds" rule from the notes above: running totals of the
+     last SPIKE_WINDOW seconds and of the minute before them slide one second at a time,
+     so the check is O(1) per hit. The SpikeHandler fires once when a spike starts,
+     outside the lock, which replaces logging every count with logging only anomalies.
+*/
 
 
 #define WINDOW_LENGTH 300 // 5-minute window in seconds
+#define HIT_STRIPES 16    // Independent stripes in StripedHitCounter
 
 // HitCounter structure
 typedef struct {
@@ -110,6 +151,22 @@ typedef struct {
     pthread_mutex_t lock; // Mutex for thread safety
 } HitCounter;
 
+// One stripe of a StripedHitCounter, alone on its cache lines
+typedef struct {
+    _Alignas(64) pthread_mutex_t lock;
+    int lastHitTime;               // Latest second the slots are expired up to, -1 before first use
+    long windowTotal;              // Sum of hitRecords, i.e. hits in the window ending at lastHitTime
+    int hitRecords[WINDOW_LENGTH]; // Hits per second, indexed by time % WINDOW_LENGTH
+} HitStripe;
+
+// Striped HitCounter: each thread records into its own stripe
+typedef struct {
+    HitStripe stripes[HIT_STRIPES];
+} StripedHitCounter;
+
+static atomic_int nextHitStripe;
+static _Thread_local int hitStripeIndex = -1;
+
 // Get the current time in seconds
 int getCurrTimeSec() {
     return (int)time(NULL);
@@ -173,39 +230,430 @@ int getHits(HitCounter *counter) {
     return count;
 }
 
+// Initialize the StripedHitCounter
+void initStripedHitCounter(StripedHitCounter *counter) {
+    for (int s = 0; s < HIT_STRIPES; s++) {
+        HitStripe *stripe = &counter->stripes[s];
+        pthread_mutex_init(&stripe->lock, NULL);
+        stripe->lastHitTime = -1;
+        stripe->windowTotal = 0;
+        for (int i = 0; i < WINDOW_LENGTH; i++) {
+            stripe->hitRecords[i] = 0;
+        }
+    }
+}
+
+// Expire the slots of the seconds between lastHitTime and currTime. Each second is
+// cleared once, so the cost is amortized O(1) per call. Caller holds the stripe lock.
+static void advanceStripe(HitStripe *stripe, int currTime) {
+    if (stripe->lastHitTime < 0 || currTime - stripe->lastHitTime >= WINDOW_LENGTH) {
+        // First use, or idle for a whole window: nothing in it is live any more
+        for (int i = 0; i < WINDOW_LENGTH; i++) {
+            stripe->hitRecords[i] = 0;
+        }
+        stripe->windowTotal = 0;
+        stripe->lastHitTime = currTime;
+        return;
+    }
+    // A clock that stepped back keeps counting into the latest second
+    for (int t = stripe->lastHitTime + 1; t <= currTime; t++) {
+        int index = t % WINDOW_LENGTH;
+        stripe->windowTotal -= stripe->hitRecords[index];
+        stripe->hitRecords[index] = 0;
+    }
+    if (currTime > stripe->lastHitTime) {
+        stripe->lastHitTime = currTime;
+    }
+}
+
+// Stripe of the calling thread: assigned round-robin on first use
+static HitStripe *threadStripe(StripedHitCounter *counter) {
+    if (hitStripeIndex < 0) {
+        hitStripeIndex = atomic_fetch_add_explicit(&nextHitStripe, 1, memory_order_relaxed) % HIT_STRIPES;
+    }
+    return &counter->stripes[hitStripeIndex];
+}
+
+// Record a hit at the current timestamp in the calling thread's stripe
+void stripedHit(StripedHitCounter *counter) {
+    HitStripe *stripe = threadStripe(counter);
+    pthread_mutex_lock(&stripe->lock);
+    advanceStripe(stripe, getCurrTimeSec());
+    stripe->hitRecords[stripe->lastHitTime % WINDOW_LENGTH]++;
+    stripe->windowTotal++;
+    pthread_mutex_unlock(&stripe->lock);
+}
+
+// Get the number of hits in the past WINDOW_LENGTH seconds: O(HIT_STRIPES)
+long stripedGetHits(StripedHitCounter *counter) {
+    int currTime = getCurrTimeSec();
+    long count = 0;
+    for (int s = 0; s < HIT_STRIPES; s++) {
+        HitStripe *stripe = &counter->stripes[s];
+        pthread_mutex_lock(&stripe->lock);
+        advanceStripe(stripe, currTime);
+        count += stripe->windowTotal;
+        pthread_mutex_unlock(&stripe->lock);
+    }
+    return count;
+}
+
+// Release the StripedHitCounter's locks
+void destroyStripedHitCounter(StripedHitCounter *counter) {
+    for (int s = 0; s < HIT_STRIPES; s++) {
+        pthread_mutex_destroy(&counter->stripes[s].lock);
+    }
+}
+
+// Multi-resolution hit counter: the same hits at 1 second, 1 minute and 1 hour
+// resolution, each level in its own ring of slots
+#define RES_LEVELS 3
+#define HDR_SUB_BUCKET_BITS 3                        // 8 sub-buckets per power of two: ~12% precision
+#define HDR_SUB_BUCKETS (1 << HDR_SUB_BUCKET_BITS)
+#define HDR_BUCKETS (HDR_SUB_BUCKETS * (32 - HDR_SUB_BUCKET_BITS + 1)) // Latencies up to 2^32-1 us
+#define SPIKE_WINDOW 10                              // Seconds in the window watched for spikes
+#define SPIKE_BASELINE_WINDOWS 6                     // Baseline: the SPIKE_WINDOW * 6 seconds before it
+#define SPIKE_RATIO 5.0                              // "Spike by 500%": recent window >= 5x the baseline average
+#define SPIKE_MIN_HITS 50                            // Ignore spikes smaller than this
+
+static const int resSlotSeconds[RES_LEVELS] = { 1, 60, 3600 };
+static const int resSpanSeconds[RES_LEVELS] = { WINDOW_LENGTH, 3600, 86400 };
+
+// One resolution: slotCount slots of slotSeconds each. One slot more than the span
+// needs, so a window not aligned to slot boundaries still finds its oldest slot.
+typedef struct {
+    int slotSeconds;
+    int slotCount;
+    int lastSlot;               // Latest slot number (time / slotSeconds) expired up to
+    long *counts;
+    uint32_t *histograms;       // slotCount * HDR_BUCKETS latency counts, NULL if disabled
+} ResolutionLevel;
+
+typedef void (*SpikeHandler)(int time, long recentHits, double baselineHits, void *context);
+
+typedef struct {
+    ResolutionLevel levels[RES_LEVELS];
+    int firstHitTime;           // -1 before first use
+    int lastHitTime;
+    long recentHits;            // Hits in the last SPIKE_WINDOW seconds
+    long baselineHits;          // Hits in the SPIKE_BASELINE_WINDOWS windows before those
+    int spiking;                // Set while recentHits is a spike; handler fires on the rising edge
+    SpikeHandler onSpike;
+    void *spikeContext;
+    pthread_mutex_t lock;
+} MultiResHitCounter;
+
+// HDR-style bucket of a latency: exact below HDR_SUB_BUCKETS, then HDR_SUB_BUCKETS
+// logarithmic sub-buckets per power of two
+static int hdrBucketOf(uint32_t value) {
+    if (value < HDR_SUB_BUCKETS) return (int)value;
+    int exponent = 31 - __builtin_clz(value);
+    int sub = (int)(value >> (exponent - HDR_SUB_BUCKET_BITS)) & (HDR_SUB_BUCKETS - 1);
+    return HDR_SUB_BUCKETS + (exponent - HDR_SUB_BUCKET_BITS) * HDR_SUB_BUCKETS + sub;
+}
+
+// Largest latency that falls in bucket i
+static uint64_t hdrBucketHigh(int i) {
+    if (i < HDR_SUB_BUCKETS) return (uint64_t)i;
+    int shift = (i - HDR_SUB_BUCKETS) / HDR_SUB_BUCKETS;
+    uint64_t sub = (uint64_t)((i - HDR_SUB_BUCKETS) % HDR_SUB_BUCKETS);
+    return ((HDR_SUB_BUCKETS + sub + 1) << shift) - 1;
+}
+
+// Initialize the MultiResHitCounter. With trackLatency set, every slot also keeps a
+// latency histogram (about 1 KB per slot). Returns 0 on OOM.
+int initMultiResHitCounter(MultiResHitCounter *counter, int trackLatency, SpikeHandler onSpike, void *spikeContext) {
+    memset(counter, 0, sizeof(*counter));
+    for (int l = 0; l < RES_LEVELS; l++) {
+        ResolutionLevel *level = &counter->levels[l];
+        level->slotSeconds = resSlotSeconds[l];
+        level->slotCount = resSpanSeconds[l] / resSlotSeconds[l] + 1;
+        level->lastSlot = -1;
+        level->counts = calloc(level->slotCount, sizeof(long));
+        level->histograms = trackLatency ? calloc((size_t)level->slotCount * HDR_BUCKETS, sizeof(uint32_t)) : NULL;
+        if (!level->counts || (trackLatency && !level->histograms)) {
+            for (int k = 0; k <= l; k++) {
+                free(counter->levels[k].counts);
+                free(counter->levels[k].histograms);
+            }
+            return 0;
+        }
+    }
+    counter->firstHitTime = -1;
+    counter->lastHitTime = -1;
+    counter->onSpike = onSpike;
+    counter->spikeContext = spikeContext;
+    pthread_mutex_init(&counter->lock, NULL);
+    return 1;
+}
+
+void destroyMultiResHitCounter(MultiResHitCounter *counter) {
+    for (int l = 0; l < RES_LEVELS; l++) {
+        free(counter->levels[l].counts);
+        free(counter->levels[l].histograms);
+    }
+    pthread_mutex_destroy(&counter->lock);
+}
+
+static void clearLevelSlot(ResolutionLevel *level, int index) {
+    level->counts[index] = 0;
+    if (level->histograms) {
+        memset(&level->histograms[(size_t)index * HDR_BUCKETS], 0, HDR_BUCKETS * sizeof(uint32_t));
+    }
+}
+
+// Expire the slots between the level's last slot and currTime, each once
+static void advanceLevel(ResolutionLevel *level, int currTime) {
+    int slot = currTime / level->slotSeconds;
+    if (level->lastSlot < 0 || slot - level->lastSlot >= level->slotCount) {
+        for (int i = 0; i < level->slotCount; i++) {
+            clearLevelSlot(level, i);
+        }
+    } else {
+        for (int s = level->lastSlot + 1; s <= slot; s++) {
+            clearLevelSlot(level, s % level->slotCount);
+        }
+    }
+    if (slot > level->lastSlot) {
+        level->lastSlot = slot;
+    }
+}
+
+// Spike rule on the running totals: the last SPIKE_WINDOW seconds against the
+// average SPIKE_WINDOW of the baseline before them. Needs a full baseline first.
+static int isSpike(const MultiResHitCounter *counter) {
+    if (counter->lastHitTime - counter->firstHitTime < SPIKE_WINDOW * (SPIKE_BASELINE_WINDOWS + 1)) return 0;
+    double baseline = (double)counter->baselineHits / SPIKE_BASELINE_WINDOWS;
+    return counter->recentHits >= SPIKE_MIN_HITS && counter->recentHits >= SPIKE_RATIO * baseline;
+}
+
+// Move every level up to currTime, sliding the spike windows one second at a time.
+// Caller holds the lock. Returns 1 if a spike started.
+static int advanceMultiRes(MultiResHitCounter *counter, int currTime) {
+    const ResolutionLevel *seconds = &counter->levels[0];
+    if (counter->lastHitTime < 0 || currTime - counter->lastHitTime >= seconds->slotCount) {
+        // First use, or idle longer than the seconds ring: the spike windows are empty
+        if (counter->firstHitTime < 0) counter->firstHitTime = currTime;
+        counter->recentHits = 0;
+        counter->baselineHits = 0;
+    } else {
+        int last = counter->lastHitTime;
+        for (int t = last + 1; t <= currTime; t++) {
+            // Seconds after the last hit are still stale in the ring: they had no hits
+            int recentEdge = t - SPIKE_WINDOW;
+            int baselineEdge = t - SPIKE_WINDOW * (SPIKE_BASELINE_WINDOWS + 1);
+            long leavingRecent = recentEdge > last ? 0 : seconds->counts[recentEdge % seconds->slotCount];
+            long leavingBaseline = baselineEdge > last ? 0 : seconds->counts[baselineEdge % seconds->slotCount];
+            counter->recentHits -= leavingRecent;
+            counter->baselineHits += leavingRecent - leavingBaseline;
+        }
+    }
+    for (int l = 0; l < RES_LEVELS; l++) {
+        advanceLevel(&counter->levels[l], currTime);
+    }
+    if (currTime > counter->lastHitTime) {
+        counter->lastHitTime = currTime;
+    }
+    int spike = isSpike(counter);
+    int started = spike && !counter->spiking;
+    counter->spiking = spike;
+    return started;
+}
+
+static void reportSpike(MultiResHitCounter *counter, int started, int time, long recent, long baseline) {
+    if (started && counter->onSpike) {
+        counter->onSpike(time, recent, (double)baseline / SPIKE_BASELINE_WINDOWS, counter->spikeContext);
+    }
+}
+
+// Record a hit at currTime with an optional latency (negative: none)
+void multiResRecordAt(MultiResHitCounter *counter, int currTime, long latencyUs) {
+    pthread_mutex_lock(&counter->lock);
+    int started = advanceMultiRes(counter, currTime);
+    int bucket = latencyUs < 0 ? -1 : hdrBucketOf(latencyUs > UINT32_MAX ? UINT32_MAX : (uint32_t)latencyUs);
+    for (int l = 0; l < RES_LEVELS; l++) {
+        ResolutionLevel *level = &counter->levels[l];
+        int index = level->lastSlot % level->slotCount;
+        level->counts[index]++;
+        if (level->histograms && bucket >= 0) {
+            level->histograms[(size_t)index * HDR_BUCKETS + bucket]++;
+        }
+    }
+    counter->recentHits++;
+    if (!counter->spiking && isSpike(counter)) {
+        counter->spiking = 1;
+        started = 1;
+    }
+    int time = counter->lastHitTime;
+    long recent = counter->recentHits, baseline = counter->baselineHits;
+    pthread_mutex_unlock(&counter->lock);
+    reportSpike(counter, started, time, recent, baseline);
+}
+
+// Finest level whose span covers windowSeconds, and the first slot of the window.
+// Caller holds the lock and has advanced the counter.
+static const ResolutionLevel *windowLevel(const MultiResHitCounter *counter, int currTime, int windowSeconds,
+                                          int *firstSlot) {
+    int l = 0;
+    while (l < RES_LEVELS - 1 && windowSeconds > resSpanSeconds[l]) l++;
+    if (windowSeconds > resSpanSeconds[l]) windowSeconds = resSpanSeconds[l];
+    const ResolutionLevel *level = &counter->levels[l];
+    *firstSlot = (currTime - windowSeconds + 1) / level->slotSeconds;
+    if (*firstSlot < 0) *firstSlot = 0;
+    return level;
+}
+
+// Hits in the windowSeconds seconds ending at currTime, for any window up to a day.
+// Exact up to WINDOW_LENGTH; beyond it the oldest minute or hour slot is prorated.
+long multiResHitsAt(MultiResHitCounter *counter, int currTime, int windowSeconds) {
+    pthread_mutex_lock(&counter->lock);
+    int started = advanceMultiRes(counter, currTime);
+    int firstSlot;
+    const ResolutionLevel *level = windowLevel(counter, currTime, windowSeconds, &firstSlot);
+    double count = 0;
+    int windowStart = currTime - windowSeconds + 1;
+    for (int s = firstSlot; s <= level->lastSlot; s++) {
+        long hits = level->counts[s % level->slotCount];
+        int slotStart = s * level->slotSeconds;
+        if (slotStart < windowStart) {
+            // Only the part of the oldest slot inside the window, assuming hits were spread evenly
+            count += (double)hits * (slotStart + level->slotSeconds - windowStart) / level->slotSeconds;
+        } else {
+            count += hits;
+        }
+    }
+    int time = counter->lastHitTime;
+    long recent = counter->recentHits, baseline = counter->baselineHits;
+    pthread_mutex_unlock(&counter->lock);
+    reportSpike(counter, started, time, recent, baseline);
+    return (long)(count + 0.5);
+}
+
+// Latency at percentile (0-100] of the hits in the window ending at currTime, as
+// the upper bound of its histogram bucket. Whole slots are used, so a window is
+// rounded out to the resolution of its level. Returns -1 without latency data.
+long multiResPercentileAt(MultiResHitCounter *counter, int currTime, int windowSeconds, double percentile) {
+    uint64_t merged[HDR_BUCKETS] = { 0 };
+    uint64_t total = 0;
+    pthread_mutex_lock(&counter->lock);
+    int started = advanceMultiRes(counter, currTime);
+    int firstSlot;
+    const ResolutionLevel *level = windowLevel(counter, currTime, windowSeconds, &firstSlot);
+    if (level->histograms) {
+        for (int s = firstSlot; s <= level->lastSlot; s++) {
+            const uint32_t *histogram = &level->histograms[(size_t)(s % level->slotCount) * HDR_BUCKETS];
+            for (int b = 0; b < HDR_BUCKETS; b++) {
+                merged[b] += histogram[b];
+                total += histogram[b];
+            }
+        }
+    }
+    int time = counter->lastHitTime;
+    long recent = counter->recentHits, baseline = counter->baselineHits;
+    pthread_mutex_unlock(&counter->lock);
+    reportSpike(counter, started, time, recent, baseline);
+
+    if (total == 0) return -1;
+    uint64_t rank = (uint64_t)(percentile / 100.0 * (double)total + 0.999999);
+    if (rank < 1) rank = 1;
+    uint64_t seen = 0;
+    for (int b = 0; b < HDR_BUCKETS; b++) {
+        seen += merged[b];
+        if (seen >= rank) return (long)hdrBucketHigh(b);
+    }
+    return (long)hdrBucketHigh(HDR_BUCKETS - 1);
+}
+
+// Record a hit now, with its latency in microseconds (negative: none)
+void multiResHit(MultiResHitCounter *counter, long latencyUs) {
+    multiResRecordAt(counter, getCurrTimeSec(), latencyUs);
+}
+
+// Get the number of hits in the past windowSeconds seconds
+long multiResGetHits(MultiResHitCounter *counter, int windowSeconds) {
+    return multiResHitsAt(counter, getCurrTimeSec(), windowSeconds);
+}
+
+// Get a latency percentile over the past windowSeconds seconds
+long multiResGetPercentile(MultiResHitCounter *counter, int windowSeconds, double percentile) {
+    return multiResPercentileAt(counter, getCurrTimeSec(), windowSeconds, percentile);
+}
+
+// Both counters, so the test threads can compare them
+typedef struct {
+    HitCounter counter;
+    StripedHitCounter striped;
+} HitCounters;
+
 // Multi-threaded test functions
 void* simulateHits(void* arg) {
-    HitCounter* counter = (HitCounter*)arg;
+    HitCounters* counters = (HitCounters*)arg;
     for (int i = 0; i < 10; i++) {
-        hit(counter);
+        hit(&counters->counter);
+        stripedHit(&counters->striped);
         usleep(500000); // Simulate random hit intervals
     }
     return NULL;
 }
 
 void* simulateGetHits(void* arg) {
-    HitCounter* counter = (HitCounter*)arg;
+    HitCounters* counters = (HitCounters*)arg;
     for (int i = 0; i < 5; i++) {
-        printf("Hits in the last %d seconds: %d\n", WINDOW_LENGTH, getHits(counter));
+        printf("Hits in the last %d seconds: %d (striped: %ld)\n", WINDOW_LENGTH,
+               getHits(&counters->counter), stripedGetHits(&counters->striped));
         sleep(1);
     }
     return NULL;
 }
 
+static void printSpike(int time, long recentHits, double baselineHits, void *context) {
+    (void)context;
+    printf("WARNING: traffic spike at t=%d: %ld hits in %d seconds (baseline %.1f)\n",
+           time, recentHits, SPIKE_WINDOW, baselineHits);
+}
+
+// Replay two minutes of simulated traffic with a burst, using explicit timestamps
+void runMultiResolutionDemo() {
+    MultiResHitCounter counter;
+    if (!initMultiResHitCounter(&counter, 1, printSpike, NULL)) {
+        fprintf(stderr, "Failed to allocate the multi-resolution counter\n");
+        return;
+    }
+    srand(42);
+    int start = 1000000;
+    for (int t = start; t < start + 120; t++) {
+        int hits = (t >= start + 90 && t < start + 95) ? 100 : 5; // Burst of 20x normal traffic
+        for (int i = 0; i < hits; i++) {
+            long latency = 200 + rand() % 800;                     // 0.2-1 ms, with a slow tail
+            if (rand() % 100 == 0) latency = 50000 + rand() % 50000;
+            multiResRecordAt(&counter, t, latency);
+        }
+    }
+    int now = start + 119;
+    printf("Hits in the last 10 s: %ld, 1 min: %ld, 5 min: %ld, 1 h: %ld\n",
+           multiResHitsAt(&counter, now, 10), multiResHitsAt(&counter, now, 60),
+           multiResHitsAt(&counter, now, 300), multiResHitsAt(&counter, now, 3600));
+    printf("Latency over 5 min: p50 <= %ld us, p99 <= %ld us, p99.9 <= %ld us\n",
+           multiResPercentileAt(&counter, now, 300, 50), multiResPercentileAt(&counter, now, 300, 99),
+           multiResPercentileAt(&counter, now, 300, 99.9));
+    destroyMultiResHitCounter(&counter);
+}
+
 // Main function to test the hit counter with multi-threading
 int main() {
-    HitCounter counter;
-    initHitCounter(&counter);
+    static HitCounters counters;
+    initHitCounter(&counters.counter);
+    initStripedHitCounter(&counters.striped);
     
     pthread_t hitThreads[3], getHitThread;
     
     // Start multiple hit generators
     for (int i = 0; i < 3; i++) {
-        pthread_create(&hitThreads[i], NULL, simulateHits, &counter);
+        pthread_create(&hitThreads[i], NULL, simulateHits, &counters);
     }
     
     // Start a thread to fetch hit counts periodically
-    pthread_create(&getHitThread, NULL, simulateGetHits, &counter);
+    pthread_create(&getHitThread, NULL, simulateGetHits, &counters);
     
     // Join all threads
     for (int i = 0; i < 3; i++) {
@@ -213,6 +661,9 @@ int main() {
     }
     pthread_join(getHitThread, NULL);
     
+    destroyStripedHitCounter(&counters.striped);
+    
+    runMultiResolutionDemo();
     return 0;
 }
 
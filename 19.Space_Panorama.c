@@ -2,6 +2,12 @@
 #include <stdlib.h>
 #include <string.h>
 #include <pthread.h>
+#include <stdint.h>
+#include <stdatomic.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
 
 /* Key Features Implemented
 
@@ -26,9 +32,49 @@
    Next Step:
    Further optimizations, such as distributed caching across multiple servers?
 
+   2D Sector Index (mortonCode)
+   - Sectors are keyed by the Morton code of (x, y): the bits of x and y interleaved into
+     one 64-bit key, so neighbouring sectors in both directions get nearby keys and any
+     number of sectors per row hashes evenly (the old x % MAX_CACHE_SIZE sent a whole
+     row to one slot).
+   - The LRUCache index is a real chained hash table with its own links, separate from
+     the LRU list, so colliding sectors no longer overwrite each other.
+
+   Sharded CLOCK Cache (ShardedImageCache)
+   - CACHE_SHARDS independently locked shards, chosen by the sector's hash, so ingest
+     and viewer threads working on different sectors do not meet on one lock.
+   - Lookups take only the shard's read lock: instead of splicing an LRU list they set
+     the entry's reference bit, and eviction runs the CLOCK algorithm over the shard's
+     slots, skipping (and clearing) referenced entries. This approximates LRU while
+     letting any number of readers proceed in parallel.
+   - Images are returned by value; like LRUCache, the cache does not own image data.
+
+   Memory-Mapped Tile Store (TileStore)
+   - One file of fixed-size sector tiles plus an open-addressing index on the Morton code,
+     mapped MAP_SHARED. Lookups take no lock: misses become page faults into the mapping
+     instead of reloads, and the kernel's page cache holds what fits in memory.
+   - With a store attached, shardedPutImage() writes each image through to its tile, so an
+     evicted image is never lost, and a miss in shardedGetImage() is served from the store.
+   - Every miss queues the 8 neighbouring (x±1, y±1) sectors for a readahead thread, which
+     asks the kernel to read their tiles in the background (MADV_WILLNEED), so a viewer
+     panning across a region finds the next sectors already in memory.
+
+   Byte Budget
+   - ShardedImageCache is bounded by CACHE_BYTE_BUDGET bytes of images rather than an entry
+     count: CLOCK evicts until a new image fits its shard's share. Evicted tiles are
+     dropped from the mapping (MADV_DONTNEED); their data stays in the file.
+
 */
 
 #define MAX_CACHE_SIZE 100 // Maximum cache size for LRU eviction
+#define CACHE_SHARDS 16    // Independently locked shards in ShardedImageCache (power of two)
+#define CACHE_BYTE_BUDGET (64 * 1024 * 1024) // Image bytes a ShardedImageCache may hold
+#define CACHE_SHARD_INITIAL_SLOTS 16 // Slots per shard before it first grows (power of two)
+#define TILE_BYTES (64 * 1024)       // Bytes per sector tile in a TileStore
+#define TILE_CAPACITY 4096           // Tiles in a new TileStore
+#define TILE_STORE_MAGIC "PANOTILE"
+#define READAHEAD_QUEUE_SIZE 256     // Pending neighbour prefetches; more are dropped
+#define DEMO_BYTE_BUDGET (CACHE_SHARDS * 64) // Budget in main(), small enough to evict and miss
 
 // Structure for representing an image
 typedef struct {
@@ -46,6 +92,7 @@ typedef struct DLinkedList {
     Sector key;
     Image value;
     struct DLinkedList *prev, *next;
+    struct DLinkedList *hashNext; // Next node in the same hash bucket
 } DLinkedList;
 
 // Structure for the LRU Cache
@@ -62,6 +109,99 @@ typedef struct {
 
 RowHashTable rowHash;
 
+// Memory-mapped backing store of fixed-size sector tiles.
+// File layout: TileStoreHeader | index of indexSlots TileIndexEntry | tileCapacity tiles
+typedef struct {
+    char magic[8];              // TILE_STORE_MAGIC
+    uint32_t tileBytes;         // Bytes per tile, a multiple of the page size
+    uint32_t tileCapacity;
+    uint32_t indexSlots;        // Power of two, at least twice tileCapacity
+    uint32_t tileCount;         // Tiles handed out so far
+} TileStoreHeader;
+
+// One index slot: open addressing on the sector's hash
+typedef struct {
+    uint64_t code;              // Morton code + 1, 0 if the slot is empty; published last
+    uint32_t tile;
+    uint32_t size;              // Bytes of the tile in use
+} TileIndexEntry;
+
+typedef struct {
+    int fd;
+    unsigned char *base;        // Whole file, MAP_SHARED
+    size_t length;
+    TileStoreHeader *header;
+    TileIndexEntry *index;
+    unsigned char *tiles;
+    pthread_mutex_t writeLock;  // Serializes writers; readers take no lock
+} TileStore;
+
+// One cached image of a ShardedImageCache shard
+typedef struct {
+    uint64_t code;              // Morton code of key
+    Sector key;
+    Image value;
+    int hashNext;               // Next slot in the same bucket or the free list, -1 at the end
+    int used;
+    int inStore;                // value points into the tile store's mapping
+    atomic_uchar referenced;    // CLOCK reference bit, set by lookups under the read lock
+} CacheSlot;
+
+typedef struct {
+    pthread_rwlock_t lock;
+    CacheSlot *slots;
+    int *buckets;               // First slot of each bucket, -1 if empty
+    int capacity;               // Slots allocated; grows as needed
+    int bucketCount;            // Power of two
+    int count;
+    int freeHead;               // First unused slot, -1 if none
+    int hand;                   // CLOCK hand: next slot considered for eviction
+    size_t bytes;               // Image bytes cached in this shard
+    size_t budgetBytes;         // This shard's share of the byte budget
+    char pad[64];
+} CacheShard;
+
+// Sharded cache with CLOCK eviction (approximate LRU) under a byte budget,
+// optionally backed by a TileStore with asynchronous neighbour readahead
+typedef struct {
+    CacheShard shards[CACHE_SHARDS];
+    TileStore *store;
+    pthread_t readaheadThread;
+    pthread_mutex_t readaheadLock;
+    pthread_cond_t readaheadReady;
+    Sector readaheadQueue[READAHEAD_QUEUE_SIZE];
+    int readaheadHead;
+    int readaheadCount;
+    int readaheadStop;
+} ShardedImageCache;
+
+// Spread the 32 bits of v over the even bits of a 64-bit word
+static uint64_t spreadBits(uint32_t v) {
+    uint64_t x = v;
+    x = (x | (x << 16)) & 0x0000FFFF0000FFFFULL;
+    x = (x | (x << 8)) & 0x00FF00FF00FF00FFULL;
+    x = (x | (x << 4)) & 0x0F0F0F0F0F0F0F0FULL;
+    x = (x | (x << 2)) & 0x3333333333333333ULL;
+    x = (x | (x << 1)) & 0x5555555555555555ULL;
+    return x;
+}
+
+// Morton (Z-order) code of a sector: x on the even bits, y on the odd bits
+uint64_t mortonCode(Sector key) {
+    return spreadBits((uint32_t)key.x) | (spreadBits((uint32_t)key.y) << 1);
+}
+
+// Mix a Morton code so every bit affects the shard and bucket
+static uint64_t sectorHash(Sector key) {
+    uint64_t h = mortonCode(key);
+    h ^= h >> 33;
+    h *= 0xff51afd7ed558ccdULL;
+    h ^= h >> 33;
+    h *= 0xc4ceb9fe1a85ec53ULL;
+    h ^= h >> 33;
+    return h;
+}
+
 // Function prototypes
 DLinkedList* createNode(Sector key, Image value);
 void removeNode(LRUCache *cache, DLinkedList *node);
@@ -87,6 +227,7 @@ DLinkedList* createNode(Sector key, Image value) {
     node->key = key;
     node->value = value;
     node->prev = node->next = NULL;
+    node->hashNext = NULL;
     return node;
 }
 
@@ -107,7 +248,7 @@ void moveToTail(LRUCache *cache, DLinkedList *node) {
 // Retrieve an image from the LRU Cache
 Image* getImage(LRUCache *cache, Sector key) {
     pthread_mutex_lock(&cache->lock);
-    int index = key.x % MAX_CACHE_SIZE; // Hash row index
+    int index = sectorHash(key) % MAX_CACHE_SIZE; // Hash of both coordinates
     DLinkedList *node = rowHash.table[index];
     
     while (node) {
@@ -117,7 +258,7 @@ Image* getImage(LRUCache *cache, Sector key) {
             pthread_mutex_unlock(&cache->lock);
             return &node->value;
         }
-        node = node->next;
+        node = node->hashNext;
     }
     pthread_mutex_unlock(&cache->lock);
     return NULL;
@@ -127,7 +268,7 @@ Image* getImage(LRUCache *cache, Sector key) {
 void putImage(LRUCache *cache, Sector key, Image value) {
     pthread_mutex_lock(&cache->lock);
     
-    int index = key.x % MAX_CACHE_SIZE; // Hash row index
+    int index = sectorHash(key) % MAX_CACHE_SIZE; // Hash of both coordinates
     DLinkedList *node = rowHash.table[index];
     
     while (node) {
@@ -138,7 +279,7 @@ void putImage(LRUCache *cache, Sector key, Image value) {
             pthread_mutex_unlock(&cache->lock);
             return;
         }
-        node = node->next;
+        node = node->hashNext;
     }
     
     if (cache->count == cache->capacity) {
@@ -147,6 +288,7 @@ void putImage(LRUCache *cache, Sector key, Image value) {
     
     node = createNode(key, value);
     moveToTail(cache, node);
+    node->hashNext = rowHash.table[index];
     rowHash.table[index] = node;
     cache->count++;
     
@@ -157,12 +299,445 @@ void putImage(LRUCache *cache, Sector key, Image value) {
 void removeLRU(LRUCache *cache) {
     DLinkedList *lru = cache->head->next;
     removeNode(cache, lru);
-    int index = lru->key.x % MAX_CACHE_SIZE;
-    rowHash.table[index] = NULL;
+    int index = sectorHash(lru->key) % MAX_CACHE_SIZE;
+    DLinkedList **link = &rowHash.table[index];
+    while (*link != lru) {
+        link = &(*link)->hashNext;
+    }
+    *link = lru->hashNext; // Unlink only this node from its bucket
     free(lru);
     cache->count--;
 }
 
+/* ========== Tile Store ========== */
+
+static size_t tileStoreDataOffset(uint32_t indexSlots, size_t pageSize) {
+    size_t offset = sizeof(TileStoreHeader) + (size_t)indexSlots * sizeof(TileIndexEntry);
+    return (offset + pageSize - 1) / pageSize * pageSize;
+}
+
+// Open the tile store at path, creating it with tileCapacity tiles of at least
+// tileBytes each if it does not exist. An existing store keeps its own geometry,
+// which is checked against the file size before mapping it.
+// The file is sparse, so unused tiles take no disk space. Returns NULL on error.
+TileStore* openTileStore(const char *path, size_t tileBytes, uint32_t tileCapacity) {
+    size_t pageSize = (size_t)sysconf(_SC_PAGESIZE);
+    int fd = open(path, O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+    if (fd < 0) return NULL;
+    struct stat st;
+    TileStoreHeader header;
+    if (fstat(fd, &st) != 0) {
+        close(fd);
+        return NULL;
+    }
+    if (st.st_size == 0) {
+        memset(&header, 0, sizeof(header));
+        memcpy(header.magic, TILE_STORE_MAGIC, sizeof(header.magic));
+        header.tileBytes = (uint32_t)((tileBytes + pageSize - 1) / pageSize * pageSize);
+        header.tileCapacity = tileCapacity;
+        header.indexSlots = 1;
+        while (header.indexSlots < 2 * tileCapacity) header.indexSlots <<= 1;
+        size_t length = tileStoreDataOffset(header.indexSlots, pageSize) + (size_t)tileCapacity * header.tileBytes;
+        if (ftruncate(fd, (off_t)length) != 0 || pwrite(fd, &header, sizeof(header), 0) != (ssize_t)sizeof(header)) {
+            close(fd);
+            unlink(path);
+            return NULL;
+        }
+    } else if (pread(fd, &header, sizeof(header), 0) != (ssize_t)sizeof(header) ||
+               memcmp(header.magic, TILE_STORE_MAGIC, sizeof(header.magic)) != 0 ||
+               header.tileBytes == 0 || header.tileBytes % pageSize != 0 ||
+               header.indexSlots == 0 || (header.indexSlots & (header.indexSlots - 1)) != 0 ||
+               header.indexSlots < 2 * (uint64_t)header.tileCapacity ||
+               header.tileCount > header.tileCapacity) {
+        close(fd);
+        return NULL;
+    }
+
+    size_t dataOffset = tileStoreDataOffset(header.indexSlots, pageSize);
+    size_t length = dataOffset + (size_t)header.tileCapacity * header.tileBytes;
+    if (st.st_size != 0 && (uint64_t)st.st_size < length) {
+        close(fd);  // Truncated: tiles past the end of the file would fault with SIGBUS
+        return NULL;
+    }
+    TileStore *store = malloc(sizeof(TileStore));
+    void *base = store ? mmap(NULL, length, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0) : MAP_FAILED;
+    if (base == MAP_FAILED) {
+        free(store);
+        close(fd);
+        return NULL;
+    }
+    store->fd = fd;
+    store->base = base;
+    store->length = length;
+    store->header = base;
+    store->index = (TileIndexEntry*)(store->base + sizeof(TileStoreHeader));
+    store->tiles = store->base + dataOffset;
+    pthread_mutex_init(&store->writeLock, NULL);
+    // Lookups hit the index at random; tiles are read in runs of pages
+    madvise(store->base, dataOffset, MADV_RANDOM);
+    return store;
+}
+
+// Flush the mapping to disk and close the store
+void closeTileStore(TileStore *store) {
+    msync(store->base, store->length, MS_SYNC);
+    munmap(store->base, store->length);
+    close(store->fd);
+    pthread_mutex_destroy(&store->writeLock);
+    free(store);
+}
+
+// Index slot of the sector, or the empty slot where it belongs
+static TileIndexEntry* tileIndexProbe(const TileStore *store, uint64_t code, uint64_t hash) {
+    uint32_t mask = store->header->indexSlots - 1;
+    for (uint32_t i = (uint32_t)hash & mask;; i = (i + 1) & mask) {
+        TileIndexEntry *entry = &store->index[i];
+        uint64_t stored = __atomic_load_n(&entry->code, __ATOMIC_ACQUIRE);
+        if (stored == 0 || stored == code + 1) return entry;
+    }
+}
+
+// Look up a sector's tile without locking. The image points into the mapping, so a
+// tile not yet in memory is paged in on first access instead of being reloaded.
+int tileStoreGet(TileStore *store, Sector key, Image *out) {
+    uint64_t code = mortonCode(key);
+    TileIndexEntry *entry = tileIndexProbe(store, code, sectorHash(key));
+    if (__atomic_load_n(&entry->code, __ATOMIC_ACQUIRE) == 0) return 0;
+    out->data = (char*)(store->tiles + (size_t)entry->tile * store->header->tileBytes);
+    out->size = __atomic_load_n(&entry->size, __ATOMIC_ACQUIRE);
+    return 1;
+}
+
+// Write a sector's image into its tile, allocating one on first write. Returns 0 if
+// the image is larger than a tile or the store is full. Tiles are rewritten in place,
+// so a reader of the same sector during a rewrite may see a mix of both versions.
+int tileStorePut(TileStore *store, Sector key, const Image *value) {
+    if (value->size > store->header->tileBytes) return 0;
+    uint64_t code = mortonCode(key);
+    pthread_mutex_lock(&store->writeLock);
+    TileIndexEntry *entry = tileIndexProbe(store, code, sectorHash(key));
+    int isNew = entry->code == 0;
+    if (isNew) {
+        if (store->header->tileCount == store->header->tileCapacity) {
+            pthread_mutex_unlock(&store->writeLock);
+            return 0;
+        }
+        entry->tile = store->header->tileCount++;
+    }
+    memcpy(store->tiles + (size_t)entry->tile * store->header->tileBytes, value->data, value->size);
+    __atomic_store_n(&entry->size, (uint32_t)value->size, __ATOMIC_RELEASE);
+    if (isNew) {
+        // Publish the slot only once its tile and size are in place
+        __atomic_store_n(&entry->code, code + 1, __ATOMIC_RELEASE);
+    }
+    pthread_mutex_unlock(&store->writeLock);
+    return 1;
+}
+
+// Pages spanned by a tile image, rounded out to page boundaries
+static void tilePages(const TileStore *store, const Image *image, void **start, size_t *length) {
+    size_t pageSize = (size_t)sysconf(_SC_PAGESIZE);
+    uintptr_t begin = (uintptr_t)image->data & ~(uintptr_t)(pageSize - 1);
+    size_t bytes = image->size ? image->size : 1;
+    (void)store;
+    *start = (void*)begin;
+    *length = ((uintptr_t)image->data + bytes - begin + pageSize - 1) / pageSize * pageSize;
+}
+
+// Ask the kernel to start reading a sector's tile in the background
+static void tileStorePrefetch(TileStore *store, Sector key) {
+    Image image;
+    if (!tileStoreGet(store, key, &image)) return;
+    void *start;
+    size_t length;
+    tilePages(store, &image, &start, &length);
+    madvise(start, length, MADV_WILLNEED);
+}
+
+// Drop an evicted tile's pages from our mapping. The data stays in the file (and the
+// page cache); the next access faults it back in.
+static void tileStoreRelease(TileStore *store, const Image *image) {
+    void *start;
+    size_t length;
+    tilePages(store, image, &start, &length);
+    madvise(start, length, MADV_DONTNEED);
+}
+
+/* ========== Sharded Image Cache ========== */
+
+static CacheShard* shardOf(ShardedImageCache *cache, uint64_t hash) {
+    return &cache->shards[(hash >> 60) & (CACHE_SHARDS - 1)];
+}
+
+// Initialize a ShardedImageCache that holds up to budgetBytes of images. Returns 0 on OOM.
+int initShardedImageCache(ShardedImageCache *cache, size_t budgetBytes) {
+    memset(cache, 0, sizeof(*cache));
+    for (int s = 0; s < CACHE_SHARDS; s++) {
+        CacheShard *shard = &cache->shards[s];
+        shard->bucketCount = CACHE_SHARD_INITIAL_SLOTS;
+        shard->buckets = malloc(shard->bucketCount * sizeof(int));
+        if (!shard->buckets) {
+            for (int t = 0; t < s; t++) free(cache->shards[t].buckets);
+            return 0;
+        }
+        for (int b = 0; b < shard->bucketCount; b++) {
+            shard->buckets[b] = -1;
+        }
+        shard->freeHead = -1;
+        shard->budgetBytes = budgetBytes / CACHE_SHARDS;
+        pthread_rwlock_init(&shard->lock, NULL);
+    }
+    return 1;
+}
+
+static void* readaheadLoop(void *arg);
+
+// Back the cache with a tile store: puts write through to it, misses are served
+// from it, and a background thread reads ahead around every miss. Returns 0 on error.
+int attachTileStore(ShardedImageCache *cache, TileStore *store) {
+    cache->store = store;
+    pthread_mutex_init(&cache->readaheadLock, NULL);
+    pthread_cond_init(&cache->readaheadReady, NULL);
+    if (pthread_create(&cache->readaheadThread, NULL, readaheadLoop, cache) != 0) {
+        cache->store = NULL;
+        return 0;
+    }
+    return 1;
+}
+
+void destroyShardedImageCache(ShardedImageCache *cache) {
+    if (cache->store) {
+        pthread_mutex_lock(&cache->readaheadLock);
+        cache->readaheadStop = 1;
+        pthread_cond_signal(&cache->readaheadReady);
+        pthread_mutex_unlock(&cache->readaheadLock);
+        pthread_join(cache->readaheadThread, NULL);
+        pthread_mutex_destroy(&cache->readaheadLock);
+        pthread_cond_destroy(&cache->readaheadReady);
+    }
+    for (int s = 0; s < CACHE_SHARDS; s++) {
+        free(cache->shards[s].slots);
+        free(cache->shards[s].buckets);
+        pthread_rwlock_destroy(&cache->shards[s].lock);
+    }
+}
+
+// Slot holding the sector with this Morton code, or -1. The code is unique per
+// sector, so it is the only thing compared. Caller holds the shard lock (read or write).
+static int findSlot(const CacheShard *shard, uint64_t code, uint64_t hash) {
+    int i = shard->buckets[hash & (shard->bucketCount - 1)];
+    while (i >= 0 && shard->slots[i].code != code) {
+        i = shard->slots[i].hashNext;
+    }
+    return i;
+}
+
+// Evict one entry with CLOCK: give every referenced entry a second chance.
+// Terminates within two sweeps because each pass clears the bits it skips.
+// Caller holds the write lock and the shard is not empty.
+static void clockEvict(ShardedImageCache *cache, CacheShard *shard) {
+    for (;;) {
+        int i = shard->hand;
+        shard->hand = (shard->hand + 1) % shard->capacity;
+        CacheSlot *slot = &shard->slots[i];
+        if (!slot->used) continue;
+        if (atomic_load_explicit(&slot->referenced, memory_order_relaxed)) {
+            atomic_store_explicit(&slot->referenced, 0, memory_order_relaxed);
+            continue;
+        }
+        // Unlink the victim from its bucket
+        int *link = &shard->buckets[sectorHash(slot->key) & (shard->bucketCount - 1)];
+        while (*link != i) {
+            link = &shard->slots[*link].hashNext;
+        }
+        *link = slot->hashNext;
+        // Images in the store are already written back; just give their memory back
+        if (slot->inStore) {
+            tileStoreRelease(cache->store, &slot->value);
+        }
+        slot->used = 0;
+        slot->hashNext = shard->freeHead;
+        shard->freeHead = i;
+        shard->bytes -= slot->value.size;
+        shard->count--;
+        return;
+    }
+}
+
+// A free slot, growing the slot array and rehashing the buckets as needed.
+// Caller holds the write lock. Returns -1 on OOM.
+static int allocSlot(CacheShard *shard) {
+    if (shard->freeHead < 0) {
+        int capacity = shard->capacity ? shard->capacity * 2 : CACHE_SHARD_INITIAL_SLOTS;
+        CacheSlot *slots = realloc(shard->slots, capacity * sizeof(CacheSlot));
+        if (!slots) return -1;
+        for (int i = capacity - 1; i >= shard->capacity; i--) {
+            slots[i].used = 0;
+            slots[i].hashNext = shard->freeHead;
+            shard->freeHead = i;
+        }
+        shard->slots = slots;
+        shard->capacity = capacity;
+    }
+    if (shard->count + 1 > shard->bucketCount) {
+        int bucketCount = shard->bucketCount * 2;
+        int *buckets = malloc(bucketCount * sizeof(int));
+        if (buckets) {
+            for (int b = 0; b < bucketCount; b++) {
+                buckets[b] = -1;
+            }
+            for (int i = 0; i < shard->capacity; i++) {
+                if (!shard->slots[i].used) continue;
+                int *bucket = &buckets[sectorHash(shard->slots[i].key) & (bucketCount - 1)];
+                shard->slots[i].hashNext = *bucket;
+                *bucket = i;
+            }
+            free(shard->buckets);
+            shard->buckets = buckets;
+            shard->bucketCount = bucketCount;
+        }
+    }
+    int i = shard->freeHead;
+    shard->freeHead = shard->slots[i].hashNext;
+    return i;
+}
+
+// Insert or update a cached image, evicting until it fits the shard's budget.
+// Images larger than the whole budget are not cached. Caller holds the write lock.
+static void cacheInsert(ShardedImageCache *cache, CacheShard *shard, Sector key, uint64_t code,
+                        uint64_t hash, Image value, int inStore) {
+    int i = findSlot(shard, code, hash);
+    if (i >= 0) {
+        shard->bytes = shard->bytes - shard->slots[i].value.size + value.size;
+        shard->slots[i].value = value;
+        shard->slots[i].inStore = inStore;
+        atomic_store_explicit(&shard->slots[i].referenced, 1, memory_order_relaxed);
+        while (shard->bytes > shard->budgetBytes && shard->count > 1) {
+            clockEvict(cache, shard);  // The updated entry is referenced, so it is spared first
+        }
+        return;
+    }
+    if (value.size > shard->budgetBytes) return;
+    while (shard->count > 0 && shard->bytes + value.size > shard->budgetBytes) {
+        clockEvict(cache, shard);
+    }
+    i = allocSlot(shard);
+    if (i < 0) return;
+    CacheSlot *slot = &shard->slots[i];
+    slot->code = code;
+    slot->key = key;
+    slot->value = value;
+    slot->used = 1;
+    slot->inStore = inStore;
+    atomic_store_explicit(&slot->referenced, 0, memory_order_relaxed);
+    int *bucket = &shard->buckets[hash & (shard->bucketCount - 1)];
+    slot->hashNext = *bucket;
+    *bucket = i;
+    shard->bytes += value.size;
+    shard->count++;
+}
+
+// Look a sector up in the cache only, marking it recently used
+static int cacheLookup(ShardedImageCache *cache, Sector key, Image *out) {
+    uint64_t code = mortonCode(key);
+    uint64_t hash = sectorHash(key);
+    CacheShard *shard = shardOf(cache, hash);
+    pthread_rwlock_rdlock(&shard->lock);
+    int i = findSlot(shard, code, hash);
+    if (i >= 0) {
+        if (out) *out = shard->slots[i].value;
+        // Skip the store when already set, so hot entries do not bounce their cache line
+        if (!atomic_load_explicit(&shard->slots[i].referenced, memory_order_relaxed)) {
+            atomic_store_explicit(&shard->slots[i].referenced, 1, memory_order_relaxed);
+        }
+    }
+    pthread_rwlock_unlock(&shard->lock);
+    return i >= 0;
+}
+
+// Check whether a sector is cached without marking it used, so probes such as
+// readahead do not keep it from being evicted
+static int cacheContains(ShardedImageCache *cache, Sector key) {
+    uint64_t hash = sectorHash(key);
+    CacheShard *shard = shardOf(cache, hash);
+    pthread_rwlock_rdlock(&shard->lock);
+    int found = findSlot(shard, mortonCode(key), hash) >= 0;
+    pthread_rwlock_unlock(&shard->lock);
+    return found;
+}
+
+// Queue the 8 neighbours of a sector for readahead; dropped if the queue is full
+static void requestReadahead(ShardedImageCache *cache, Sector center) {
+    pthread_mutex_lock(&cache->readaheadLock);
+    for (int dx = -1; dx <= 1; dx++) {
+        for (int dy = -1; dy <= 1; dy++) {
+            if ((dx == 0 && dy == 0) || cache->readaheadCount == READAHEAD_QUEUE_SIZE) continue;
+            Sector neighbour = { center.x + dx, center.y + dy };
+            cache->readaheadQueue[(cache->readaheadHead + cache->readaheadCount++) % READAHEAD_QUEUE_SIZE] = neighbour;
+        }
+    }
+    pthread_cond_signal(&cache->readaheadReady);
+    pthread_mutex_unlock(&cache->readaheadLock);
+}
+
+// Readahead thread: have the kernel start reading neighbouring tiles that are not
+// cached yet, so a viewer panning into them does not wait on the disk
+static void* readaheadLoop(void *arg) {
+    ShardedImageCache *cache = arg;
+    pthread_mutex_lock(&cache->readaheadLock);
+    while (!cache->readaheadStop) {
+        if (cache->readaheadCount == 0) {
+            pthread_cond_wait(&cache->readaheadReady, &cache->readaheadLock);
+            continue;
+        }
+        Sector sector = cache->readaheadQueue[cache->readaheadHead];
+        cache->readaheadHead = (cache->readaheadHead + 1) % READAHEAD_QUEUE_SIZE;
+        cache->readaheadCount--;
+        pthread_mutex_unlock(&cache->readaheadLock);
+        if (!cacheContains(cache, sector)) {
+            tileStorePrefetch(cache->store, sector);
+        }
+        pthread_mutex_lock(&cache->readaheadLock);
+    }
+    pthread_mutex_unlock(&cache->readaheadLock);
+    return NULL;
+}
+
+// Retrieve an image: copies it to *out and returns 1, or returns 0 if not found.
+// Hits take only the shard's read lock. With a tile store, a miss is served from
+// the mapped store, cached, and starts readahead of the neighbouring sectors.
+int shardedGetImage(ShardedImageCache *cache, Sector key, Image *out) {
+    if (cacheLookup(cache, key, out)) return 1;
+    if (!cache->store || !tileStoreGet(cache->store, key, out)) return 0;
+
+    uint64_t code = mortonCode(key);
+    uint64_t hash = sectorHash(key);
+    CacheShard *shard = shardOf(cache, hash);
+    pthread_rwlock_wrlock(&shard->lock);
+    if (findSlot(shard, code, hash) < 0) {
+        cacheInsert(cache, shard, key, code, hash, *out, 1);
+    }
+    pthread_rwlock_unlock(&shard->lock);
+    requestReadahead(cache, key);
+    return 1;
+}
+
+// Store an image. With a tile store it is written through to its tile first, so an
+// evicted image is never lost; without one the caller keeps owning its data.
+void shardedPutImage(ShardedImageCache *cache, Sector key, Image value) {
+    uint64_t code = mortonCode(key);
+    uint64_t hash = sectorHash(key);
+    int inStore = 0;
+    if (cache->store && tileStorePut(cache->store, key, &value)) {
+        tileStoreGet(cache->store, key, &value);
+        inStore = 1;
+    }
+    CacheShard *shard = shardOf(cache, hash);
+    pthread_rwlock_wrlock(&shard->lock);
+    cacheInsert(cache, shard, key, code, hash, value, inStore);
+    pthread_rwlock_unlock(&shard->lock);
+}
+
 // Main function to test the Space Panorama system
 int main() {
     LRUCache cache;
@@ -183,6 +758,43 @@ int main() {
         printf("Image not found!\n");
     }
     
+    // Sharded cache backed by a tile store: ingest a region, then pan across it. The
+    // budget holds only a few images per shard, so ingesting evicts written-through
+    // tiles and the pan is served mostly by misses read back from the store.
+    static ShardedImageCache sharded;
+    const char *storePath = "space_panorama.tiles";
+    unlink(storePath);
+    TileStore *store = openTileStore(storePath, TILE_BYTES, TILE_CAPACITY);
+    if (!store || !initShardedImageCache(&sharded, DEMO_BYTE_BUDGET) || !attachTileStore(&sharded, store)) {
+        printf("Failed to open the tile store!\n");
+        return 1;
+    }
+    char tile[64];
+    for (int x = 0; x < 32; x++) {
+        for (int y = 0; y < 32; y++) {
+            int length = snprintf(tile, sizeof(tile), "Sector(%d,%d)", x, y);
+            Sector sector = {x, y};
+            Image img = {tile, (size_t)length + 1};
+            shardedPutImage(&sharded, sector, img);
+        }
+    }
+    int found = 0, misses = 0;
+    for (int x = 0; x < 32; x++) {
+        Image img;
+        Sector sector = {x, x};
+        misses += !cacheContains(&sharded, sector);
+        found += shardedGetImage(&sharded, sector, &img);
+    }
+    Image img;
+    Sector first = {0, 0};
+    if (shardedGetImage(&sharded, first, &img)) {
+        printf("Tile store: %d of 32 sectors on the diagonal found (%d from the store), first is %s\n",
+               found, misses, img.data);
+    }
+    destroyShardedImageCache(&sharded);
+    closeTileStore(store);
+    unlink(storePath);
+    
     return 0;
 }
 
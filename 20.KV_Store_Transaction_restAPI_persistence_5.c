@@ -1,3 +1,4 @@
+#define _GNU_SOURCE      // For memmem(), MSG_MORE and fdatasync()
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -8,6 +9,18 @@
 #include <netinet/in.h>  // For sockaddr_in, INADDR_LOOPBACK
 #include <sys/socket.h>  // For socket functions
 #include <time.h>
+#include <stdarg.h>
+#include <stdint.h>
+#include <errno.h>
+#include <fcntl.h>       // For open() flags used by the write-ahead log
+#include <poll.h>
+#include <netinet/tcp.h> // For TCP_NODELAY on follower connections
+#include <sys/eventfd.h>
+#include <stdatomic.h>   // Lock-free snapshot reads of shard tables and version chains
+#include <sched.h>
+#include <stddef.h>      // For offsetof()
+#include <dirent.h>      // For removing orphaned sorted tables at startup
+#include <sys/stat.h>
 
 /* 
  * Importnat lookout where you run this code 
@@ -38,15 +51,39 @@
    - Added logging to confirm successful loading.
 
    Additional Enhancements
-   - Data Persistence: Saves and loads key-value pairs from disk (kv_store.txt).
-   - Thread Safety: Uses mutex locks for concurrency.
+   - Data Persistence: Every SET/DELETE is appended to a checksummed binary write-ahead
+     log (kv_store.wal); one writer thread batches concurrent writers into a single
+     fdatasync per group-commit window. A background flush rotates the log, so startup
+     opens the sorted tables and replays only the log tail.
+   - Storage Engine: LSM-style tiers. The MVCC shard tables are the memtable; flushes
+     write immutable sorted tables (kv_store-<id>.sst) with a bloom filter and block
+     index kept in memory, flushed keys leave RAM, and a background compaction merges
+     similar-sized tables. A point read that misses memory costs about one block read.
+   - Thread Safety: Writers lock their shard; readers pin an MVCC snapshot and never lock
+     (get, /mget, snapshots and scan_keys() never block writers). A GC thread frees
+     versions no pinned snapshot can see.
+   - Replication: Each follower (--follower=host:port) gets a persistent connection and a
+     bounded send queue; mutations are batched into WAL-framed POST /replicate requests
+     that are pipelined without waiting per ack. --acks=async|quorum|all picks when a
+     client write returns. A follower that falls a whole queue behind is resynced
+     from a copy of the store (POST /resync/begin, /replicate frames, /resync/end).
+   - HTTP front end: --http-mode=threads (thread per connection, default) or
+     --http-mode=epoll with --http-threads=N epoll workers for many keep-alive clients
+     (async acks only).
+     Fixed-body responses are preallocated and shared instead of copied per request.
    - Sharding for Scalability: Distributes keys across multiple shards.
    - Scalable Architecture: Supports sharding for horizontal scaling.
-   - Transaction Support: Allows atomic operations (start, commit, rollback).
+   - Transaction Support: start_transaction()/txn_get()/txn_set()/txn_delete() buffer work
+     against a snapshot; commit_transaction() validates and applies it under one commit
+     timestamp (KV_ERR_CONFLICT on a lost race); rollback_transaction() drops it.
    - Full REST API Support:
      - GET /get/key → Retrieve a value
      - POST /set/key/value → Store a value
      - DELETE /delete/key → Remove a key
+     - POST /mget, POST /mset → Many keys per request. /mget reads one snapshot; /mset
+       commits as a single transaction.
+       JSON bodies ({"keys": [...]} / {"k": "v", ...}), or length-prefixed binary bodies
+       with Content-Type: application/octet-stream (see parse_batch_request()).
 
    Start the HTTP for local host
    
@@ -92,208 +129,2880 @@
 
    In-Memory Key-Value Store with Transaction Support
    
-   - Uses a hash table with fixed-size storage (MAX_KEYS) for efficiency.
+   - Each shard is an open-addressing (linear probing) hash table that grows on its own
+     past a 70% load factor; entries cache their 64-bit hash and deletes leave tombstones.
+   - SHARD_COUNT shards are selected from the high hash bits, slots from the low bits.
    - Allows setting, retrieving, and deleting keys within transactions.
 
    Transactional Consistency
 
    - Supports ACID-like transactions with:
-   - start_transaction() → Begins a new transaction.
-   - commit_transaction() → Applies changes.
+   - start_transaction() → Begins a new transaction on the latest snapshot.
+   - commit_transaction() → Applies changes atomically, or fails if a key it read
+     or wrote changed since the snapshot.
    - rollback_transaction() → Discards changes.
+   - Multi-key commits are logged as one WAL group that recovery applies all-or-nothing.
 
    Multi-threading Support
 
-   - Uses pthread_mutex_t locks to ensure thread safety.
+   - Uses pthread_mutex_t locks to serialize writers per shard; reads are lock-free.
    - Allows multiple clients to access the KV store concurrently.
 
    Space-Efficient Storage
 
-   - Uses fixed-size buffers (char[]) instead of dynamic allocation to minimize memory overhead.
+   - Values are immutable, reference-counted buffers sized to the value (up to
+     MAX_VALUE_LENGTH) that also hold the rendered GET body, so a GET sends the stored
+     bytes without copying and readers, batches and follower queues share one copy.
   
    Now, the KV store supports transactions and can be used in high-performance applications!
    
    Next step:
    Add dditional features like persistence to disk or replication for distributed systems?
 */   
-#define MAX_KEYS 100
 #define MAX_KEY_LENGTH 50
-#define MAX_VALUE_LENGTH 100
-#define PERSISTENCE_FILE "kv_store.txt"
+#define MAX_VALUE_LENGTH (32 * 1024)  // Longest value accepted; storage is sized per value
+#define PERSISTENCE_FILE "kv_store.txt"      // Legacy text dump, imported once if no snapshot exists
+#define SNAPSHOT_FILE "kv_store.snap"        // Legacy binary snapshot, imported once if no manifest exists
+#define MANIFEST_FILE "kv_store.manifest"    // Live sorted tables and the WAL LSN they cover
+#define SST_FILE_PREFIX "kv_store-"          // Sorted tables are kv_store-<id>.sst
+#define WAL_FILE "kv_store.wal"              // Active write-ahead log
+#define WAL_ROTATED_FILE "kv_store.wal.1"    // Log segment being covered by an in-progress snapshot
 #define LOG_FILE "kv_store.log"
-#define SHARD_COUNT 3
+#define SHARD_COUNT 64               // Power of two; selected from the high hash bits
+#define SHARD_INITIAL_CAPACITY 64    // Slots per shard before the first resize (power of two)
+#define SHARD_MAX_LOAD_PERCENT 70    // Grow (or rehash) once active + tombstone slots pass this
+#define WAL_GROUP_COMMIT_US 500      // How long the WAL writer waits to gather a batch before fdatasync
+#define WAL_MAX_RECORD (64 * 1024)   // Sanity bound used when replaying a possibly torn log
+                                     // (must hold a key plus MAX_VALUE_LENGTH)
+#define SNAPSHOT_INTERVAL 10         // Seconds between flushes while writes trickle in
+#define MEMTABLE_FLUSH_BYTES (64 * 1024 * 1024) // Unflushed writes that trigger an early flush
+#define LSM_POLL_MS 100              // How often the background thread checks the memtable size
+#define SST_BLOCK_SIZE 4096          // Target data block size; a point lookup reads one block
+#define SST_BLOOM_BITS_PER_KEY 10    // About 1% false positives with SST_BLOOM_PROBES
+#define SST_BLOOM_PROBES 7
+#define SST_MERGE_MIN 4              // Tables a size-tiered merge needs at least
+#define SST_SIZE_RATIO 2             // A table joins a merge run if at most this times the run so far
+#define SST_MAX_TABLES 32            // Force merges past this many tables to bound read fan-out
 #define PORT 8080
 #define API_KEY "secure123"  // Simple API key for authentication
-#define REPLICA_SERVER "http://127.0.0.1:8081/set/" // Example replica server
+#define MAX_FOLLOWERS 8
+#define REPL_QUEUE_CAPACITY 4096     // Unacknowledged mutations buffered per follower (power of two)
+#define REPL_BATCH_MAX 256           // Mutations packed into one replication frame
+#define REPL_MAX_IN_FLIGHT 8         // Frames on the wire before waiting for the oldest ack
+#define REPL_ACK_TIMEOUT_MS 2000     // How long quorum/all writes wait for follower acks
+#define REPL_RECONNECT_MS 1000
+#define MAX_REQUEST_BODY (1024 * 1024)
+#define REPL_FRAME_MAX_BYTES (MAX_REQUEST_BODY - WAL_MAX_RECORD) // A frame always fits a follower's body limit
+#define RESPONSE_BUFFER_SIZE 1024
+#define MAX_BATCH_KEYS 1024          // Keys accepted by one /mget or /mset request
+#define BINARY_CONTENT_TYPE "application/octet-stream"
+#define HTTP_CONNECTION_TIMEOUT 30   // Seconds an idle keep-alive connection is kept open
+#define HTTP_CONNECTION_LIMIT 10000  // Concurrent connections accepted in epoll mode
+#define READER_BLOCK_SLOTS 4096      // Reader slots per block; another block is added when all are taken
+#define GC_INTERVAL_MS 100           // How often superseded versions are reclaimed
+
+// Slot states for the open-addressing table
+enum { SLOT_EMPTY = 0, SLOT_ACTIVE, SLOT_TOMBSTONE };
+
+// WAL record operations. Writes of a multi-key transaction carry WAL_TXN_FLAG
+// and are only applied on recovery once the closing WAL_OP_TXN_COMMIT is read.
+enum { WAL_OP_SET = 1, WAL_OP_DELETE = 2, WAL_OP_TXN_COMMIT = 3 };
+#define WAL_TXN_FLAG 0x80
+
+// Result codes for set_key / delete_key / commit_transaction, and KV_ERR_READ
+// for reads that hit an unreadable or corrupt sorted table
+enum { KV_OK = 0, KV_ERR_PERSIST = -1, KV_ERR_REPLICATION = -2, KV_ERR_CONFLICT = -3, KV_ERR_READ = -4 };
+
+// Reader slot values besides a pinned snapshot timestamp
+#define READER_FREE 0
+#define READER_IDLE UINT64_MAX
+
+// How the HTTP front end maps connections to threads
+typedef enum { HTTP_MODE_THREAD_PER_CONNECTION = 0, HTTP_MODE_EPOLL } HttpMode;
+
+// When a client write is acknowledged relative to the followers
+typedef enum { ACKS_ASYNC = 0, ACKS_QUORUM, ACKS_ALL } ReplAckMode;
+
+/*
+ * Multi-version storage.
+ *
+ * Every committed write prepends a KVVersion stamped with a commit timestamp
+ * from commit_clock; visible_ts is the highest timestamp whose writes (and all
+ * earlier ones) are installed. A reader pins visible_ts in a ReaderSlot and
+ * walks each chain to the newest version at or below it, without any lock.
+ * Writers still serialize per shard on the shard mutex.
+ *
+ * Memory is reclaimed by the GC thread: versions older than the newest one
+ * visible to every pinned reader are freed, and objects readers may still be
+ * looking at (replaced tables, a key's last tombstone) are retired with the
+ * visible_ts at unlink time and freed once every pinned reader is newer.
+ * Keys flushed to a sorted table are evicted the same way (see Sorted Tables);
+ * a key with no version in memory at a snapshot is looked up in the tables.
+ * A slot's key never changes while its table is live, so probes need no lock.
+ */
+
+/*
+ * Immutable, reference-counted value. data[] starts with the rendered GET body
+ * {"key": "value"}, so a GET hands it to libmicrohttpd without a copy or a
+ * format pass. The raw value is the quoted part of the body, or is stored
+ * after it when JSON escaping changed it. Versions, transactions, batches and
+ * follower queues each hold their own reference.
+ */
+typedef struct {
+    _Atomic uint32_t refs;
+    uint32_t len;                      // Raw value bytes
+    uint32_t value_off;                // Raw value is data[value_off .. value_off + len)
+    uint32_t body_len;                 // GET body is data[0 .. body_len)
+    char data[];
+} KVValue;
+
+typedef struct KVVersion {
+    uint64_t commit_ts;
+    KVValue *value;                    // NULL marks a delete: the key reads as absent
+    struct KVVersion *_Atomic older;   // Next older version; trimmed by the GC
+} KVVersion;
 
 // Structure for key-value entry
 typedef struct {
+    uint64_t hash;                 // Cached full hash: cheap reject before strcmp, no rehash on resize
+    _Atomic int state;             // SLOT_EMPTY / SLOT_ACTIVE / SLOT_TOMBSTONE
     char key[MAX_KEY_LENGTH];
-    char value[MAX_VALUE_LENGTH];
-    int is_active;
+    KVVersion *_Atomic head;       // Newest version first
 } KVEntry;
 
-// Sharded Key-Value Store
-typedef struct {
-    KVEntry store[MAX_KEYS];
-    pthread_mutex_t lock;
-} KVShard;
+typedef struct {
+    size_t capacity;               // Power of two
+    KVEntry slots[];
+} KVTable;
+
+// Sharded Key-Value Store: each shard is a growable linear-probing hash table
+typedef struct {
+    KVTable *_Atomic table;        // Swapped on resize; the old one is retired
+    size_t count;                  // SLOT_ACTIVE entries
+    size_t tombstones;             // SLOT_TOMBSTONE entries (only reclaimed by a rehash)
+    pthread_mutex_t lock;
+} KVShard;
+
+// A pinned snapshot, padded so readers on different cores do not share a line
+typedef struct {
+    _Atomic uint64_t read_ts;      // READER_FREE, READER_IDLE, or the pinned timestamp
+    char pad[56];
+} ReaderSlot;
+
+// Reader slots come in blocks linked into a list that only grows, so any number
+// of threads and open transactions can pin a snapshot
+typedef struct ReaderBlock {
+    ReaderSlot slots[READER_BLOCK_SLOTS];
+    struct ReaderBlock *_Atomic next;
+} ReaderBlock;
+
+// Memory that lock-free readers may still reference, freed by the GC
+typedef struct Retired {
+    struct Retired *next;
+    uint64_t stamp;                // visible_ts when it was unlinked
+    void *ptr;
+    void (*destroy)(void *);       // free(), or a destructor for objects owning more
+} Retired;
+
+// One data block of a sorted table, as described by its in-memory block index
+typedef struct {
+    char first_key[MAX_KEY_LENGTH];
+    uint64_t offset;
+    uint32_t len;
+    uint32_t crc;
+} SstBlock;
+
+// An open, immutable sorted table. Only its data blocks stay on disk.
+typedef struct {
+    uint64_t id;
+    int fd;
+    uint64_t data_size;            // Bytes of data blocks, used to pick merges
+    uint64_t max_ts;               // Newest commit timestamp it stores
+    SstBlock *blocks;              // Sorted by first_key
+    size_t block_count;
+    uint8_t *bloom;
+    uint32_t bloom_bits;
+} SSTable;
+
+// The live tables, newest first. Replaced as a whole and retired like a KVTable.
+typedef struct {
+    size_t count;
+    SSTable *tables[];
+} SstList;
+
+// One buffered operation of a transaction (op 0 records a read for validation)
+typedef struct {
+    char key[MAX_KEY_LENGTH];
+    KVValue *value;                // WAL_OP_SET only
+    uint64_t hash;
+    uint8_t op;
+} TxnOp;
+
+// Optimistic transaction: reads come from the snapshot pinned at start,
+// writes are buffered and validated against newer commits at commit time
+typedef struct {
+    ReaderSlot *reader;
+    uint64_t read_ts;
+    TxnOp *ops;
+    size_t count;
+    size_t cap;
+} Transaction;
+
+/*
+ * Write-ahead log with group commit.
+ *
+ * On-disk record (host byte order):
+ *   u32 payload_len | u32 crc32(payload) | payload
+ *   payload = u64 lsn | u8 op | u16 key_len | u32 value_len | key | value
+ *
+ * Writers append into `pending` while holding their shard lock (so LSN order
+ * matches apply order per key), then wait outside the shard lock until the
+ * writer thread has made their LSN durable. The writer thread swaps buffers,
+ * issues one write() + fdatasync() for everyone in the window, and wakes them.
+ */
+typedef struct {
+    char *data;
+    size_t len;
+    size_t cap;
+} WalBuffer;
+
+typedef struct {
+    int fd;
+    uint64_t next_lsn;             // LSN handed to the next appended record
+    uint64_t durable_lsn;          // Highest LSN known to be on stable storage
+    WalBuffer pending;             // Records appended since the last flush
+    WalBuffer flushing;            // Buffer owned by the writer thread during I/O
+    uint64_t pending_last_lsn;
+    int io_error;                  // Sticky: set once a write/fdatasync fails
+    int stopping;
+    pthread_mutex_t lock;
+    pthread_cond_t has_work;       // pending became non-empty, or stopping
+    pthread_cond_t durable;        // durable_lsn advanced
+    pthread_t writer;
+} WriteAheadLog;
+
+// Callback used when decoding framed records (recovery, snapshots, replication)
+typedef void (*WalApplyFn)(void *ctx, uint8_t op, const char *key, const char *value, uint32_t value_len);
+
+/*
+ * Replication to followers.
+ *
+ * Each follower has a persistent TCP connection and one I/O thread. Writers
+ * push mutations into the follower's bounded ring (under their shard lock, so
+ * per-key order is preserved) and never touch the socket. The I/O thread packs
+ * up to REPL_BATCH_MAX queued mutations into one WAL-framed body, sends it as
+ * a pipelined "POST /replicate" keep-alive request, and keeps up to
+ * REPL_MAX_IN_FLIGHT frames outstanding. Responses arrive in order, so each
+ * ack advances acked_seq to the end of the oldest in-flight frame. After a
+ * reconnect everything not yet acked is resent; replaying SET/DELETE is idempotent.
+ *
+ * A follower whose queue overflows is marked diverged and its queue is no
+ * longer filled. The I/O thread then resyncs it (follower_resync()): the queue
+ * restarts at its head, the current store is copied between POST /resync/begin
+ * and /resync/end, on which the follower deletes every key the copy did not
+ * write, and the queue resumes behind the copy.
+ */
+typedef struct {
+    uint64_t lsn;
+    uint8_t op;
+    char key[MAX_KEY_LENGTH];
+    KVValue *value;                // Reference dropped once the follower acks it
+} ReplItem;
+
+typedef struct {
+    char host[64];
+    int port;
+    int fd;                        // -1 while disconnected
+    int wake_fd;                   // eventfd: new work or shutdown
+    ReplItem *queue;               // Ring indexed by seq & (REPL_QUEUE_CAPACITY - 1)
+    uint64_t head_seq;             // Next position to fill
+    uint64_t send_seq;             // Next position to put on the wire
+    uint64_t acked_seq;            // Positions below this are acknowledged (also read under repl_ack_lock)
+    uint64_t resync_seq;           // Positions below this are covered by the last resync copy
+    uint64_t frame_end[REPL_MAX_IN_FLIGHT]; // FIFO of in-flight frames (end positions)
+    int frame_head;
+    int frame_count;
+    int idle;                      // I/O thread is parked in poll() and needs a wakeup
+    int diverged;                  // Queue overflowed; the I/O thread resyncs the follower from a copy
+    pthread_mutex_t lock;
+    pthread_t thread;
+} Follower;
+
+// One key of a /mget or /mset batch
+typedef struct {
+    char key[MAX_KEY_LENGTH];
+    KVValue *value;                // /mset input, /mget result (NULL = missing)
+} BatchItem;
+
+// Queue positions of one write on every follower, used to wait for its acks
+typedef struct {
+    uint64_t seq[MAX_FOLLOWERS];   // Position + 1 on follower i, 0 if not queued
+} ReplTicket;
+
+KVShard kv_shards[SHARD_COUNT]; 
+WriteAheadLog wal;
+FILE *audit_log = NULL;
+pthread_t persistence_thread;
+pthread_t gc_thread;
+volatile int running = 1; 
+
+_Atomic uint64_t commit_clock = 1;     // Last commit timestamp handed out
+_Atomic uint64_t visible_ts = 1;       // Every commit at or below this is installed
+ReaderBlock reader_slots;
+Retired *retired_list = NULL;
+pthread_mutex_t retired_lock = PTHREAD_MUTEX_INITIALIZER;
+
+SstList *_Atomic sst_list = NULL;      // Only the persistence thread replaces it
+uint64_t next_sst_id = 1;
+uint64_t manifest_lsn = 0;             // WAL records up to this LSN are in the tables
+_Atomic uint64_t flushed_ts = 0;       // Every version at or below this is in a table
+_Atomic int lsm_flushing = 0;          // A flush is between its scan and publishing its table
+_Atomic uint64_t memtable_unflushed = 0; // Bytes written since the last flush began
+
+Follower followers[MAX_FOLLOWERS];
+int follower_count = 0;
+ReplAckMode repl_ack_mode = ACKS_ASYNC;
+volatile int repl_stopping = 0;
+pthread_mutex_t repl_ack_lock = PTHREAD_MUTEX_INITIALIZER;
+pthread_cond_t repl_ack_cond = PTHREAD_COND_INITIALIZER;
+_Atomic uint64_t resync_begin_ts = 0;  // Follower: commit_clock when the leader's resync began, 0 if none
+int server_port = PORT;
+HttpMode http_mode = HTTP_MODE_THREAD_PER_CONNECTION;
+int http_threads = 0;              // epoll worker threads; 0 = one per online CPU
+
+// Function prototypes
+void persist_to_disk();
+void load_from_disk();
+void log_operation(const char *operation, const char *key);
+void* background_persistence(void *arg);
+void init_kv_store();
+void shutdown_kv_store();
+KVValue *kv_value_new(const char *key, const char *value, size_t len);
+void kv_value_release(KVValue *value);
+int set_key(const char *key, const char *value);
+int get_key(const char *key, KVValue **value);
+int delete_key(const char *key);
+Transaction *start_transaction(void);
+int txn_get(Transaction *txn, const char *key, KVValue **value);
+int txn_set(Transaction *txn, const char *key, const char *value);
+int txn_delete(Transaction *txn, const char *key);
+int commit_transaction(Transaction *txn);
+void rollback_transaction(Transaction *txn);
+int scan_keys(int (*visit)(void *ctx, const char *key, const KVValue *value), void *ctx);
+int multi_get(BatchItem *items, size_t count);
+int multi_set(BatchItem *items, size_t count);
+void batch_release(BatchItem *items, size_t count);
+uint64_t hash_string(const char *key);
+int get_shard_index(const char *key);
+int add_follower(const char *host_port);
+void init_replication();
+void shutdown_replication();
+void replicate_to_followers(uint64_t lsn, uint8_t op, const char *key, KVValue *value, ReplTicket *ticket);
+int wait_for_replication(const ReplTicket *ticket);
+int apply_replication_frame(const char *body, size_t len);
+void begin_resync(void);
+int finish_resync(void);
+int authenticate_request(struct MHD_Connection *connection);
+int http_handler(void *cls, struct MHD_Connection *connection, const char *url,
+                 const char *method, const char *version, const char *upload_data,
+                 size_t *upload_data_size, void **ptr);
+void start_server();
+
+/* ========== Utility Functions ========== */
+
+// 64-bit string hash: FNV-1a over the bytes followed by the murmur3 fmix64
+// finalizer so every input bit affects both the high (shard) and low (slot) bits
+uint64_t hash_string(const char *key) {
+    uint64_t h = 1469598103934665603ULL;
+    for (const unsigned char *p = (const unsigned char *)key; *p; p++) {
+        h ^= *p;
+        h *= 1099511628211ULL;
+    }
+    h ^= h >> 33;
+    h *= 0xff51afd7ed558ccdULL;
+    h ^= h >> 33;
+    h *= 0xc4ceb9fe1a85ec53ULL;
+    h ^= h >> 33;
+    return h;
+}
+
+// Shard selection uses the top bits; slot selection inside a shard uses the low bits
+static int shard_of_hash(uint64_t hash) {
+    return (int)(hash >> 58) & (SHARD_COUNT - 1);
+}
+
+// Hash function to determine which shard a key belongs to
+int get_shard_index(const char *key) {
+    return shard_of_hash(hash_string(key));
+}
+
+// CRC-32 (IEEE, reflected) used to detect torn or corrupt WAL records
+static uint32_t crc32_table[256];
+static pthread_once_t crc32_once = PTHREAD_ONCE_INIT;
+
+static void crc32_init_table(void) {
+    for (uint32_t i = 0; i < 256; i++) {
+        uint32_t c = i;
+        for (int k = 0; k < 8; k++) c = (c & 1) ? 0xEDB88320u ^ (c >> 1) : c >> 1;
+        crc32_table[i] = c;
+    }
+}
+
+static uint32_t crc32_compute(const void *data, size_t len) {
+    pthread_once(&crc32_once, crc32_init_table);
+    const unsigned char *p = data;
+    uint32_t c = 0xFFFFFFFFu;
+    while (len--) c = crc32_table[(c ^ *p++) & 0xFF] ^ (c >> 8);
+    return c ^ 0xFFFFFFFFu;
+}
+
+// Log operation for auditing. The file stays open; the background thread
+// flushes it, so the request path never pays for fopen/fclose.
+void log_operation(const char *operation, const char *key) {
+    if (!audit_log) return;
+    time_t now = time(NULL);
+    fprintf(audit_log, "%ld: %s on key %s\n", (long)now, operation, key);
+}
+
+// Flush the memtable once it holds MEMTABLE_FLUSH_BYTES of new writes, or
+// every SNAPSHOT_INTERVAL seconds if anything changed (background thread)
+void* background_persistence(void *arg) {
+    (void)arg;
+    int since_flush_ms = 0;
+    while (running) {
+        usleep(LSM_POLL_MS * 1000);
+        since_flush_ms += LSM_POLL_MS;
+        uint64_t unflushed = atomic_load(&memtable_unflushed);
+        if (unflushed >= MEMTABLE_FLUSH_BYTES || (unflushed > 0 && since_flush_ms >= SNAPSHOT_INTERVAL * 1000)) {
+            persist_to_disk();
+            since_flush_ms = 0;
+        }
+        if (audit_log && since_flush_ms % 1000 == 0) fflush(audit_log);
+    }
+    return NULL;
+}
+
+/* ========== Values ========== */
+
+// Bytes s takes as the inside of a JSON string literal: quotes, backslashes,
+// \n, \r and \t take two, other control bytes six (\u00XX)
+static size_t json_escaped_len(const char *s, size_t len) {
+    size_t n = len;
+    for (size_t i = 0; i < len; i++) {
+        unsigned char c = (unsigned char)s[i];
+        if (c == '"' || c == '\\' || c == '\n' || c == '\r' || c == '\t') n += 1;
+        else if (c < 0x20) n += 5;
+    }
+    return n;
+}
+
+// Write s JSON-escaped to dst, json_escaped_len() bytes; returns the bytes written
+static size_t json_escape(char *dst, const char *s, size_t len) {
+    static const char hex[] = "0123456789abcdef";
+    char *p = dst;
+    for (size_t i = 0; i < len; i++) {
+        unsigned char c = (unsigned char)s[i];
+        if (c == '"' || c == '\\') {
+            *p++ = '\\';
+            *p++ = (char)c;
+        } else if (c == '\n' || c == '\r' || c == '\t') {
+            *p++ = '\\';
+            *p++ = c == '\n' ? 'n' : c == '\r' ? 'r' : 't';
+        } else if (c < 0x20) {
+            memcpy(p, "\\u00", 4);
+            p[4] = hex[c >> 4];
+            p[5] = hex[c & 15];
+            p += 6;
+        } else {
+            *p++ = (char)c;
+        }
+    }
+    return (size_t)(p - dst);
+}
+
+// Build a value holding one reference. Returns NULL on OOM or if len exceeds MAX_VALUE_LENGTH.
+KVValue *kv_value_new(const char *key, const char *value, size_t len) {
+    if (len > MAX_VALUE_LENGTH) return NULL;
+    size_t key_len = strlen(key);
+    size_t escaped_key = json_escaped_len(key, key_len);
+    size_t escaped_value = json_escaped_len(value, len);
+    size_t body_len = 2 + escaped_key + 4 + escaped_value + 2;   // {"key": "value"}
+    int raw_copy = escaped_value != len;
+
+    KVValue *v = malloc(sizeof(KVValue) + body_len + (raw_copy ? len : 0) + 1);
+    if (!v) return NULL;
+    atomic_init(&v->refs, 1);
+    v->len = (uint32_t)len;
+    v->body_len = (uint32_t)body_len;
+    char *p = v->data;
+    memcpy(p, "{\"", 2); p += 2;
+    p += json_escape(p, key, key_len);
+    memcpy(p, "\": \"", 4); p += 4;
+    v->value_off = (uint32_t)(p - v->data);
+    p += json_escape(p, value, len);
+    memcpy(p, "\"}", 2); p += 2;
+    if (raw_copy) {
+        v->value_off = (uint32_t)body_len;
+        memcpy(p, value, len);
+        p += len;
+    }
+    *p = '\0';
+    return v;
+}
+
+static const char *kv_value_bytes(const KVValue *v) {
+    return v->data + v->value_off;
+}
+
+static KVValue *kv_value_ref(KVValue *v) {
+    if (v) atomic_fetch_add_explicit(&v->refs, 1, memory_order_relaxed);
+    return v;
+}
+
+void kv_value_release(KVValue *v) {
+    if (v && atomic_fetch_sub_explicit(&v->refs, 1, memory_order_acq_rel) == 1) free(v);
+}
+
+// libmicrohttpd free callback for a response built from a value's GET body
+static void kv_value_release_body(void *body) {
+    kv_value_release((KVValue *)((char *)body - offsetof(KVValue, data)));
+}
+
+/* ========== Write-Ahead Log ========== */
+
+static int wal_buffer_reserve(WalBuffer *buf, size_t extra) {
+    if (buf->len + extra <= buf->cap) return 0;
+    size_t cap = buf->cap ? buf->cap : 4096;
+    while (cap < buf->len + extra) cap *= 2;
+    char *data = realloc(buf->data, cap);
+    if (!data) return -1;
+    buf->data = data;
+    buf->cap = cap;
+    return 0;
+}
+
+// Serialize one framed record into buf
+static int wal_encode(WalBuffer *buf, uint64_t lsn, uint8_t op, const char *key,
+                      const char *value, uint32_t value_len) {
+    uint16_t key_len = (uint16_t)strlen(key);
+    uint32_t payload_len = 8 + 1 + 2 + 4 + key_len + value_len;
+    if (wal_buffer_reserve(buf, 8 + payload_len) != 0) return -1;
+
+    char *frame = buf->data + buf->len;
+    char *p = frame + 8;
+    memcpy(p, &lsn, 8); p += 8;
+    *p++ = (char)op;
+    memcpy(p, &key_len, 2); p += 2;
+    memcpy(p, &value_len, 4); p += 4;
+    memcpy(p, key, key_len); p += key_len;
+    if (value_len) memcpy(p, value, value_len);
+
+    uint32_t crc = crc32_compute(frame + 8, payload_len);
+    memcpy(frame, &payload_len, 4);
+    memcpy(frame + 4, &crc, 4);
+    buf->len += 8 + payload_len;
+    return 0;
+}
+
+static int write_fully(int fd, const char *data, size_t len) {
+    while (len > 0) {
+        ssize_t n = write(fd, data, len);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            return -1;
+        }
+        data += n;
+        len -= (size_t)n;
+    }
+    return 0;
+}
+
+// WAL writer thread: one write() + fdatasync() per group-commit window
+static void *wal_writer_thread(void *arg) {
+    (void)arg;
+    pthread_mutex_lock(&wal.lock);
+    for (;;) {
+        while (wal.pending.len == 0 && !wal.stopping) {
+            pthread_cond_wait(&wal.has_work, &wal.lock);
+        }
+        if (wal.pending.len == 0 && wal.stopping) break;
+
+        // Give concurrent writers a short window to join this batch
+        pthread_mutex_unlock(&wal.lock);
+        if (!wal.stopping) usleep(WAL_GROUP_COMMIT_US);
+        pthread_mutex_lock(&wal.lock);
+
+        WalBuffer batch = wal.pending;
+        wal.pending = wal.flushing;
+        wal.pending.len = 0;
+        uint64_t batch_lsn = wal.pending_last_lsn;
+        int fd = wal.fd;
+        pthread_mutex_unlock(&wal.lock);
+
+        int failed = write_fully(fd, batch.data, batch.len) != 0 || fdatasync(fd) != 0;
+
+        pthread_mutex_lock(&wal.lock);
+        batch.len = 0;
+        wal.flushing = batch;
+        if (failed) {
+            fprintf(stderr, "Error: WAL write failed: %s\n", strerror(errno));
+            wal.io_error = 1;
+        } else {
+            wal.durable_lsn = batch_lsn;
+        }
+        pthread_cond_broadcast(&wal.durable);
+    }
+    pthread_mutex_unlock(&wal.lock);
+    return NULL;
+}
+
+static int wal_open_file(void) {
+    return open(WAL_FILE, O_WRONLY | O_CREAT | O_APPEND, 0644);
+}
+
+// Open the active log and start the writer. next_lsn continues after recovery.
+static int wal_start(uint64_t next_lsn) {
+    wal.fd = wal_open_file();
+    if (wal.fd < 0) return -1;
+    wal.next_lsn = next_lsn;
+    wal.durable_lsn = next_lsn - 1;
+    wal.pending_last_lsn = next_lsn - 1;
+    pthread_mutex_init(&wal.lock, NULL);
+    pthread_cond_init(&wal.has_work, NULL);
+    pthread_cond_init(&wal.durable, NULL);
+    return pthread_create(&wal.writer, NULL, wal_writer_thread, NULL);
+}
+
+// Append a record. Call with the key's shard lock held. Returns the LSN, or 0 on failure.
+static uint64_t wal_append(uint8_t op, const char *key, const KVValue *value) {
+    pthread_mutex_lock(&wal.lock);
+    uint64_t lsn = 0;
+    if (!wal.io_error && wal_encode(&wal.pending, wal.next_lsn, op, key, value ? kv_value_bytes(value) : NULL,
+                                    value ? value->len : 0) == 0) {
+        lsn = wal.next_lsn++;
+        wal.pending_last_lsn = lsn;
+        pthread_cond_signal(&wal.has_work);
+    }
+    pthread_mutex_unlock(&wal.lock);
+    return lsn;
+}
+
+// Append a transaction's writes as one contiguous group closed by a commit
+// record, so recovery applies all of them or none. Call with every involved
+// shard lock held. Returns the LSN of the commit record, or 0 on failure.
+static uint64_t wal_append_txn(const TxnOp *ops, size_t count) {
+    pthread_mutex_lock(&wal.lock);
+    uint64_t lsn = wal.next_lsn;
+    size_t rollback_len = wal.pending.len;
+    int failed = wal.io_error;
+    for (size_t i = 0; i < count && !failed; i++) {
+        if (ops[i].op == 0) continue;
+        const KVValue *v = ops[i].value;
+        failed = wal_encode(&wal.pending, lsn++, ops[i].op | WAL_TXN_FLAG, ops[i].key,
+                            v ? kv_value_bytes(v) : NULL, v ? v->len : 0) != 0;
+    }
+    if (!failed) failed = wal_encode(&wal.pending, lsn, WAL_OP_TXN_COMMIT, "", NULL, 0) != 0;
+    if (failed) {
+        wal.pending.len = rollback_len;
+        lsn = 0;
+    } else {
+        wal.next_lsn = lsn + 1;
+        wal.pending_last_lsn = lsn;
+        pthread_cond_signal(&wal.has_work);
+    }
+    pthread_mutex_unlock(&wal.lock);
+    return lsn;
+}
+
+// Block until lsn is durable. Call without any shard lock held. Returns 0 on success.
+static int wal_wait_durable(uint64_t lsn) {
+    pthread_mutex_lock(&wal.lock);
+    while (wal.durable_lsn < lsn && !wal.io_error) {
+        pthread_cond_wait(&wal.durable, &wal.lock);
+    }
+    int ok = wal.durable_lsn >= lsn;
+    pthread_mutex_unlock(&wal.lock);
+    return ok ? 0 : -1;
+}
+
+// Flush anything pending and stop the writer thread
+static void wal_stop(void) {
+    pthread_mutex_lock(&wal.lock);
+    wal.stopping = 1;
+    pthread_cond_signal(&wal.has_work);
+    pthread_mutex_unlock(&wal.lock);
+    pthread_join(wal.writer, NULL);
+    close(wal.fd);
+    free(wal.pending.data);
+    free(wal.flushing.data);
+}
+
+// Start a new log segment so the records a snapshot covers can be dropped
+// afterwards. *covered_lsn receives the last LSN the snapshot must include.
+// Returns 1 if WAL_ROTATED_FILE holds only covered records once this returns.
+static int wal_rotate(uint64_t *covered_lsn) {
+    pthread_mutex_lock(&wal.lock);
+    *covered_lsn = wal.next_lsn - 1;
+
+    // A rotated segment is still present if a previous snapshot failed;
+    // keep it and let this snapshot cover it instead of rotating again.
+    if (access(WAL_ROTATED_FILE, F_OK) == 0) {
+        pthread_mutex_unlock(&wal.lock);
+        return 1;
+    }
+
+    // Drain the current batch so it lands in the segment being rotated out
+    while (wal.durable_lsn < wal.pending_last_lsn && !wal.io_error) {
+        pthread_cond_wait(&wal.durable, &wal.lock);
+    }
+    int rotated = 0;
+    if (!wal.io_error && rename(WAL_FILE, WAL_ROTATED_FILE) == 0) {
+        int fd = wal_open_file();
+        if (fd >= 0) {
+            close(wal.fd);
+            wal.fd = fd;
+            rotated = 1;
+        } else {
+            rename(WAL_ROTATED_FILE, WAL_FILE);
+        }
+    }
+    pthread_mutex_unlock(&wal.lock);
+    return rotated;
+}
+
+// One decoded record; key is copied out, value points into the payload
+typedef struct {
+    uint64_t lsn;
+    uint8_t op;
+    char key[MAX_KEY_LENGTH];
+    const char *value;
+    uint32_t value_len;
+} WalRecord;
+
+// Validate and decode one record payload. Returns 0 on success.
+static int wal_decode(const char *payload, uint32_t payload_len, WalRecord *rec) {
+    uint16_t key_len;
+    if (payload_len < 15) return -1;
+    memcpy(&rec->lsn, payload, 8);
+    rec->op = (uint8_t)payload[8];
+    memcpy(&key_len, payload + 9, 2);
+    memcpy(&rec->value_len, payload + 11, 4);
+    if (15u + key_len + rec->value_len != payload_len ||
+        key_len >= MAX_KEY_LENGTH || rec->value_len > MAX_VALUE_LENGTH) return -1;
+    memcpy(rec->key, payload + 15, key_len);
+    rec->key[key_len] = '\0';
+    rec->value = payload + 15 + key_len;
+    return 0;
+}
+
+// Replay framed records from the current position of file, applying those
+// with lsn >= min_lsn. Transaction groups are held back (as raw payloads) until
+// their commit record. Stops at the first torn or corrupt record and stores the
+// offset just past the last complete record or group in *valid_end. Returns the highest LSN seen.
+static uint64_t wal_replay_records(FILE *file, uint64_t min_lsn, long *valid_end, size_t *applied,
+                                   WalApplyFn apply, void *ctx) {
+    uint64_t max_lsn = 0;
+    size_t replayed = 0;
+    char *payload = malloc(WAL_MAX_RECORD);
+    WalBuffer group = {0};              // u32 payload_len | payload, per held-back record
+    uint32_t header[2];
+    WalRecord rec;
+    *valid_end = ftell(file);
+    while (payload && fread(header, 4, 2, file) == 2) {
+        uint32_t payload_len = header[0];
+        if (payload_len < 15 || payload_len > WAL_MAX_RECORD) break;
+        if (fread(payload, 1, payload_len, file) != payload_len) break;
+        if (crc32_compute(payload, payload_len) != header[1]) break;
+        if (wal_decode(payload, payload_len, &rec) != 0) break;
+
+        if (rec.op & WAL_TXN_FLAG) {
+            if (wal_buffer_reserve(&group, 4 + payload_len) != 0) break;
+            memcpy(group.data + group.len, &payload_len, 4);
+            memcpy(group.data + group.len + 4, payload, payload_len);
+            group.len += 4 + payload_len;
+            continue;
+        }
+
+        if (rec.op == WAL_OP_TXN_COMMIT) {
+            for (size_t off = 0; rec.lsn >= min_lsn && off < group.len; ) {
+                uint32_t len;
+                WalRecord op;
+                memcpy(&len, group.data + off, 4);
+                wal_decode(group.data + off + 4, len, &op);
+                apply(ctx, op.op & ~WAL_TXN_FLAG, op.key, op.value, op.value_len);
+                replayed++;
+                off += 4 + len;
+            }
+            group.len = 0;
+        } else if (group.len) {
+            break;                      // A group is always closed before the next plain record
+        } else if (rec.lsn >= min_lsn) {
+            apply(ctx, rec.op, rec.key, rec.value, rec.value_len);
+            replayed++;
+        }
+        *valid_end = ftell(file);
+        if (rec.lsn > max_lsn) max_lsn = rec.lsn;
+    }
+    free(group.data);
+    free(payload);
+    if (applied) *applied = replayed;
+    return max_lsn;
+}
+
+// Replay one log segment. A torn tail (crash mid-append) is truncated away
+// when truncate_tail is set so new appends never follow garbage.
+static uint64_t wal_replay_file(const char *path, uint64_t min_lsn, int truncate_tail,
+                                WalApplyFn apply, void *ctx) {
+    FILE *file = fopen(path, truncate_tail ? "r+b" : "rb");
+    if (!file) return 0;
+    long valid_end;
+    size_t applied;
+    uint64_t max_lsn = wal_replay_records(file, min_lsn, &valid_end, &applied, apply, ctx);
+    if (applied) printf("Replayed %zu records from %s.\n", applied, path);
+    if (truncate_tail) {
+        fseek(file, 0, SEEK_END);
+        if (ftell(file) != valid_end) {
+            fprintf(stderr, "Warning: truncating torn WAL tail in %s at offset %ld\n", path, valid_end);
+            if (ftruncate(fileno(file), valid_end) != 0) {
+                fprintf(stderr, "Warning: failed to truncate %s\n", path);
+            }
+        }
+    }
+    fclose(file);
+    return max_lsn;
+}
+
+/* ========== Snapshot Readers and Reclamation ========== */
+
+static pthread_key_t reader_key;
+static pthread_once_t reader_key_once = PTHREAD_ONCE_INIT;
+static __thread ReaderSlot *thread_reader = NULL;
+
+// Claim a free reader slot, adding a block of slots if every slot is in use.
+// Never waits on other readers (it is called under shard locks), only retries
+// if a new block cannot be allocated.
+static ReaderSlot *reader_acquire(void) {
+    for (ReaderBlock *block = &reader_slots;;) {
+        for (int i = 0; i < READER_BLOCK_SLOTS; i++) {
+            uint64_t expected = READER_FREE;
+            if (atomic_load_explicit(&block->slots[i].read_ts, memory_order_relaxed) == READER_FREE &&
+                atomic_compare_exchange_strong(&block->slots[i].read_ts, &expected, READER_IDLE)) {
+                return &block->slots[i];
+            }
+        }
+        ReaderBlock *next = atomic_load(&block->next);
+        if (!next) {
+            // READER_FREE is 0, so a zeroed block is all free slots
+            ReaderBlock *fresh = calloc(1, sizeof(ReaderBlock));
+            if (!fresh) {
+                sched_yield();
+                block = &reader_slots;
+                continue;
+            }
+            if (atomic_compare_exchange_strong(&block->next, &next, fresh)) {
+                next = fresh;
+            } else {
+                free(fresh);           // Another thread linked one first; next is that block
+            }
+        }
+        block = next;
+    }
+}
+
+static void reader_release(void *slot) {
+    atomic_store(&((ReaderSlot *)slot)->read_ts, READER_FREE);
+}
+
+static void reader_key_init(void) {
+    pthread_key_create(&reader_key, reader_release);
+}
+
+// The calling thread's slot for one-shot reads, released when the thread exits
+static ReaderSlot *thread_reader_slot(void) {
+    if (!thread_reader) {
+        pthread_once(&reader_key_once, reader_key_init);
+        thread_reader = reader_acquire();
+        pthread_setspecific(reader_key, thread_reader);
+    }
+    return thread_reader;
+}
+
+// Pin the latest snapshot and return its timestamp. Re-reading visible_ts
+// after publishing the pin means any GC pass that missed the slot computed its
+// horizon no later than the timestamp finally pinned.
+static uint64_t reader_pin(ReaderSlot *slot) {
+    uint64_t ts = atomic_load(&visible_ts);
+    for (;;) {
+        atomic_store(&slot->read_ts, ts);
+        uint64_t now = atomic_load(&visible_ts);
+        if (now == ts) return ts;
+        ts = now;
+    }
+}
+
+static void reader_unpin(ReaderSlot *slot) {
+    atomic_store(&slot->read_ts, READER_IDLE);
+}
+
+// Oldest pinned snapshot, or READER_IDLE if nobody is reading
+static uint64_t oldest_pinned_ts(void) {
+    uint64_t oldest = READER_IDLE;
+    for (ReaderBlock *block = &reader_slots; block; block = atomic_load(&block->next)) {
+        for (int i = 0; i < READER_BLOCK_SLOTS; i++) {
+            uint64_t ts = atomic_load(&block->slots[i].read_ts);
+            if (ts != READER_FREE && ts < oldest) oldest = ts;
+        }
+    }
+    return oldest;
+}
+
+// Defer destroy(ptr) until no pinned reader can still reach ptr
+static void retire_object(void *ptr, void (*destroy)(void *)) {
+    Retired *r = malloc(sizeof(Retired));
+    if (!r) return;                        // Leaking beats freeing under a reader
+    r->ptr = ptr;
+    r->destroy = destroy;
+    r->stamp = atomic_load(&visible_ts);
+    pthread_mutex_lock(&retired_lock);
+    r->next = retired_list;
+    retired_list = r;
+    pthread_mutex_unlock(&retired_lock);
+}
+
+// Defer freeing ptr until no pinned reader can still reach it
+static void retire_memory(void *ptr) {
+    retire_object(ptr, free);
+}
+
+// Free retired memory unlinked before every currently pinned snapshot
+static void free_retired(void) {
+    pthread_mutex_lock(&retired_lock);
+    Retired *list = retired_list;
+    retired_list = NULL;
+    pthread_mutex_unlock(&retired_lock);
+
+    uint64_t oldest = oldest_pinned_ts();
+    Retired *keep = NULL;
+    while (list) {
+        Retired *next = list->next;
+        if (list->stamp < oldest) {
+            list->destroy(list->ptr);
+            free(list);
+        } else {
+            list->next = keep;
+            keep = list;
+        }
+        list = next;
+    }
+    if (!keep) return;
+    pthread_mutex_lock(&retired_lock);
+    Retired **tail = &keep;
+    while (*tail) tail = &(*tail)->next;
+    *tail = retired_list;
+    retired_list = keep;
+    pthread_mutex_unlock(&retired_lock);
+}
+
+// Hand out the next commit timestamp. Call with the written shards locked.
+static uint64_t commit_begin(void) {
+    return atomic_fetch_add(&commit_clock, 1) + 1;
+}
+
+// Make ts visible once every earlier commit is, so a snapshot never sees a
+// later commit without an earlier one. Earlier commits hold none of our locks.
+static void commit_publish(uint64_t ts) {
+    while (atomic_load(&visible_ts) != ts - 1) sched_yield();
+    atomic_store(&visible_ts, ts);
+}
+
+/* ========== Sorted Tables ========== */
+
+/*
+ * Tiered (LSM) storage.
+ *
+ * The MVCC shard tables are the memtable. persist_to_disk() flushes every key
+ * written since the previous flush into a new immutable sorted table, and the
+ * GC evicts flushed keys from memory once no pinned snapshot predates the
+ * flush, so RAM holds recent writes while the dataset lives on disk. A read
+ * that finds no version in memory probes the tables newest first: the bloom
+ * filter skips tables without the key and the block index names the one
+ * block to pread(), so a point read costs about one disk seek.
+ *
+ * A table stores each key's newest version as of its flush. Merges keep
+ * every version newer than the oldest pinned snapshot plus the newest one
+ * at or below it, the same rule the GC applies to version chains, so a
+ * pinned reader that falls through to the tables still finds its version.
+ *
+ * Table file (host byte order, like the WAL):
+ *   data blocks  records u16 key_len | u8 op | u32 value_len | u64 commit_ts | key | value,
+ *                sorted by key, newest first; one key's versions never span two blocks
+ *   index        per block: u16 key_len | first key | u64 offset | u32 len | u32 crc32(block)
+ *   bloom        u32 bits | bit array
+ *   footer       u64 index_off | u64 max_ts | u32 crc32(index + bloom) | u32 reserved | "KVSST001"
+ *
+ * Manifest: "KVMAN001" | u64 covered_lsn | u64 next_id | u32 count | u64 id[count] | u32 crc32,
+ * ids newest first. It is replaced atomically (write, fsync, rename) on every change.
+ */
+
+#define SST_FOOTER_SIZE 32
+#define SST_RECORD_HEADER 15
+
+// One decoded table record; key is copied out, value points into the block
+typedef struct {
+    char key[MAX_KEY_LENGTH];
+    uint8_t op;                    // WAL_OP_SET or WAL_OP_DELETE
+    const char *value;
+    uint32_t value_len;
+    uint64_t commit_ts;
+} SstRecord;
+
+static void sst_file_name(char *buf, size_t size, uint64_t id) {
+    snprintf(buf, size, SST_FILE_PREFIX "%06llu.sst", (unsigned long long)id);
+}
+
+// Double hashing over the key's 64-bit hash: probe i tests bit (h1 + i*h2) mod bits
+static uint32_t bloom_bit(uint64_t hash, int i, uint32_t bits) {
+    uint64_t h2 = (hash >> 32 | hash << 32) | 1;
+    return (uint32_t)((hash + (uint64_t)i * h2) % bits);
+}
+
+static int sst_may_contain_key(const SSTable *t, uint64_t hash) {
+    for (int i = 0; i < SST_BLOOM_PROBES; i++) {
+        uint32_t bit = bloom_bit(hash, i, t->bloom_bits);
+        if (!(t->bloom[bit >> 3] & (1u << (bit & 7)))) return 0;
+    }
+    return 1;
+}
+
+// 1 if any live table may hold a version of the key. The caller keeps the
+// list alive: it is pinned, or it is the GC or persistence thread.
+static int sst_may_contain(uint64_t hash) {
+    const SstList *list = atomic_load(&sst_list);
+    for (size_t i = 0; list && i < list->count; i++) {
+        if (sst_may_contain_key(list->tables[i], hash)) return 1;
+    }
+    return 0;
+}
+
+static void sst_destroy(void *ptr) {
+    SSTable *t = ptr;
+    close(t->fd);
+    free(t->blocks);
+    free(t->bloom);
+    free(t);
+}
+
+// Destructor for a table merged away: the manifest no longer names its file
+static void sst_destroy_and_unlink(void *ptr) {
+    char path[64];
+    sst_file_name(path, sizeof(path), ((SSTable *)ptr)->id);
+    sst_destroy(ptr);
+    unlink(path);
+}
+
+// Open table id and load its block index and bloom filter. Returns NULL on failure.
+static SSTable *sst_open(uint64_t id) {
+    char path[64];
+    sst_file_name(path, sizeof(path), id);
+    SSTable *t = calloc(1, sizeof(SSTable));
+    if (!t) return NULL;
+    t->id = id;
+    t->fd = open(path, O_RDONLY);
+    struct stat st;
+    char footer[SST_FOOTER_SIZE];
+    uint64_t index_off = 0;
+    uint32_t meta_crc;
+    char *meta = NULL;
+    if (t->fd < 0 || fstat(t->fd, &st) != 0 || st.st_size < SST_FOOTER_SIZE ||
+        pread(t->fd, footer, SST_FOOTER_SIZE, st.st_size - SST_FOOTER_SIZE) != SST_FOOTER_SIZE ||
+        memcmp(footer + 24, "KVSST001", 8) != 0) goto fail;
+    memcpy(&index_off, footer, 8);
+    memcpy(&t->max_ts, footer + 8, 8);
+    memcpy(&meta_crc, footer + 16, 4);
+    size_t meta_len = (size_t)st.st_size - SST_FOOTER_SIZE - index_off;
+    if (index_off > (uint64_t)st.st_size - SST_FOOTER_SIZE || meta_len < 4 ||
+        !(meta = malloc(meta_len)) || pread(t->fd, meta, meta_len, (off_t)index_off) != (ssize_t)meta_len ||
+        crc32_compute(meta, meta_len) != meta_crc) goto fail;
+    t->data_size = index_off;
+
+    // Index entries up to the bloom filter, which fills the rest of the metadata
+    const char *p = meta, *end = meta + meta_len;
+    size_t cap = 0;
+    for (;;) {
+        uint16_t key_len;
+        if (end - p < 2) goto fail;
+        memcpy(&key_len, p, 2);
+        if (key_len == 0xFFFF) break;  // Index terminator
+        if (key_len >= MAX_KEY_LENGTH || (size_t)(end - p) < 2u + key_len + 16) goto fail;
+        if (t->block_count == cap) {
+            cap = cap ? cap * 2 : 64;
+            SstBlock *blocks = realloc(t->blocks, cap * sizeof(SstBlock));
+            if (!blocks) goto fail;
+            t->blocks = blocks;
+        }
+        SstBlock *b = &t->blocks[t->block_count++];
+        memcpy(b->first_key, p + 2, key_len);
+        b->first_key[key_len] = '\0';
+        p += 2 + key_len;
+        memcpy(&b->offset, p, 8);
+        memcpy(&b->len, p + 8, 4);
+        memcpy(&b->crc, p + 12, 4);
+        p += 16;
+        if (b->offset + b->len > index_off) goto fail;
+    }
+    p += 2;
+    if (end - p < 4) goto fail;
+    memcpy(&t->bloom_bits, p, 4);
+    p += 4;
+    if (t->bloom_bits == 0 || (size_t)(end - p) != (t->bloom_bits + 7) / 8 || !(t->bloom = malloc((size_t)(end - p)))) goto fail;
+    memcpy(t->bloom, p, (size_t)(end - p));
+    free(meta);
+    return t;
+
+fail:
+    fprintf(stderr, "Error: unreadable sorted table %s\n", path);
+    free(meta);
+    if (t->fd >= 0) close(t->fd);
+    free(t->blocks);
+    free(t->bloom);
+    free(t);
+    return NULL;
+}
+
+// Read and verify one data block. Returns a malloc()ed copy, or NULL on an I/O or checksum error.
+static char *sst_read_block(const SSTable *t, const SstBlock *b) {
+    char *data = malloc(b->len ? b->len : 1);
+    if (data && (pread(t->fd, data, b->len, (off_t)b->offset) != (ssize_t)b->len ||
+                 crc32_compute(data, b->len) != b->crc)) {
+        fprintf(stderr, "Error: corrupt block at offset %llu of sorted table %llu\n",
+                (unsigned long long)b->offset, (unsigned long long)t->id);
+        free(data);
+        data = NULL;
+    }
+    return data;
+}
+
+// Decode the record at p. Returns the position after it, or NULL if malformed.
+static const char *sst_decode_record(const char *p, const char *end, SstRecord *rec) {
+    uint16_t key_len;
+    if (end - p < SST_RECORD_HEADER) return NULL;
+    memcpy(&key_len, p, 2);
+    rec->op = (uint8_t)p[2];
+    memcpy(&rec->value_len, p + 3, 4);
+    memcpy(&rec->commit_ts, p + 7, 8);
+    p += SST_RECORD_HEADER;
+    if (key_len >= MAX_KEY_LENGTH || (size_t)(end - p) < (size_t)key_len + rec->value_len) return NULL;
+    memcpy(rec->key, p, key_len);
+    rec->key[key_len] = '\0';
+    rec->value = p + key_len;
+    return p + key_len + rec->value_len;
+}
+
+// Index of the only block that can hold key, or -1 if key sorts before the table
+static long sst_find_block(const SSTable *t, const char *key) {
+    long lo = 0, hi = (long)t->block_count - 1, found = -1;
+    while (lo <= hi) {
+        long mid = lo + (hi - lo) / 2;
+        if (strcmp(t->blocks[mid].first_key, key) <= 0) {
+            found = mid;
+            lo = mid + 1;
+        } else {
+            hi = mid - 1;
+        }
+    }
+    return found;
+}
+
+// Look key up in one table as of read_ts. Returns 1 and fills *rec (pointing
+// into *block_out, which the caller frees) if the table has a version at or
+// below read_ts, 0 if not, -1 on a read error.
+static int sst_table_get(const SSTable *t, const char *key, uint64_t read_ts, SstRecord *rec, char **block_out) {
+    long b = sst_find_block(t, key);
+    if (b < 0) return 0;
+    char *data = sst_read_block(t, &t->blocks[b]);
+    if (!data) return -1;
+    const char *p = data, *end = data + t->blocks[b].len;
+    while (p < end && (p = sst_decode_record(p, end, rec)) != NULL) {
+        int cmp = strcmp(rec->key, key);
+        if (cmp > 0) break;
+        if (cmp == 0 && rec->commit_ts <= read_ts) {
+            *block_out = data;
+            return 1;
+        }
+    }
+    free(data);
+    return p ? 0 : -1;
+}
+
+// Look up a key with no version in memory at read_ts. Call pinned at read_ts.
+// *value receives a new reference, or NULL if the key is absent. Returns 0, or
+// -1 if a table could not be read (or memory ran out), so that an unreadable
+// block is never mistaken for a missing key or answered by an older table.
+static int sst_get(const char *key, uint64_t hash, uint64_t read_ts, KVValue **value) {
+    *value = NULL;
+    const SstList *list = atomic_load(&sst_list);
+    for (size_t i = 0; list && i < list->count; i++) {
+        const SSTable *t = list->tables[i];
+        if (!sst_may_contain_key(t, hash)) continue;
+        SstRecord rec;
+        char *block;
+        int found = sst_table_get(t, key, read_ts, &rec, &block);
+        if (found < 0) return -1;
+        if (found == 0) continue;
+        if (rec.op == WAL_OP_SET) *value = kv_value_new(key, rec.value, rec.value_len);
+        free(block);
+        return rec.op == WAL_OP_SET && !*value ? -1 : 0;
+    }
+    return 0;
+}
+
+// Sequential reader over one table's records
+typedef struct {
+    const SSTable *table;
+    size_t next_block;
+    char *data;
+    const char *pos;
+    const char *end;
+    SstRecord rec;                 // Current record, valid while valid is set
+    int valid;
+} SstIter;
+
+// Step to the next record. Returns 0 (check it->valid for the end), -1 on a read error.
+static int sst_iter_next(SstIter *it) {
+    while (it->pos == it->end) {
+        free(it->data);
+        it->data = NULL;
+        it->pos = it->end = NULL;
+        if (it->next_block == it->table->block_count) {
+            it->valid = 0;
+            return 0;
+        }
+        const SstBlock *b = &it->table->blocks[it->next_block++];
+        if (!(it->data = sst_read_block(it->table, b))) return -1;
+        it->pos = it->data;
+        it->end = it->data + b->len;
+    }
+    it->pos = sst_decode_record(it->pos, it->end, &it->rec);
+    if (!it->pos) return -1;
+    it->valid = 1;
+    return 0;
+}
+
+// k-way merge over tables given newest first
+typedef struct {
+    SstIter *iters;
+    size_t count;
+} SstMerge;
+
+static int sst_merge_open(SstMerge *m, SSTable *const *tables, size_t count) {
+    m->count = count;
+    m->iters = calloc(count ? count : 1, sizeof(SstIter));
+    if (!m->iters) return -1;
+    for (size_t i = 0; i < count; i++) {
+        m->iters[i].table = tables[i];
+        if (sst_iter_next(&m->iters[i]) != 0) return -1;
+    }
+    return 0;
+}
+
+static void sst_merge_close(SstMerge *m) {
+    for (size_t i = 0; m->iters && i < m->count; i++) free(m->iters[i].data);
+    free(m->iters);
+}
+
+// Iterator holding the smallest key, or NULL when done. On equal keys the newer
+// table wins: all of its versions are newer than any in an older table.
+static SstIter *sst_merge_peek(SstMerge *m) {
+    SstIter *best = NULL;
+    for (size_t i = 0; i < m->count; i++) {
+        SstIter *it = &m->iters[i];
+        if (it->valid && (!best || strcmp(it->rec.key, best->rec.key) < 0)) best = it;
+    }
+    return best;
+}
+
+// Writes one table to a temporary file, publishing it under its id on finish
+typedef struct {
+    uint64_t id;
+    int fd;
+    uint64_t offset;               // Data bytes written so far
+    WalBuffer block;               // Block being filled
+    char block_first[MAX_KEY_LENGTH];
+    char last_key[MAX_KEY_LENGTH];
+    WalBuffer index;
+    WalBuffer hashes;              // u64 per distinct key, for the bloom filter
+    uint64_t max_ts;
+    size_t records;
+    int failed;
+} SstWriter;
+
+static int sst_writer_open(SstWriter *w, uint64_t id) {
+    char path[72];
+    memset(w, 0, sizeof(*w));
+    w->id = id;
+    sst_file_name(path, sizeof(path), id);
+    strcat(path, ".tmp");
+    w->fd = open(path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    return w->fd >= 0 ? 0 : -1;
+}
+
+static void sst_writer_end_block(SstWriter *w) {
+    if (w->block.len == 0 || w->failed) return;
+    uint16_t key_len = (uint16_t)strlen(w->block_first);
+    uint32_t len = (uint32_t)w->block.len;
+    uint32_t crc = crc32_compute(w->block.data, w->block.len);
+    if (write_fully(w->fd, w->block.data, w->block.len) != 0 ||
+        wal_buffer_reserve(&w->index, 2 + key_len + 16) != 0) {
+        w->failed = 1;
+        return;
+    }
+    char *p = w->index.data + w->index.len;
+    memcpy(p, &key_len, 2);
+    memcpy(p + 2, w->block_first, key_len);
+    p += 2 + key_len;
+    memcpy(p, &w->offset, 8);
+    memcpy(p + 8, &len, 4);
+    memcpy(p + 12, &crc, 4);
+    w->index.len += 2 + key_len + 16;
+    w->offset += len;
+    w->block.len = 0;
+}
+
+// Append a record. Keys must arrive sorted, each key's versions newest first.
+static void sst_writer_add(SstWriter *w, const char *key, uint8_t op, const char *value, uint32_t value_len,
+                           uint64_t commit_ts) {
+    if (w->failed) return;
+    uint16_t key_len = (uint16_t)strlen(key);
+    if (w->records == 0 || strcmp(key, w->last_key) != 0) {
+        if (w->block.len >= SST_BLOCK_SIZE) sst_writer_end_block(w);
+        uint64_t hash = hash_string(key);
+        if (wal_buffer_reserve(&w->hashes, 8) != 0) {
+            w->failed = 1;
+            return;
+        }
+        memcpy(w->hashes.data + w->hashes.len, &hash, 8);
+        w->hashes.len += 8;
+        memcpy(w->last_key, key, key_len + 1);
+    }
+    if (w->block.len == 0) memcpy(w->block_first, key, key_len + 1);
+    if (wal_buffer_reserve(&w->block, SST_RECORD_HEADER + key_len + value_len) != 0) {
+        w->failed = 1;
+        return;
+    }
+    char *p = w->block.data + w->block.len;
+    memcpy(p, &key_len, 2);
+    p[2] = (char)op;
+    memcpy(p + 3, &value_len, 4);
+    memcpy(p + 7, &commit_ts, 8);
+    memcpy(p + SST_RECORD_HEADER, key, key_len);
+    if (value_len) memcpy(p + SST_RECORD_HEADER + key_len, value, value_len);
+    w->block.len += SST_RECORD_HEADER + key_len + value_len;
+    if (commit_ts > w->max_ts) w->max_ts = commit_ts;
+    w->records++;
+}
+
+static void sst_writer_free(SstWriter *w) {
+    free(w->block.data);
+    free(w->index.data);
+    free(w->hashes.data);
+}
+
+// Drop a table that will never be published
+static void sst_writer_abort(SstWriter *w) {
+    char path[72];
+    if (w->fd >= 0) close(w->fd);
+    sst_file_name(path, sizeof(path), w->id);
+    strcat(path, ".tmp");
+    unlink(path);
+    sst_writer_free(w);
+}
+
+// Make the directory entry of a rename durable
+static void sync_directory(void) {
+    int dir_fd = open(".", O_RDONLY);
+    if (dir_fd >= 0) {
+        fsync(dir_fd);
+        close(dir_fd);
+    }
+}
+
+// Write the index, bloom filter and footer, make the table durable and open it.
+// Returns NULL if nothing was added (the file is dropped) or on failure.
+static SSTable *sst_writer_finish(SstWriter *w) {
+    if (w->records == 0) {
+        sst_writer_abort(w);
+        return NULL;
+    }
+    sst_writer_end_block(w);
+
+    size_t keys = w->hashes.len / 8;
+    uint32_t bits = (uint32_t)(keys * SST_BLOOM_BITS_PER_KEY < 64 ? 64 : keys * SST_BLOOM_BITS_PER_KEY);
+    uint16_t terminator = 0xFFFF;
+    size_t meta_len = w->index.len + 2 + 4 + (bits + 7) / 8;
+    char *meta = calloc(1, meta_len);
+    if (!meta) w->failed = 1;
+    if (!w->failed) {
+        memcpy(meta, w->index.data, w->index.len);
+        memcpy(meta + w->index.len, &terminator, 2);
+        memcpy(meta + w->index.len + 2, &bits, 4);
+        uint8_t *bloom = (uint8_t *)meta + w->index.len + 6;
+        for (size_t k = 0; k < keys; k++) {
+            uint64_t hash;
+            memcpy(&hash, w->hashes.data + k * 8, 8);
+            for (int i = 0; i < SST_BLOOM_PROBES; i++) {
+                uint32_t bit = bloom_bit(hash, i, bits);
+                bloom[bit >> 3] |= (uint8_t)(1u << (bit & 7));
+            }
+        }
+        char footer[SST_FOOTER_SIZE] = {0};
+        uint32_t crc = crc32_compute(meta, meta_len);
+        memcpy(footer, &w->offset, 8);
+        memcpy(footer + 8, &w->max_ts, 8);
+        memcpy(footer + 16, &crc, 4);
+        memcpy(footer + 24, "KVSST001", 8);
+        w->failed = write_fully(w->fd, meta, meta_len) != 0 || write_fully(w->fd, footer, SST_FOOTER_SIZE) != 0 ||
+                    fsync(w->fd) != 0;
+    }
+    free(meta);
+
+    char tmp[72], path[64];
+    sst_file_name(path, sizeof(path), w->id);
+    snprintf(tmp, sizeof(tmp), "%s.tmp", path);
+    if (w->failed || rename(tmp, path) != 0) {
+        fprintf(stderr, "Error: failed to write sorted table %s\n", path);
+        sst_writer_abort(w);
+        return NULL;
+    }
+    close(w->fd);
+    sst_writer_free(w);
+    sync_directory();
+    SSTable *t = sst_open(w->id);
+    if (!t) unlink(path);
+    return t;
+}
+
+// Atomically replace the manifest with tables (newest first) covering the log up to covered_lsn
+static int manifest_write(SSTable *const *tables, size_t count, uint64_t covered_lsn) {
+    WalBuffer buf = {0};
+    uint32_t n = (uint32_t)count;
+    if (wal_buffer_reserve(&buf, 8 + 8 + 8 + 4 + count * 8 + 4) != 0) return -1;
+    memcpy(buf.data, "KVMAN001", 8);
+    memcpy(buf.data + 8, &covered_lsn, 8);
+    memcpy(buf.data + 16, &next_sst_id, 8);
+    memcpy(buf.data + 24, &n, 4);
+    buf.len = 28;
+    for (size_t i = 0; i < count; i++, buf.len += 8) memcpy(buf.data + buf.len, &tables[i]->id, 8);
+    uint32_t crc = crc32_compute(buf.data, buf.len);
+    memcpy(buf.data + buf.len, &crc, 4);
+    buf.len += 4;
+
+    int fd = open(MANIFEST_FILE ".tmp", O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    int failed = fd < 0 || write_fully(fd, buf.data, buf.len) != 0 || fsync(fd) != 0;
+    if (fd >= 0) close(fd);
+    free(buf.data);
+    if (failed || rename(MANIFEST_FILE ".tmp", MANIFEST_FILE) != 0) {
+        fprintf(stderr, "Error: failed to write %s\n", MANIFEST_FILE);
+        unlink(MANIFEST_FILE ".tmp");
+        return -1;
+    }
+    sync_directory();
+    manifest_lsn = covered_lsn;
+    return 0;
+}
+
+// New list of `first` (if any) followed by tables[0 .. count)
+static SstList *sst_list_build(SSTable *first, SSTable *const *tables, size_t count) {
+    SstList *list = malloc(sizeof(SstList) + (count + 1) * sizeof(SSTable *));
+    if (!list) return NULL;
+    list->count = 0;
+    if (first) list->tables[list->count++] = first;
+    for (size_t i = 0; i < count; i++) list->tables[list->count++] = tables[i];
+    return list;
+}
+
+// Delete table files the manifest does not name: merge outputs or inputs a
+// crash left behind, and unfinished .tmp files
+static void sst_remove_orphans(const SstList *list) {
+    DIR *dir = opendir(".");
+    if (!dir) return;
+    struct dirent *ent;
+    size_t prefix = strlen(SST_FILE_PREFIX);
+    while ((ent = readdir(dir)) != NULL) {
+        if (strncmp(ent->d_name, SST_FILE_PREFIX, prefix) != 0) continue;
+        char *end;
+        unsigned long long id = strtoull(ent->d_name + prefix, &end, 10);
+        int live = 0;
+        if (strcmp(end, ".sst") == 0) {
+            for (size_t i = 0; list && i < list->count && !live; i++) live = list->tables[i]->id == id;
+        } else if (strcmp(end, ".sst.tmp") != 0) {
+            continue;
+        }
+        if (!live) unlink(ent->d_name);
+    }
+    closedir(dir);
+}
+
+// Open the tables the manifest names. Returns 1 and sets *covered_lsn if a
+// manifest exists, 0 if not. Exits if a named table cannot be opened, since
+// continuing would silently lose its keys.
+static int lsm_load(uint64_t *covered_lsn) {
+    FILE *file = fopen(MANIFEST_FILE, "rb");
+    if (!file) return 0;
+    char *data = NULL;
+    long size = fseek(file, 0, SEEK_END) == 0 ? ftell(file) : -1;
+    uint32_t count = 0, crc = 0;
+    int ok = size >= 32 && fseek(file, 0, SEEK_SET) == 0 && (data = malloc((size_t)size)) != NULL &&
+             fread(data, 1, (size_t)size, file) == (size_t)size && memcmp(data, "KVMAN001", 8) == 0;
+    fclose(file);
+    if (ok) {
+        memcpy(&count, data + 24, 4);
+        memcpy(&crc, data + size - 4, 4);
+        ok = (uint64_t)size == 32 + (uint64_t)count * 8 && crc32_compute(data, (size_t)size - 4) == crc;
+    }
+    if (!ok) {
+        fprintf(stderr, "Error: corrupt %s\n", MANIFEST_FILE);
+        exit(1);
+    }
+
+    SstList *list = malloc(sizeof(SstList) + count * sizeof(SSTable *));
+    if (!list) exit(1);
+    list->count = 0;
+    uint64_t max_ts = 0;
+    for (uint32_t i = 0; i < count; i++) {
+        uint64_t id;
+        memcpy(&id, data + 28 + (size_t)i * 8, 8);
+        SSTable *t = sst_open(id);
+        if (!t) exit(1);
+        list->tables[list->count++] = t;
+        if (t->max_ts > max_ts) max_ts = t->max_ts;
+    }
+    memcpy(covered_lsn, data + 8, 8);
+    memcpy(&next_sst_id, data + 16, 8);
+    free(data);
+    manifest_lsn = *covered_lsn;
+    atomic_store(&sst_list, list);
+    sst_remove_orphans(list);
+
+    // Timestamps continue after the newest stored version, so versions
+    // replayed from the log shadow the tables, and nothing stored needs flushing
+    if (max_ts > atomic_load(&commit_clock)) {
+        atomic_store(&commit_clock, max_ts);
+        atomic_store(&visible_ts, max_ts);
+    }
+    atomic_store(&flushed_ts, max_ts);
+    printf("Opened %zu sorted tables from %s.\n", list->count, MANIFEST_FILE);
+    return 1;
+}
+
+// Size-tiered compaction: merge the newest run of tables where each older
+// table is at most SST_SIZE_RATIO times the run so far, once the run has
+// SST_MERGE_MIN tables (or the list grew past SST_MAX_TABLES). Runs on the
+// persistence thread, the only one that replaces sst_list. Returns 1 if it merged.
+static int lsm_compact(void) {
+    SstList *list = atomic_load(&sst_list);
+    if (!list || list->count < 2) return 0;
+    size_t run = 1;
+    uint64_t run_size = list->tables[0]->data_size;
+    while (run < list->count && list->tables[run]->data_size <= run_size * SST_SIZE_RATIO) {
+        run_size += list->tables[run++]->data_size;
+    }
+    if (run < SST_MERGE_MIN) {
+        if (list->count <= SST_MAX_TABLES) return 0;
+        run = SST_MERGE_MIN;
+    }
+    // With the oldest table in the run, a delete marker has nothing left to hide
+    int bottom = run == list->count;
+    uint64_t horizon = atomic_load(&visible_ts);
+    uint64_t oldest = oldest_pinned_ts();
+    if (oldest < horizon) horizon = oldest;
+
+    SstWriter w;
+    SstMerge m;
+    if (sst_writer_open(&w, next_sst_id) != 0) return 0;
+    next_sst_id++;
+    int failed = sst_merge_open(&m, list->tables, run) != 0;
+    char key[MAX_KEY_LENGTH] = "";
+    int key_done = 0;              // Emitted the key's newest version at or below the horizon
+    SstIter *it;
+    while (!failed && (it = sst_merge_peek(&m)) != NULL) {
+        const SstRecord *rec = &it->rec;
+        if (strcmp(rec->key, key) != 0) {
+            memcpy(key, rec->key, sizeof(key));
+            key_done = 0;
+        }
+        if (!key_done) {
+            if (rec->commit_ts <= horizon) key_done = 1;
+            if (!(key_done && bottom && rec->op == WAL_OP_DELETE)) {
+                sst_writer_add(&w, rec->key, rec->op, rec->value, rec->value_len, rec->commit_ts);
+            }
+        }
+        failed = sst_iter_next(it) != 0 || w.failed;
+    }
+    sst_merge_close(&m);
+    if (failed) {
+        fprintf(stderr, "Error: compaction failed, keeping %zu tables\n", run);
+        sst_writer_abort(&w);
+        return 0;
+    }
+
+    size_t records = w.records;
+    SSTable *merged = sst_writer_finish(&w);
+    if (!merged && records) return 0;
+    SstList *fresh = sst_list_build(merged, list->tables + run, list->count - run);
+    if (!fresh || manifest_write(fresh->tables, fresh->count, manifest_lsn) != 0) {
+        free(fresh);
+        if (merged) sst_destroy_and_unlink(merged);
+        return 0;
+    }
+    atomic_store(&sst_list, fresh);
+    retire_memory(list);
+    for (size_t i = 0; i < run; i++) retire_object(list->tables[i], sst_destroy_and_unlink);
+    return 1;
+}
+
+/* ========== Key-Value Store Functions ========== */
+
+static KVTable *table_alloc(size_t capacity) {
+    KVTable *table = calloc(1, sizeof(KVTable) + capacity * sizeof(KVEntry));
+    if (table) table->capacity = capacity;
+    return table;
+}
+
+// Find the live slot holding key, or NULL. Safe without the shard lock: a
+// slot's key is written before it is published as SLOT_ACTIVE and never reused.
+// Probing stops at the first SLOT_EMPTY; tombstones keep probe chains intact.
+static KVEntry *table_find(KVTable *table, const char *key, uint64_t hash) {
+    size_t mask = table->capacity - 1;
+    for (size_t i = hash & mask, n = 0; n < table->capacity; i = (i + 1) & mask, n++) {
+        KVEntry *e = &table->slots[i];
+        int state = atomic_load_explicit(&e->state, memory_order_acquire);
+        if (state == SLOT_EMPTY) return NULL;
+        if (state == SLOT_ACTIVE && e->hash == hash && strcmp(e->key, key) == 0) return e;
+    }
+    return NULL;
+}
+
+static KVEntry *shard_find(KVShard *shard, const char *key, uint64_t hash) {
+    return table_find(atomic_load_explicit(&shard->table, memory_order_acquire), key, hash);
+}
+
+// Newest version of e committed at or before read_ts, or NULL
+static const KVVersion *version_at(const KVEntry *e, uint64_t read_ts) {
+    const KVVersion *v = atomic_load_explicit(&e->head, memory_order_acquire);
+    while (v && v->commit_ts > read_ts) v = atomic_load_explicit(&v->older, memory_order_acquire);
+    return v;
+}
+
+// Look key up in a pinned snapshot. *value receives a new reference to its
+// value, or NULL if absent. Returns KV_OK, or KV_ERR_READ if a sorted table
+// could not be read. The pin keeps the version, and so its reference, alive
+// until ours is taken. Memory holds every version a snapshot can see unless
+// the key was flushed and evicted, so only a miss in memory goes to the tables.
+static int snapshot_get(const char *key, uint64_t hash, uint64_t read_ts, KVValue **value) {
+    const KVEntry *e = shard_find(&kv_shards[shard_of_hash(hash)], key, hash);
+    const KVVersion *v = e ? version_at(e, read_ts) : NULL;
+    if (v) {
+        *value = kv_value_ref(v->value);
+        return KV_OK;
+    }
+    return sst_get(key, hash, read_ts, value) == 0 ? KV_OK : KV_ERR_READ;
+}
+
+// Rebuild the table at new_capacity, dropping tombstones. Cached hashes mean no
+// key is rehashed; version chains move by pointer. Readers still probing the old
+// table see a consistent (older) picture, so it is retired rather than freed.
+// Caller holds the shard lock. Returns 0 on success.
+static int shard_resize(KVShard *shard, size_t new_capacity) {
+    KVTable *old = atomic_load_explicit(&shard->table, memory_order_relaxed);
+    KVTable *fresh = table_alloc(new_capacity);
+    if (!fresh) return -1;
+    size_t mask = new_capacity - 1;
+    for (size_t j = 0; j < old->capacity; j++) {
+        KVEntry *e = &old->slots[j];
+        if (atomic_load_explicit(&e->state, memory_order_relaxed) != SLOT_ACTIVE) continue;
+        size_t i = e->hash & mask;
+        while (atomic_load_explicit(&fresh->slots[i].state, memory_order_relaxed) != SLOT_EMPTY) i = (i + 1) & mask;
+        KVEntry *dst = &fresh->slots[i];
+        dst->hash = e->hash;
+        memcpy(dst->key, e->key, MAX_KEY_LENGTH);
+        atomic_store_explicit(&dst->head, atomic_load_explicit(&e->head, memory_order_relaxed), memory_order_relaxed);
+        atomic_store_explicit(&dst->state, SLOT_ACTIVE, memory_order_relaxed);
+    }
+    atomic_store_explicit(&shard->table, fresh, memory_order_release);
+    retire_memory(old);
+    shard->tombstones = 0;
+    return 0;
+}
+
+// Find or create the slot for key. A new slot has no versions yet and reads
+// as absent. Caller holds the shard lock. Returns NULL if a resize failed.
+static KVEntry *shard_slot_for_write(KVShard *shard, const char *key, uint64_t hash) {
+    KVTable *table = atomic_load_explicit(&shard->table, memory_order_relaxed);
+    KVEntry *e = table_find(table, key, hash);
+    if (e) return e;
+
+    // Keep active + tombstone slots under the load limit so probes stay short.
+    // If most of the load is tombstones, rehashing in place is enough.
+    if ((shard->count + shard->tombstones + 1) * 100 > table->capacity * SHARD_MAX_LOAD_PERCENT) {
+        size_t new_capacity = table->capacity;
+        if ((shard->count + 1) * 100 > new_capacity * SHARD_MAX_LOAD_PERCENT / 2) new_capacity *= 2;
+        if (shard_resize(shard, new_capacity) != 0) return NULL;
+        table = atomic_load_explicit(&shard->table, memory_order_relaxed);
+    }
+
+    // Only empty slots are filled: reusing a tombstone would rewrite a key a
+    // lock-free reader may be comparing. The next rehash reclaims them.
+    size_t mask = table->capacity - 1;
+    size_t i = hash & mask;
+    while (atomic_load_explicit(&table->slots[i].state, memory_order_relaxed) != SLOT_EMPTY) i = (i + 1) & mask;
+    e = &table->slots[i];
+    e->hash = hash;
+    snprintf(e->key, MAX_KEY_LENGTH, "%s", key);
+    atomic_store_explicit(&e->head, NULL, memory_order_relaxed);
+    atomic_store_explicit(&e->state, SLOT_ACTIVE, memory_order_release);
+    shard->count++;
+    return e;
+}
+
+// New version taking over the caller's reference to value (NULL for a delete)
+static KVVersion *version_new(KVValue *value) {
+    KVVersion *v = malloc(sizeof(KVVersion));
+    if (v) v->value = value;
+    return v;
+}
+
+// Prepend v to e's chain at commit timestamp ts. Caller holds the shard lock.
+static void version_install(KVEntry *e, KVVersion *v, uint64_t ts) {
+    v->commit_ts = ts;
+    atomic_store_explicit(&v->older, atomic_load_explicit(&e->head, memory_order_relaxed), memory_order_relaxed);
+    atomic_store_explicit(&e->head, v, memory_order_release);
+}
+
+static void version_free_chain(KVVersion *v) {
+    while (v) {
+        KVVersion *older = atomic_load_explicit(&v->older, memory_order_relaxed);
+        kv_value_release(v->value);
+        free(v);
+        v = older;
+    }
+}
+
+static void version_chain_destroy(void *ptr) {
+    version_free_chain(ptr);
+}
+
+// 1 if key may currently exist: live in memory or, with no version in memory,
+// possibly in a sorted table. Only bloom filters are consulted, so a delete
+// never reads the disk under the shard lock. Caller holds the shard lock.
+static int shard_may_have_key(KVShard *shard, const char *key, uint64_t hash) {
+    KVEntry *e = shard_find(shard, key, hash);
+    KVVersion *head = e ? atomic_load_explicit(&e->head, memory_order_relaxed) : NULL;
+    if (head) return head->value != NULL;
+    ReaderSlot *slot = thread_reader_slot();
+    reader_pin(slot);
+    int found = sst_may_contain(hash);
+    reader_unpin(slot);
+    return found;
+}
+
+// Count a write towards the next memtable flush
+static void memtable_note_write(const char *key, const KVValue *value) {
+    atomic_fetch_add_explicit(&memtable_unflushed, sizeof(KVVersion) + strlen(key) + (value ? value->len : 0),
+                              memory_order_relaxed);
+}
+
+// Apply a recovered record directly to memory (no WAL, no replication).
+// Recovery runs before any reader exists, so superseded versions go at once.
+static void apply_recovered(void *ctx, uint8_t op, const char *key, const char *value, uint32_t value_len) {
+    (void)ctx;
+    uint64_t hash = hash_string(key);
+    KVShard *shard = &kv_shards[shard_of_hash(hash)];
+    KVValue *data = op == WAL_OP_SET ? kv_value_new(key, value, value_len) : NULL;
+    pthread_mutex_lock(&shard->lock);
+    if (data || (op == WAL_OP_DELETE && shard_may_have_key(shard, key, hash))) {
+        KVVersion *v = version_new(data);
+        KVEntry *e = v ? shard_slot_for_write(shard, key, hash) : NULL;
+        if (e) {
+            memtable_note_write(key, data);
+            uint64_t ts = commit_begin();
+            version_install(e, v, ts);
+            version_free_chain(atomic_exchange(&v->older, NULL));
+            commit_publish(ts);
+            data = NULL;
+        } else {
+            free(v);
+            fprintf(stderr, "Error: Out of memory recovering key %s\n", key);
+        }
+    } else if (op == WAL_OP_SET) {
+        fprintf(stderr, "Error: Out of memory recovering key %s\n", key);
+    }
+    pthread_mutex_unlock(&shard->lock);
+    kv_value_release(data);
+}
+
+// Reclaim versions no pinned snapshot can see. For each key the newest version
+// visible at the horizon is kept and everything older is freed. A key whose
+// kept version is its only one becomes a tombstone (leaves memory) if that
+// version is in a sorted table every snapshot reads past, or is a delete
+// marker of a key no table holds. While a flush is writing a table the bloom
+// filters cannot vouch for it, so markers wait; reading lsm_flushing before
+// the horizon means the flush's snapshot is no older than any marker dropped.
+static void gc_collect(void) {
+    int flushing = atomic_load(&lsm_flushing);
+    uint64_t flushed = atomic_load(&flushed_ts);
+    uint64_t horizon = atomic_load(&visible_ts);
+    uint64_t oldest = oldest_pinned_ts();
+    if (oldest < horizon) horizon = oldest;
+
+    for (int s = 0; s < SHARD_COUNT; s++) {
+        KVShard *shard = &kv_shards[s];
+        pthread_mutex_lock(&shard->lock);
+        KVTable *table = atomic_load_explicit(&shard->table, memory_order_relaxed);
+        for (size_t j = 0; j < table->capacity; j++) {
+            KVEntry *e = &table->slots[j];
+            if (atomic_load_explicit(&e->state, memory_order_relaxed) != SLOT_ACTIVE) continue;
+            KVVersion *head = atomic_load_explicit(&e->head, memory_order_relaxed);
+            KVVersion *keep = head;
+            while (keep && keep->commit_ts > horizon) keep = atomic_load_explicit(&keep->older, memory_order_relaxed);
+            if (keep) version_free_chain(atomic_exchange(&keep->older, NULL));
+            int evict = head && head->commit_ts <= flushed && flushed <= horizon;
+            int dead = head && !head->value && !flushing && !sst_may_contain(e->hash);
+            if (keep == head && (!head || evict || dead)) {
+                atomic_store_explicit(&e->head, NULL, memory_order_release);
+                atomic_store_explicit(&e->state, SLOT_TOMBSTONE, memory_order_release);
+                shard->count--;
+                shard->tombstones++;
+                if (head) retire_object(head, version_chain_destroy);
+            }
+        }
+        pthread_mutex_unlock(&shard->lock);
+    }
+    free_retired();
+}
+
+// Background version collector
+static void *gc_worker(void *arg) {
+    (void)arg;
+    while (running) {
+        usleep(GC_INTERVAL_MS * 1000);
+        gc_collect();
+    }
+    return NULL;
+}
+
+// Initialize the KV store, load from disk, and start background sync
+void init_kv_store() {
+    printf("Initializing Key-Value Store...\n");
+    for (int i = 0; i < SHARD_COUNT; i++) {
+        if (pthread_mutex_init(&kv_shards[i].lock, NULL) != 0) {
+            fprintf(stderr, "Error: Failed to initialize mutex for shard %d\n", i);
+            exit(1);
+        }
+        KVTable *table = table_alloc(SHARD_INITIAL_CAPACITY);
+        if (!table) {
+            fprintf(stderr, "Error: Failed to allocate storage for shard %d\n", i);
+            exit(1);
+        }
+        atomic_init(&kv_shards[i].table, table);
+        kv_shards[i].count = 0;
+        kv_shards[i].tombstones = 0;
+    }
+    audit_log = fopen(LOG_FILE, "a");
+    load_from_disk();
+    pthread_create(&persistence_thread, NULL, background_persistence, NULL);
+    pthread_create(&gc_thread, NULL, gc_worker, NULL);
+    printf("KV Store initialized successfully.\n");
+}
+
+// Stop background threads and flush the log
+void shutdown_kv_store() {
+    running = 0;
+    pthread_join(persistence_thread, NULL);
+    pthread_join(gc_thread, NULL);
+    wal_stop();
+    if (audit_log) fclose(audit_log);
+    audit_log = NULL;
+}
+
+// Open the sorted tables (or import a legacy snapshot), then replay only the
+// log records newer than what they cover
+void load_from_disk() {
+    uint64_t snapshot_lsn = 0;
+    // The tables supersede a legacy snapshot a crash kept around
+    int have_tables = lsm_load(&snapshot_lsn);
+    FILE *file = have_tables ? NULL : fopen(SNAPSHOT_FILE, "rb");
+    if (file) {
+        char magic[8];
+        long valid_end;
+        if (fread(magic, 1, 8, file) == 8 && memcmp(magic, "KVSNAP01", 8) == 0 &&
+            fread(&snapshot_lsn, 8, 1, file) == 1) {
+            size_t applied;
+            wal_replay_records(file, 0, &valid_end, &applied, apply_recovered, NULL);
+            printf("Loaded %zu keys from %s.\n", applied, SNAPSHOT_FILE);
+        } else {
+            snapshot_lsn = 0;
+            fprintf(stderr, "Warning: ignoring unreadable snapshot %s\n", SNAPSHOT_FILE);
+        }
+        fclose(file);
+    } else if (!have_tables && (file = fopen(PERSISTENCE_FILE, "r")) != NULL) {
+        // One-time import of the old whitespace-separated text format
+        char key[MAX_KEY_LENGTH], value[MAX_VALUE_LENGTH];
+        while (fscanf(file, "%49s %99s", key, value) == 2) {
+            apply_recovered(NULL, WAL_OP_SET, key, value, (uint32_t)strlen(value));
+        }
+        fclose(file);
+    }
+
+    uint64_t last_lsn = snapshot_lsn;
+    uint64_t lsn = wal_replay_file(WAL_ROTATED_FILE, snapshot_lsn + 1, 0, apply_recovered, NULL);
+    if (lsn > last_lsn) last_lsn = lsn;
+    lsn = wal_replay_file(WAL_FILE, snapshot_lsn + 1, 1, apply_recovered, NULL);
+    if (lsn > last_lsn) last_lsn = lsn;
+    printf("Recovered store at LSN %llu.\n", (unsigned long long)last_lsn);
+
+    if (wal_start(last_lsn + 1) != 0) {
+        fprintf(stderr, "Error: Failed to open write-ahead log %s\n", WAL_FILE);
+        exit(1);
+    }
+}
+
+// A key to flush and its version as of the flush snapshot (kept alive by the pin)
+typedef struct {
+    const char *key;
+    const KVVersion *version;
+} FlushItem;
+
+static int flush_item_compare(const void *a, const void *b) {
+    return strcmp(((const FlushItem *)a)->key, ((const FlushItem *)b)->key);
+}
+
+// Visit every live key of one consistent snapshot once, in key order: versions
+// in memory are collected and merged with the sorted tables, so a key the GC
+// evicts to a table during the scan is still answered by its memory version
+// only. No shard lock is taken, so a long scan never blocks writers; it only
+// holds back version reclamation. Stops early and returns the visitor's result
+// if it is non-zero (-1 if a table could not be read or memory ran out).
+// The visitor also gets the commit timestamp of the version it is shown.
+static int scan_versions(int (*visit)(void *ctx, const char *key, const KVValue *value, uint64_t commit_ts),
+                         void *ctx) {
+    ReaderSlot *slot = reader_acquire();
+    uint64_t read_ts = reader_pin(slot);
+    int result = 0;
+    // Keys and versions stay valid while pinned, even if their table is retired
+    FlushItem *items = NULL;
+    size_t count = 0, cap = 0;
+    for (int s = 0; s < SHARD_COUNT && result == 0; s++) {
+        KVTable *table = atomic_load_explicit(&kv_shards[s].table, memory_order_acquire);
+        for (size_t j = 0; j < table->capacity && result == 0; j++) {
+            const KVEntry *e = &table->slots[j];
+            if (atomic_load_explicit(&e->state, memory_order_acquire) != SLOT_ACTIVE) continue;
+            const KVVersion *v = version_at(e, read_ts);
+            if (!v) continue;
+            if (count == cap) {
+                cap = cap ? cap * 2 : 1024;
+                FlushItem *grown = realloc(items, cap * sizeof(FlushItem));
+                if (!grown) {
+                    result = -1;
+                    break;
+                }
+                items = grown;
+            }
+            items[count].key = e->key;
+            items[count++].version = v;
+        }
+    }
+    if (result == 0) qsort(items, count, sizeof(FlushItem), flush_item_compare);
+
+    SstList *list = atomic_load(&sst_list);
+    SstMerge m = {0};
+    if (result == 0 && list && sst_merge_open(&m, list->tables, list->count) != 0) result = -1;
+    size_t next = 0;               // First memory item not yet visited
+    char key[MAX_KEY_LENGTH] = "";
+    int key_done = 0;              // Memory or a newer record already answered for key
+    while (result == 0) {
+        SstIter *it = sst_merge_peek(&m);
+        // Memory keys sorting before the next table key have no table records left
+        while (result == 0 && next < count && (!it || strcmp(items[next].key, it->rec.key) < 0)) {
+            const KVVersion *v = items[next++].version;
+            if (v->value) result = visit(ctx, items[next - 1].key, v->value, v->commit_ts);
+        }
+        if (result != 0 || !it) break;
+        const SstRecord *rec = &it->rec;
+        if (strcmp(rec->key, key) != 0) {
+            memcpy(key, rec->key, sizeof(key));
+            key_done = next < count && strcmp(items[next].key, key) == 0;
+            if (key_done) {
+                const KVVersion *v = items[next++].version;
+                if (v->value) result = visit(ctx, key, v->value, v->commit_ts);
+            }
+        }
+        if (result == 0 && !key_done && rec->commit_ts <= read_ts) {
+            key_done = 1;
+            if (rec->op == WAL_OP_SET) {
+                KVValue *value = kv_value_new(key, rec->value, rec->value_len);
+                result = value ? visit(ctx, key, value, rec->commit_ts) : -1;
+                kv_value_release(value);
+            }
+        }
+        if (result == 0 && sst_iter_next(it) != 0) result = -1;
+    }
+    sst_merge_close(&m);
+    free(items);
+    reader_release(slot);
+    return result;
+}
+
+typedef struct {
+    int (*visit)(void *ctx, const char *key, const KVValue *value);
+    void *ctx;
+} ScanKeysVisitor;
+
+static int scan_keys_visit(void *arg, const char *key, const KVValue *value, uint64_t commit_ts) {
+    const ScanKeysVisitor *visitor = arg;
+    (void)commit_ts;
+    return visitor->visit(visitor->ctx, key, value);
+}
+
+// Visit every live key of one consistent snapshot once, in key order (see scan_versions())
+int scan_keys(int (*visit)(void *ctx, const char *key, const KVValue *value), void *ctx) {
+    ScanKeysVisitor visitor = { visit, ctx };
+    return scan_versions(scan_keys_visit, &visitor);
+}
+
+// Flush the memtable without stopping writers: rotate the log, then write
+// every key whose version at one MVCC snapshot (which includes every commit
+// the rotated segment holds) is newer than the previous flush into a new
+// sorted table. Commits racing with the scan carry LSNs above the covered LSN
+// and are replayed on top; per key, LSN order matches commit order, so replay
+// ends at the same state. Once the manifest names the table the rotated
+// segment is dropped and the GC may evict the flushed keys. Finishes with
+// any merges that became due.
+void persist_to_disk() {
+    uint64_t pending = atomic_exchange(&memtable_unflushed, 0);
+    atomic_store(&lsm_flushing, 1);
+    uint64_t covered_lsn;
+    int drop_rotated = wal_rotate(&covered_lsn);
+
+    // Every record up to covered_lsn got its timestamp before the rotation
+    uint64_t covered_ts = atomic_load(&commit_clock);
+    while (atomic_load(&visible_ts) < covered_ts) sched_yield();
+
+    ReaderSlot *slot = reader_acquire();
+    uint64_t flush_ts = reader_pin(slot);
+    uint64_t since = atomic_load(&flushed_ts);
+    FlushItem *items = NULL;
+    size_t count = 0, cap = 0;
+    int failed = 0;
+    for (int s = 0; s < SHARD_COUNT && !failed; s++) {
+        KVTable *table = atomic_load_explicit(&kv_shards[s].table, memory_order_acquire);
+        for (size_t j = 0; j < table->capacity && !failed; j++) {
+            const KVEntry *e = &table->slots[j];
+            if (atomic_load_explicit(&e->state, memory_order_acquire) != SLOT_ACTIVE) continue;
+            const KVVersion *v = version_at(e, flush_ts);
+            if (!v || v->commit_ts <= since) continue;
+            if (count == cap) {
+                cap = cap ? cap * 2 : 1024;
+                FlushItem *grown = realloc(items, cap * sizeof(FlushItem));
+                if (!grown) {
+                    failed = 1;
+                    break;
+                }
+                items = grown;
+            }
+            items[count].key = e->key;
+            items[count++].version = v;
+        }
+    }
+
+    SstWriter w;
+    SSTable *table = NULL;
+    if (!failed && sst_writer_open(&w, next_sst_id) == 0) {
+        next_sst_id++;
+        qsort(items, count, sizeof(FlushItem), flush_item_compare);
+        for (size_t i = 0; i < count; i++) {
+            const KVValue *value = items[i].version->value;
+            sst_writer_add(&w, items[i].key, value ? WAL_OP_SET : WAL_OP_DELETE, value ? kv_value_bytes(value) : NULL,
+                           value ? value->len : 0, items[i].version->commit_ts);
+        }
+        table = sst_writer_finish(&w);
+        failed = !table && count > 0;
+    } else {
+        failed = 1;
+    }
+    reader_release(slot);
+    free(items);
+
+    SstList *list = atomic_load(&sst_list);
+    SstList *fresh = failed ? NULL : sst_list_build(table, list ? list->tables : NULL, list ? list->count : 0);
+    if (!fresh || manifest_write(fresh->tables, fresh->count, covered_lsn) != 0) {
+        fprintf(stderr, "Error: flush failed, keeping the write-ahead log\n");
+        free(fresh);
+        if (table) sst_destroy_and_unlink(table);
+        atomic_store(&lsm_flushing, 0);
+        atomic_fetch_add(&memtable_unflushed, pending);
+        return;
+    }
+    atomic_store(&sst_list, fresh);
+    if (list) retire_memory(list);
+    atomic_store(&flushed_ts, flush_ts);
+    atomic_store(&lsm_flushing, 0);
+    if (drop_rotated) unlink(WAL_ROTATED_FILE);
+    unlink(SNAPSHOT_FILE);             // A legacy snapshot is in the tables now
+    while (lsm_compact()) {}
+}
+
+// Apply a single-key mutation to memory and the log as its own commit. Caller
+// holds the key's shard lock. Client writes are also queued for the followers
+// while the lock still orders them. Takes over the reference to value (NULL for a delete).
+// *lsn_out is 0 when nothing was logged (delete of a missing key).
+static int kv_mutate_locked(KVShard *shard, uint8_t op, const char *key, uint64_t hash, KVValue *value,
+                            ReplTicket *ticket, uint64_t *lsn_out) {
+    *lsn_out = 0;
+    if (op == WAL_OP_DELETE && !shard_may_have_key(shard, key, hash)) return KV_OK;
+
+    KVVersion *v = version_new(value);
+    KVEntry *e = v ? shard_slot_for_write(shard, key, hash) : NULL;
+    if (!e) {
+        free(v);
+        kv_value_release(value);
+        fprintf(stderr, "Error: Out of memory writing key %s\n", key);
+        return KV_ERR_PERSIST;
+    }
+    // The timestamp comes before the LSN, as a flush relies on (see persist_to_disk()).
+    // Appending under the shard lock keeps LSN order equal to apply order per key,
+    // and the version is only installed once it is logged, so a write the log
+    // refused is never seen. The timestamp is published either way.
+    uint64_t ts = commit_begin();
+    uint64_t lsn = wal_append(op, key, value);
+    if (lsn != 0) {
+        memtable_note_write(key, value);
+        version_install(e, v, ts);
+        log_operation(op == WAL_OP_SET ? "SET" : "DELETE", key);
+        if (ticket) replicate_to_followers(lsn, op, key, value, ticket);
+    } else {
+        free(v);
+        kv_value_release(value);
+    }
+    commit_publish(ts);
+
+    *lsn_out = lsn;
+    return lsn ? KV_OK : KV_ERR_PERSIST;
+}
+
+// Lock the key's shard and apply one mutation. The value is built before the
+// lock is taken, so the critical section does no copying.
+static int kv_mutate(uint8_t op, const char *key, const char *value, size_t value_len,
+                     ReplTicket *ticket, uint64_t *lsn_out) {
+    KVValue *data = NULL;
+    if (op == WAL_OP_SET && !(data = kv_value_new(key, value, value_len))) {
+        *lsn_out = 0;
+        return KV_ERR_PERSIST;
+    }
+    uint64_t hash = hash_string(key);
+    KVShard *shard = &kv_shards[shard_of_hash(hash)];
+
+    // Lock the shard to prevent concurrent modifications
+    pthread_mutex_lock(&shard->lock);
+    int status = kv_mutate_locked(shard, op, key, hash, data, ticket, lsn_out);
+    pthread_mutex_unlock(&shard->lock);
+    return status;
+}
+
+// Wait for local durability, then for the follower acks the ack mode asks for
+static int kv_commit(int status, uint64_t lsn, const ReplTicket *ticket) {
+    if (status != KV_OK || lsn == 0) return status;
+    if (wal_wait_durable(lsn) != 0) return KV_ERR_PERSIST;
+    return wait_for_replication(ticket) == 0 ? KV_OK : KV_ERR_REPLICATION;
+}
+
+// Set key-value pair. Returns KV_OK once the write is durable (and acked per repl_ack_mode).
+int set_key(const char *key, const char *value) {
+    ReplTicket ticket;
+    uint64_t lsn;
+    int status = kv_mutate(WAL_OP_SET, key, value, strlen(value), &ticket, &lsn);
+    return kv_commit(status, lsn, &ticket);
+}
+
+// Get key-value pair from the latest snapshot without locking the shard or
+// copying. *value receives a reference the caller drops with kv_value_release(),
+// or NULL if the key is absent. Returns KV_OK, or KV_ERR_READ if storage failed.
+int get_key(const char *key, KVValue **value) {
+    ReaderSlot *slot = thread_reader_slot();
+    int status = snapshot_get(key, hash_string(key), reader_pin(slot), value);
+    reader_unpin(slot);
+    return status;
+}
+
+// Function to delete a key-value pair. Returns KV_OK once the delete is durable.
+int delete_key(const char *key) {
+    ReplTicket ticket;
+    uint64_t lsn;
+    int status = kv_mutate(WAL_OP_DELETE, key, NULL, 0, &ticket, &lsn);
+    if (lsn) printf("Deleted key: %s\n", key);
+    return kv_commit(status, lsn, &ticket);
+}
+
+/* ========== Transactions ========== */
+
+// Begin a transaction reading from the latest snapshot. Returns NULL on OOM.
+Transaction *start_transaction(void) {
+    Transaction *txn = calloc(1, sizeof(Transaction));
+    if (!txn) return NULL;
+    txn->reader = reader_acquire();
+    txn->read_ts = reader_pin(txn->reader);
+    return txn;
+}
+
+static TxnOp *txn_push(Transaction *txn, uint8_t op, const char *key) {
+    if (txn->count == txn->cap) {
+        size_t cap = txn->cap ? txn->cap * 2 : 8;
+        TxnOp *ops = realloc(txn->ops, cap * sizeof(TxnOp));
+        if (!ops) return NULL;
+        txn->ops = ops;
+        txn->cap = cap;
+    }
+    TxnOp *t = &txn->ops[txn->count++];
+    snprintf(t->key, MAX_KEY_LENGTH, "%s", key);
+    t->value = NULL;
+    t->hash = hash_string(t->key);
+    t->op = op;
+    return t;
+}
+
+// Read key as of the transaction's snapshot, seeing its own buffered writes.
+// *value receives a reference the caller releases, or NULL if absent.
+// Returns KV_OK, or KV_ERR_READ if storage failed.
+int txn_get(Transaction *txn, const char *key, KVValue **value) {
+    for (size_t i = txn->count; i-- > 0; ) {
+        const TxnOp *t = &txn->ops[i];
+        if (t->op != 0 && strcmp(t->key, key) == 0) {
+            *value = kv_value_ref(t->value);
+            return KV_OK;
+        }
+    }
+    const TxnOp *read = txn_push(txn, 0, key);
+    uint64_t hash = read ? read->hash : hash_string(key);
+    return snapshot_get(key, hash, txn->read_ts, value);
+}
+
+// Buffer a write taking over the caller's reference to value; nothing is
+// visible to others until commit. Returns 0 on success.
+static int txn_put_value(Transaction *txn, const char *key, KVValue *value) {
+    TxnOp *t = value ? txn_push(txn, WAL_OP_SET, key) : NULL;
+    if (!t) {
+        kv_value_release(value);
+        return -1;
+    }
+    t->value = value;
+    return 0;
+}
 
-KVShard kv_shards[SHARD_COUNT]; 
-pthread_t persistence_thread;
-volatile int running = 1; 
+int txn_set(Transaction *txn, const char *key, const char *value) {
+    return txn_put_value(txn, key, kv_value_new(key, value, strlen(value)));
+}
 
-// Function prototypes
-void persist_to_disk();
-void load_from_disk();
-void log_operation(const char *operation, const char *key);
-void* background_persistence(void *arg);
-void init_kv_store();
-void set_key(const char *key, const char *value);
-char* get_key(const char *key);
-void delete_key(const char *key);
-int get_shard_index(const char *key);
-void replicate_to_followers(const char *key, const char *value);
-int authenticate_request(struct MHD_Connection *connection);
-int http_handler(void *cls, struct MHD_Connection *connection, const char *url,
-                 const char *method, const char *version, const char *upload_data,
-                 size_t *upload_data_size, void **ptr);
-void start_server();
+int txn_delete(Transaction *txn, const char *key) {
+    return txn_push(txn, WAL_OP_DELETE, key) ? 0 : -1;
+}
 
-/* ========== Utility Functions ========== */
+static void txn_free(Transaction *txn) {
+    reader_release(txn->reader);
+    for (size_t i = 0; i < txn->count; i++) kv_value_release(txn->ops[i].value);
+    free(txn->ops);
+    free(txn);
+}
 
-// Hash function to determine which shard a key belongs to
-int get_shard_index(const char *key) {
-    int hash = 0;
-    for (int i = 0; key[i] != '\0'; i++) {
-        hash = (hash * 31 + key[i]) % SHARD_COUNT;
+// Discard the transaction's buffered writes
+void rollback_transaction(Transaction *txn) {
+    txn_free(txn);
+}
+
+// Commit the buffered writes atomically under one timestamp. Every shard the
+// transaction touched is locked, in index order so concurrent commits cannot
+// deadlock. With validate set, the commit fails with KV_ERR_CONFLICT if any key
+// it read or wrote was committed by someone else after its snapshot; blind
+// batch writes skip that and behave like last-writer-wins set_key calls.
+// Frees txn.
+static int txn_commit(Transaction *txn, int validate) {
+    int status = KV_OK;
+    uint64_t lsn = 0;
+    ReplTicket ticket;
+    memset(&ticket, 0, sizeof(ticket));
+
+    uint64_t shards = 0;
+    size_t writes = 0;
+    for (size_t i = 0; i < txn->count; i++) {
+        if (txn->ops[i].op != 0) writes++;
+        shards |= 1ULL << shard_of_hash(txn->ops[i].hash);
+    }
+    // A read-only transaction saw one consistent snapshot; there is nothing to apply
+    if (writes == 0) {
+        txn_free(txn);
+        return KV_OK;
+    }
+    for (int s = 0; s < SHARD_COUNT; s++) {
+        if (shards & (1ULL << s)) pthread_mutex_lock(&kv_shards[s].lock);
     }
-    return hash;
+
+    for (size_t i = 0; validate && i < txn->count && status == KV_OK; i++) {
+        const TxnOp *t = &txn->ops[i];
+        const KVEntry *e = shard_find(&kv_shards[shard_of_hash(t->hash)], t->key, t->hash);
+        const KVVersion *head = e ? atomic_load_explicit(&e->head, memory_order_relaxed) : NULL;
+        if (head && head->commit_ts > txn->read_ts) status = KV_ERR_CONFLICT;
+    }
+
+    // Allocate and make room for everything before taking a timestamp, so a
+    // failure cannot leave half a transaction visible
+    KVVersion **versions = status == KV_OK ? calloc(txn->count, sizeof(KVVersion *)) : NULL;
+    if (status == KV_OK && !versions) status = KV_ERR_PERSIST;
+    for (size_t i = 0; i < txn->count && status == KV_OK; i++) {
+        const TxnOp *t = &txn->ops[i];
+        if (t->op == 0) continue;
+        versions[i] = version_new(NULL);
+        if (!versions[i] || !shard_slot_for_write(&kv_shards[shard_of_hash(t->hash)], t->key, t->hash)) {
+            status = KV_ERR_PERSIST;
+        }
+    }
+
+    if (status == KV_OK) {
+        // Log first and install only what was logged, as kv_mutate_locked() does
+        uint64_t ts = commit_begin();
+        if (writes > 1) {
+            lsn = wal_append_txn(txn->ops, txn->count);
+        } else {
+            for (size_t i = 0; i < txn->count && lsn == 0; i++) {
+                if (txn->ops[i].op != 0) lsn = wal_append(txn->ops[i].op, txn->ops[i].key, txn->ops[i].value);
+            }
+        }
+        for (size_t i = 0; i < txn->count && lsn != 0; i++) {
+            const TxnOp *t = &txn->ops[i];
+            if (t->op == 0) continue;
+            // Slots are looked up again: making room for a later key may have resized the shard
+            versions[i]->value = kv_value_ref(t->value);
+            memtable_note_write(t->key, t->value);
+            version_install(shard_find(&kv_shards[shard_of_hash(t->hash)], t->key, t->hash), versions[i], ts);
+            versions[i] = NULL;
+            log_operation(t->op == WAL_OP_SET ? "SET" : "DELETE", t->key);
+            // Followers apply the writes one by one; queue order still follows commit order
+            ReplTicket one;
+            replicate_to_followers(lsn, t->op, t->key, t->value, &one);
+            for (int f = 0; f < follower_count; f++) {
+                if (one.seq[f] > ticket.seq[f]) ticket.seq[f] = one.seq[f];
+            }
+        }
+        if (lsn == 0) status = KV_ERR_PERSIST;
+        commit_publish(ts);
+    }
+
+    for (int s = SHARD_COUNT - 1; s >= 0; s--) {
+        if (shards & (1ULL << s)) pthread_mutex_unlock(&kv_shards[s].lock);
+    }
+    if (versions) {
+        for (size_t i = 0; i < txn->count; i++) free(versions[i]);
+        free(versions);
+    }
+    txn_free(txn);
+    return kv_commit(status, lsn, &ticket);
 }
 
-// Log operation for auditing
-void log_operation(const char *operation, const char *key) {
-    FILE *log_file = fopen(LOG_FILE, "a");
-    if (!log_file) return;
-    time_t now = time(NULL);
-    fprintf(log_file, "%s: %s on key %s\n", ctime(&now), operation, key);
-    fclose(log_file);
+// Commit with conflict detection. Returns KV_OK once durable (and acked per
+// repl_ack_mode), KV_ERR_CONFLICT if the transaction lost a race and must be retried.
+int commit_transaction(Transaction *txn) {
+    return txn_commit(txn, 1);
 }
 
-// Persist Key-Value Store to disk periodically (background thread)
-void* background_persistence(void *arg) {
-    while (running) {
-        sleep(10);  // Sync to disk every 10 seconds
-        persist_to_disk();
+/* ========== Batch Operations ========== */
+
+// Fetch many keys from one snapshot, so the batch is consistent, without locking a shard.
+// Each found item gets a value reference; release them with batch_release().
+// Returns KV_OK, or KV_ERR_READ if any key could not be read.
+int multi_get(BatchItem *items, size_t count) {
+    ReaderSlot *slot = thread_reader_slot();
+    uint64_t read_ts = reader_pin(slot);
+    int status = KV_OK;
+    for (size_t i = 0; i < count; i++) {
+        if (snapshot_get(items[i].key, hash_string(items[i].key), read_ts, &items[i].value) != KV_OK) status = KV_ERR_READ;
     }
-    return NULL;
+    reader_unpin(slot);
+    return status;
 }
 
-/* ========== Key-Value Store Functions ========== */
+// Store many keys as one transaction: every shard involved is locked once, the
+// whole batch becomes visible at a single timestamp, and one group commit (and
+// set of follower acks) covers it. Duplicate keys keep their request order.
+int multi_set(BatchItem *items, size_t count) {
+    Transaction *txn = start_transaction();
+    if (!txn) return KV_ERR_PERSIST;
+    for (size_t i = 0; i < count; i++) {
+        if (txn_put_value(txn, items[i].key, kv_value_ref(items[i].value)) != 0) {
+            rollback_transaction(txn);
+            return KV_ERR_PERSIST;
+        }
+    }
+    return txn_commit(txn, 0);
+}
 
-// Initialize the KV store, load from disk, and start background sync
-void init_kv_store() {
-    printf("Initializing Key-Value Store...\n");
-    for (int i = 0; i < SHARD_COUNT; i++) {
-        if (pthread_mutex_init(&kv_shards[i].lock, NULL) != 0) {
-            fprintf(stderr, "Error: Failed to initialize mutex for shard %d\n", i);
-            exit(1);
+// Drop the value references a batch holds
+void batch_release(BatchItem *items, size_t count) {
+    for (size_t i = 0; i < count; i++) {
+        kv_value_release(items[i].value);
+        items[i].value = NULL;
+    }
+}
+
+/* ========== Replication ========== */
+
+// Register a follower given as "host:port" (IPv4). Returns 0 on success.
+int add_follower(const char *host_port) {
+    if (follower_count >= MAX_FOLLOWERS) return -1;
+    Follower *f = &followers[follower_count];
+    const char *colon = strrchr(host_port, ':');
+    if (!colon || colon == host_port || (size_t)(colon - host_port) >= sizeof(f->host)) return -1;
+    memset(f, 0, sizeof(*f));
+    memcpy(f->host, host_port, (size_t)(colon - host_port));
+    f->port = atoi(colon + 1);
+    if (f->port <= 0 || f->port > 65535) return -1;
+    follower_count++;
+    return 0;
+}
+
+static int follower_connect(const Follower *f) {
+    struct sockaddr_in addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons((uint16_t)f->port);
+    if (inet_pton(AF_INET, f->host, &addr.sin_addr) != 1) return -1;
+
+    int fd = socket(AF_INET, SOCK_STREAM, 0);
+    if (fd < 0) return -1;
+    int one = 1;
+    setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+    if (connect(fd, (struct sockaddr *)&addr, sizeof(addr)) != 0) {
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+static int send_fully(int fd, const char *data, size_t len, int flags) {
+    while (len > 0) {
+        ssize_t n = send(fd, data, len, flags | MSG_NOSIGNAL);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            return -1;
         }
+        data += n;
+        len -= (size_t)n;
     }
-    load_from_disk();
-    pthread_create(&persistence_thread, NULL, background_persistence, NULL);
-    printf("KV Store initialized successfully.\n");
+    return 0;
 }
 
-// Load data from disk
-void load_from_disk() {
-    FILE *file = fopen(PERSISTENCE_FILE, "r");
-    if (!file) return;
-    char key[MAX_KEY_LENGTH], value[MAX_VALUE_LENGTH];
-    while (fscanf(file, "%s %s", key, value) != EOF) {
-        set_key(key, value);
+// Put one frame on the wire as a keep-alive POST to path. Does not wait for the reply.
+static int follower_send_frame(const Follower *f, const char *path, const WalBuffer *body) {
+    char header[256];
+    int n = snprintf(header, sizeof(header),
+                     "POST %s HTTP/1.1\r\nHost: %s:%d\r\nAuthorization: %s\r\n"
+                     "Content-Type: application/octet-stream\r\nContent-Length: %zu\r\n\r\n",
+                     path, f->host, f->port, API_KEY, body->len);
+    if (send_fully(f->fd, header, (size_t)n, MSG_MORE) != 0) return -1;
+    return send_fully(f->fd, body->data, body->len, 0);
+}
+
+// Parse one complete HTTP response from buf. Returns the bytes it occupies
+// (0 if incomplete, -1 if malformed) and stores its status code in *status.
+static long parse_http_response(const char *buf, size_t len, int *status) {
+    const char *end = memmem(buf, len, "\r\n\r\n", 4);
+    if (!end) return len >= 4096 ? -1 : 0;
+    if (sscanf(buf, "HTTP/%*d.%*d %d", status) != 1) return -1;
+
+    size_t content_length = 0;
+    for (const char *line = strstr(buf, "\r\n"); line && line < end; line = strstr(line + 2, "\r\n")) {
+        if (strncasecmp(line + 2, "Content-Length:", 15) == 0) {
+            content_length = strtoul(line + 17, NULL, 10);
+        }
     }
-    fclose(file);
+    size_t total = (size_t)(end - buf) + 4 + content_length;
+    return total <= len ? (long)total : 0;
 }
 
-// Save data to disk
-void persist_to_disk() {
-    FILE *file = fopen(PERSISTENCE_FILE, "w");
-    if (!file) return;
-    for (int i = 0; i < SHARD_COUNT; i++) {
-        pthread_mutex_lock(&kv_shards[i].lock);
-        for (int j = 0; j < MAX_KEYS; j++) {
-            if (kv_shards[i].store[j].is_active) {
-                fprintf(file, "%s %s\n", kv_shards[i].store[j].key, kv_shards[i].store[j].value);
+static void follower_disconnect(Follower *f, const char *reason) {
+    if (f->fd >= 0) {
+        fprintf(stderr, "Replication to %s:%d interrupted: %s\n", f->host, f->port, reason);
+        close(f->fd);
+    }
+    f->fd = -1;
+}
+
+// Send one request and wait for its response; only used with nothing else in
+// flight on the connection. Returns 0 if the follower answered 200.
+static int follower_call(Follower *f, const char *path, const WalBuffer *body) {
+    if (follower_send_frame(f, path, body) != 0) return -1;
+    char buf[4096];
+    size_t len = 0;
+    int status;
+    long used;
+    while ((used = parse_http_response(buf, len, &status)) == 0) {
+        struct pollfd pfd = { f->fd, POLLIN, 0 };
+        if (len == sizeof(buf) || poll(&pfd, 1, HTTP_CONNECTION_TIMEOUT * 1000) <= 0) return -1;
+        ssize_t n = recv(f->fd, buf + len, sizeof(buf) - len, 0);
+        if (n <= 0) return -1;
+        len += (size_t)n;
+    }
+    return used > 0 && status == MHD_HTTP_OK ? 0 : -1;
+}
+
+// Resync copy in progress: values are packed into frames like queued mutations
+typedef struct {
+    Follower *f;
+    WalBuffer *body;
+} ResyncCopy;
+
+static int resync_visit(void *arg, const char *key, const KVValue *value) {
+    ResyncCopy *copy = arg;
+    if (repl_stopping) return -1;
+    if (copy->body->len >= REPL_FRAME_MAX_BYTES) {
+        if (follower_call(copy->f, "/replicate", copy->body) != 0) return -1;
+        copy->body->len = 0;
+    }
+    return wal_encode(copy->body, 0, WAL_OP_SET, key, kv_value_bytes(value), value->len);
+}
+
+// Bring a diverged follower back, on a connection with nothing in flight. The
+// queue restarts at its head, so writes from now on are queued behind the copy;
+// every write dropped before that has its timestamp already, so the copy is
+// read once those are visible. Queued writes the copy covers are acknowledged
+// when it completes. Returns 0 on success; on failure the follower stays diverged.
+static int follower_resync(Follower *f, WalBuffer *body) {
+    pthread_mutex_lock(&f->lock);
+    uint64_t base = f->head_seq;
+    for (uint64_t seq = f->acked_seq > f->resync_seq ? f->acked_seq : f->resync_seq; seq < base; seq++) {
+        ReplItem *item = &f->queue[seq & (REPL_QUEUE_CAPACITY - 1)];
+        kv_value_release(item->value);
+        item->value = NULL;
+    }
+    f->resync_seq = f->send_seq = base;
+    f->frame_count = 0;
+    f->diverged = 0;
+    pthread_mutex_unlock(&f->lock);
+    uint64_t covered_ts = atomic_load(&commit_clock);
+    while (atomic_load(&visible_ts) < covered_ts) sched_yield();
+
+    printf("Resyncing follower %s:%d\n", f->host, f->port);
+    ResyncCopy copy = { f, body };
+    body->len = 0;
+    int ok = follower_call(f, "/resync/begin", body) == 0 && scan_keys(resync_visit, &copy) == 0 &&
+             (body->len == 0 || follower_call(f, "/replicate", body) == 0);
+    body->len = 0;
+    ok = ok && follower_call(f, "/resync/end", body) == 0;
+
+    pthread_mutex_lock(&f->lock);
+    if (ok) {
+        pthread_mutex_lock(&repl_ack_lock);
+        if (f->acked_seq < base) f->acked_seq = base;
+        pthread_cond_broadcast(&repl_ack_cond);
+        pthread_mutex_unlock(&repl_ack_lock);
+    } else {
+        f->diverged = 1;
+    }
+    pthread_mutex_unlock(&f->lock);
+    if (ok) printf("Follower %s:%d resynced\n", f->host, f->port);
+    return ok ? 0 : -1;
+}
+
+// Follower I/O thread: ships batched frames and consumes pipelined acks
+static void *follower_thread(void *arg) {
+    Follower *f = arg;
+    char rbuf[4096];
+    size_t rlen = 0;
+    WalBuffer body = {0};
+    int fresh = 0;                 // Connection has carried no frames yet
+
+    while (!repl_stopping) {
+        if (f->fd < 0) {
+            f->fd = follower_connect(f);
+            if (f->fd < 0) {
+                struct pollfd wake = { f->wake_fd, POLLIN, 0 };
+                poll(&wake, 1, REPL_RECONNECT_MS);
+                continue;
+            }
+            // Resend everything that was in flight on the old connection
+            pthread_mutex_lock(&f->lock);
+            f->send_seq = f->acked_seq;
+            f->frame_count = 0;
+            pthread_mutex_unlock(&f->lock);
+            rlen = 0;
+            fresh = 1;
+            printf("Replication connected to %s:%d\n", f->host, f->port);
+        }
+
+        pthread_mutex_lock(&f->lock);
+        int diverged = f->diverged;
+        pthread_mutex_unlock(&f->lock);
+        if (diverged) {
+            // The copy goes over a new connection, so no old frame is answered in between
+            if (!fresh) {
+                follower_disconnect(f, "resyncing diverged follower");
+            } else if (follower_resync(f, &body) != 0) {
+                follower_disconnect(f, "resync failed");
+                struct pollfd wake = { f->wake_fd, POLLIN, 0 };
+                poll(&wake, 1, REPL_RECONNECT_MS);
+            }
+            continue;
+        }
+
+        // Keep the pipeline full: encode the next batch while holding the queue lock only
+        pthread_mutex_lock(&f->lock);
+        int have_frame = !f->diverged && f->send_seq < f->head_seq && f->frame_count < REPL_MAX_IN_FLIGHT;
+        if (have_frame) {
+            uint64_t end = f->head_seq;
+            if (end - f->send_seq > REPL_BATCH_MAX) end = f->send_seq + REPL_BATCH_MAX;
+            body.len = 0;
+            for (uint64_t seq = f->send_seq; seq < end; seq++) {
+                const ReplItem *item = &f->queue[seq & (REPL_QUEUE_CAPACITY - 1)];
+                if ((body.len > 0 && body.len >= REPL_FRAME_MAX_BYTES) ||
+                    wal_encode(&body, item->lsn, item->op, item->key, item->value ? kv_value_bytes(item->value) : NULL,
+                               item->value ? item->value->len : 0) != 0) {
+                    end = seq;
+                    break;
+                }
             }
+            have_frame = end > f->send_seq;
+            if (have_frame) {
+                f->frame_end[(f->frame_head + f->frame_count) % REPL_MAX_IN_FLIGHT] = end;
+                f->frame_count++;
+                f->send_seq = end;
+            }
+        }
+        f->idle = !have_frame;
+        pthread_mutex_unlock(&f->lock);
+
+        if (have_frame) {
+            if (follower_send_frame(f, "/replicate", &body) != 0) follower_disconnect(f, strerror(errno));
+            fresh = 0;
+            continue;
+        }
+
+        // Nothing to send: wait for an ack or for new work
+        struct pollfd pfd[2] = { { f->fd, POLLIN, 0 }, { f->wake_fd, POLLIN, 0 } };
+        poll(pfd, 2, REPL_RECONNECT_MS);
+        pthread_mutex_lock(&f->lock);
+        f->idle = 0;
+        pthread_mutex_unlock(&f->lock);
+        if (pfd[1].revents & POLLIN) {
+            uint64_t wakeups;
+            if (read(f->wake_fd, &wakeups, sizeof(wakeups)) < 0) { /* drained */ }
+        }
+        if (!(pfd[0].revents & (POLLIN | POLLHUP | POLLERR))) continue;
+
+        ssize_t n = recv(f->fd, rbuf + rlen, sizeof(rbuf) - rlen, 0);
+        if (n <= 0) {
+            follower_disconnect(f, n == 0 ? "connection closed" : strerror(errno));
+            continue;
+        }
+        rlen += (size_t)n;
+
+        int status;
+        long used;
+        while ((used = parse_http_response(rbuf, rlen, &status)) > 0) {
+            pthread_mutex_lock(&f->lock);
+            if (status != MHD_HTTP_OK || f->frame_count == 0) {
+                pthread_mutex_unlock(&f->lock);
+                used = -1;
+                break;
+            }
+            uint64_t acked = f->frame_end[f->frame_head];
+            f->frame_head = (f->frame_head + 1) % REPL_MAX_IN_FLIGHT;
+            f->frame_count--;
+            for (uint64_t seq = f->acked_seq; seq < acked; seq++) {
+                ReplItem *item = &f->queue[seq & (REPL_QUEUE_CAPACITY - 1)];
+                kv_value_release(item->value);
+                item->value = NULL;
+            }
+            pthread_mutex_lock(&repl_ack_lock);
+            f->acked_seq = acked;
+            pthread_cond_broadcast(&repl_ack_cond);
+            pthread_mutex_unlock(&repl_ack_lock);
+            pthread_mutex_unlock(&f->lock);
+
+            rlen -= (size_t)used;
+            memmove(rbuf, rbuf + used, rlen);
         }
-        pthread_mutex_unlock(&kv_shards[i].lock);
+        if (used < 0) follower_disconnect(f, "rejected or malformed response");
     }
-    fclose(file);
+
+    free(body.data);
+    if (f->fd >= 0) close(f->fd);
+    return NULL;
 }
 
-// Set key-value pair
-void set_key(const char *key, const char *value) {
-    int shard_index = get_shard_index(key);
-    pthread_mutex_lock(&kv_shards[shard_index].lock);
-    for (int i = 0; i < MAX_KEYS; i++) {
-        if (!kv_shards[shard_index].store[i].is_active || strcmp(kv_shards[shard_index].store[i].key, key) == 0) {
-            strcpy(kv_shards[shard_index].store[i].key, key);
-            strcpy(kv_shards[shard_index].store[i].value, value);
-            kv_shards[shard_index].store[i].is_active = 1;
-            log_operation("SET", key);
-            pthread_mutex_unlock(&kv_shards[shard_index].lock);
-            persist_to_disk();
-            replicate_to_followers(key, value);
-            return;
+// Start one I/O thread per configured follower
+void init_replication() {
+    for (int i = 0; i < follower_count; i++) {
+        Follower *f = &followers[i];
+        f->fd = -1;
+        f->queue = calloc(REPL_QUEUE_CAPACITY, sizeof(ReplItem));
+        f->wake_fd = eventfd(0, EFD_NONBLOCK);
+        if (!f->queue || f->wake_fd < 0) {
+            fprintf(stderr, "Error: Failed to set up replication to %s:%d\n", f->host, f->port);
+            exit(1);
         }
+        pthread_mutex_init(&f->lock, NULL);
+        pthread_create(&f->thread, NULL, follower_thread, f);
+    }
+    if (follower_count > 0) {
+        static const char *mode_names[] = { "async", "quorum", "all" };
+        printf("Replicating to %d follower(s), acks=%s\n", follower_count, mode_names[repl_ack_mode]);
     }
-    pthread_mutex_unlock(&kv_shards[shard_index].lock);
 }
 
-// Get key-value pair
-char* get_key(const char *key) {
-    int shard_index = get_shard_index(key);
-    pthread_mutex_lock(&kv_shards[shard_index].lock);
-    for (int i = 0; i < MAX_KEYS; i++) {
-        if (kv_shards[shard_index].store[i].is_active && strcmp(kv_shards[shard_index].store[i].key, key) == 0) {
-            pthread_mutex_unlock(&kv_shards[shard_index].lock);
-            return kv_shards[shard_index].store[i].value;
+void shutdown_replication() {
+    repl_stopping = 1;
+    for (int i = 0; i < follower_count; i++) {
+        uint64_t one = 1;
+        if (write(followers[i].wake_fd, &one, sizeof(one)) < 0) { /* thread polls with a timeout */ }
+        pthread_join(followers[i].thread, NULL);
+        close(followers[i].wake_fd);
+        for (uint64_t seq = followers[i].acked_seq; seq < followers[i].head_seq; seq++) {
+            kv_value_release(followers[i].queue[seq & (REPL_QUEUE_CAPACITY - 1)].value);
         }
+        free(followers[i].queue);
     }
-    pthread_mutex_unlock(&kv_shards[shard_index].lock);
-    return NULL;
 }
 
-// Function to delete a key-value pair
-void delete_key(const char *key) {
-    int shard_index = get_shard_index(key);
+// Queue a mutation for every follower. Called with the key's shard lock held,
+// so it never blocks: a follower whose queue is full is marked diverged.
+// Each queue takes its own reference to value instead of a copy.
+void replicate_to_followers(uint64_t lsn, uint8_t op, const char *key, KVValue *value, ReplTicket *ticket) {
+    for (int i = 0; i < follower_count; i++) {
+        Follower *f = &followers[i];
+        ticket->seq[i] = 0;
+        pthread_mutex_lock(&f->lock);
+        uint64_t tail = f->acked_seq > f->resync_seq ? f->acked_seq : f->resync_seq;
+        if (!f->diverged && f->head_seq - tail >= REPL_QUEUE_CAPACITY) {
+            f->diverged = 1;
+            fprintf(stderr, "Error: follower %s:%d fell %d mutations behind; resyncing it\n",
+                    f->host, f->port, REPL_QUEUE_CAPACITY);
+        }
+        int wake = 0;
+        if (!f->diverged) {
+            ReplItem *item = &f->queue[f->head_seq & (REPL_QUEUE_CAPACITY - 1)];
+            item->lsn = lsn;
+            item->op = op;
+            snprintf(item->key, MAX_KEY_LENGTH, "%s", key);
+            item->value = op == WAL_OP_SET ? kv_value_ref(value) : NULL;
+            ticket->seq[i] = ++f->head_seq;
+            wake = f->idle;
+        }
+        pthread_mutex_unlock(&f->lock);
+        if (wake) {
+            uint64_t one = 1;
+            if (write(f->wake_fd, &one, sizeof(one)) < 0) { /* counter saturated: already signalled */ }
+        }
+    }
+}
 
-    // Lock the shard to prevent concurrent modifications
-    pthread_mutex_lock(&kv_shards[shard_index].lock);
+// Block until enough followers acknowledged the write for repl_ack_mode.
+// Returns 0 on success, -1 on timeout.
+int wait_for_replication(const ReplTicket *ticket) {
+    if (repl_ack_mode == ACKS_ASYNC || follower_count == 0) return 0;
+    // Quorum is a majority of leader + followers; the leader already has the write
+    int needed = repl_ack_mode == ACKS_ALL ? follower_count : (follower_count + 1) / 2;
 
-    for (int i = 0; i < MAX_KEYS; i++) {
-        if (kv_shards[shard_index].store[i].is_active &&
-            strcmp(kv_shards[shard_index].store[i].key, key) == 0) {
+    struct timespec deadline;
+    clock_gettime(CLOCK_REALTIME, &deadline);
+    deadline.tv_sec += REPL_ACK_TIMEOUT_MS / 1000;
+    deadline.tv_nsec += (REPL_ACK_TIMEOUT_MS % 1000) * 1000000L;
+    if (deadline.tv_nsec >= 1000000000L) {
+        deadline.tv_sec++;
+        deadline.tv_nsec -= 1000000000L;
+    }
 
-            // Mark the entry as inactive (deleted)
-            kv_shards[shard_index].store[i].is_active = 0;
-            printf("Deleted key: %s\n", key);
+    int ok = 0;
+    pthread_mutex_lock(&repl_ack_lock);
+    for (;;) {
+        int acks = 0;
+        for (int i = 0; i < follower_count; i++) {
+            if (ticket->seq[i] && followers[i].acked_seq >= ticket->seq[i]) acks++;
+        }
+        if (acks >= needed) {
+            ok = 1;
             break;
         }
+        if (pthread_cond_timedwait(&repl_ack_cond, &repl_ack_lock, &deadline) == ETIMEDOUT) break;
     }
+    pthread_mutex_unlock(&repl_ack_lock);
+    return ok ? 0 : -1;
+}
+
+// Follower side: apply one decoded mutation locally, remembering the last local LSN
+static void apply_replicated(void *ctx, uint8_t op, const char *key, const char *value, uint32_t value_len) {
+    uint64_t *last_lsn = ctx;
+    uint64_t lsn;
+    if (kv_mutate(op, key, value, value_len, NULL, &lsn) == KV_OK && lsn > *last_lsn) *last_lsn = lsn;
+}
+
+// Follower side: apply a whole replication frame, then wait for a single
+// group commit covering all of it. Returns 0 on success.
+int apply_replication_frame(const char *body, size_t len) {
+    if (len == 0) return 0;
+    FILE *frame = fmemopen((void *)body, len, "rb");
+    if (!frame) return -1;
+    uint64_t last_lsn = 0;
+    long valid_end;
+    wal_replay_records(frame, 0, &valid_end, NULL, apply_replicated, &last_lsn);
+    fclose(frame);
+    if ((size_t)valid_end != len) return -1;
+    return last_lsn ? wal_wait_durable(last_lsn) : 0;
+}
 
-    // Unlock the shard after modification
-    pthread_mutex_unlock(&kv_shards[shard_index].lock);
+// Follower side: the leader is about to copy its whole store. Keys whose newest
+// version is at or below this timestamp are stale unless the copy rewrites them.
+void begin_resync(void) {
+    uint64_t ts = atomic_load(&commit_clock);
+    while (atomic_load(&visible_ts) < ts) sched_yield();
+    atomic_store(&resync_begin_ts, ts);
 }
 
+typedef struct {
+    char (*keys)[MAX_KEY_LENGTH];
+    size_t count;
+    size_t cap;
+    uint64_t before_ts;
+} StaleKeys;
 
+static int collect_stale_key(void *arg, const char *key, const KVValue *value, uint64_t commit_ts) {
+    StaleKeys *stale = arg;
+    (void)value;
+    if (commit_ts > stale->before_ts) return 0;
+    if (stale->count == stale->cap) {
+        size_t cap = stale->cap ? stale->cap * 2 : 1024;
+        char (*grown)[MAX_KEY_LENGTH] = realloc(stale->keys, cap * MAX_KEY_LENGTH);
+        if (!grown) return -1;
+        stale->keys = grown;
+        stale->cap = cap;
+    }
+    snprintf(stale->keys[stale->count++], MAX_KEY_LENGTH, "%s", key);
+    return 0;
+}
 
-// Replication to secondary nodes
-void replicate_to_followers(const char *key, const char *value) {
-    char command[256];
-    snprintf(command, sizeof(command), "curl -X POST %s%s/%s", REPLICA_SERVER, key, value);
-    system(command);  // Execute curl command to replicate data
+// Follower side: the copy is complete, so delete every key it did not write
+// (keys the leader no longer has) and wait until the deletes are durable.
+// Returns 0 on success, -1 without a begun resync or on a storage error.
+int finish_resync(void) {
+    uint64_t before_ts = atomic_exchange(&resync_begin_ts, 0);
+    if (before_ts == 0) return -1;
+    StaleKeys stale = { NULL, 0, 0, before_ts };
+    int ret = scan_versions(collect_stale_key, &stale) == 0 ? 0 : -1;
+    uint64_t last_lsn = 0;
+    for (size_t i = 0; i < stale.count && ret == 0; i++) {
+        uint64_t lsn;
+        ret = kv_mutate(WAL_OP_DELETE, stale.keys[i], NULL, 0, NULL, &lsn) == KV_OK ? 0 : -1;
+        if (lsn > last_lsn) last_lsn = lsn;
+    }
+    if (ret == 0 && last_lsn) ret = wal_wait_durable(last_lsn);
+    if (ret == 0) printf("Resync from the leader complete, %zu stale key(s) deleted\n", stale.count);
+    free(stale.keys);
+    return ret;
 }
 
 /* ========== Security and API Handling ========== */
@@ -304,57 +3013,513 @@ int authenticate_request(struct MHD_Connection *connection) {
     return key && strcmp(key, API_KEY) == 0;
 }
 
+// Per-request state: libmicrohttpd delivers a request body over several handler calls
+typedef struct {
+    char *body;
+    size_t len;
+    size_t cap;
+    int too_large;
+} RequestContext;
+
+// Free the per-request state once libmicrohttpd is done with the request
+static void request_completed(void *cls, struct MHD_Connection *connection, void **ptr,
+                              enum MHD_RequestTerminationCode toe) {
+    (void)cls; (void)connection; (void)toe;
+    RequestContext *ctx = *ptr;
+    if (ctx) {
+        free(ctx->body);
+        free(ctx);
+        *ptr = NULL;
+    }
+}
+
+// Append an upload chunk to the request body, bounded by MAX_REQUEST_BODY
+static void request_append_body(RequestContext *ctx, const char *data, size_t size) {
+    if (ctx->too_large || ctx->len + size > MAX_REQUEST_BODY) {
+        ctx->too_large = 1;
+        return;
+    }
+    if (ctx->len + size > ctx->cap) {
+        size_t cap = ctx->cap ? ctx->cap : 4096;
+        while (cap < ctx->len + size) cap *= 2;
+        char *body = realloc(ctx->body, cap);
+        if (!body) {
+            ctx->too_large = 1;
+            return;
+        }
+        ctx->body = body;
+        ctx->cap = cap;
+    }
+    memcpy(ctx->body + ctx->len, data, size);
+    ctx->len += size;
+}
+
+// Responses with a fixed body are built once at startup instead of per request
+static struct MHD_Response *resp_ok, *resp_not_found, *resp_invalid_format, *resp_unsupported,
+                           *resp_unauthorized, *resp_frame_too_large, *resp_frame_failed,
+                           *resp_invalid_batch, *resp_batch_too_large, *resp_batch_failed,
+                           *resp_batch_not_replicated, *resp_read_failed, *resp_resync_failed;
+
+static struct MHD_Response *make_static_response(const char *text) {
+    struct MHD_Response *response = MHD_create_response_from_buffer(strlen(text), (void *)text,
+                                                                    MHD_RESPMEM_PERSISTENT);
+    if (!response) {
+        fprintf(stderr, "Error: Failed to allocate HTTP response\n");
+        exit(1);
+    }
+    return response;
+}
+
+static void init_static_responses() {
+    resp_ok = make_static_response("{\"message\": \"ok\"}");
+    resp_not_found = make_static_response("{\"error\": \"Key not found\"}");
+    resp_invalid_format = make_static_response("{\"error\": \"Invalid key-value format\"}");
+    resp_unsupported = make_static_response("{\"error\": \"Unsupported Operation\"}");
+    resp_unauthorized = make_static_response("{\"error\": \"Unauthorized\"}");
+    resp_frame_too_large = make_static_response("{\"error\": \"Replication frame too large\"}");
+    resp_frame_failed = make_static_response("{\"error\": \"Failed to apply replication frame\"}");
+    resp_invalid_batch = make_static_response("{\"error\": \"Invalid batch body\"}");
+    resp_batch_too_large = make_static_response("{\"error\": \"Batch body too large\"}");
+    resp_batch_failed = make_static_response("{\"error\": \"Batch operation failed\"}");
+    resp_batch_not_replicated = make_static_response("{\"error\": \"Batch stored but not acknowledged by followers\"}");
+    resp_read_failed = make_static_response("{\"error\": \"Failed to read key from storage\"}");
+    resp_resync_failed = make_static_response("{\"error\": \"Resync failed\"}");
+}
+
+static void destroy_static_responses() {
+    MHD_destroy_response(resp_ok);
+    MHD_destroy_response(resp_not_found);
+    MHD_destroy_response(resp_invalid_format);
+    MHD_destroy_response(resp_unsupported);
+    MHD_destroy_response(resp_unauthorized);
+    MHD_destroy_response(resp_frame_too_large);
+    MHD_destroy_response(resp_frame_failed);
+    MHD_destroy_response(resp_invalid_batch);
+    MHD_destroy_response(resp_batch_too_large);
+    MHD_destroy_response(resp_batch_failed);
+    MHD_destroy_response(resp_batch_not_replicated);
+    MHD_destroy_response(resp_read_failed);
+    MHD_destroy_response(resp_resync_failed);
+}
+
+// Format a per-request body into a heap buffer that libmicrohttpd frees (MHD_RESPMEM_MUST_FREE)
+static char *format_body(const char *fmt, ...) {
+    char *body = malloc(RESPONSE_BUFFER_SIZE);
+    if (!body) return NULL;
+    va_list args;
+    va_start(args, fmt);
+    vsnprintf(body, RESPONSE_BUFFER_SIZE, fmt, args);
+    va_end(args);
+    return body;
+}
+
+// Minimal JSON helpers for the batch endpoints: flat objects/arrays of strings
+static const char *json_skip_ws(const char *p, const char *end) {
+    while (p < end && (*p == ' ' || *p == '\t' || *p == '\r' || *p == '\n')) p++;
+    return p;
+}
+
+// Read the four hex digits of a \uXXXX escape at p; -1 if malformed
+static long json_parse_hex4(const char *p, const char *end) {
+    if (end - p < 4) return -1;
+    long v = 0;
+    for (int i = 0; i < 4; i++) {
+        char c = p[i];
+        int d = c >= '0' && c <= '9' ? c - '0' : c >= 'a' && c <= 'f' ? c - 'a' + 10 : c >= 'A' && c <= 'F' ? c - 'A' + 10 : -1;
+        if (d < 0) return -1;
+        v = v << 4 | d;
+    }
+    return v;
+}
+
+// Parse a JSON string at p into out (NUL-terminated), decoding \uXXXX escapes
+// and surrogate pairs to UTF-8. The decoded length goes to *out_len; with a NULL
+// out_len an embedded \u0000 is rejected, since the caller reads out as a C
+// string. Returns the position after the closing quote, or NULL if malformed or
+// longer than out_size - 1.
+static const char *json_parse_string(const char *p, const char *end, char *out, size_t out_size, size_t *out_len) {
+    if (p >= end || *p != '"') return NULL;
+    size_t n = 0;
+    for (p++; p < end && *p != '"'; p++) {
+        char c = *p;
+        if (c == '\\') {
+            if (++p >= end) return NULL;
+            switch (*p) {
+                case '"': case '\\': case '/': c = *p; break;
+                case 'b': c = '\b'; break;
+                case 'f': c = '\f'; break;
+                case 'n': c = '\n'; break;
+                case 't': c = '\t'; break;
+                case 'r': c = '\r'; break;
+                case 'u': {
+                    long cp = json_parse_hex4(p + 1, end);
+                    if (cp < 0 || (cp >= 0xDC00 && cp <= 0xDFFF)) return NULL;  // Lone low surrogate
+                    p += 4;
+                    if (cp >= 0xD800 && cp <= 0xDBFF) {
+                        if (end - p < 3 || p[1] != '\\' || p[2] != 'u') return NULL;
+                        long low = json_parse_hex4(p + 3, end);
+                        if (low < 0xDC00 || low > 0xDFFF) return NULL;
+                        cp = 0x10000 + ((cp - 0xD800) << 10) + (low - 0xDC00);
+                        p += 6;
+                    }
+                    if (cp == 0 && !out_len) return NULL;
+                    char utf8[4];
+                    size_t len;
+                    if (cp < 0x80) {
+                        utf8[0] = (char)cp;
+                        len = 1;
+                    } else if (cp < 0x800) {
+                        utf8[0] = (char)(0xC0 | cp >> 6);
+                        utf8[1] = (char)(0x80 | (cp & 0x3F));
+                        len = 2;
+                    } else if (cp < 0x10000) {
+                        utf8[0] = (char)(0xE0 | cp >> 12);
+                        utf8[1] = (char)(0x80 | (cp >> 6 & 0x3F));
+                        utf8[2] = (char)(0x80 | (cp & 0x3F));
+                        len = 3;
+                    } else {
+                        utf8[0] = (char)(0xF0 | cp >> 18);
+                        utf8[1] = (char)(0x80 | (cp >> 12 & 0x3F));
+                        utf8[2] = (char)(0x80 | (cp >> 6 & 0x3F));
+                        utf8[3] = (char)(0x80 | (cp & 0x3F));
+                        len = 4;
+                    }
+                    if (n + len >= out_size) return NULL;
+                    memcpy(out + n, utf8, len);
+                    n += len;
+                    continue;
+                }
+                default: return NULL;
+            }
+        }
+        if (n + 1 >= out_size) return NULL;
+        out[n++] = c;
+    }
+    if (p >= end) return NULL;
+    out[n] = '\0';
+    if (out_len) *out_len = n;
+    return p + 1;
+}
+
+// Append len bytes of s to buf as a JSON string literal
+static int json_append_string(WalBuffer *buf, const char *s, size_t len) {
+    if (wal_buffer_reserve(buf, json_escaped_len(s, len) + 2) != 0) return -1;
+    buf->data[buf->len++] = '"';
+    buf->len += json_escape(buf->data + buf->len, s, len);
+    buf->data[buf->len++] = '"';
+    return 0;
+}
+
+static int buffer_append(WalBuffer *buf, const void *data, size_t len) {
+    if (wal_buffer_reserve(buf, len) != 0) return -1;
+    memcpy(buf->data + buf->len, data, len);
+    buf->len += len;
+    return 0;
+}
+
+// Decode a batch request body into items. JSON bodies are {"keys": ["k1", ...]}
+// for /mget and {"k1": "v1", ...} for /mset. Binary bodies (network byte order):
+//   u32 count, then count x { u16 key_len, key [, u32 value_len, value] }
+// where the value fields are only present for /mset. Returns the item count or -1.
+// Parsed values are references the caller releases with batch_release(), even on failure.
+static long parse_batch_request(const char *body, size_t len, int binary, int with_values, BatchItem *items) {
+    const char *p = body, *end = body + len;
+    size_t count = 0;
+    memset(items, 0, MAX_BATCH_KEYS * sizeof(BatchItem));
+
+    if (binary) {
+        uint32_t n32;
+        if (len < 4) return -1;
+        memcpy(&n32, p, 4);
+        p += 4;
+        size_t n = ntohl(n32);
+        if (n > MAX_BATCH_KEYS) return -1;
+        for (; count < n; count++) {
+            uint16_t key_len;
+            if (end - p < 2) return -1;
+            memcpy(&key_len, p, 2);
+            key_len = ntohs(key_len);
+            p += 2;
+            if (key_len == 0 || key_len >= MAX_KEY_LENGTH || end - p < key_len) return -1;
+            memcpy(items[count].key, p, key_len);
+            items[count].key[key_len] = '\0';
+            p += key_len;
+            if (!with_values) continue;
+
+            uint32_t value_len;
+            if (end - p < 4) return -1;
+            memcpy(&value_len, p, 4);
+            value_len = ntohl(value_len);
+            p += 4;
+            if (value_len > MAX_VALUE_LENGTH || (size_t)(end - p) < value_len) return -1;
+            if (!(items[count].value = kv_value_new(items[count].key, p, value_len))) return -1;
+            p += value_len;
+        }
+        return p == end ? (long)count : -1;
+    }
+
+    char field[MAX_KEY_LENGTH];
+    char *value = with_values ? malloc(MAX_VALUE_LENGTH + 1) : NULL;
+    if (with_values && !value) return -1;
+    long result = -1;
+    p = json_skip_ws(p, end);
+    if (p >= end || *p++ != '{') goto done;
+    if (!with_values) {
+        p = json_skip_ws(p, end);
+        if (!(p = json_parse_string(p, end, field, sizeof(field), NULL)) || strcmp(field, "keys") != 0) goto done;
+        p = json_skip_ws(p, end);
+        if (p >= end || *p++ != ':') goto done;
+        p = json_skip_ws(p, end);
+        if (p >= end || *p++ != '[') goto done;
+    }
+    const char close = with_values ? '}' : ']';
+    p = json_skip_ws(p, end);
+    if (p < end && *p == close) {
+        p++;
+    } else {
+        for (;;) {
+            if (count >= MAX_BATCH_KEYS) goto done;
+            p = json_parse_string(json_skip_ws(p, end), end, items[count].key, MAX_KEY_LENGTH, NULL);
+            if (!p || items[count].key[0] == '\0') goto done;
+            if (with_values) {
+                p = json_skip_ws(p, end);
+                if (p >= end || *p++ != ':') goto done;
+                size_t value_len;
+                p = json_parse_string(json_skip_ws(p, end), end, value, MAX_VALUE_LENGTH + 1, &value_len);
+                if (!p || !(items[count].value = kv_value_new(items[count].key, value, value_len))) goto done;
+            }
+            count++;
+            p = json_skip_ws(p, end);
+            if (p < end && *p == ',') {
+                p++;
+                continue;
+            }
+            if (p >= end || *p++ != close) goto done;
+            break;
+        }
+    }
+    if (!with_values) {
+        p = json_skip_ws(p, end);
+        if (p >= end || *p++ != '}') goto done;
+    }
+    if (json_skip_ws(p, end) == end) result = (long)count;
+done:
+    free(value);
+    return result;
+}
+
+// Encode /mget results. JSON: {"k1": "v1", "k2": null}. Binary (network byte order):
+//   u32 count, then count x { u16 key_len, key, u32 value_len (0xFFFFFFFF = missing), value }
+static int encode_batch_response(WalBuffer *out, const BatchItem *items, size_t count, int binary) {
+    if (binary) {
+        uint32_t n32 = htonl((uint32_t)count);
+        if (buffer_append(out, &n32, 4) != 0) return -1;
+        for (size_t i = 0; i < count; i++) {
+            uint16_t key_len = (uint16_t)strlen(items[i].key);
+            const KVValue *v = items[i].value;
+            uint32_t value_len = v ? v->len : 0xFFFFFFFFu;
+            uint16_t key_len_be = htons(key_len);
+            uint32_t value_len_be = htonl(value_len);
+            if (buffer_append(out, &key_len_be, 2) != 0 || buffer_append(out, items[i].key, key_len) != 0 ||
+                buffer_append(out, &value_len_be, 4) != 0) return -1;
+            if (v && buffer_append(out, kv_value_bytes(v), value_len) != 0) return -1;
+        }
+        return 0;
+    }
+
+    if (buffer_append(out, "{", 1) != 0) return -1;
+    for (size_t i = 0; i < count; i++) {
+        if (i > 0 && buffer_append(out, ", ", 2) != 0) return -1;
+        const KVValue *v = items[i].value;
+        if (json_append_string(out, items[i].key, strlen(items[i].key)) != 0 || buffer_append(out, ": ", 2) != 0) return -1;
+        if (v ? json_append_string(out, kv_value_bytes(v), v->len) != 0 : buffer_append(out, "null", 4) != 0) return -1;
+    }
+    return buffer_append(out, "}", 1);
+}
+
+// Handle POST /mget and POST /mset. Bodies are binary when the request's
+// Content-Type is application/octet-stream, JSON otherwise.
+static int handle_batch_request(struct MHD_Connection *connection, const RequestContext *ctx, int is_set) {
+    const char *type = MHD_lookup_connection_value(connection, MHD_HEADER_KIND, MHD_HTTP_HEADER_CONTENT_TYPE);
+    int binary = type && strncmp(type, BINARY_CONTENT_TYPE, strlen(BINARY_CONTENT_TYPE)) == 0;
+    if (ctx->too_large) return MHD_queue_response(connection, MHD_HTTP_BAD_REQUEST, resp_batch_too_large);
+
+    BatchItem *items = malloc(MAX_BATCH_KEYS * sizeof(BatchItem));
+    if (!items) return MHD_NO;
+    long count = parse_batch_request(ctx->body ? ctx->body : "", ctx->len, binary, is_set, items);
+    if (count < 0) {
+        batch_release(items, MAX_BATCH_KEYS);
+        free(items);
+        return MHD_queue_response(connection, MHD_HTTP_BAD_REQUEST, resp_invalid_batch);
+    }
+
+    int status_code = MHD_HTTP_OK;
+    WalBuffer out = {0};
+    if (is_set) {
+        int status = multi_set(items, (size_t)count);
+        batch_release(items, (size_t)count);
+        free(items);
+        if (status == KV_ERR_REPLICATION) {
+            return MHD_queue_response(connection, MHD_HTTP_SERVICE_UNAVAILABLE, resp_batch_not_replicated);
+        } else if (status != KV_OK) {
+            return MHD_queue_response(connection, MHD_HTTP_INTERNAL_SERVER_ERROR, resp_batch_failed);
+        }
+        char *body = format_body("{\"message\": \"%ld keys set successfully\"}", count);
+        if (!body) return MHD_NO;
+        out.data = body;
+        out.len = strlen(body);
+        binary = 0;
+    } else {
+        int failed = multi_get(items, (size_t)count) != 0 || encode_batch_response(&out, items, (size_t)count, binary) != 0;
+        batch_release(items, (size_t)count);
+        free(items);
+        if (failed) {
+            free(out.data);
+            return MHD_queue_response(connection, MHD_HTTP_INTERNAL_SERVER_ERROR, resp_batch_failed);
+        }
+    }
+
+    struct MHD_Response *response = MHD_create_response_from_buffer(out.len, out.data, MHD_RESPMEM_MUST_FREE);
+    if (!response) {
+        free(out.data);
+        return MHD_NO;
+    }
+    MHD_add_response_header(response, MHD_HTTP_HEADER_CONTENT_TYPE, binary ? BINARY_CONTENT_TYPE : "application/json");
+    int ret = MHD_queue_response(connection, status_code, response);
+    MHD_destroy_response(response);
+    return ret;
+}
+
 // REST API handler: Process GET, POST, DELETE requests
 int http_handler(void *cls, struct MHD_Connection *connection, const char *url,
                  const char *method, const char *version, const char *upload_data,
                  size_t *upload_data_size, void **ptr) {
-    static int dummy;
-    if (&dummy != *ptr) {
-        *ptr = &dummy;
+    (void)cls; (void)version;
+    RequestContext *ctx = *ptr;
+    if (!ctx) {
+        ctx = calloc(1, sizeof(*ctx));
+        if (!ctx) return MHD_NO;
+        *ptr = ctx;
+        return MHD_YES;
+    }
+    if (*upload_data_size > 0) {
+        request_append_body(ctx, upload_data, *upload_data_size);
+        *upload_data_size = 0;
         return MHD_YES;
     }
-    *ptr = NULL;
 
-    char response_buffer[1024];
-    struct MHD_Response *response;
+    struct MHD_Response *response = NULL;  // Preallocated response shared across requests
+    char *body = NULL;                      // Or a per-request body handed over without a copy
     int status_code = MHD_HTTP_OK;
 
+    // ** POST Request from the leader: apply a batch of replicated mutations **
+    if (strcmp(method, "POST") == 0 && strcmp(url, "/replicate") == 0) {
+        if (!authenticate_request(connection)) {
+            response = resp_unauthorized;
+            status_code = MHD_HTTP_UNAUTHORIZED;
+        } else if (ctx->too_large) {
+            response = resp_frame_too_large;
+            status_code = MHD_HTTP_BAD_REQUEST;
+        } else if (apply_replication_frame(ctx->body, ctx->len) != 0) {
+            response = resp_frame_failed;
+            status_code = MHD_HTTP_INTERNAL_SERVER_ERROR;
+        } else {
+            response = resp_ok;
+        }
+
+    // ** POST Request from the leader: a diverged follower's resync starts or ends **
+    } else if (strcmp(method, "POST") == 0 &&
+               (strcmp(url, "/resync/begin") == 0 || strcmp(url, "/resync/end") == 0)) {
+        if (!authenticate_request(connection)) {
+            response = resp_unauthorized;
+            status_code = MHD_HTTP_UNAUTHORIZED;
+        } else if (strcmp(url, "/resync/begin") == 0) {
+            begin_resync();
+            response = resp_ok;
+        } else if (finish_resync() != 0) {
+            response = resp_resync_failed;
+            status_code = MHD_HTTP_INTERNAL_SERVER_ERROR;
+        } else {
+            response = resp_ok;
+        }
+
+    // ** POST Request: Fetch or store many keys at once **
+    } else if (strcmp(method, "POST") == 0 && strcmp(url, "/mget") == 0) {
+        return handle_batch_request(connection, ctx, 0);
+    } else if (strcmp(method, "POST") == 0 && strcmp(url, "/mset") == 0) {
+        return handle_batch_request(connection, ctx, 1);
+
     // ** GET Request: Fetch a key's value **
-    if (strcmp(method, "GET") == 0 && strstr(url, "/get/") == url) {
+    } else if (strcmp(method, "GET") == 0 && strstr(url, "/get/") == url) {
         char key[MAX_KEY_LENGTH];
-        sscanf(url, "/get/%s", key);
-        char *value = get_key(key);
-        if (value) {
-            snprintf(response_buffer, sizeof(response_buffer), "{\"%s\": \"%s\"}", key, value);
-        } else {
-            snprintf(response_buffer, sizeof(response_buffer), "{\"error\": \"Key not found\"}");
-            status_code = MHD_HTTP_NOT_FOUND;
+        sscanf(url, "/get/%49s", key);
+        KVValue *value;
+        if (get_key(key, &value) != KV_OK) {
+            return MHD_queue_response(connection, MHD_HTTP_INTERNAL_SERVER_ERROR, resp_read_failed);
         }
+        if (!value) return MHD_queue_response(connection, MHD_HTTP_NOT_FOUND, resp_not_found);
+
+        // The stored body is sent as is; libmicrohttpd drops our reference when done
+        response = MHD_create_response_from_buffer_with_free_callback(value->body_len, value->data,
+                                                                      kv_value_release_body);
+        if (!response) {
+            kv_value_release(value);
+            return MHD_NO;
+        }
+        int ret = MHD_queue_response(connection, MHD_HTTP_OK, response);
+        MHD_destroy_response(response);
+        return ret;
 
     // ** POST Request: Set a key-value pair **
     } else if (strcmp(method, "POST") == 0 && strstr(url, "/set/") == url) {
-        char key[MAX_KEY_LENGTH], value[MAX_VALUE_LENGTH];
-        if (sscanf(url, "/set/%49[^/]/%99s", key, value) == 2) {
-            set_key(key, value);
-            snprintf(response_buffer, sizeof(response_buffer), "{\"message\": \"Key '%s' set successfully\"}", key);
+        char key[MAX_KEY_LENGTH];
+        int key_end = 0;
+        // The value is the rest of the path, so it is not bounded by a scan width
+        if (sscanf(url, "/set/%49[^/]/%n", key, &key_end) == 1 && key_end > 0 && url[key_end] != '\0' &&
+            strlen(url + key_end) <= MAX_VALUE_LENGTH) {
+            int status = set_key(key, url + key_end);
+            if (status == KV_OK) {
+                body = format_body("{\"message\": \"Key '%s' set successfully\"}", key);
+            } else if (status == KV_ERR_REPLICATION) {
+                body = format_body("{\"error\": \"Key '%s' stored but not acknowledged by followers\"}", key);
+                status_code = MHD_HTTP_SERVICE_UNAVAILABLE;
+            } else {
+                body = format_body("{\"error\": \"Failed to persist key '%s'\"}", key);
+                status_code = MHD_HTTP_INTERNAL_SERVER_ERROR;
+            }
         } else {
-            snprintf(response_buffer, sizeof(response_buffer), "{\"error\": \"Invalid key-value format\"}");
+            response = resp_invalid_format;
             status_code = MHD_HTTP_BAD_REQUEST;
         }
 
     // ** DELETE Request: Remove a key from the store **
     } else if (strcmp(method, "DELETE") == 0 && strstr(url, "/delete/") == url) {
         char key[MAX_KEY_LENGTH];
-        sscanf(url, "/delete/%s", key);
-        delete_key(key);
-        snprintf(response_buffer, sizeof(response_buffer), "{\"message\": \"Key '%s' deleted\"}", key);
+        sscanf(url, "/delete/%49s", key);
+        int status = delete_key(key);
+        if (status == KV_OK) {
+            body = format_body("{\"message\": \"Key '%s' deleted\"}", key);
+        } else if (status == KV_ERR_REPLICATION) {
+            body = format_body("{\"error\": \"Delete of '%s' not acknowledged by followers\"}", key);
+            status_code = MHD_HTTP_SERVICE_UNAVAILABLE;
+        } else {
+            body = format_body("{\"error\": \"Failed to persist delete of '%s'\"}", key);
+            status_code = MHD_HTTP_INTERNAL_SERVER_ERROR;
+        }
 
     } else {
-        snprintf(response_buffer, sizeof(response_buffer), "{\"error\": \"Unsupported Operation\"}");
+        response = resp_unsupported;
         status_code = MHD_HTTP_BAD_REQUEST;
     }
 
-    response = MHD_create_response_from_buffer(strlen(response_buffer), response_buffer, MHD_RESPMEM_MUST_COPY);
+    // Shared responses are reference counted by libmicrohttpd; never destroy them here
+    if (response) return MHD_queue_response(connection, status_code, response);
+    if (!body) return MHD_NO;
+    response = MHD_create_response_from_buffer(strlen(body), body, MHD_RESPMEM_MUST_FREE);
+    if (!response) {
+        free(body);
+        return MHD_NO;
+    }
     int ret = MHD_queue_response(connection, status_code, response);
     MHD_destroy_response(response);
     return ret;
@@ -362,23 +3527,86 @@ int http_handler(void *cls, struct MHD_Connection *connection, const char *url,
 
 
 
-// HTTP Server
+// HTTP Server. HTTP_MODE_THREAD_PER_CONNECTION gives every client its own thread;
+// HTTP_MODE_EPOLL multiplexes keep-alive connections over http_threads epoll workers.
+// In epoll mode a handler blocked on a group commit stalls the other connections
+// on that worker, so size the pool for the expected write concurrency; waiting for
+// follower acks would stall them for a network round trip, so main() refuses epoll
+// with --acks=quorum|all.
 void start_server() {
-    struct MHD_Daemon *daemon = MHD_start_daemon(MHD_USE_THREAD_PER_CONNECTION, PORT, NULL, NULL, &http_handler, NULL, MHD_OPTION_END);
+    init_static_responses();
+
+    struct MHD_Daemon *daemon;
+    if (http_mode == HTTP_MODE_EPOLL) {
+        unsigned int threads = http_threads > 0 ? (unsigned int)http_threads : (unsigned int)sysconf(_SC_NPROCESSORS_ONLN);
+        daemon = MHD_start_daemon(MHD_USE_EPOLL_INTERNAL_THREAD | MHD_USE_TURBO, (uint16_t)server_port, NULL, NULL,
+                                  &http_handler, NULL,
+                                  MHD_OPTION_THREAD_POOL_SIZE, threads,
+                                  MHD_OPTION_CONNECTION_LIMIT, (unsigned int)HTTP_CONNECTION_LIMIT,
+                                  MHD_OPTION_CONNECTION_TIMEOUT, (unsigned int)HTTP_CONNECTION_TIMEOUT,
+                                  MHD_OPTION_NOTIFY_COMPLETED, &request_completed, NULL,
+                                  MHD_OPTION_END);
+        if (daemon) printf("HTTP front end: epoll with %u worker threads\n", threads);
+    } else {
+        daemon = MHD_start_daemon(MHD_USE_THREAD_PER_CONNECTION, (uint16_t)server_port, NULL, NULL,
+                                  &http_handler, NULL,
+                                  MHD_OPTION_CONNECTION_TIMEOUT, (unsigned int)HTTP_CONNECTION_TIMEOUT,
+                                  MHD_OPTION_NOTIFY_COMPLETED, &request_completed, NULL,
+                                  MHD_OPTION_END);
+    }
     if (!daemon) {
         fprintf(stderr, "Failed to start HTTP server\n");
         exit(1);
     }
-    printf("HTTP Server running on port %d...\n", PORT);
+    printf("HTTP Server running on port %d...\n", server_port);
     getchar();
     MHD_stop_daemon(daemon);
+    destroy_static_responses();
 }
 
-int main() {
+// Usage: ./kv_store [--port=N] [--http-mode=threads|epoll] [--http-threads=N]
+//                   [--follower=host:port ...] [--acks=async|quorum|all]
+// --http-mode=epoll requires --acks=async.
+int main(int argc, char **argv) {
+    for (int i = 1; i < argc; i++) {
+        if (strncmp(argv[i], "--port=", 7) == 0) {
+            server_port = atoi(argv[i] + 7);
+        } else if (strcmp(argv[i], "--http-mode=threads") == 0) {
+            http_mode = HTTP_MODE_THREAD_PER_CONNECTION;
+        } else if (strcmp(argv[i], "--http-mode=epoll") == 0) {
+            http_mode = HTTP_MODE_EPOLL;
+        } else if (strncmp(argv[i], "--http-threads=", 15) == 0) {
+            http_threads = atoi(argv[i] + 15);
+        } else if (strncmp(argv[i], "--follower=", 11) == 0) {
+            if (add_follower(argv[i] + 11) != 0) {
+                fprintf(stderr, "Invalid follower '%s' (expected IPv4 host:port, at most %d)\n", argv[i] + 11, MAX_FOLLOWERS);
+                return 1;
+            }
+        } else if (strcmp(argv[i], "--acks=async") == 0) {
+            repl_ack_mode = ACKS_ASYNC;
+        } else if (strcmp(argv[i], "--acks=quorum") == 0) {
+            repl_ack_mode = ACKS_QUORUM;
+        } else if (strcmp(argv[i], "--acks=all") == 0) {
+            repl_ack_mode = ACKS_ALL;
+        } else {
+            fprintf(stderr, "Usage: %s [--port=N] [--http-mode=threads|epoll] [--http-threads=N]\n"
+                            "       [--follower=host:port ...] [--acks=async|quorum|all]\n", argv[0]);
+            return 1;
+        }
+    }
+
+    if (http_mode == HTTP_MODE_EPOLL && repl_ack_mode != ACKS_ASYNC) {
+        // Quorum and all writes wait for follower acks inside the handler, which
+        // would stall every connection sharing that epoll worker
+        fprintf(stderr, "--http-mode=epoll cannot be used with --acks=quorum|all; use --http-mode=threads\n");
+        return 1;
+    }
+
     init_kv_store();
+    init_replication();
     start_server();
-    running = 0;
-    pthread_join(persistence_thread, NULL);
+    shutdown_replication();
+    shutdown_kv_store();
     return 0;
 }
 
@@ -6,8 +6,17 @@
  * - Multi-threaded support for handling concurrent requests
  * - Sharded architecture for distributed data storage
  * - REST API endpoints for put/get operations
+ * - Values are immutable reference-counted buffers holding a pre-rendered GET
+ *   body, so a GET is answered without copying or formatting
+ * - Batch POST /mget and /mset (JSON or length-prefixed binary bodies),
+ *   grouped by shard so each shard lock is taken once per batch
  * - Persistent storage using JSON files
- * - Leader election and log replication (RAFT-like approach)
+ * - Leader election and log replication (RAFT-like approach, --raft-*): pipelined
+ *   AppendEntries batches, leader leases for local reads, snapshot install
+ * - Thread-per-connection or epoll worker-pool HTTP front end (--http-mode)
+ * - Consistent-hash ring with virtual nodes (--self/--peer, POST /ring/join|leave);
+ *   requests for remote keys are redirected and moved keys stream to their new
+ *   owner in the background while misses fall back to the previous owners
  *
  * Dependencies:
  * - gcc
@@ -16,108 +25,2446 @@
  * - cJSON (for JSON storage)
  */
 
+#define _GNU_SOURCE      // memmem()
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <pthread.h>
 #include <microhttpd.h>
 #include <unistd.h>
+#include <stdint.h>
+#include <stddef.h>
+#include <stdatomic.h>
+#include <arpa/inet.h>   // For htonl()/ntohl() in the binary batch encoding
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <strings.h>
+#include <endian.h>
+#include <fcntl.h>
+#include <time.h>
 #include <cjson/cJSON.h>
 
 #define PORT 8080
-#define MAX_NODES 3
-#define SHARD_COUNT 3
+#define STR_(x) #x
+#define STR(x) STR_(x)
+#define MAX_NODES 16                 // Cluster members on the consistent-hash ring
+#define SHARD_COUNT 16               // Local shards, each with its own lock
+#define NODE_NAME_LEN 64             // "host:port" of a ring member
+#define VNODES_PER_NODE 128          // Ring tokens per cluster member
+#define VNODES_PER_SHARD 128         // Ring tokens per local shard
+#define RING_HANDOFF_VIEWS 4         // Past ring views kept for misses until their keys have moved
+#define MIGRATION_RETRY_SECONDS 1
+#define RAFT_HEARTBEAT_MS 50
+#define RAFT_ELECTION_MIN_MS 300     // Also how long followers stay loyal to a live leader
+#define RAFT_ELECTION_MAX_MS 600
+#define RAFT_LEASE_MS 250            // Below RAFT_ELECTION_MIN_MS by a clock drift margin
+#define RAFT_TICK_MS 10
+#define RAFT_PROPOSE_TIMEOUT_MS 2000
+#define RAFT_MAX_INFLIGHT 8          // Pipelined AppendEntries batches per follower
+#define RAFT_BATCH_ENTRIES 512
+#define RAFT_BATCH_BYTES (512 * 1024)
+#define RAFT_ENTRY_BYTES (256 * 1024)    // Larger writes are split over several entries
+#define RAFT_SNAPSHOT_ENTRIES 10000  // Applied entries kept before the log is compacted
+#define RAFT_SNAPSHOT_CHUNK (512 * 1024)
+#define RAFT_RESULT_SLOTS 4096
+#define HTTP_CONNECTION_TIMEOUT 30   // Seconds an idle keep-alive connection is kept open
+#define HTTP_CONNECTION_LIMIT 10000  // Concurrent connections accepted in epoll mode
+#define SHARD_CAPACITY 100
+#define MAX_VALUE_SIZE (64 * 1024)   // Longest value accepted; each value is allocated to size
+#define MAX_BATCH_KEYS 1024          // Keys accepted by one /mget or /mset request
+#define MAX_REQUEST_BODY (1024 * 1024)
+#define BINARY_CONTENT_TYPE "application/octet-stream"
+
+// ----------------------
+// Reference-counted values
+// ----------------------
+// A value never changes once built. data[] starts with the GET body
+// { "key": "k", "value": "v" }, so a GET passes it to libmicrohttpd as is.
+// The raw value is the quoted part of that body, or a copy placed after it
+// when JSON escaping changed it. Readers take a reference under the shard
+// lock and keep using it after unlocking; an overwrite swaps in a new buffer.
+typedef struct {
+    atomic_int refs;
+    uint32_t len;                  // Raw value bytes
+    uint32_t value_off;            // Raw value is data[value_off .. value_off + len)
+    uint32_t body_len;             // GET body is data[0 .. body_len)
+    char data[];
+} ValueBuffer;
+
+// Quotes, backslashes, \n, \r and \t take two bytes, other control bytes six (\u00XX)
+static size_t json_escaped_len(const char *s, size_t len) {
+    size_t n = len;
+    for (size_t i = 0; i < len; i++) {
+        unsigned char c = (unsigned char)s[i];
+        if (c == '"' || c == '\\' || c == '\n' || c == '\r' || c == '\t') n += 1;
+        else if (c < 0x20) n += 5;
+    }
+    return n;
+}
+
+static char *json_escape(char *dst, const char *s, size_t len) {
+    static const char hex[] = "0123456789abcdef";
+    for (size_t i = 0; i < len; i++) {
+        unsigned char c = (unsigned char)s[i];
+        if (c == '"' || c == '\\') {
+            *dst++ = '\\';
+            *dst++ = (char)c;
+        } else if (c == '\n' || c == '\r' || c == '\t') {
+            *dst++ = '\\';
+            *dst++ = c == '\n' ? 'n' : c == '\r' ? 'r' : 't';
+        } else if (c < 0x20) {
+            memcpy(dst, "\\u00", 4);
+            dst[4] = hex[c >> 4];
+            dst[5] = hex[c & 15];
+            dst += 6;
+        } else {
+            *dst++ = (char)c;
+        }
+    }
+    return dst;
+}
+
+// Build a value with one reference held by the caller. NULL on OOM or if too long.
+ValueBuffer *value_create(const char *key, const char *value, size_t len) {
+    static const char prefix[] = "{ \"key\": \"", middle[] = "\", \"value\": \"", suffix[] = "\" }";
+    if (len > MAX_VALUE_SIZE) return NULL;
+    size_t key_len = strlen(key);
+    size_t escaped_value = json_escaped_len(value, len);
+    size_t body_len = sizeof(prefix) - 1 + json_escaped_len(key, key_len) + sizeof(middle) - 1 +
+                      escaped_value + sizeof(suffix) - 1;
+    int raw_copy = escaped_value != len;
+
+    ValueBuffer *v = malloc(sizeof(ValueBuffer) + body_len + (raw_copy ? len : 0) + 1);
+    if (!v) return NULL;
+    atomic_init(&v->refs, 1);
+    v->len = (uint32_t)len;
+    v->body_len = (uint32_t)body_len;
+    char *p = v->data;
+    memcpy(p, prefix, sizeof(prefix) - 1); p += sizeof(prefix) - 1;
+    p = json_escape(p, key, key_len);
+    memcpy(p, middle, sizeof(middle) - 1); p += sizeof(middle) - 1;
+    v->value_off = (uint32_t)(p - v->data);
+    p = json_escape(p, value, len);
+    memcpy(p, suffix, sizeof(suffix) - 1); p += sizeof(suffix) - 1;
+    if (raw_copy) {
+        v->value_off = (uint32_t)body_len;
+        memcpy(p, value, len);
+        p += len;
+    }
+    *p = '\0';
+    return v;
+}
+
+static const char *value_bytes(const ValueBuffer *v) {
+    return v->data + v->value_off;
+}
+
+static ValueBuffer *value_ref(ValueBuffer *v) {
+    if (v) atomic_fetch_add_explicit(&v->refs, 1, memory_order_relaxed);
+    return v;
+}
+
+void value_release(ValueBuffer *v) {
+    if (v && atomic_fetch_sub_explicit(&v->refs, 1, memory_order_acq_rel) == 1) free(v);
+}
+
+// libmicrohttpd free callback for a response sent straight from a value's body
+static void value_release_body(void *body) {
+    value_release((ValueBuffer *)((char *)body - offsetof(ValueBuffer, data)));
+}
 
 // ----------------------
 // Key-Value Store Structure
 // ----------------------
 typedef struct {
-    char key[256];
-    char value[256];
-} KeyValue;
+    char key[256];
+    ValueBuffer *value;            // The store's reference
+} KeyValue;
+
+// Shards of the key-value store
+KeyValue store[SHARD_COUNT][SHARD_CAPACITY];
+int store_size[SHARD_COUNT] = {0};
+pthread_mutex_t locks[SHARD_COUNT];
+
+// ----------------------
+// Helper function: Hash Key to Shard
+// ----------------------
+// 64-bit FNV-1a followed by the murmur3 fmix64 finalizer, so ring tokens and
+// key positions are spread evenly over the whole 64-bit space
+uint64_t hash64(const char *data, size_t len) {
+    uint64_t h = 1469598103934665603ULL;
+    for (size_t i = 0; i < len; i++) {
+        h ^= (unsigned char)data[i];
+        h *= 1099511628211ULL;
+    }
+    h ^= h >> 33;
+    h *= 0xff51afd7ed558ccdULL;
+    h ^= h >> 33;
+    h *= 0xc4ceb9fe1a85ec53ULL;
+    h ^= h >> 33;
+    return h;
+}
+
+// ----------------------
+// Consistent-hash rings
+// ----------------------
+// Each owner is placed on the ring at `vnodes` tokens hashed from its name;
+// a key belongs to the first token at or after its hash. Adding or removing
+// an owner only moves the keys between it and its ring neighbours.
+//
+// Two rings are used: the node ring spreads keys over cluster members (every
+// node builds the same ring from the same "host:port" list), and the shard
+// ring spreads this node's keys over its local shards. The shard ring never
+// changes, so a key stays in the same local shard while nodes come and go.
+typedef struct {
+    uint64_t token;
+    int owner;                     // Node index (node ring) or shard index (shard ring)
+} RingPoint;
+
+typedef struct {
+    RingPoint *points;             // Sorted by token
+    size_t count;
+} HashRing;
+
+typedef struct {
+    char nodes[MAX_NODES][NODE_NAME_LEN];  // "host:port" of every member
+    int node_count;
+    int self;                      // Index of this node, -1 once it has left
+    HashRing ring;
+} Membership;
+
+// A view replaced by a ring change, kept for hand-off reads until every one of
+// its members reported that it moved out the keys it no longer owns
+typedef struct {
+    Membership view;
+    uint64_t generation;
+    int migrated[MAX_NODES];       // view.nodes[i] holds no keys from this view any more
+} HandoffView;
+
+HashRing shard_ring;
+Membership members;                // Current view
+uint64_t ring_generation = 1;      // Of members; every node applies the same changes in order
+HandoffView handoff_views[RING_HANDOFF_VIEWS];  // Older views, newest first
+int handoff_count = 0;
+pthread_rwlock_t ring_lock = PTHREAD_RWLOCK_INITIALIZER;
+char self_name[NODE_NAME_LEN] = "127.0.0.1:" STR(PORT);
+
+static int ring_point_cmp(const void *a, const void *b) {
+    const RingPoint *x = a, *y = b;
+    return x->token < y->token ? -1 : x->token > y->token;
+}
+
+// Build a ring for `owners` names with `vnodes` tokens each. Returns 0 on success.
+static int ring_build(HashRing *ring, const char (*names)[NODE_NAME_LEN], int owners, int vnodes) {
+    RingPoint *points = malloc((size_t)(owners * vnodes) * sizeof(RingPoint));
+    if (!points && owners > 0) return -1;
+    size_t n = 0;
+    for (int o = 0; o < owners; o++) {
+        for (int v = 0; v < vnodes; v++) {
+            char label[NODE_NAME_LEN + 16];
+            int len = snprintf(label, sizeof(label), "%s#%d", names[o], v);
+            points[n].token = hash64(label, (size_t)len);
+            points[n].owner = o;
+            n++;
+        }
+    }
+    qsort(points, n, sizeof(RingPoint), ring_point_cmp);
+    free(ring->points);
+    ring->points = points;
+    ring->count = n;
+    return 0;
+}
+
+// Owner of hash: first token >= hash, wrapping around. -1 on an empty ring.
+static int ring_owner(const HashRing *ring, uint64_t hash) {
+    if (ring->count == 0) return -1;
+    size_t lo = 0, hi = ring->count;
+    while (lo < hi) {
+        size_t mid = lo + (hi - lo) / 2;
+        if (ring->points[mid].token < hash) lo = mid + 1;
+        else hi = mid;
+    }
+    return ring->points[lo == ring->count ? 0 : lo].owner;
+}
+
+// Local shard for a key
+int hash_key(const char *key) {
+    return ring_owner(&shard_ring, hash64(key, strlen(key)));
+}
+
+static int init_shard_ring(void) {
+    char names[SHARD_COUNT][NODE_NAME_LEN];
+    for (int i = 0; i < SHARD_COUNT; i++) snprintf(names[i], NODE_NAME_LEN, "shard-%d", i);
+    return ring_build(&shard_ring, (const char (*)[NODE_NAME_LEN])names, SHARD_COUNT, VNODES_PER_SHARD);
+}
+
+// Replace m's member list and rebuild its ring. Caller holds ring_lock for writing.
+static int membership_set(Membership *m, const char (*nodes)[NODE_NAME_LEN], int count) {
+    char copy[MAX_NODES][NODE_NAME_LEN];
+    memcpy(copy, nodes, (size_t)count * NODE_NAME_LEN);
+    if (ring_build(&m->ring, (const char (*)[NODE_NAME_LEN])copy, count, VNODES_PER_NODE) != 0) return -1;
+    memcpy(m->nodes, copy, (size_t)count * NODE_NAME_LEN);
+    m->node_count = count;
+    m->self = -1;
+    for (int i = 0; i < count; i++) {
+        if (strcmp(m->nodes[i], self_name) == 0) m->self = i;
+    }
+    return 0;
+}
+
+// Cluster member owning key. Returns 1 if it is this node; otherwise copies
+// the owner's "host:port" into owner (empty if the ring is empty).
+int key_owner(const char *key, char *owner) {
+    uint64_t hash = hash64(key, strlen(key));
+    pthread_rwlock_rdlock(&ring_lock);
+    int node = ring_owner(&members.ring, hash);
+    int local = node >= 0 && node == members.self;
+    owner[0] = '\0';
+    if (node >= 0 && !local) snprintf(owner, NODE_NAME_LEN, "%s", members.nodes[node]);
+    pthread_rwlock_unlock(&ring_lock);
+    return local;
+}
+
+// The member that owned key in the newest hand-off view older than generation
+// `before`, if that was another node that may still hold it. Returns 1 and
+// fills owner and *generation (that view's) in that case.
+int key_previous_owner(const char *key, uint64_t before, char *owner, uint64_t *generation) {
+    uint64_t hash = hash64(key, strlen(key));
+    int remote = 0;
+    pthread_rwlock_rdlock(&ring_lock);
+    for (int v = 0; v < handoff_count && !remote; v++) {
+        const HandoffView *h = &handoff_views[v];
+        int node = h->generation < before ? ring_owner(&h->view.ring, hash) : -1;
+        if (node < 0 || node == h->view.self || h->migrated[node]) continue;
+        snprintf(owner, NODE_NAME_LEN, "%s", h->view.nodes[node]);
+        *generation = h->generation;
+        remote = 1;
+    }
+    pthread_rwlock_unlock(&ring_lock);
+    return remote;
+}
+
+// A member moved out every key it did not own at ring generation `generation`,
+// so views older than that no longer hold keys on it. A view is dropped once
+// all its members got there. Returns -1 if this node has not seen that
+// generation yet; the member retries.
+int ring_migrated(const char *node, uint64_t generation) {
+    pthread_rwlock_wrlock(&ring_lock);
+    int ret = generation > ring_generation ? -1 : 0;
+    for (int v = 0; v < handoff_count && ret == 0; ) {
+        HandoffView *h = &handoff_views[v];
+        int pending = 0;
+        for (int i = 0; i < h->view.node_count; i++) {
+            if (h->generation < generation && strcmp(h->view.nodes[i], node) == 0) h->migrated[i] = 1;
+            pending += !h->migrated[i];
+        }
+        if (pending) {
+            v++;
+            continue;
+        }
+        printf("Ring: hand-off from generation %llu finished\n", (unsigned long long)h->generation);
+        free(h->view.ring.points);
+        handoff_count--;
+        memmove(h, h + 1, (size_t)(handoff_count - v) * sizeof(HandoffView));
+    }
+    pthread_rwlock_unlock(&ring_lock);
+    return ret;
+}
+
+void request_migration(void);
+
+// Add (join = 1) or remove a member, keeping the old view for hand-off reads,
+// then start streaming keys this node no longer owns. Returns 0 on success.
+int ring_change(const char *node, int join) {
+    pthread_rwlock_wrlock(&ring_lock);
+    char nodes[MAX_NODES][NODE_NAME_LEN];
+    int count = 0, found = 0;
+    for (int i = 0; i < members.node_count; i++) {
+        if (strcmp(members.nodes[i], node) == 0) {
+            found = 1;
+            if (!join) continue;
+        }
+        memcpy(nodes[count++], members.nodes[i], NODE_NAME_LEN);
+    }
+    int ret = -1;
+    if (join && !found && count < MAX_NODES && strlen(node) < NODE_NAME_LEN) {
+        snprintf(nodes[count++], NODE_NAME_LEN, "%s", node);
+        ret = 0;
+    } else if (!join && found && count > 0) {
+        ret = 0;
+    }
+    if (ret == 0) {
+        Membership next = { .ring = { NULL, 0 } };
+        ret = membership_set(&next, (const char (*)[NODE_NAME_LEN])nodes, count);
+        if (ret == 0) {
+            if (handoff_count == RING_HANDOFF_VIEWS) {
+                HandoffView *oldest = &handoff_views[--handoff_count];
+                printf("Ring: dropping hand-off view %llu before its keys finished moving\n",
+                       (unsigned long long)oldest->generation);
+                free(oldest->view.ring.points);
+            }
+            memmove(handoff_views + 1, handoff_views, (size_t)handoff_count * sizeof(HandoffView));
+            handoff_views[0] = (HandoffView){ .view = members, .generation = ring_generation };
+            handoff_count++;
+            members = next;
+            ring_generation++;
+        }
+    }
+    pthread_rwlock_unlock(&ring_lock);
+    if (ret == 0) {
+        printf("Ring %s %s: %d member(s)\n", join ? "joined by" : "left by", node, count);
+        request_migration();
+    }
+    return ret;
+}
+
+// ----------------------
+// Store Key-Value in the shard
+// ----------------------
+// Overwrites an existing key in a shard's entries, otherwise appends.
+// Takes over the caller's reference to value (released on failure).
+// Returns -1 if the shard is full.
+static int shard_put(KeyValue *entries, int *size, const char *key, ValueBuffer *value) {
+    for (int i = 0; i < *size; i++) {
+        if (strcmp(entries[i].key, key) == 0) {
+            ValueBuffer *old = entries[i].value;
+            entries[i].value = value;
+            value_release(old);    // Readers holding the old buffer keep their own reference
+            return 0;
+        }
+    }
+    if (*size >= SHARD_CAPACITY) {
+        value_release(value);
+        return -1;
+    }
+    snprintf(entries[*size].key, sizeof(entries[0].key), "%s", key);
+    entries[*size].value = value;
+    (*size)++;
+    return 0;
+}
+
+// Caller holds locks[shard]
+static int put_value_locked(int shard, const char *key, ValueBuffer *value) {
+    return shard_put(store[shard], &store_size[shard], key, value);
+}
+
+// The buffer is built before the shard is locked. Returns -1 on a full shard or OOM.
+int put_value(const char *key, const char *value, size_t len) {
+    ValueBuffer *buffer = value_create(key, value, len);
+    if (!buffer) return -1;
+    int shard = hash_key(key);
+    pthread_mutex_lock(&locks[shard]);
+    int ret = put_value_locked(shard, key, buffer);
+    pthread_mutex_unlock(&locks[shard]);
+    return ret;
+}
+
+// ----------------------
+// Retrieve Value from the shard
+// ----------------------
+/*
+const char *get_value(const char *key) {
+    int shard = hash_key(key);
+    pthread_mutex_lock(&locks[shard]);
+    for (int i = 0; i < store_size[shard]; i++) {
+        if (strcmp(store[shard][i].key, key) == 0) {
+            pthread_mutex_unlock(&locks[shard]);
+            return store[shard][i].value;
+        }
+    }
+    pthread_mutex_unlock(&locks[shard]);
+    return NULL;
+}
+*/
+/*
+const char *get_value(const char *key) {
+    if (key == NULL) return NULL; // Ensure key is not NULL
+
+    int shard = hash_key(key);
+    pthread_mutex_lock(&locks[shard]);
+
+    for (int i = 0; i < store_size[shard]; i++) {
+        if (strcmp(store[shard][i].key, key) == 0) {
+            pthread_mutex_unlock(&locks[shard]);
+            return store[shard][i].value; // Ensure returned value exists
+        }
+    }
+
+    pthread_mutex_unlock(&locks[shard]);
+    return NULL;
+}
+*/
+// Returns a reference the caller drops with value_release(), or NULL.
+// Every caller gets its own reference, so concurrent GETs never share scratch memory.
+ValueBuffer *get_value(const char *key) {
+    int shard = hash_key(key);
+    pthread_mutex_lock(&locks[shard]);
+    
+    for (int i = 0; i < store_size[shard]; i++) {
+        if (strcmp(store[shard][i].key, key) == 0) {
+            ValueBuffer *value = value_ref(store[shard][i].value);
+            pthread_mutex_unlock(&locks[shard]);
+            return value;
+        }
+    }
+    
+    pthread_mutex_unlock(&locks[shard]);
+    return NULL;
+}
+
+
+// ----------------------
+// Preallocated HTTP responses
+// ----------------------
+// Fixed bodies are wrapped once at startup; libmicrohttpd reference counts
+// responses, so the same object can be queued on any number of connections.
+static struct MHD_Response *resp_success, *resp_not_found, *resp_invalid, *resp_invalid_batch, *resp_store_full,
+                            *resp_misdirected, *resp_no_leader, *resp_value_too_large;
+
+static struct MHD_Response *make_static_response(const char *text) {
+    return MHD_create_response_from_buffer(strlen(text), (void *)text, MHD_RESPMEM_PERSISTENT);
+}
+
+static int init_static_responses(void) {
+    resp_success = make_static_response("{ \"status\": \"success\" }");
+    resp_not_found = make_static_response("{ \"error\": \"Key not found\" }");
+    resp_invalid = make_static_response("{ \"error\": \"Invalid Request\" }");
+    resp_invalid_batch = make_static_response("{ \"error\": \"Invalid batch body\" }");
+    resp_store_full = make_static_response("{ \"error\": \"Shard full\" }");
+    resp_misdirected = make_static_response("{ \"error\": \"Batch keys are owned by other nodes\" }");
+    resp_no_leader = make_static_response("{ \"error\": \"No replication leader\" }");
+    resp_value_too_large = make_static_response("{ \"error\": \"Value too large\" }");
+    return resp_success && resp_not_found && resp_invalid && resp_invalid_batch && resp_store_full &&
+           resp_misdirected && resp_no_leader && resp_value_too_large ? 0 : -1;
+}
+
+static void destroy_static_responses(void) {
+    MHD_destroy_response(resp_success);
+    MHD_destroy_response(resp_not_found);
+    MHD_destroy_response(resp_invalid);
+    MHD_destroy_response(resp_invalid_batch);
+    MHD_destroy_response(resp_store_full);
+    MHD_destroy_response(resp_misdirected);
+    MHD_destroy_response(resp_no_leader);
+    MHD_destroy_response(resp_value_too_large);
+}
+
+// ----------------------
+// Request bodies
+// ----------------------
+typedef struct {
+    char *data;                    // NUL-terminated once complete
+    size_t len;
+    size_t cap;
+    int too_large;
+} RequestBody;
+
+static void request_body_append(RequestBody *body, const char *data, size_t size) {
+    if (body->too_large || body->len + size > MAX_REQUEST_BODY) {
+        body->too_large = 1;
+        return;
+    }
+    if (body->len + size + 1 > body->cap) {
+        size_t cap = body->cap ? body->cap : 1024;
+        while (cap < body->len + size + 1) cap *= 2;
+        char *grown = realloc(body->data, cap);
+        if (!grown) {
+            body->too_large = 1;
+            return;
+        }
+        body->data = grown;
+        body->cap = cap;
+    }
+    memcpy(body->data + body->len, data, size);
+    body->len += size;
+    body->data[body->len] = '\0';
+}
+
+static void request_completed(void *cls, struct MHD_Connection *connection,
+                              void **con_cls, enum MHD_RequestTerminationCode toe) {
+    (void)cls; (void)connection; (void)toe;
+    RequestBody *body = *con_cls;
+    if (body) {
+        free(body->data);
+        free(body);
+        *con_cls = NULL;
+    }
+}
+
+// ----------------------
+// Batch Get / Put
+// ----------------------
+typedef struct {
+    char key[256];
+    ValueBuffer *value;            // /mset input, /mget result (NULL = missing)
+    int shard;
+} BatchItem;
+
+static void batch_release(BatchItem *items, size_t count) {
+    for (size_t i = 0; i < count; i++) value_release(items[i].value);
+}
+
+// Stable counting sort of batch items by shard, so each shard lock is
+// taken once per batch and duplicate keys keep their request order
+static void group_by_shard(BatchItem *items, size_t count, size_t *order) {
+    size_t start[SHARD_COUNT + 1] = {0};
+    for (size_t i = 0; i < count; i++) {
+        items[i].shard = hash_key(items[i].key);
+        start[items[i].shard + 1]++;
+    }
+    for (int s = 0; s < SHARD_COUNT; s++) start[s + 1] += start[s];
+    for (size_t i = 0; i < count; i++) order[start[items[i].shard]++] = i;
+}
+
+int multi_get(BatchItem *items, size_t count) {
+    size_t *order = malloc(count * sizeof(size_t));
+    if (!order) return -1;
+    group_by_shard(items, count, order);
+
+    for (size_t i = 0; i < count; ) {
+        int shard = items[order[i]].shard;
+        pthread_mutex_lock(&locks[shard]);
+        for (; i < count && items[order[i]].shard == shard; i++) {
+            BatchItem *item = &items[order[i]];
+            item->value = NULL;
+            for (int j = 0; j < store_size[shard]; j++) {
+                if (strcmp(store[shard][j].key, item->key) == 0) {
+                    item->value = value_ref(store[shard][j].value);
+                    break;
+                }
+            }
+        }
+        pthread_mutex_unlock(&locks[shard]);
+    }
+    free(order);
+    return 0;
+}
+
+// Returns 0 on success, -1 if a shard filled up part-way (earlier keys stay stored)
+int multi_put(BatchItem *items, size_t count) {
+    size_t *order = malloc(count * sizeof(size_t));
+    if (!order) return -1;
+    group_by_shard(items, count, order);
+
+    int ret = 0;
+    for (size_t i = 0; i < count && ret == 0; ) {
+        int shard = items[order[i]].shard;
+        pthread_mutex_lock(&locks[shard]);
+        for (; i < count && items[order[i]].shard == shard && ret == 0; i++) {
+            ret = put_value_locked(shard, items[order[i]].key, value_ref(items[order[i]].value));
+        }
+        pthread_mutex_unlock(&locks[shard]);
+    }
+    free(order);
+    return ret;
+}
+
+// Store keys handed over by their previous owner. Keys already present were
+// written here after the ownership change and are newer, so they are kept.
+// Returns 0 on success, -1 if a shard filled up part-way.
+int migrate_put(BatchItem *items, size_t count) {
+    size_t *order = malloc(count * sizeof(size_t));
+    if (!order) return -1;
+    group_by_shard(items, count, order);
+
+    int ret = 0;
+    for (size_t i = 0; i < count && ret == 0; ) {
+        int shard = items[order[i]].shard;
+        pthread_mutex_lock(&locks[shard]);
+        for (; i < count && items[order[i]].shard == shard && ret == 0; i++) {
+            BatchItem *item = &items[order[i]];
+            int present = 0;
+            for (int j = 0; j < store_size[shard] && !present; j++) {
+                present = strcmp(store[shard][j].key, item->key) == 0;
+            }
+            if (!present) ret = put_value_locked(shard, item->key, value_ref(item->value));
+        }
+        pthread_mutex_unlock(&locks[shard]);
+    }
+    free(order);
+    return ret;
+}
+
+// Drop keys whose stored value still equals the given one: copies a new owner
+// acknowledged, unless a write replaced them meanwhile. Always returns 0.
+int remove_matching(BatchItem *items, size_t count) {
+    for (size_t i = 0; i < count; i++) {
+        int shard = hash_key(items[i].key);
+        pthread_mutex_lock(&locks[shard]);
+        for (int j = 0; j < store_size[shard]; j++) {
+            if (strcmp(store[shard][j].key, items[i].key) != 0) continue;
+            const ValueBuffer *v = store[shard][j].value;
+            if (v->len == items[i].value->len && memcmp(value_bytes(v), value_bytes(items[i].value), v->len) == 0) {
+                value_release(store[shard][j].value);
+                store[shard][j] = store[shard][--store_size[shard]];
+            }
+            break;
+        }
+        pthread_mutex_unlock(&locks[shard]);
+    }
+    return 0;
+}
+
+// Step over a length-prefixed field of a binary body (network byte order length).
+// Returns the field's bytes and stores its length, or NULL if truncated.
+static const char *read_binary_field(const char **p, const char *end, int len_bytes, uint32_t *len) {
+    if (end - *p < len_bytes) return NULL;
+    if (len_bytes == 2) {
+        uint16_t len16;
+        memcpy(&len16, *p, 2);
+        *len = ntohs(len16);
+    } else {
+        memcpy(len, *p, 4);
+        *len = ntohl(*len);
+    }
+    *p += len_bytes;
+    if ((size_t)(end - *p) < *len) return NULL;
+    const char *field = *p;
+    *p += *len;
+    return field;
+}
+
+// Decode a batch body into items. Returns the item count or -1.
+//   JSON:   /mget {"keys": ["k1", ...]}        /mset {"k1": "v1", ...}
+//   Binary: u32 count, then count x { u16 key_len, key [, u32 value_len, value] }
+//           (value fields only for /mset, all lengths in network byte order)
+// Parsed values are references; release them with batch_release() even on failure.
+static long parse_batch_request(const RequestBody *body, int binary, int with_values, BatchItem *items) {
+    size_t count = 0;
+    memset(items, 0, MAX_BATCH_KEYS * sizeof(BatchItem));
+    if (binary) {
+        const char *p = body->data, *end = body->data + body->len;
+        uint32_t n32;
+        if (body->len < 4) return -1;
+        memcpy(&n32, p, 4);
+        p += 4;
+        size_t n = ntohl(n32);
+        if (n > MAX_BATCH_KEYS) return -1;
+        for (; count < n; count++) {
+            uint32_t len;
+            const char *field = read_binary_field(&p, end, 2, &len);
+            if (!field || len == 0 || len >= sizeof(items[count].key)) return -1;
+            memcpy(items[count].key, field, len);
+            items[count].key[len] = '\0';
+            if (!with_values) continue;
+            if (!(field = read_binary_field(&p, end, 4, &len)) ||
+                !(items[count].value = value_create(items[count].key, field, len))) return -1;
+        }
+        return p == end ? (long)count : -1;
+    }
+
+    cJSON *root = cJSON_ParseWithLength(body->data, body->len);
+    if (!root) return -1;
+    const cJSON *list = with_values ? root : cJSON_GetObjectItemCaseSensitive(root, "keys");
+    const cJSON *entry;
+    long ret = (with_values ? cJSON_IsObject(list) : cJSON_IsArray(list)) ? 0 : -1;
+    cJSON_ArrayForEach(entry, list) {
+        if (ret < 0) break;
+        const char *key = with_values ? entry->string : entry->valuestring;
+        if (count >= MAX_BATCH_KEYS || !key || !*key || strlen(key) >= sizeof(items[0].key) ||
+            !cJSON_IsString(entry)) {
+            ret = -1;
+            break;
+        }
+        strcpy(items[count].key, key);
+        if (with_values &&
+            !(items[count].value = value_create(key, entry->valuestring, strlen(entry->valuestring)))) {
+            ret = -1;
+            break;
+        }
+        count++;
+    }
+    cJSON_Delete(root);
+    return ret < 0 ? -1 : (long)count;
+}
+
+// Binary /mget response: u32 count, then count x { u16 key_len, key,
+// u32 value_len (0xFFFFFFFF = missing), value }, network byte order
+static char *encode_binary_response(const BatchItem *items, size_t count, size_t *out_len) {
+    size_t len = 4;
+    for (size_t i = 0; i < count; i++) {
+        len += 2 + strlen(items[i].key) + 4 + (items[i].value ? items[i].value->len : 0);
+    }
+    char *out = malloc(len), *p = out;
+    if (!out) return NULL;
+    uint32_t n32 = htonl((uint32_t)count);
+    memcpy(p, &n32, 4);
+    p += 4;
+    for (size_t i = 0; i < count; i++) {
+        uint16_t key_len = (uint16_t)strlen(items[i].key), key_len_be = htons(key_len);
+        const ValueBuffer *v = items[i].value;
+        uint32_t value_len = v ? v->len : 0, value_len_be = htonl(v ? value_len : 0xFFFFFFFFu);
+        memcpy(p, &key_len_be, 2); p += 2;
+        memcpy(p, items[i].key, key_len); p += key_len;
+        memcpy(p, &value_len_be, 4); p += 4;
+        if (v) memcpy(p, value_bytes(v), value_len);
+        p += value_len;
+    }
+    *out_len = len;
+    return out;
+}
+
+static void free_json_text(void *text) {
+    cJSON_free(text);
+}
+
+// ----------------------
+// Peer HTTP client
+// ----------------------
+// Small blocking HTTP/1.1 client for node-to-node traffic (migration, Raft).
+// Responses are read with Content-Length framing so one connection can carry
+// several pipelined requests.
+typedef struct {
+    char *data;                    // Bytes received but not yet consumed
+    size_t len;
+    size_t cap;
+} PeerBuffer;
+
+static int send_all(int fd, const char *data, size_t len) {
+    while (len > 0) {
+        ssize_t n = send(fd, data, len, MSG_NOSIGNAL);
+        if (n <= 0) return -1;
+        data += n;
+        len -= (size_t)n;
+    }
+    return 0;
+}
+
+// Connect to node ("ipv4:port"); reads and writes (and the connect itself)
+// give up after timeout_ms. Returns the socket or -1.
+static int peer_connect(const char *node, int timeout_ms) {
+    char host[NODE_NAME_LEN];
+    snprintf(host, sizeof(host), "%s", node);
+    char *colon = strrchr(host, ':');
+    if (!colon) return -1;
+    *colon = '\0';
+    struct sockaddr_in addr = { .sin_family = AF_INET, .sin_port = htons((uint16_t)atoi(colon + 1)) };
+    if (inet_pton(AF_INET, host, &addr.sin_addr) != 1) return -1;
+
+    int fd = socket(AF_INET, SOCK_STREAM, 0);
+    if (fd < 0) return -1;
+    struct timeval timeout = { .tv_sec = timeout_ms / 1000, .tv_usec = (timeout_ms % 1000) * 1000 };
+    setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+    setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof(timeout));
+    int one = 1;
+    setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+    if (connect(fd, (struct sockaddr *)&addr, sizeof(addr)) != 0) {
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+static int peer_send_request(int fd, const char *node, const char *path, const char *body, size_t len,
+                             int keep_alive) {
+    char header[256 + NODE_NAME_LEN];
+    int header_len = snprintf(header, sizeof(header),
+                              "POST %s HTTP/1.1\r\nHost: %s\r\nContent-Type: " BINARY_CONTENT_TYPE "\r\n"
+                              "Content-Length: %zu\r\nConnection: %s\r\n\r\n",
+                              path, node, len, keep_alive ? "keep-alive" : "close");
+    if (header_len < 0 || (size_t)header_len >= sizeof(header)) return -1;
+    return send_all(fd, header, (size_t)header_len) == 0 && send_all(fd, body, len) == 0 ? 0 : -1;
+}
+
+// Value of header name in the header block [start, end), or NULL
+static const char *find_header(const char *start, const char *end, const char *name, size_t *len) {
+    size_t name_len = strlen(name);
+    for (const char *line = start; line < end; ) {
+        const char *eol = memchr(line, '\n', (size_t)(end - line));
+        if (!eol) eol = end;
+        if ((size_t)(eol - line) > name_len && strncasecmp(line, name, name_len) == 0 && line[name_len] == ':') {
+            const char *value = line + name_len + 1;
+            while (value < eol && *value == ' ') value++;
+            *len = (size_t)(eol - value);
+            if (*len > 0 && value[*len - 1] == '\r') (*len)--;
+            return value;
+        }
+        line = eol + 1;
+    }
+    return NULL;
+}
+
+// Read one response. The body (malloc'd, may be NULL when empty) goes to
+// *body; a Location header, if any, is copied to location. Returns the
+// status or -1 on a connection error.
+static int peer_read_response(int fd, PeerBuffer *in, char **body, size_t *body_len,
+                              char *location, size_t location_size) {
+    *body = NULL;
+    *body_len = 0;
+    for (;;) {
+        const char *end = in->len ? memmem(in->data, in->len, "\r\n\r\n", 4) : NULL;
+        if (end) {
+            size_t header_len = (size_t)(end - in->data) + 4, content_len = 0, value_len;
+            const char *value = find_header(in->data, end, "Content-Length", &value_len);
+            if (value) content_len = strtoul(value, NULL, 10);
+            if (content_len > MAX_REQUEST_BODY) return -1;
+            if (in->len >= header_len + content_len) {
+                int status;
+                if (sscanf(in->data, "HTTP/%*s %d", &status) != 1) return -1;
+                if (location && (value = find_header(in->data, end, "Location", &value_len))) {
+                    snprintf(location, location_size, "%.*s", (int)value_len, value);
+                }
+                if (content_len > 0) {
+                    if (!(*body = malloc(content_len))) return -1;
+                    memcpy(*body, in->data + header_len, content_len);
+                    *body_len = content_len;
+                }
+                in->len -= header_len + content_len;
+                memmove(in->data, in->data + header_len + content_len, in->len);
+                return status;
+            }
+        }
+        if (in->len == in->cap) {
+            size_t cap = in->cap ? in->cap * 2 : 4096;
+            char *grown = cap <= 2 * (size_t)MAX_REQUEST_BODY ? realloc(in->data, cap) : NULL;
+            if (!grown) return -1;
+            in->data = grown;
+            in->cap = cap;
+        }
+        ssize_t got = recv(fd, in->data + in->len, in->cap - in->len, 0);
+        if (got <= 0) return -1;
+        in->len += (size_t)got;
+    }
+}
+
+// One-shot POST to node. A 307 (a follower pointing at its leader) is followed
+// once. Returns the status or -1; the reply body, if wanted, is malloc'd.
+static int http_post(const char *node, const char *path, const char *body, size_t len, int timeout_ms,
+                     char **reply, size_t *reply_len) {
+    char target[NODE_NAME_LEN], location[NODE_NAME_LEN + 1024] = "";
+    snprintf(target, sizeof(target), "%s", node);
+    int status = -1;
+    for (int attempt = 0; attempt < 2; attempt++) {
+        int fd = peer_connect(target, timeout_ms);
+        if (fd < 0) return -1;
+        PeerBuffer in = { NULL, 0, 0 };
+        char *data = NULL;
+        size_t data_len = 0;
+        status = peer_send_request(fd, target, path, body, len, 0) == 0
+                     ? peer_read_response(fd, &in, &data, &data_len, location, sizeof(location)) : -1;
+        close(fd);
+        free(in.data);
+        // Location is http://host:port/path; keep the host:port part
+        const char *host = strncmp(location, "http://", 7) == 0 ? location + 7 : NULL;
+        size_t host_len = host ? strcspn(host, "/") : 0;
+        if (status == MHD_HTTP_TEMPORARY_REDIRECT && attempt == 0 && host_len > 0 && host_len < NODE_NAME_LEN) {
+            free(data);
+            snprintf(target, sizeof(target), "%.*s", (int)host_len, host);
+            continue;
+        }
+        if (reply) {
+            *reply = data;
+            *reply_len = data_len;
+        } else {
+            free(data);
+        }
+        break;
+    }
+    return status;
+}
+
+// ----------------------
+// Replicated log (Raft)
+// ----------------------
+// With --raft-self the store becomes a replicated state machine: every write
+// is a log entry (a binary /mset body plus an op code), committed once a
+// majority of replicas stored it and applied in log order by one thread.
+//  - The leader streams entries to each follower over a keep-alive connection
+//    with up to RAFT_MAX_INFLIGHT AppendEntries batches in flight; a sender
+//    thread writes batches and a receiver thread matches the responses.
+//  - Each AppendEntries acknowledged by a majority extends the leader's lease.
+//    Followers ignore votes for RAFT_ELECTION_MIN_MS after hearing from the
+//    leader or restarting, so no other leader can exist while the lease
+//    (shorter by a drift margin) holds, and the leader serves reads locally
+//    without a round trip.
+//  - The applied state is snapshotted every RAFT_SNAPSHOT_ENTRIES entries and
+//    the log prefix dropped; followers behind the snapshot get it in chunks.
+// Term, vote, log and snapshot live in --raft-dir; the leader fsyncs its log
+// in groups, off the request path, and counts only synced entries for commit.
+enum { RAFT_OP_NOOP, RAFT_OP_PUT, RAFT_OP_MIGRATE, RAFT_OP_REMOVE };
+enum { RAFT_FOLLOWER, RAFT_CANDIDATE, RAFT_LEADER };
+
+typedef struct {
+    uint64_t term;
+    int op;
+    uint32_t len;
+    char *payload;                 // Binary /mset body
+} RaftEntry;
+
+typedef struct {
+    uint64_t sent_ms;
+    uint64_t term;
+} RaftInflight;
+
+typedef struct {
+    char addr[NODE_NAME_LEN];
+    uint64_t next_index;
+    uint64_t match_index;
+    uint64_t ack_ms;               // Send time of the newest acknowledged AppendEntries
+    uint64_t last_send_ms;
+    uint64_t resume_index;         // Where to restart after a rejected batch, 0 = match_index + 1
+    int vote_granted;
+    int fd;                        // Replication connection, -1 when closed
+    int broken;                    // Set when fd must be dropped; the receiver closes it
+    RaftInflight inflight[RAFT_MAX_INFLIGHT];
+    int inflight_head, inflight_count;
+    pthread_t sender, receiver;
+} RaftPeer;
+
+typedef struct {
+    int enabled;
+    char self[NODE_NAME_LEN];
+    char dir[256];
+    RaftPeer peers[MAX_NODES];     // The other replicas
+    int peer_count;
+    pthread_mutex_t lock;
+    pthread_cond_t cond;           // Log, commit, apply or role changed
+
+    // Persistent state
+    uint64_t term;
+    char voted_for[NODE_NAME_LEN];
+    RaftEntry *log;                // log[i] holds index snap_index + 1 + i
+    size_t log_count, log_cap;
+    uint64_t snap_index, snap_term;
+    char *snapshot;                // Serialized store at snap_index
+    size_t snapshot_len;
+    int log_fd;
+
+    // Volatile state
+    _Atomic int role;
+    char leader[NODE_NAME_LEN];
+    int votes;
+    uint64_t commit_index;
+    uint64_t synced_index;         // Local log fsynced up to here
+    uint64_t log_generation;       // Bumped when the log is truncated or rewritten
+    _Atomic uint64_t last_applied;
+    _Atomic uint64_t term_start_index;  // The leader's no-op entry for its term
+    _Atomic uint64_t lease_until_ms;
+    uint64_t election_deadline_ms;
+    uint64_t leader_contact_ms;
+    int applying;                  // Apply thread is outside the lock applying an entry
+    int results[RAFT_RESULT_SLOTS];
+    uint64_t result_index[RAFT_RESULT_SLOTS];
+
+    // Snapshot being received from the leader
+    char *incoming;
+    size_t incoming_len, incoming_cap;
+    uint64_t incoming_index;
+} RaftState;
+
+RaftState raft = { .lock = PTHREAD_MUTEX_INITIALIZER, .cond = PTHREAD_COND_INITIALIZER, .log_fd = -1 };
+
+static uint64_t now_ms(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000 + (uint64_t)ts.tv_nsec / 1000000;
+}
+
+static void cond_wait_ms(pthread_cond_t *cond, pthread_mutex_t *lock, uint64_t ms) {
+    struct timespec ts;
+    clock_gettime(CLOCK_REALTIME, &ts);
+    ts.tv_sec += (time_t)(ms / 1000);
+    ts.tv_nsec += (long)(ms % 1000) * 1000000;
+    if (ts.tv_nsec >= 1000000000L) {
+        ts.tv_sec++;
+        ts.tv_nsec -= 1000000000L;
+    }
+    pthread_cond_timedwait(cond, lock, &ts);
+}
+
+static int raft_majority(void) {
+    return (raft.peer_count + 1) / 2 + 1;
+}
+
+static uint64_t raft_last_index(void) {
+    return raft.snap_index + raft.log_count;
+}
+
+static RaftEntry *raft_entry(uint64_t index) {
+    return &raft.log[index - raft.snap_index - 1];
+}
+
+// Term of a log index; 0 for index 0 or one already compacted away
+static uint64_t raft_term_at(uint64_t index) {
+    if (index == raft.snap_index) return raft.snap_term;
+    if (index < raft.snap_index || index > raft_last_index()) return 0;
+    return raft_entry(index)->term;
+}
+
+static void raft_reset_election_timer(void) {
+    raft.election_deadline_ms = now_ms() + RAFT_ELECTION_MIN_MS +
+                                (uint64_t)(rand() % (RAFT_ELECTION_MAX_MS - RAFT_ELECTION_MIN_MS));
+}
+
+// Big-endian field helpers for the Raft wire and file formats
+static char *put_u64(char *p, uint64_t v) {
+    uint64_t be = htobe64(v);
+    memcpy(p, &be, 8);
+    return p + 8;
+}
+
+static uint64_t get_u64(const char *p) {
+    uint64_t be;
+    memcpy(&be, p, 8);
+    return be64toh(be);
+}
+
+static char *put_u32(char *p, uint32_t v) {
+    uint32_t be = htonl(v);
+    memcpy(p, &be, 4);
+    return p + 4;
+}
+
+static uint32_t get_u32(const char *p) {
+    uint32_t be;
+    memcpy(&be, p, 4);
+    return ntohl(be);
+}
+
+// Length-prefixed node address: u16 length, bytes
+static char *put_addr(char *p, const char *addr) {
+    uint16_t len = (uint16_t)strlen(addr), be = htons(len);
+    memcpy(p, &be, 2);
+    memcpy(p + 2, addr, len);
+    return p + 2 + len;
+}
+
+static const char *get_addr(const char *p, const char *end, char *addr) {
+    uint16_t be;
+    if (end - p < 2) return NULL;
+    memcpy(&be, p, 2);
+    size_t len = ntohs(be);
+    if ((size_t)(end - p - 2) < len || len >= NODE_NAME_LEN) return NULL;
+    memcpy(addr, p + 2, len);
+    addr[len] = '\0';
+    return p + 2 + len;
+}
+
+// ----- Persistence -----
+// raft_state:    "term voted_for\n" (voted_for "-" when none)
+// raft_log:      records { u64 index, u64 term, u8 op, u32 len, payload };
+//                a record overrides any earlier one with the same or a later
+//                index, so truncating the log is just appending
+// raft_snapshot: u64 index, u64 term, serialized store
+
+static void raft_path(char *out, size_t size, const char *name) {
+    snprintf(out, size, "%s/%s", raft.dir, name);
+}
+
+// Write a whole file durably (temp file, fsync, rename)
+static int write_file_atomic(const char *name, const char *a, size_t a_len, const char *b, size_t b_len) {
+    char path[300], tmp[310];
+    raft_path(path, sizeof(path), name);
+    snprintf(tmp, sizeof(tmp), "%s.tmp", path);
+    int fd = open(tmp, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0) return -1;
+    int ok = write(fd, a, a_len) == (ssize_t)a_len && (!b_len || write(fd, b, b_len) == (ssize_t)b_len) &&
+             fsync(fd) == 0;
+    close(fd);
+    return ok && rename(tmp, path) == 0 ? 0 : -1;
+}
+
+static int raft_persist_state(void) {
+    char line[NODE_NAME_LEN + 32];
+    int len = snprintf(line, sizeof(line), "%llu %s\n", (unsigned long long)raft.term,
+                       raft.voted_for[0] ? raft.voted_for : "-");
+    return write_file_atomic("raft_state", line, (size_t)len, NULL, 0);
+}
+
+static int raft_write_record(int fd, uint64_t index, const RaftEntry *e) {
+    char header[21], *p = put_u64(put_u64(header, index), e->term);
+    *p++ = (char)e->op;
+    put_u32(p, e->len);
+    return write(fd, header, sizeof(header)) == (ssize_t)sizeof(header) &&
+           write(fd, e->payload, e->len) == (ssize_t)e->len ? 0 : -1;
+}
+
+// Rewrite raft_log with only the entries after the snapshot
+static int raft_rewrite_log(void) {
+    char path[300], tmp[310];
+    raft_path(path, sizeof(path), "raft_log");
+    snprintf(tmp, sizeof(tmp), "%s.tmp", path);
+    int fd = open(tmp, O_WRONLY | O_CREAT | O_TRUNC | O_APPEND, 0644);
+    if (fd < 0) return -1;
+    for (size_t i = 0; i < raft.log_count; i++) {
+        if (raft_write_record(fd, raft.snap_index + 1 + i, &raft.log[i]) != 0) {
+            close(fd);
+            return -1;
+        }
+    }
+    if (fsync(fd) != 0 || rename(tmp, path) != 0) {
+        close(fd);
+        return -1;
+    }
+    if (raft.log_fd >= 0) close(raft.log_fd);
+    raft.log_fd = fd;
+    raft.synced_index = raft_last_index();
+    raft.log_generation++;
+    return 0;
+}
+
+static int raft_persist_snapshot(void) {
+    char header[16];
+    put_u64(put_u64(header, raft.snap_index), raft.snap_term);
+    if (write_file_atomic("raft_snapshot", header, sizeof(header), raft.snapshot, raft.snapshot_len) != 0) {
+        return -1;
+    }
+    return raft_rewrite_log();
+}
+
+// Drop entries from index on (a follower's conflicting suffix)
+static void raft_truncate_locked(uint64_t index) {
+    while (raft_last_index() >= index) free(raft.log[--raft.log_count].payload);
+    if (raft.synced_index > raft_last_index()) raft.synced_index = raft_last_index();
+    raft.log_generation++;
+}
+
+// fdatasync the log written so far. Caller holds raft.lock, which is released
+// during the sync so appends and RPCs are not held up by the disk. Returns 1 if
+// synced_index now covers the log as it was when called; a truncation or
+// rewrite meanwhile already lowered or covered synced_index and wins.
+static int raft_sync_log(void) {
+    uint64_t target = raft_last_index(), generation = raft.log_generation;
+    int fd = raft.log_fd;
+    pthread_mutex_unlock(&raft.lock);
+    int synced = fdatasync(fd) == 0;
+    pthread_mutex_lock(&raft.lock);
+    if (!synced || generation != raft.log_generation) return 0;
+    if (target > raft.synced_index) raft.synced_index = target;
+    return 1;
+}
+
+// Append an entry, taking ownership of payload. Returns its index, or 0 if it
+// could not be stored.
+static uint64_t raft_append_locked(uint64_t term, int op, char *payload, uint32_t len) {
+    if (raft.log_count == raft.log_cap) {
+        size_t cap = raft.log_cap ? raft.log_cap * 2 : 1024;
+        RaftEntry *grown = realloc(raft.log, cap * sizeof(RaftEntry));
+        if (!grown) {
+            free(payload);
+            return 0;
+        }
+        raft.log = grown;
+        raft.log_cap = cap;
+    }
+    RaftEntry *e = &raft.log[raft.log_count];
+    *e = (RaftEntry){ term, op, len, payload };
+    if (raft_write_record(raft.log_fd, raft_last_index() + 1, e) != 0) {
+        free(payload);
+        return 0;
+    }
+    raft.log_count++;
+    return raft_last_index();
+}
+
+// Drop log entries up to and including index (now covered by the snapshot)
+static void raft_compact_locked(uint64_t index, uint64_t term) {
+    size_t drop = index > raft_last_index() ? raft.log_count : (size_t)(index - raft.snap_index);
+    for (size_t i = 0; i < drop; i++) free(raft.log[i].payload);
+    memmove(raft.log, raft.log + drop, (raft.log_count - drop) * sizeof(RaftEntry));
+    raft.log_count -= drop;
+    raft.snap_index = index;
+    raft.snap_term = term;
+}
+
+// ----- Store snapshots -----
+// Serialized store: u32 count, then count x { u16 key_len, key, u32 value_len,
+// value } (the binary /mset layout without the batch size limit)
+static char *store_serialize(size_t *out_len) {
+    size_t len = 4, count = 0;
+    for (int s = 0; s < SHARD_COUNT; s++) {
+        pthread_mutex_lock(&locks[s]);
+        for (int i = 0; i < store_size[s]; i++) len += 6 + strlen(store[s][i].key) + store[s][i].value->len;
+        pthread_mutex_unlock(&locks[s]);
+    }
+    char *out = malloc(len), *p = out + 4;
+    if (!out) return NULL;
+    // The apply thread is the only writer in Raft mode, so the two passes agree
+    for (int s = 0; s < SHARD_COUNT; s++) {
+        pthread_mutex_lock(&locks[s]);
+        for (int i = 0; i < store_size[s]; i++, count++) {
+            uint16_t key_len = (uint16_t)strlen(store[s][i].key), key_len_be = htons(key_len);
+            const ValueBuffer *v = store[s][i].value;
+            memcpy(p, &key_len_be, 2); p += 2;
+            memcpy(p, store[s][i].key, key_len); p += key_len;
+            p = put_u32(p, v->len);
+            memcpy(p, value_bytes(v), v->len); p += v->len;
+        }
+        pthread_mutex_unlock(&locks[s]);
+    }
+    put_u32(out, (uint32_t)count);
+    *out_len = len;
+    return out;
+}
+
+// Replace the whole store with a serialized one. The snapshot is loaded into
+// staging shards first, so a corrupt snapshot, a full shard or OOM leaves the
+// store as it was. Returns 0 on success.
+static int store_load(const char *data, size_t len) {
+    if (len > 0 && len < 4) return -1;
+    KeyValue (*staged)[SHARD_CAPACITY] = malloc(SHARD_COUNT * sizeof(*staged));
+    int staged_size[SHARD_COUNT] = {0};
+    if (!staged) return -1;
+    int ret = 0;
+    const char *p = data + 4, *end = data + len;
+    for (uint32_t n = len ? get_u32(data) : 0; n > 0 && ret == 0; n--) {
+        uint32_t key_len, value_len;
+        char key[256];
+        const char *field = read_binary_field(&p, end, 2, &key_len), *value;
+        if (!field || key_len == 0 || key_len >= sizeof(key) ||
+            !(value = read_binary_field(&p, end, 4, &value_len))) {
+            ret = -1;
+            break;
+        }
+        memcpy(key, field, key_len);
+        key[key_len] = '\0';
+        ValueBuffer *buffer = value_create(key, value, value_len);
+        int shard = hash_key(key);
+        ret = buffer ? shard_put(staged[shard], &staged_size[shard], key, buffer) : -1;
+    }
+    for (int s = 0; s < SHARD_COUNT; s++) {
+        if (ret == 0) {
+            pthread_mutex_lock(&locks[s]);
+            for (int i = 0; i < store_size[s]; i++) value_release(store[s][i].value);
+            memcpy(store[s], staged[s], (size_t)staged_size[s] * sizeof(KeyValue));
+            store_size[s] = staged_size[s];
+            pthread_mutex_unlock(&locks[s]);
+        } else {
+            for (int i = 0; i < staged_size[s]; i++) value_release(staged[s][i].value);
+        }
+    }
+    free(staged);
+    return ret;
+}
+
+// Apply a write to the local store. Returns 0, or -1 if a shard is full.
+static int store_apply(int op, BatchItem *items, size_t count) {
+    switch (op) {
+    case RAFT_OP_PUT:     return multi_put(items, count);
+    case RAFT_OP_MIGRATE: return migrate_put(items, count);
+    case RAFT_OP_REMOVE:  return remove_matching(items, count);
+    default:              return 0;
+    }
+}
+
+static int raft_apply_entry(int op, const char *payload, uint32_t len) {
+    if (op == RAFT_OP_NOOP) return 0;
+    RequestBody body = { (char *)payload, len, len, 0 };
+    BatchItem *items = malloc(MAX_BATCH_KEYS * sizeof(BatchItem));
+    if (!items) return -1;
+    long count = parse_batch_request(&body, 1, 1, items);
+    int ret = count < 0 ? -1 : store_apply(op, items, (size_t)count);
+    batch_release(items, count < 0 ? MAX_BATCH_KEYS : (size_t)count);
+    free(items);
+    return ret;
+}
+
+// ----- Roles -----
+// Drop a replication connection; its receiver closes it and resets the pipeline
+static void raft_break_connection(RaftPeer *p) {
+    if (p->fd >= 0 && !p->broken) {
+        p->broken = 1;
+        shutdown(p->fd, SHUT_RDWR);
+    }
+}
+
+static void raft_become_follower(uint64_t term) {
+    if (term > raft.term) {
+        raft.term = term;
+        raft.voted_for[0] = '\0';
+        raft.leader[0] = '\0';
+        raft_persist_state();
+    }
+    if (atomic_load(&raft.role) == RAFT_LEADER) raft.leader[0] = '\0';
+    atomic_store(&raft.role, RAFT_FOLLOWER);
+    atomic_store(&raft.lease_until_ms, 0);
+    pthread_cond_broadcast(&raft.cond);
+}
+
+static void raft_become_leader(void) {
+    atomic_store(&raft.role, RAFT_LEADER);
+    snprintf(raft.leader, sizeof(raft.leader), "%s", raft.self);
+    atomic_store(&raft.lease_until_ms, 0);
+    for (int i = 0; i < raft.peer_count; i++) {
+        RaftPeer *p = &raft.peers[i];
+        p->next_index = raft_last_index() + 1;
+        p->match_index = 0;
+        p->ack_ms = 0;
+        p->last_send_ms = 0;
+        // Responses still in flight belong to the old term: start clean
+        p->resume_index = p->next_index;
+        raft_break_connection(p);
+    }
+    // Entries from earlier terms commit with this no-op; reads wait for it
+    uint64_t index = raft_append_locked(raft.term, RAFT_OP_NOOP, NULL, 0);
+    atomic_store(&raft.term_start_index, index ? index : UINT64_MAX);
+    printf("Raft: leader for term %llu\n", (unsigned long long)raft.term);
+    pthread_cond_broadcast(&raft.cond);
+    request_migration();                       // Only the leader moves keys between ring members
+}
+
+// Leader: commit the highest index a majority stored in this term, and
+// extend the lease to the newest send time a majority acknowledged
+static void raft_leader_advance(void) {
+    uint64_t match[MAX_NODES + 1], acks[MAX_NODES + 1];
+    int n = 0;
+    match[n] = raft.synced_index;
+    acks[n++] = now_ms();
+    for (int i = 0; i < raft.peer_count; i++, n++) {
+        match[n] = raft.peers[i].match_index;
+        acks[n] = raft.peers[i].ack_ms;
+    }
+    // Insertion sort, descending; n is at most MAX_NODES + 1
+    for (int i = 1; i < n; i++) {
+        for (int j = i; j > 0 && match[j] > match[j - 1]; j--) {
+            uint64_t t = match[j]; match[j] = match[j - 1]; match[j - 1] = t;
+        }
+        for (int j = i; j > 0 && acks[j] > acks[j - 1]; j--) {
+            uint64_t t = acks[j]; acks[j] = acks[j - 1]; acks[j - 1] = t;
+        }
+    }
+    uint64_t commit = match[raft_majority() - 1];
+    if (commit > raft.commit_index && raft_term_at(commit) == raft.term) {
+        raft.commit_index = commit;
+        pthread_cond_broadcast(&raft.cond);
+    }
+    uint64_t ack = acks[raft_majority() - 1];
+    if (ack && ack + RAFT_LEASE_MS > atomic_load(&raft.lease_until_ms)) {
+        atomic_store(&raft.lease_until_ms, ack + RAFT_LEASE_MS);
+        pthread_cond_broadcast(&raft.cond);
+    }
+}
+
+// ----- Leader side: replication -----
+// AppendEntries body: u64 term, addr leader, u64 prev_index, u64 prev_term,
+// u64 leader_commit, u32 count, count x { u64 term, u8 op, u32 len, payload }
+// Reply: u64 term, u8 success, u64 index (last matching index on success,
+// otherwise where the leader should back up to)
+static char *raft_build_append(RaftPeer *p, size_t *out_len) {
+    uint64_t prev = p->next_index - 1, last = raft_last_index();
+    size_t len = 8 + 2 + strlen(raft.self) + 28, count = 0;
+    for (uint64_t i = p->next_index; i <= last; i++, count++) {
+        size_t entry = 13 + raft_entry(i)->len;
+        if (count > 0 && (len + entry > RAFT_BATCH_BYTES || count == RAFT_BATCH_ENTRIES)) break;
+        len += entry;
+    }
+    char *out = malloc(len), *q = out;
+    if (!out) return NULL;
+    q = put_u64(q, raft.term);
+    q = put_addr(q, raft.self);
+    q = put_u64(q, prev);
+    q = put_u64(q, raft_term_at(prev));
+    q = put_u64(q, raft.commit_index);
+    q = put_u32(q, (uint32_t)count);
+    for (size_t i = 0; i < count; i++) {
+        const RaftEntry *e = raft_entry(p->next_index + i);
+        q = put_u64(q, e->term);
+        *q++ = (char)e->op;
+        q = put_u32(q, e->len);
+        if (e->len) memcpy(q, e->payload, e->len);
+        q += e->len;
+    }
+    p->next_index += count;
+    *out_len = len;
+    return out;
+}
+
+// Ship the current snapshot in chunks over one-shot requests. Called and
+// returns with raft.lock held; the lock is dropped around each request.
+// Snapshot chunk body: u64 term, addr leader, u64 last_index, u64 last_term,
+// u64 offset, u8 done, chunk. Reply: u64 term, u8 accepted.
+static void raft_send_snapshot(RaftPeer *p) {
+    uint64_t index = raft.snap_index, term = raft.term;
+    size_t offset = 0;
+    for (;;) {
+        if (atomic_load(&raft.role) != RAFT_LEADER || raft.term != term || raft.snap_index != index) return;
+        size_t chunk = raft.snapshot_len - offset > RAFT_SNAPSHOT_CHUNK ? RAFT_SNAPSHOT_CHUNK
+                                                                       : raft.snapshot_len - offset;
+        int done = offset + chunk == raft.snapshot_len;
+        size_t len = 8 + 2 + strlen(raft.self) + 25 + chunk;
+        char *body = malloc(len), *q = body;
+        if (!body) return;
+        q = put_u64(q, term);
+        q = put_addr(q, raft.self);
+        q = put_u64(q, index);
+        q = put_u64(q, raft.snap_term);
+        q = put_u64(q, offset);
+        *q++ = (char)done;
+        memcpy(q, raft.snapshot + offset, chunk);
+        char addr[NODE_NAME_LEN], *reply = NULL;
+        size_t reply_len = 0;
+        memcpy(addr, p->addr, NODE_NAME_LEN);
+        pthread_mutex_unlock(&raft.lock);
+        int status = http_post(addr, "/raft/snapshot", body, len, RAFT_ELECTION_MAX_MS * 4, &reply, &reply_len);
+        free(body);
+        pthread_mutex_lock(&raft.lock);
+        int accepted = status == MHD_HTTP_OK && reply_len == 9 && reply[8];
+        uint64_t reply_term = reply_len == 9 ? get_u64(reply) : 0;
+        free(reply);
+        if (reply_term > raft.term) {
+            raft_become_follower(reply_term);
+            return;
+        }
+        if (!accepted) {
+            pthread_mutex_unlock(&raft.lock);
+            usleep(RAFT_HEARTBEAT_MS * 1000);
+            pthread_mutex_lock(&raft.lock);
+            return;
+        }
+        offset += chunk;
+        if (done) {
+            if (raft.term == term && p->match_index < index) p->match_index = index;
+            if (p->next_index <= index) p->next_index = index + 1;
+            printf("Raft: sent snapshot at %llu to %s\n", (unsigned long long)index, p->addr);
+            return;
+        }
+    }
+}
+
+static void *raft_sender(void *arg) {
+    RaftPeer *p = arg;
+    pthread_mutex_lock(&raft.lock);
+    for (;;) {
+        if (atomic_load(&raft.role) != RAFT_LEADER) {
+            cond_wait_ms(&raft.cond, &raft.lock, RAFT_HEARTBEAT_MS);
+            continue;
+        }
+        if (p->next_index <= raft.snap_index) {
+            // The entries it needs are gone: drain the pipeline, then send the snapshot
+            raft_break_connection(p);
+            if (p->fd >= 0) {
+                cond_wait_ms(&raft.cond, &raft.lock, RAFT_HEARTBEAT_MS);
+                continue;
+            }
+            raft_send_snapshot(p);
+            continue;
+        }
+        if (p->fd < 0) {
+            char addr[NODE_NAME_LEN];
+            memcpy(addr, p->addr, NODE_NAME_LEN);
+            pthread_mutex_unlock(&raft.lock);
+            int fd = peer_connect(addr, RAFT_ELECTION_MAX_MS);
+            pthread_mutex_lock(&raft.lock);
+            if (fd < 0) {
+                cond_wait_ms(&raft.cond, &raft.lock, RAFT_HEARTBEAT_MS);
+                continue;
+            }
+            p->fd = fd;
+            p->broken = 0;
+            p->inflight_head = p->inflight_count = 0;
+            p->last_send_ms = 0;
+            pthread_cond_broadcast(&raft.cond);        // Wake the receiver
+            continue;
+        }
+        uint64_t now = now_ms();
+        int pending = p->next_index <= raft_last_index();
+        if (p->broken || p->inflight_count == RAFT_MAX_INFLIGHT ||
+            (!pending && now - p->last_send_ms < RAFT_HEARTBEAT_MS)) {
+            cond_wait_ms(&raft.cond, &raft.lock, RAFT_HEARTBEAT_MS);
+            continue;
+        }
+        size_t len;
+        char *body = raft_build_append(p, &len);
+        if (!body) {
+            cond_wait_ms(&raft.cond, &raft.lock, RAFT_HEARTBEAT_MS);
+            continue;
+        }
+        RaftInflight *slot = &p->inflight[(p->inflight_head + p->inflight_count) % RAFT_MAX_INFLIGHT];
+        slot->sent_ms = now;
+        slot->term = raft.term;
+        p->inflight_count++;
+        p->last_send_ms = now;
+        int fd = p->fd;
+        char addr[NODE_NAME_LEN];
+        memcpy(addr, p->addr, NODE_NAME_LEN);
+        pthread_mutex_unlock(&raft.lock);
+        int sent = peer_send_request(fd, addr, "/raft/append", body, len, 1);
+        free(body);
+        pthread_mutex_lock(&raft.lock);
+        if (sent != 0 && p->fd == fd) raft_break_connection(p);
+    }
+    return NULL;
+}
+
+static void *raft_receiver(void *arg) {
+    RaftPeer *p = arg;
+    PeerBuffer in = { NULL, 0, 0 };
+    pthread_mutex_lock(&raft.lock);
+    for (;;) {
+        while (p->fd < 0) pthread_cond_wait(&raft.cond, &raft.lock);
+        int fd = p->fd;
+        pthread_mutex_unlock(&raft.lock);
+        char *reply;
+        size_t reply_len;
+        int status = peer_read_response(fd, &in, &reply, &reply_len, NULL, 0);
+        pthread_mutex_lock(&raft.lock);
+        if (status != MHD_HTTP_OK || reply_len != 17 || p->broken || p->inflight_count == 0) {
+            // Connection lost or out of step: the sender reconnects and backs up to match_index
+            free(reply);
+            close(fd);
+            in.len = 0;
+            p->fd = -1;
+            p->broken = 0;
+            p->inflight_count = 0;
+            // Batches sent past the last acknowledged one are resent
+            p->next_index = p->resume_index ? p->resume_index : p->match_index + 1;
+            p->resume_index = 0;
+            pthread_cond_broadcast(&raft.cond);
+            continue;
+        }
+        RaftInflight sent = p->inflight[p->inflight_head];
+        p->inflight_head = (p->inflight_head + 1) % RAFT_MAX_INFLIGHT;
+        p->inflight_count--;
+        uint64_t term = get_u64(reply), index = get_u64(reply + 9);
+        int success = reply[8];
+        free(reply);
+        if (term > raft.term) {
+            raft_become_follower(term);
+            continue;
+        }
+        if (atomic_load(&raft.role) != RAFT_LEADER || sent.term != raft.term) continue;
+        if (success) {
+            if (index > p->match_index) p->match_index = index;
+            if (sent.sent_ms > p->ack_ms) p->ack_ms = sent.sent_ms;
+            raft_leader_advance();
+        } else {
+            // Later batches in flight were built on the same wrong prefix:
+            // drop them with the connection and restart after the hint
+            p->resume_index = (index > p->match_index ? index : p->match_index) + 1;
+            raft_break_connection(p);
+        }
+        pthread_cond_broadcast(&raft.cond);
+    }
+    return NULL;
+}
+
+// ----- Elections -----
+typedef struct {
+    RaftPeer *peer;
+    uint64_t term;
+    char body[8 + 2 + NODE_NAME_LEN + 16];
+    size_t len;
+} VoteRequest;
 
-// Shards of the key-value store
-KeyValue store[SHARD_COUNT][100];
-int store_size[SHARD_COUNT] = {0};
-pthread_mutex_t locks[SHARD_COUNT];
+// RequestVote body: u64 term, addr candidate, u64 last_index, u64 last_term.
+// Reply: u64 term, u8 granted.
+static void *raft_request_vote(void *arg) {
+    VoteRequest *req = arg;
+    char *reply = NULL;
+    size_t reply_len = 0;
+    int status = http_post(req->peer->addr, "/raft/vote", req->body, req->len, RAFT_ELECTION_MIN_MS,
+                           &reply, &reply_len);
+    pthread_mutex_lock(&raft.lock);
+    if (status == MHD_HTTP_OK && reply_len == 9) {
+        uint64_t term = get_u64(reply);
+        if (term > raft.term) {
+            raft_become_follower(term);
+        } else if (reply[8] && term == req->term && raft.term == req->term &&
+                   atomic_load(&raft.role) == RAFT_CANDIDATE && !req->peer->vote_granted) {
+            req->peer->vote_granted = 1;
+            if (++raft.votes >= raft_majority()) raft_become_leader();
+        }
+    }
+    pthread_mutex_unlock(&raft.lock);
+    free(reply);
+    free(req);
+    return NULL;
+}
 
-// ----------------------
-// Helper function: Hash Key to Shard
-// ----------------------
-int hash_key(const char *key) {
-    int hash = 0;
-    while (*key) {
-        hash += *key++;
+static void raft_start_election(void) {
+    raft.term++;
+    atomic_store(&raft.role, RAFT_CANDIDATE);
+    snprintf(raft.voted_for, sizeof(raft.voted_for), "%s", raft.self);
+    raft.leader[0] = '\0';
+    raft_persist_state();
+    raft_reset_election_timer();
+    raft.votes = 1;
+    if (raft.votes >= raft_majority()) {
+        raft_become_leader();
+        return;
+    }
+    for (int i = 0; i < raft.peer_count; i++) {
+        raft.peers[i].vote_granted = 0;
+        VoteRequest *req = malloc(sizeof(*req));
+        if (!req) continue;
+        req->peer = &raft.peers[i];
+        req->term = raft.term;
+        char *q = put_u64(req->body, raft.term);
+        q = put_addr(q, raft.self);
+        q = put_u64(q, raft_last_index());
+        q = put_u64(q, raft_term_at(raft_last_index()));
+        req->len = (size_t)(q - req->body);
+        pthread_t thread;
+        if (pthread_create(&thread, NULL, raft_request_vote, req) != 0) {
+            free(req);
+            continue;
+        }
+        pthread_detach(thread);
+    }
+}
+
+// Election timer, plus group fsync of the leader's log
+static void *raft_ticker(void *arg) {
+    (void)arg;
+    pthread_mutex_lock(&raft.lock);
+    for (;;) {
+        if (atomic_load(&raft.role) != RAFT_LEADER && now_ms() >= raft.election_deadline_ms) {
+            raft_start_election();
+        }
+        if (raft_last_index() > raft.synced_index) {
+            if (raft_sync_log() && atomic_load(&raft.role) == RAFT_LEADER) raft_leader_advance();
+            continue;
+        }
+        cond_wait_ms(&raft.cond, &raft.lock, RAFT_TICK_MS);
+    }
+    return NULL;
+}
+
+// Applies committed entries in order and snapshots the store as the log grows
+static void *raft_applier(void *arg) {
+    (void)arg;
+    pthread_mutex_lock(&raft.lock);
+    for (;;) {
+        uint64_t index = atomic_load(&raft.last_applied) + 1;
+        if (index > raft.commit_index) {
+            pthread_cond_wait(&raft.cond, &raft.lock);
+            continue;
+        }
+        RaftEntry e = *raft_entry(index);
+        raft.applying = 1;
+        pthread_mutex_unlock(&raft.lock);
+        int result = raft_apply_entry(e.op, e.payload, e.len);
+        pthread_mutex_lock(&raft.lock);
+        raft.applying = 0;
+        raft.results[index % RAFT_RESULT_SLOTS] = result;
+        raft.result_index[index % RAFT_RESULT_SLOTS] = index;
+        atomic_store(&raft.last_applied, index);
+        pthread_cond_broadcast(&raft.cond);
+
+        if (index - raft.snap_index >= RAFT_SNAPSHOT_ENTRIES) {
+            uint64_t term = raft_term_at(index);
+            raft.applying = 1;                 // Keeps snapshot installs out of the store
+            pthread_mutex_unlock(&raft.lock);
+            size_t len;
+            char *snapshot = store_serialize(&len);
+            pthread_mutex_lock(&raft.lock);
+            raft.applying = 0;
+            pthread_cond_broadcast(&raft.cond);
+            if (snapshot && raft.snap_index < index) {
+                free(raft.snapshot);
+                raft.snapshot = snapshot;
+                raft.snapshot_len = len;
+                raft_compact_locked(index, term);
+                if (raft_persist_snapshot() != 0) printf("Raft: failed to persist snapshot\n");
+            } else {
+                free(snapshot);
+            }
+        }
+    }
+    return NULL;
+}
+
+// ----- Follower side: RPC handlers -----
+// Each takes a request body and fills a reply; the HTTP layer only frames them.
+
+// Common term handling for requests from a leader. Returns 0 if the request
+// is from the current term's leader.
+static int raft_accept_leader(uint64_t term, const char *leader) {
+    if (term < raft.term) return -1;
+    if (term > raft.term || atomic_load(&raft.role) != RAFT_FOLLOWER) raft_become_follower(term);
+    snprintf(raft.leader, sizeof(raft.leader), "%s", leader);
+    raft.leader_contact_ms = now_ms();
+    raft_reset_election_timer();
+    return 0;
+}
+
+static size_t raft_handle_append(const char *body, size_t len, char *reply) {
+    const char *p = body, *end = body + len;
+    char leader[NODE_NAME_LEN];
+    uint64_t term = len >= 8 ? get_u64(p) : 0;
+    int success = 0;
+    uint64_t hint = 0;
+    pthread_mutex_lock(&raft.lock);
+    if (len < 8 || !(p = get_addr(p + 8, end, leader)) || end - p < 28 || raft_accept_leader(term, leader) != 0) {
+        hint = raft_last_index();
+        goto done;
+    }
+    uint64_t prev = get_u64(p), prev_term = get_u64(p + 8), leader_commit = get_u64(p + 16);
+    uint32_t count = get_u32(p + 24);
+    p += 28;
+    if (prev > raft_last_index()) {
+        hint = raft_last_index();
+        goto done;
+    }
+    if (prev >= raft.snap_index && raft_term_at(prev) != prev_term) {
+        // Back up past the whole conflicting term in one step
+        uint64_t conflict = raft_term_at(prev);
+        hint = prev - 1;
+        while (hint > raft.snap_index && raft_term_at(hint) == conflict) hint--;
+        goto done;
     }
-    return hash % SHARD_COUNT;
+    uint64_t index = prev;
+    for (uint32_t i = 0; i < count; i++) {
+        if (end - p < 13) break;
+        uint64_t entry_term = get_u64(p);
+        int op = (unsigned char)p[8];
+        uint32_t entry_len = get_u32(p + 9);
+        p += 13;
+        if ((size_t)(end - p) < entry_len) break;
+        uint64_t next = index + 1;
+        if (next <= raft.snap_index || (next <= raft_last_index() && raft_term_at(next) == entry_term)) {
+            p += entry_len;
+            index = next;
+            continue;                          // Already have it
+        }
+        if (next <= raft_last_index()) raft_truncate_locked(next);
+        char *payload = entry_len ? malloc(entry_len) : NULL;
+        if (entry_len && !payload) break;
+        if (entry_len) memcpy(payload, p, entry_len);
+        p += entry_len;
+        if (!raft_append_locked(entry_term, op, payload, entry_len)) break;
+        index = next;
+    }
+    if (index != prev + count) {
+        hint = index;                          // Stored partially: resume after what is known good
+        goto done;
+    }
+    int intact = 1;
+    if (index > raft.synced_index) {
+        // Entries matched above may still be unsynced from an earlier append.
+        // The lock is dropped for the sync: only acknowledge entries that are still ours
+        uint64_t index_term = raft_term_at(index);
+        raft_sync_log();
+        intact = raft.term == term && raft_last_index() >= index && raft_term_at(index) == index_term;
+    }
+    success = intact && raft.synced_index >= index;
+    hint = success ? index : prev;
+    if (success && leader_commit > raft.commit_index) {
+        raft.commit_index = leader_commit < index ? leader_commit : index;
+        pthread_cond_broadcast(&raft.cond);
+    }
+done:;
+    char *q = put_u64(reply, raft.term);
+    *q++ = (char)success;
+    put_u64(q, hint);
+    pthread_mutex_unlock(&raft.lock);
+    return 17;
+}
+
+static size_t raft_handle_vote(const char *body, size_t len, char *reply) {
+    const char *p = body, *end = body + len;
+    char candidate[NODE_NAME_LEN];
+    int granted = 0;
+    pthread_mutex_lock(&raft.lock);
+    if (len >= 8 && (p = get_addr(p + 8, end, candidate)) && end - p == 16) {
+        uint64_t term = get_u64(body), last_index = get_u64(p), last_term = get_u64(p + 8);
+        // A leader heard from recently may hold a lease: do not help replace it.
+        // Startup counts as contact, since a lease may have been granted just before.
+        int leader_alive = atomic_load(&raft.role) == RAFT_LEADER ||
+                           now_ms() - raft.leader_contact_ms < RAFT_ELECTION_MIN_MS;
+        if (!leader_alive) {
+            if (term > raft.term) raft_become_follower(term);
+            uint64_t my_term = raft_term_at(raft_last_index());
+            int up_to_date = last_term > my_term || (last_term == my_term && last_index >= raft_last_index());
+            if (term == raft.term && up_to_date &&
+                (!raft.voted_for[0] || strcmp(raft.voted_for, candidate) == 0)) {
+                snprintf(raft.voted_for, sizeof(raft.voted_for), "%s", candidate);
+                granted = raft_persist_state() == 0;
+                if (granted) raft_reset_election_timer();
+            }
+        }
+    }
+    put_u64(reply, raft.term);
+    reply[8] = (char)granted;
+    pthread_mutex_unlock(&raft.lock);
+    return 9;
+}
+
+static size_t raft_handle_snapshot(const char *body, size_t len, char *reply) {
+    const char *p = body, *end = body + len;
+    char leader[NODE_NAME_LEN];
+    int accepted = 0;
+    pthread_mutex_lock(&raft.lock);
+    if (len >= 8 && (p = get_addr(p + 8, end, leader)) && end - p >= 25 &&
+        raft_accept_leader(get_u64(body), leader) == 0) {
+        uint64_t index = get_u64(p), term = get_u64(p + 8), offset = get_u64(p + 16);
+        int done = p[24];
+        const char *chunk = p + 25;
+        size_t chunk_len = (size_t)(end - chunk);
+        if (offset == 0) {
+            raft.incoming_len = 0;
+            raft.incoming_index = index;
+        }
+        if (raft.incoming_index == index && raft.incoming_len == offset) {
+            if (raft.incoming_len + chunk_len > raft.incoming_cap) {
+                size_t cap = (raft.incoming_len + chunk_len) * 2;
+                char *grown = realloc(raft.incoming, cap);
+                if (grown) {
+                    raft.incoming = grown;
+                    raft.incoming_cap = cap;
+                }
+            }
+            if (raft.incoming_len + chunk_len <= raft.incoming_cap) {
+                memcpy(raft.incoming + raft.incoming_len, chunk, chunk_len);
+                raft.incoming_len += chunk_len;
+                accepted = 1;
+            }
+        }
+        if (accepted && done && index > raft.snap_index) {
+            // Nothing may be mid-apply while the store is replaced
+            while (raft.applying) pthread_cond_wait(&raft.cond, &raft.lock);
+            char *snapshot = malloc(raft.incoming_len ? raft.incoming_len : 1);
+            accepted = snapshot && store_load(raft.incoming, raft.incoming_len) == 0;
+            if (accepted) {
+                memcpy(snapshot, raft.incoming, raft.incoming_len);
+                free(raft.snapshot);
+                raft.snapshot = snapshot;
+                raft.snapshot_len = raft.incoming_len;
+                // Keep a log suffix that agrees with the snapshot, drop the rest
+                if (raft_term_at(index) != term) raft_truncate_locked(raft.snap_index + 1);
+                raft_compact_locked(index, term);
+                if (raft.commit_index < index) raft.commit_index = index;
+                atomic_store(&raft.last_applied, index);
+                raft_persist_snapshot();
+                printf("Raft: installed snapshot at %llu\n", (unsigned long long)index);
+            } else {
+                free(snapshot);
+            }
+            pthread_cond_broadcast(&raft.cond);
+        }
+    }
+    put_u64(reply, raft.term);
+    reply[8] = (char)accepted;
+    pthread_mutex_unlock(&raft.lock);
+    return 9;
+}
+
+// ----- Client side -----
+// Where a request should go: 0 = serve here, 1 = redirect to leader (filled
+// in), -1 = no usable leader right now. Reads need a lease; writes need the
+// leader role. The fast path for a leader read is a few atomic loads.
+static int raft_route(int write, char *leader) {
+    if (!raft.enabled) return 0;
+    if (!write && atomic_load(&raft.role) == RAFT_LEADER &&
+        (raft.peer_count == 0 || now_ms() < atomic_load(&raft.lease_until_ms)) &&
+        atomic_load(&raft.last_applied) >= atomic_load(&raft.term_start_index)) return 0;
+
+    int ret = -1;
+    uint64_t deadline = now_ms() + RAFT_ELECTION_MAX_MS;
+    pthread_mutex_lock(&raft.lock);
+    while (now_ms() < deadline) {
+        if (atomic_load(&raft.role) == RAFT_LEADER) {
+            if (write) {
+                ret = 0;
+                break;
+            }
+            if ((raft.peer_count == 0 || now_ms() < atomic_load(&raft.lease_until_ms)) &&
+                atomic_load(&raft.last_applied) >= atomic_load(&raft.term_start_index)) {
+                ret = 0;
+                break;
+            }
+        } else if (raft.leader[0]) {
+            snprintf(leader, NODE_NAME_LEN, "%s", raft.leader);
+            ret = 1;
+            break;
+        }
+        cond_wait_ms(&raft.cond, &raft.lock, RAFT_TICK_MS);
+    }
+    pthread_mutex_unlock(&raft.lock);
+    return ret;
+}
+
+// Append a write on the leader and wait until it is applied. Takes ownership
+// of payload. Returns the apply result (0 or -1), or -2 if leadership was lost
+// or the entry did not commit in time.
+static int raft_propose(int op, char *payload, size_t len) {
+    pthread_mutex_lock(&raft.lock);
+    uint64_t term = raft.term, index = 0;
+    if (atomic_load(&raft.role) == RAFT_LEADER) index = raft_append_locked(term, op, payload, (uint32_t)len);
+    else free(payload);
+    if (!index) {
+        pthread_mutex_unlock(&raft.lock);
+        return -2;
+    }
+    pthread_cond_broadcast(&raft.cond);
+    uint64_t deadline = now_ms() + RAFT_PROPOSE_TIMEOUT_MS;
+    while (atomic_load(&raft.last_applied) < index && raft.term == term && now_ms() < deadline) {
+        cond_wait_ms(&raft.cond, &raft.lock, RAFT_TICK_MS);
+    }
+    int ret = -2;
+    // Applied and still ours: once the term moved on, a new leader may have
+    // replaced the entry at this index
+    if (atomic_load(&raft.last_applied) >= index && (raft.term == term || raft_term_at(index) == term)) {
+        ret = raft.result_index[index % RAFT_RESULT_SLOTS] == index ? raft.results[index % RAFT_RESULT_SLOTS] : 0;
+    }
+    pthread_mutex_unlock(&raft.lock);
+    return ret;
+}
+
+// Apply a write locally, or through the log in Raft mode. Returns 0, -1 if a
+// shard is full, -2 if this node cannot accept writes right now.
+// Large batches are split so every entry fits an AppendEntries request.
+int store_write(int op, BatchItem *items, size_t count) {
+    if (!raft.enabled) return store_apply(op, items, count);
+    for (size_t i = 0, n; i < count; i += n) {
+        size_t bytes = 4, len;
+        for (n = 0; i + n < count && n < MAX_BATCH_KEYS; n++) {
+            size_t item = 6 + strlen(items[i + n].key) + items[i + n].value->len;
+            if (n > 0 && bytes + item > RAFT_ENTRY_BYTES) break;
+            bytes += item;
+        }
+        char *payload = encode_binary_response(items + i, n, &len);
+        if (!payload) return -1;
+        int ret = raft_propose(op, payload, len);
+        if (ret != 0) return ret;
+    }
+    return 0;
+}
+
+// Load persisted state and start the Raft threads
+static int raft_start(void) {
+    char path[300], line[NODE_NAME_LEN + 32];
+    raft_path(path, sizeof(path), "raft_state");
+    FILE *f = fopen(path, "r");
+    if (f) {
+        unsigned long long term;
+        char vote[NODE_NAME_LEN];
+        if (fgets(line, sizeof(line), f) && sscanf(line, "%llu %63s", &term, vote) == 2) {
+            raft.term = term;
+            snprintf(raft.voted_for, sizeof(raft.voted_for), "%s", strcmp(vote, "-") ? vote : "");
+        }
+        fclose(f);
+    }
+
+    raft_path(path, sizeof(path), "raft_snapshot");
+    f = fopen(path, "rb");
+    if (f) {
+        char header[16];
+        fseek(f, 0, SEEK_END);
+        long size = ftell(f);
+        fseek(f, 0, SEEK_SET);
+        if (size >= 16 && fread(header, 1, 16, f) == 16) {
+            raft.snapshot_len = (size_t)size - 16;
+            raft.snapshot = malloc(raft.snapshot_len ? raft.snapshot_len : 1);
+            if (!raft.snapshot || fread(raft.snapshot, 1, raft.snapshot_len, f) != raft.snapshot_len ||
+                store_load(raft.snapshot, raft.snapshot_len) != 0) {
+                fclose(f);
+                printf("Raft: corrupt snapshot %s\n", path);
+                return -1;
+            }
+            raft.snap_index = get_u64(header);
+            raft.snap_term = get_u64(header + 8);
+        }
+        fclose(f);
+    }
+    raft.commit_index = raft.snap_index;
+    atomic_store(&raft.last_applied, raft.snap_index);
+
+    raft_path(path, sizeof(path), "raft_log");
+    raft.log_fd = open(path, O_RDWR | O_CREAT | O_APPEND, 0644);
+    if (raft.log_fd < 0) return -1;
+    f = fopen(path, "rb");
+    char header[21];
+    while (f && fread(header, 1, sizeof(header), f) == sizeof(header)) {
+        uint64_t index = get_u64(header);
+        RaftEntry e = { get_u64(header + 8), (unsigned char)header[16], get_u32(header + 17), NULL };
+        if (e.len > MAX_REQUEST_BODY || (e.len && !(e.payload = malloc(e.len))) ||
+            fread(e.payload, 1, e.len, f) != e.len) {
+            free(e.payload);
+            break;                             // Torn tail from a crash: it was never acknowledged
+        }
+        if (index <= raft.snap_index || index > raft_last_index() + 1) {
+            free(e.payload);
+            continue;
+        }
+        raft_truncate_locked(index);
+        if (raft.log_count == raft.log_cap) {
+            size_t cap = raft.log_cap ? raft.log_cap * 2 : 1024;
+            RaftEntry *grown = realloc(raft.log, cap * sizeof(RaftEntry));
+            if (!grown) {
+                free(e.payload);
+                break;
+            }
+            raft.log = grown;
+            raft.log_cap = cap;
+        }
+        raft.log[raft.log_count++] = e;
+    }
+    if (f) fclose(f);
+    // Compact the file to exactly the recovered log (drops overridden records)
+    if (raft_rewrite_log() != 0) return -1;
+
+    for (int i = 0; i < raft.peer_count; i++) raft.peers[i].fd = -1;
+    atomic_store(&raft.term_start_index, UINT64_MAX);
+    srand((unsigned int)(time(NULL) ^ getpid()));
+    raft.leader_contact_ms = now_ms();
+    raft_reset_election_timer();
+    raft.enabled = 1;
+    printf("Raft: %s with %d peer(s), log %llu..%llu, term %llu\n", raft.self, raft.peer_count,
+           (unsigned long long)raft.snap_index, (unsigned long long)raft_last_index(),
+           (unsigned long long)raft.term);
+
+    pthread_t thread;
+    if (pthread_create(&thread, NULL, raft_ticker, NULL) != 0) return -1;
+    pthread_detach(thread);
+    if (pthread_create(&thread, NULL, raft_applier, NULL) != 0) return -1;
+    pthread_detach(thread);
+    for (int i = 0; i < raft.peer_count; i++) {
+        if (pthread_create(&raft.peers[i].sender, NULL, raft_sender, &raft.peers[i]) != 0 ||
+            pthread_create(&raft.peers[i].receiver, NULL, raft_receiver, &raft.peers[i]) != 0) return -1;
+        pthread_detach(raft.peers[i].sender);
+        pthread_detach(raft.peers[i].receiver);
+    }
+    return 0;
+}
+
+// GET /raft: this replica's view of the replication group
+static int handle_raft_status(struct MHD_Connection *connection) {
+    char text[512];
+    pthread_mutex_lock(&raft.lock);
+    static const char *roles[] = { "follower", "candidate", "leader" };
+    int len = snprintf(text, sizeof(text),
+                       "{ \"self\": \"%s\", \"role\": \"%s\", \"term\": %llu, \"leader\": \"%s\", "
+                       "\"commit_index\": %llu, \"last_applied\": %llu, \"snapshot_index\": %llu, "
+                       "\"last_index\": %llu }",
+                       raft.self, roles[atomic_load(&raft.role)], (unsigned long long)raft.term, raft.leader,
+                       (unsigned long long)raft.commit_index, (unsigned long long)atomic_load(&raft.last_applied),
+                       (unsigned long long)raft.snap_index, (unsigned long long)raft_last_index());
+    pthread_mutex_unlock(&raft.lock);
+    struct MHD_Response *resp = MHD_create_response_from_buffer((size_t)len, text, MHD_RESPMEM_MUST_COPY);
+    if (!resp) return MHD_NO;
+    MHD_add_response_header(resp, MHD_HTTP_HEADER_CONTENT_TYPE, "application/json");
+    int ret = MHD_queue_response(connection, MHD_HTTP_OK, resp);
+    MHD_destroy_response(resp);
+    return ret;
+}
+
+// POST /raft/append, /raft/vote, /raft/snapshot from other replicas
+static int handle_raft_rpc(struct MHD_Connection *connection, const char *url, const RequestBody *body) {
+    char *reply = malloc(17);
+    if (!reply) return MHD_NO;
+    const char *data = body->data ? body->data : "";
+    size_t len;
+    if (!raft.enabled || body->too_large) {
+        free(reply);
+        return MHD_queue_response(connection, MHD_HTTP_BAD_REQUEST, resp_invalid);
+    }
+    if (strcmp(url, "/raft/append") == 0) len = raft_handle_append(data, body->len, reply);
+    else if (strcmp(url, "/raft/vote") == 0) len = raft_handle_vote(data, body->len, reply);
+    else len = raft_handle_snapshot(data, body->len, reply);
+    struct MHD_Response *resp = MHD_create_response_from_buffer(len, reply, MHD_RESPMEM_MUST_FREE);
+    if (!resp) {
+        free(reply);
+        return MHD_NO;
+    }
+    MHD_add_response_header(resp, MHD_HTTP_HEADER_CONTENT_TYPE, BINARY_CONTENT_TYPE);
+    int ret = MHD_queue_response(connection, MHD_HTTP_OK, resp);
+    MHD_destroy_response(resp);
+    return ret;
 }
 
 // ----------------------
-// Store Key-Value in the shard
+// Request routing
 // ----------------------
-void put_value(const char *key, const char *value) {
-    int shard = hash_key(key);
-    pthread_mutex_lock(&locks[shard]);
-    strcpy(store[shard][store_size[shard]].key, key);
-    strcpy(store[shard][store_size[shard]].value, value);
-    store_size[shard]++;
-    pthread_mutex_unlock(&locks[shard]);
+// Requests for keys this node does not own are redirected (307 keeps the
+// method and body) to the owner. A new owner that misses a key while hand-off
+// views are kept redirects the read to the key's owner in the newest of them
+// with ?handoff=<generation of that view>. That node answers from local data
+// and on a miss only tries views older than the generation, so a read walks
+// back through the previous owners and cannot bounce.
+static uint64_t handoff_generation(struct MHD_Connection *connection) {
+    const char *value = MHD_lookup_connection_value(connection, MHD_GET_ARGUMENT_KIND, "handoff");
+    return value ? strtoull(value, NULL, 10) : 0;
+}
+
+static int queue_redirect(struct MHD_Connection *connection, const char *node, const char *url, uint64_t handoff) {
+    char location[NODE_NAME_LEN + 1024], query[32] = "";
+    if (handoff) snprintf(query, sizeof(query), "?handoff=%llu", (unsigned long long)handoff);
+    int len = snprintf(location, sizeof(location), "http://%s%s%s", node, url, query);
+    if (len < 0 || (size_t)len >= sizeof(location)) {
+        return MHD_queue_response(connection, MHD_HTTP_BAD_REQUEST, resp_invalid);
+    }
+    struct MHD_Response *resp = MHD_create_response_from_buffer(0, (void *)"", MHD_RESPMEM_PERSISTENT);
+    if (!resp) return MHD_NO;
+    MHD_add_response_header(resp, MHD_HTTP_HEADER_LOCATION, location);
+    int ret = MHD_queue_response(connection, MHD_HTTP_TEMPORARY_REDIRECT, resp);
+    MHD_destroy_response(resp);
+    return ret;
+}
+
+// A request this replica may not serve (see raft_route): redirect to the
+// leader, or 503 while there is none
+static int queue_not_leader(struct MHD_Connection *connection, int route, const char *leader,
+                            const char *url, uint64_t handoff) {
+    if (route == 1) return queue_redirect(connection, leader, url, handoff);
+    return MHD_queue_response(connection, MHD_HTTP_SERVICE_UNAVAILABLE, resp_no_leader);
+}
+
+// A batch is served only if this node owns every key; a client splits its
+// batches with the same ring (GET /ring lists the members)
+static int batch_is_local(const BatchItem *items, size_t count) {
+    char owner[NODE_NAME_LEN];
+    for (size_t i = 0; i < count; i++) {
+        if (!key_owner(items[i].key, owner)) return 0;
+    }
+    return 1;
+}
+
+// Handle POST /mget and POST /mset. The body is binary when Content-Type is
+// application/octet-stream and JSON otherwise; /mget answers in the same encoding.
+static int handle_batch_request(struct MHD_Connection *connection, const RequestBody *body, int is_put) {
+    const char *type = MHD_lookup_connection_value(connection, MHD_HEADER_KIND, MHD_HTTP_HEADER_CONTENT_TYPE);
+    int binary = type && strncmp(type, BINARY_CONTENT_TYPE, strlen(BINARY_CONTENT_TYPE)) == 0;
+    if (body->too_large || body->len == 0) {
+        return MHD_queue_response(connection, MHD_HTTP_BAD_REQUEST, resp_invalid_batch);
+    }
+    char leader[NODE_NAME_LEN];
+    int route = raft_route(is_put, leader);
+    if (route != 0) return queue_not_leader(connection, route, leader, is_put ? "/mset" : "/mget", 0);
+
+    BatchItem *items = malloc(MAX_BATCH_KEYS * sizeof(BatchItem));
+    if (!items) return MHD_NO;
+    long count = parse_batch_request(body, binary, is_put, items);
+    if (count < 0) {
+        batch_release(items, MAX_BATCH_KEYS);
+        free(items);
+        return MHD_queue_response(connection, MHD_HTTP_BAD_REQUEST, resp_invalid_batch);
+    }
+    if (!batch_is_local(items, (size_t)count)) {
+        batch_release(items, (size_t)count);
+        free(items);
+        return MHD_queue_response(connection, MHD_HTTP_MISDIRECTED_REQUEST, resp_misdirected);
+    }
+    if (is_put) {
+        int ret = store_write(RAFT_OP_PUT, items, (size_t)count);
+        batch_release(items, (size_t)count);
+        free(items);
+        return MHD_queue_response(connection, ret == 0 ? MHD_HTTP_OK : MHD_HTTP_SERVICE_UNAVAILABLE,
+                                  ret == 0 ? resp_success : ret == -1 ? resp_store_full : resp_no_leader);
+    }
+
+    multi_get(items, (size_t)count);
+    struct MHD_Response *resp = NULL;
+    if (binary) {
+        size_t len;
+        char *out = encode_binary_response(items, (size_t)count, &len);
+        if (out) resp = MHD_create_response_from_buffer(len, out, MHD_RESPMEM_MUST_FREE);
+        if (out && !resp) free(out);
+    } else {
+        cJSON *result = cJSON_CreateObject();
+        for (long i = 0; result && i < count; i++) {
+            if (items[i].value) {
+                // cJSON wants a terminated string; the raw value inside the body is not
+                char *text = strndup(value_bytes(items[i].value), items[i].value->len);
+                if (!text || !cJSON_AddStringToObject(result, items[i].key, text)) {
+                    cJSON_Delete(result);
+                    result = NULL;
+                }
+                free(text);
+            } else {
+                cJSON_AddNullToObject(result, items[i].key);
+            }
+        }
+        char *text = result ? cJSON_PrintUnformatted(result) : NULL;
+        cJSON_Delete(result);
+        if (text) resp = MHD_create_response_from_buffer_with_free_callback(strlen(text), text, free_json_text);
+        if (text && !resp) cJSON_free(text);
+    }
+    batch_release(items, (size_t)count);
+    free(items);
+    if (!resp) return MHD_NO;
+
+    MHD_add_response_header(resp, MHD_HTTP_HEADER_CONTENT_TYPE, binary ? BINARY_CONTENT_TYPE : "application/json");
+    int ret = MHD_queue_response(connection, MHD_HTTP_OK, resp);
+    MHD_destroy_response(resp);
+    return ret;
 }
 
 // ----------------------
-// Retrieve Value from the shard
+// Online rebalancing
 // ----------------------
-/*
-const char *get_value(const char *key) {
-    int shard = hash_key(key);
+// After a membership change a background thread streams every key this node
+// no longer owns to its new owner, one shard at a time, with the binary /mset
+// encoding on POST /migrate. The receiver refuses keys it does not own in its
+// own view. A key is dropped locally only after the owner acknowledged it and
+// only if no newer local write replaced it meanwhile. Once nothing is left to
+// move, every member is told (POST /ring/migrated) so it can drop the hand-off
+// views this node held keys under.
+pthread_mutex_t migration_lock = PTHREAD_MUTEX_INITIALIZER;
+pthread_cond_t migration_cond = PTHREAD_COND_INITIALIZER;
+int migration_pending = 0;
+atomic_size_t misplaced_keys = 0;  // Keys still waiting to move, from the last pass
+
+void request_migration(void) {
+    pthread_mutex_lock(&migration_lock);
+    migration_pending = 1;
+    pthread_cond_signal(&migration_cond);
+    pthread_mutex_unlock(&migration_lock);
+}
+
+// Move the misplaced keys of one shard. Returns how many were found and adds
+// the ones handed over to *moved.
+static size_t migrate_shard(int shard, size_t *moved) {
+    static BatchItem items[SHARD_CAPACITY], batch[SHARD_CAPACITY];  // Migration thread only
+    static char dest[SHARD_CAPACITY][NODE_NAME_LEN];
+    size_t n = 0;
     pthread_mutex_lock(&locks[shard]);
     for (int i = 0; i < store_size[shard]; i++) {
-        if (strcmp(store[shard][i].key, key) == 0) {
-            pthread_mutex_unlock(&locks[shard]);
-            return store[shard][i].value;
+        if (!key_owner(store[shard][i].key, dest[n])) {
+            memcpy(items[n].key, store[shard][i].key, sizeof(items[n].key));
+            items[n].value = value_ref(store[shard][i].value);
+            n++;
         }
     }
     pthread_mutex_unlock(&locks[shard]);
-    return NULL;
-}
-*/
-/*
-const char *get_value(const char *key) {
-    if (key == NULL) return NULL; // Ensure key is not NULL
-
-    int shard = hash_key(key);
-    pthread_mutex_lock(&locks[shard]);
 
-    for (int i = 0; i < store_size[shard]; i++) {
-        if (strcmp(store[shard][i].key, key) == 0) {
-            pthread_mutex_unlock(&locks[shard]);
-            return store[shard][i].value; // Ensure returned value exists
+    // One POST per destination, split so each body fits the receiver's
+    // MAX_REQUEST_BODY; dest[] entries are cleared once batched
+    for (size_t i = 0; i < n; i++) {
+        if (!dest[i][0]) continue;
+        char node[NODE_NAME_LEN];
+        memcpy(node, dest[i], NODE_NAME_LEN);
+        size_t count = 0, bytes = 4;
+        for (size_t j = i; j < n; j++) {
+            if (strcmp(dest[j], node) != 0) continue;
+            size_t item = 6 + strlen(items[j].key) + items[j].value->len;
+            if (count > 0 && bytes + item > MAX_REQUEST_BODY) continue;  // Left for a later POST
+            bytes += item;
+            batch[count++] = items[j];          // Borrows items[j]'s reference
+            dest[j][0] = '\0';
         }
+        size_t len;
+        char *body = encode_binary_response(batch, count, &len);
+        if (!body) continue;
+        int status = http_post(node, "/migrate", body, len, HTTP_CONNECTION_TIMEOUT * 1000, NULL, NULL);
+        free(body);
+        if (status != MHD_HTTP_OK) {
+            printf("Migration of %zu key(s) to %s failed (status %d)\n", count, node, status);
+            continue;
+        }
+        if (store_write(RAFT_OP_REMOVE, batch, count) == 0) *moved += count;
     }
+    batch_release(items, n);
+    return n;
+}
 
-    pthread_mutex_unlock(&locks[shard]);
-    return NULL;
+static uint64_t current_ring_generation(void) {
+    pthread_rwlock_rdlock(&ring_lock);
+    uint64_t generation = ring_generation;
+    pthread_rwlock_unlock(&ring_lock);
+    return generation;
 }
-*/
-const char *get_value(const char *key) {
-    
-    static char return_value[256]; // Ensure memory does not get freed
-    
-    int shard = hash_key(key);
-    pthread_mutex_lock(&locks[shard]);
-    
-    for (int i = 0; i < store_size[shard]; i++) {
-        if (strcmp(store[shard][i].key, key) == 0) {
-            strncpy(return_value, store[shard][i].value, 256);
-            pthread_mutex_unlock(&locks[shard]);
-            return return_value; // Returning valid memory
+
+// Report a clean migration pass at `generation` to every member (see
+// ring_migrated). Returns how many could not be told.
+static int announce_migrated(uint64_t generation) {
+    char nodes[MAX_NODES][NODE_NAME_LEN], path[NODE_NAME_LEN + 64];
+    pthread_rwlock_rdlock(&ring_lock);
+    int count = members.node_count;
+    memcpy(nodes, members.nodes, (size_t)count * NODE_NAME_LEN);
+    pthread_rwlock_unlock(&ring_lock);
+    snprintf(path, sizeof(path), "/ring/migrated?node=%s&generation=%llu", self_name,
+             (unsigned long long)generation);
+    int failed = 0;
+    for (int i = 0; i < count; i++) {
+        if (strcmp(nodes[i], self_name) == 0) continue;
+        failed += http_post(nodes[i], path, "", 0, HTTP_CONNECTION_TIMEOUT * 1000, NULL, NULL) != MHD_HTTP_OK;
+    }
+    ring_migrated(self_name, generation);
+    return failed;
+}
+
+static void *migration_worker(void *arg) {
+    (void)arg;
+    for (;;) {
+        pthread_mutex_lock(&migration_lock);
+        while (!migration_pending) pthread_cond_wait(&migration_cond, &migration_lock);
+        migration_pending = 0;
+        pthread_mutex_unlock(&migration_lock);
+
+        // Passes repeat until nothing is misplaced; keys rewritten during a
+        // pass, or refused by an unreachable owner, are picked up by the next
+        size_t found;
+        uint64_t generation;
+        do {
+            size_t moved = 0;
+            found = 0;
+            generation = 0;
+            // In a replication group the leader moves keys for everyone
+            if (raft.enabled && atomic_load(&raft.role) != RAFT_LEADER) break;
+            generation = current_ring_generation();
+            for (int shard = 0; shard < SHARD_COUNT; shard++) found += migrate_shard(shard, &moved);
+            atomic_store(&misplaced_keys, found - moved);
+            if (found && !moved) sleep(MIGRATION_RETRY_SECONDS);
+        } while (found);
+        // A clean pass under an unchanged ring lets the members drop the views
+        // this node held keys under; repeated until every member heard it
+        if (generation && generation == current_ring_generation() && announce_migrated(generation) != 0) {
+            sleep(MIGRATION_RETRY_SECONDS);
+            request_migration();
         }
     }
-    
-    pthread_mutex_unlock(&locks[shard]);
     return NULL;
 }
 
+// POST /migrate: keys pushed by their previous owner (binary /mset body)
+static int handle_migrate_request(struct MHD_Connection *connection, const RequestBody *body) {
+    if (body->too_large || body->len == 0) {
+        return MHD_queue_response(connection, MHD_HTTP_BAD_REQUEST, resp_invalid_batch);
+    }
+    char leader[NODE_NAME_LEN];
+    int route = raft_route(1, leader);
+    if (route != 0) return queue_not_leader(connection, route, leader, "/migrate", 0);
+    BatchItem *items = malloc(MAX_BATCH_KEYS * sizeof(BatchItem));
+    if (!items) return MHD_NO;
+    long count = parse_batch_request(body, 1, 1, items);
+    // A sender with a different ring view retries once the views agree
+    int ret = count < 0 ? -3 : !batch_is_local(items, (size_t)count) ? -4
+                             : store_write(RAFT_OP_MIGRATE, items, (size_t)count);
+    batch_release(items, count < 0 ? MAX_BATCH_KEYS : (size_t)count);
+    free(items);
+    if (ret == -3) return MHD_queue_response(connection, MHD_HTTP_BAD_REQUEST, resp_invalid_batch);
+    if (ret == -4) return MHD_queue_response(connection, MHD_HTTP_MISDIRECTED_REQUEST, resp_misdirected);
+    return MHD_queue_response(connection, ret == 0 ? MHD_HTTP_OK : MHD_HTTP_SERVICE_UNAVAILABLE,
+                              ret == 0 ? resp_success : ret == -1 ? resp_store_full : resp_no_leader);
+}
+
+// GET /ring: this node's view of the cluster
+static int handle_ring_request(struct MHD_Connection *connection) {
+    cJSON *result = cJSON_CreateObject();
+    cJSON *nodes = cJSON_CreateArray();
+    if (!result || !nodes || !cJSON_AddItemToObject(result, "nodes", nodes)) {
+        cJSON_Delete(result);
+        cJSON_Delete(nodes);
+        return MHD_NO;
+    }
+    pthread_rwlock_rdlock(&ring_lock);
+    for (int i = 0; i < members.node_count; i++) {
+        cJSON_AddItemToArray(nodes, cJSON_CreateString(members.nodes[i]));
+    }
+    uint64_t generation = ring_generation;
+    int handoff = handoff_count;
+    pthread_rwlock_unlock(&ring_lock);
+    cJSON_AddStringToObject(result, "self", self_name);
+    cJSON_AddNumberToObject(result, "vnodes", VNODES_PER_NODE);
+    cJSON_AddNumberToObject(result, "generation", (double)generation);
+    cJSON_AddNumberToObject(result, "handoff_views", handoff);
+    cJSON_AddNumberToObject(result, "misplaced_keys", (double)atomic_load(&misplaced_keys));
+    char *text = cJSON_PrintUnformatted(result);
+    cJSON_Delete(result);
+    struct MHD_Response *resp = text ? MHD_create_response_from_buffer_with_free_callback(strlen(text), text,
+                                                                                           free_json_text) : NULL;
+    if (!resp) {
+        if (text) cJSON_free(text);
+        return MHD_NO;
+    }
+    MHD_add_response_header(resp, MHD_HTTP_HEADER_CONTENT_TYPE, "application/json");
+    int ret = MHD_queue_response(connection, MHD_HTTP_OK, resp);
+    MHD_destroy_response(resp);
+    return ret;
+}
 
 // ----------------------
 // Handle HTTP Requests (PUT/GET)
@@ -130,59 +2477,145 @@ static int request_handler(void *cls, struct MHD_Connection *connection,
     struct MHD_Response *resp;
     int ret;
 
-    // Debug: Print incoming request
-    printf("Received %s request at %s\n", method, url);
+    // Collect the request body: libmicrohttpd delivers it over several calls
+    RequestBody *body = *con_cls;
+    if (!body) {
+        body = calloc(1, sizeof(*body));
+        if (!body) return MHD_NO;
+        *con_cls = body;
+        // Debug: Print incoming request (not the replicas' own traffic)
+        if (strncmp(url, "/raft/", 6) != 0) printf("Received %s request at %s\n", method, url);
+        return MHD_YES;
+    }
+    if (*upload_data_size > 0) {
+        request_body_append(body, upload_data, *upload_data_size);
+        *upload_data_size = 0;
+        return MHD_YES;
+    }
+
+    if (strcmp(method, "POST") == 0 && strcmp(url, "/mget") == 0) {
+        return handle_batch_request(connection, body, 0);
+    }
+    if (strcmp(method, "POST") == 0 && strcmp(url, "/mset") == 0) {
+        return handle_batch_request(connection, body, 1);
+    }
+    if (strcmp(method, "POST") == 0 && strncmp(url, "/raft/", 6) == 0) {
+        return handle_raft_rpc(connection, url, body);
+    }
+    if (strcmp(method, "GET") == 0 && strcmp(url, "/raft") == 0) {
+        return handle_raft_status(connection);
+    }
+    if (strcmp(method, "POST") == 0 && strcmp(url, "/migrate") == 0) {
+        return handle_migrate_request(connection, body);
+    }
+    if (strcmp(method, "GET") == 0 && strcmp(url, "/ring") == 0) {
+        return handle_ring_request(connection);
+    }
+    // POST /ring/join?node=host:port and /ring/leave?node=host:port; sent to
+    // every member so they all build the same ring
+    if (strcmp(method, "POST") == 0 && (strcmp(url, "/ring/join") == 0 || strcmp(url, "/ring/leave") == 0)) {
+        const char *node = MHD_lookup_connection_value(connection, MHD_GET_ARGUMENT_KIND, "node");
+        if (!node || !strchr(node, ':') || ring_change(node, url[6] == 'j') != 0) {
+            return MHD_queue_response(connection, MHD_HTTP_BAD_REQUEST, resp_invalid);
+        }
+        return MHD_queue_response(connection, MHD_HTTP_OK, resp_success);
+    }
+    // POST /ring/migrated?node=host:port&generation=N: node moved out its
+    // misplaced keys at ring generation N (see migration_worker)
+    if (strcmp(method, "POST") == 0 && strcmp(url, "/ring/migrated") == 0) {
+        const char *node = MHD_lookup_connection_value(connection, MHD_GET_ARGUMENT_KIND, "node");
+        const char *generation = MHD_lookup_connection_value(connection, MHD_GET_ARGUMENT_KIND, "generation");
+        uint64_t at = generation ? strtoull(generation, NULL, 10) : 0;
+        if (!node || at == 0) return MHD_queue_response(connection, MHD_HTTP_BAD_REQUEST, resp_invalid);
+        return ring_migrated(node, at) == 0 ? MHD_queue_response(connection, MHD_HTTP_OK, resp_success)
+                                            : MHD_queue_response(connection, MHD_HTTP_CONFLICT, resp_invalid);
+    }
 
     if (strcmp(method, "PUT") == 0) {
         //char key[256], value[256];
 
-        if (*upload_data_size == 0) {
+        if (body->len == 0 || body->too_large) {
             printf("Error: Empty request body\n");
-            return MHD_NO;
+            return MHD_queue_response(connection, MHD_HTTP_BAD_REQUEST, resp_invalid);
         }
 
         //sscanf(upload_data, "{ \"key\": \"%255[^\"]\", \"value\": \"%255[^\"]\" }", key, value);
 
-	char key[256] = {0}, value[256] = {0};
-	printf("Received Data: %s\n", upload_data); // Debugging
+	printf("Received Data: %s\n", body->data); // Debugging
 
-	if (sscanf(upload_data, "{ \"key\": \"%255[^\"]\", \"value\": \"%255[^\"]\" }", key, value) != 2) {
+	// Parsed with cJSON so values are not limited by a fixed scan width
+	cJSON *root = cJSON_ParseWithLength(body->data, body->len);
+	const cJSON *key = cJSON_GetObjectItemCaseSensitive(root, "key");
+	const cJSON *value = cJSON_GetObjectItemCaseSensitive(root, "value");
+	if (!cJSON_IsString(key) || !cJSON_IsString(value) || !*key->valuestring || strlen(key->valuestring) >= 256) {
     		printf("Error: Malformed JSON input\n");
-    		return MHD_NO;
+    		cJSON_Delete(root);
+    		return MHD_queue_response(connection, MHD_HTTP_BAD_REQUEST, resp_invalid);
+	}
+	// Rejected like /mset does, rather than as a full shard when value_create() refuses it
+	if (strlen(value->valuestring) > MAX_VALUE_SIZE) {
+    		cJSON_Delete(root);
+    		return MHD_queue_response(connection, MHD_HTTP_BAD_REQUEST, resp_value_too_large);
 	}
 
-	put_value(key, value);
+	char owner[NODE_NAME_LEN];
+	if (!key_owner(key->valuestring, owner)) {
+    		cJSON_Delete(root);
+    		return queue_redirect(connection, owner, url, 0);
+	}
+	int route = raft_route(1, owner);
+	if (route != 0) {
+    		cJSON_Delete(root);
+    		return queue_not_leader(connection, route, owner, url, 0);
+	}
 
-        const char *response = "{ \"status\": \"success\" }";
-        resp = MHD_create_response_from_buffer(strlen(response), (void *)response, MHD_RESPMEM_PERSISTENT);
-        ret = MHD_queue_response(connection, MHD_HTTP_OK, resp);
-        MHD_destroy_response(resp);
-        return ret;
+	BatchItem item = { .value = value_create(key->valuestring, value->valuestring, strlen(value->valuestring)) };
+	snprintf(item.key, sizeof(item.key), "%s", key->valuestring);
+	cJSON_Delete(root);
+	int stored = item.value ? store_write(RAFT_OP_PUT, &item, 1) : -1;
+	value_release(item.value);
+	if (stored != 0) {
+            return MHD_queue_response(connection, MHD_HTTP_SERVICE_UNAVAILABLE,
+                                      stored == -1 ? resp_store_full : resp_no_leader);
+	}
+
+        return MHD_queue_response(connection, MHD_HTTP_OK, resp_success);
     }
 
     if (strncmp(url, "/get/", 5) == 0) {
         const char *key = url + 5;
-        const char *value = get_value(key);
-        char response[512];
-
-        if (value) {
-            snprintf(response, sizeof(response), "{ \"key\": \"%s\", \"value\": \"%s\" }", key, value);
-        } else {
-            snprintf(response, sizeof(response), "{ \"error\": \"Key not found\" }");
+        char owner[NODE_NAME_LEN];
+        uint64_t handoff = handoff_generation(connection);
+        if (!handoff && !key_owner(key, owner)) {
+            return queue_redirect(connection, owner, url, 0);
+        }
+        // A leader with a lease answers from local state
+        int route = raft_route(0, owner);
+        if (route != 0) return queue_not_leader(connection, route, owner, url, handoff);
+        ValueBuffer *value = get_value(key);
+        if (!value) {
+            // Not moved here yet: a previous owner may still hold it
+            uint64_t generation;
+            if (key_previous_owner(key, handoff ? handoff : UINT64_MAX, owner, &generation)) {
+                return queue_redirect(connection, owner, url, generation);
+            }
+            return MHD_queue_response(connection, MHD_HTTP_OK, resp_not_found);
         }
 
-        resp = MHD_create_response_from_buffer(strlen(response), (void *)response, MHD_RESPMEM_PERSISTENT);
+        // The stored body goes out as is; libmicrohttpd drops our reference when done
+        resp = MHD_create_response_from_buffer_with_free_callback(value->body_len, value->data,
+                                                                  value_release_body);
+        if (!resp) {
+            value_release(value);
+            return MHD_NO;
+        }
         ret = MHD_queue_response(connection, MHD_HTTP_OK, resp);
         MHD_destroy_response(resp);
         return ret;
     }
 
     // Default error response
-    const char *error_msg = "{ \"error\": \"Invalid Request\" }";
-    resp = MHD_create_response_from_buffer(strlen(error_msg), (void *)error_msg, MHD_RESPMEM_PERSISTENT);
-    ret = MHD_queue_response(connection, MHD_HTTP_BAD_REQUEST, resp);
-    MHD_destroy_response(resp);
-    return ret;
+    return MHD_queue_response(connection, MHD_HTTP_BAD_REQUEST, resp_invalid);
 }
 
 /*
@@ -231,23 +2664,127 @@ static int request_handler(void *cls, struct MHD_Connection *connection,
 // ----------------------
 // Main Function: Start Server
 // ----------------------
-int main() {
+// Usage: ./kv_store [--http-mode=threads|epoll] [--http-threads=N]
+//                   [--self=ip:port] [--peer=ip:port ...]
+//                   [--raft-self=ip:port --raft-peer=ip:port ... [--raft-dir=path]]
+//   threads: one thread per connection (default)
+//   epoll:   keep-alive connections multiplexed over an epoll worker pool,
+//            N workers (default: one per online CPU)
+//   --self:  this node's ring name and listen port (default 127.0.0.1:8080)
+//   --peer:  another member of the initial ring; every node is started with
+//            the same member list
+//   --raft-self, --raft-peer, --raft-dir: run as a replica of a Raft group
+//            (this replica's address and listen port, the other replicas', and
+//            where log and snapshots are kept, default "."). All replicas of
+//            a group share one --self name on the ring. Requires threads mode.
+int main(int argc, char **argv) {
     struct MHD_Daemon *server;
+    int use_epoll = 0;
+    int http_threads = 0;
+    char peers[MAX_NODES][NODE_NAME_LEN];
+    int peer_count = 1;              // peers[0] is this node
+
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--http-mode=epoll") == 0) {
+            use_epoll = 1;
+        } else if (strcmp(argv[i], "--http-mode=threads") == 0) {
+            use_epoll = 0;
+        } else if (strncmp(argv[i], "--http-threads=", 15) == 0) {
+            http_threads = atoi(argv[i] + 15);
+        } else if (strncmp(argv[i], "--self=", 7) == 0 && strchr(argv[i] + 7, ':') &&
+                   strlen(argv[i] + 7) < NODE_NAME_LEN) {
+            snprintf(self_name, sizeof(self_name), "%s", argv[i] + 7);
+        } else if (strncmp(argv[i], "--peer=", 7) == 0 && strchr(argv[i] + 7, ':') &&
+                   strlen(argv[i] + 7) < NODE_NAME_LEN && peer_count < MAX_NODES) {
+            snprintf(peers[peer_count++], NODE_NAME_LEN, "%s", argv[i] + 7);
+        } else if (strncmp(argv[i], "--raft-self=", 12) == 0 && strchr(argv[i] + 12, ':') &&
+                   strlen(argv[i] + 12) < NODE_NAME_LEN) {
+            snprintf(raft.self, sizeof(raft.self), "%s", argv[i] + 12);
+        } else if (strncmp(argv[i], "--raft-peer=", 12) == 0 && strchr(argv[i] + 12, ':') &&
+                   strlen(argv[i] + 12) < NODE_NAME_LEN && raft.peer_count < MAX_NODES) {
+            snprintf(raft.peers[raft.peer_count++].addr, NODE_NAME_LEN, "%s", argv[i] + 12);
+        } else if (strncmp(argv[i], "--raft-dir=", 11) == 0 && strlen(argv[i] + 11) < sizeof(raft.dir)) {
+            snprintf(raft.dir, sizeof(raft.dir), "%s", argv[i] + 11);
+        } else {
+            printf("Usage: %s [--http-mode=threads|epoll] [--http-threads=N] "
+                   "[--self=ip:port] [--peer=ip:port ...] "
+                   "[--raft-self=ip:port --raft-peer=ip:port ... [--raft-dir=path]]\n", argv[0]);
+            return 1;
+        }
+    }
+    if (raft.peer_count > 0 && !raft.self[0]) {
+        printf("--raft-peer needs --raft-self\n");
+        return 1;
+    }
+    if (use_epoll && raft.self[0]) {
+        // Raft writes wait for a quorum inside the handler, which would stall every
+        // connection sharing that epoll worker
+        printf("--http-mode=epoll cannot be used with --raft-self; use --http-mode=threads\n");
+        return 1;
+    }
+    if (!raft.dir[0]) snprintf(raft.dir, sizeof(raft.dir), ".");
+    snprintf(peers[0], NODE_NAME_LEN, "%s", self_name);
+    int unique = 1;
+    for (int i = 1; i < peer_count; i++) {
+        int seen = 0;
+        for (int j = 0; j < unique; j++) seen |= strcmp(peers[i], peers[j]) == 0;
+        if (!seen) memcpy(peers[unique++], peers[i], NODE_NAME_LEN);
+    }
+    peer_count = unique;
+    const char *listen_addr = raft.self[0] ? raft.self : self_name;
+    uint16_t port = (uint16_t)atoi(strrchr(listen_addr, ':') + 1);
+
     for (int i = 0; i < SHARD_COUNT; i++) {
         pthread_mutex_init(&locks[i], NULL);
     }
-    
-    server = MHD_start_daemon(MHD_USE_THREAD_PER_CONNECTION, PORT, NULL, NULL,
-                              &request_handler, NULL, MHD_OPTION_END);
+    if (init_static_responses() != 0) {
+        printf("Failed to allocate HTTP responses\n");
+        return 1;
+    }
+    if (init_shard_ring() != 0 ||
+        membership_set(&members, (const char (*)[NODE_NAME_LEN])peers, peer_count) != 0) {
+        printf("Failed to build the hash ring\n");
+        return 1;
+    }
+    if (raft.self[0] && raft_start() != 0) {
+        printf("Failed to start Raft replication in %s\n", raft.dir);
+        return 1;
+    }
+    pthread_t migration_thread;
+    if (pthread_create(&migration_thread, NULL, migration_worker, NULL) != 0) {
+        printf("Failed to start the migration thread\n");
+        return 1;
+    }
+    pthread_detach(migration_thread);
+
+    if (use_epoll) {
+        unsigned int threads = http_threads > 0 ? (unsigned int)http_threads
+                                                : (unsigned int)sysconf(_SC_NPROCESSORS_ONLN);
+        server = MHD_start_daemon(MHD_USE_EPOLL_INTERNAL_THREAD | MHD_USE_TURBO, port, NULL, NULL,
+                                  &request_handler, NULL,
+                                  MHD_OPTION_NOTIFY_COMPLETED, &request_completed, NULL,
+                                  MHD_OPTION_THREAD_POOL_SIZE, threads,
+                                  MHD_OPTION_CONNECTION_LIMIT, (unsigned int)HTTP_CONNECTION_LIMIT,
+                                  MHD_OPTION_CONNECTION_TIMEOUT, (unsigned int)HTTP_CONNECTION_TIMEOUT,
+                                  MHD_OPTION_END);
+        if (server) printf("HTTP front end: epoll with %u worker threads\n", threads);
+    } else {
+        server = MHD_start_daemon(MHD_USE_THREAD_PER_CONNECTION, port, NULL, NULL,
+                                  &request_handler, NULL,
+                                  MHD_OPTION_NOTIFY_COMPLETED, &request_completed, NULL,
+                                  MHD_OPTION_CONNECTION_TIMEOUT, (unsigned int)HTTP_CONNECTION_TIMEOUT,
+                                  MHD_OPTION_END);
+    }
     
     if (!server) {
         printf("Failed to start server\n");
         return 1;
     }
     
-    printf("Server running on port %d\n", PORT);
+    printf("Server running on port %u as %s (%d ring member(s))\n", port, self_name, peer_count);
     getchar();
     MHD_stop_daemon(server);
+    destroy_static_responses();
     return 0;
 }
 